@@ -0,0 +1,256 @@
+#!/usr/bin/env python3
+"""HTTP load test for the gas meter's web server.
+
+Opens N keep-alive clients that poll GET routes back to back and reports latency
+percentiles and errors per route. esp_http_server keeps up to five connections open
+but runs all handlers in its one task, so the clients are served in turn. With
+--firmware, one extra client uploads that image to /update meanwhile, which shows how
+long the other routes stall during an OTA upload.
+
+Pulses are injected while the clients poll, and the run fails (exit code 1) unless
+every one of them is counted:
+  --selftest   starts the pulse self-test on the virtual input (POST /api/selftest,
+               pin=0, load=0), which the sampling job reads next to the reed contact,
+               and polls until the sweep is done. Every step the meter can produce
+               (pulse and gap at least PULSE_MIN_MS) must count exactly what the
+               generator made. The clients keep polling until then.
+  --pulses N   for an external pulse source on the reed input: pulseCount in
+               /api/status must grow by exactly N between start and end of the run.
+               Start the source after "ready" is printed and let it finish before
+               the run ends.
+
+    python3 http_load_test.py 192.168.178.50 --clients 4 --selftest
+    python3 http_load_test.py 192.168.178.50 --seconds 60 --pulses 500
+    python3 http_load_test.py 192.168.178.50 --firmware .pio/build/lilygo-t-display/firmware.bin
+
+Only the standard library is used. The summary is printed as JSON.
+"""
+import argparse
+import hashlib
+import http.client
+import json
+import sys
+import threading
+import time
+import urllib.parse
+
+DEFAULT_ROUTES = ["/api/status", "/metrics", "/api/settings", "/"]
+# Shortest pulse and gap the sampling job (every 50 ms) is specified to see
+PULSE_MIN_MS = 100
+
+
+def percentile(sorted_values, p):
+    if not sorted_values:
+        return None
+    return sorted_values[min(len(sorted_values) - 1, int(p * (len(sorted_values) - 1) + 0.5))]
+
+
+class RouteStats:
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.latencies = []
+        self.errors = 0
+        self.bytes = 0
+
+    def add(self, seconds, size):
+        with self.lock:
+            self.latencies.append(seconds)
+            self.bytes += size
+
+    def fail(self):
+        with self.lock:
+            self.errors += 1
+
+    def summary(self, elapsed):
+        values = sorted(self.latencies)
+        ms = lambda v: None if v is None else round(v * 1000, 1)
+        return {
+            "requests": len(values),
+            "errors": self.errors,
+            "perSecond": round(len(values) / elapsed, 2),
+            "bytes": self.bytes,
+            "p50Ms": ms(percentile(values, 0.50)),
+            "p95Ms": ms(percentile(values, 0.95)),
+            "p99Ms": ms(percentile(values, 0.99)),
+            "maxMs": ms(values[-1] if values else None),
+        }
+
+
+def poll(host, port, routes, offset, stats, deadline, stop, timeout):
+    conn = None
+    i = offset
+    while time.monotonic() < deadline and not stop.is_set():
+        route = routes[i % len(routes)]
+        i += 1
+        try:
+            if conn is None:
+                conn = http.client.HTTPConnection(host, port, timeout=timeout)
+            start = time.monotonic()
+            conn.request("GET", route, headers={"Connection": "keep-alive"})
+            response = conn.getresponse()
+            body = response.read()
+            if response.status != 200:
+                stats[route].fail()
+            else:
+                stats[route].add(time.monotonic() - start, len(body))
+            if response.getheader("Connection", "").lower() == "close":
+                conn.close()
+                conn = None
+        except (OSError, http.client.HTTPException):
+            stats[route].fail()
+            if conn is not None:
+                conn.close()
+            conn = None
+    if conn is not None:
+        conn.close()
+
+
+def request_json(host, port, method, path, form=None, timeout=10):
+    conn = http.client.HTTPConnection(host, port, timeout=timeout)
+    try:
+        body = urllib.parse.urlencode(form) if form is not None else None
+        headers = {"Content-Type": "application/x-www-form-urlencoded"} if form is not None else {}
+        conn.request(method, path, body=body, headers=headers)
+        response = conn.getresponse()
+        data = response.read()
+        if response.status != 200:
+            raise RuntimeError("%s %s: HTTP %d %s" % (method, path, response.status, data[:200]))
+        return json.loads(data)
+    finally:
+        conn.close()
+
+
+def pulse_count(host, port):
+    return request_json(host, port, "GET", "/api/status")["pulseCount"]
+
+
+def run_selftest(host, port, step_seconds, result, stop):
+    """Runs the self-test sweep to the end; stop is set when it is over."""
+    try:
+        request_json(host, port, "POST", "/api/selftest",
+                     {"pin": 0, "stepSeconds": step_seconds, "load": 0})
+        status = {}
+        # 18 steps plus settling; give up well after that
+        deadline = time.monotonic() + 18 * (step_seconds + 5) + 60
+        while time.monotonic() < deadline:
+            time.sleep(2)
+            try:
+                status = request_json(host, port, "GET", "/api/selftest")
+            except (OSError, http.client.HTTPException, RuntimeError, ValueError):
+                continue
+            if status.get("state") in ("done", "stopped"):
+                break
+        result["state"] = status.get("state", "unknown")
+        result["steps"] = status.get("steps", [])
+        result["maxReliableHz"] = status.get("maxReliableHz")
+        result["minReliableWidthMs"] = status.get("minReliableWidthMs")
+    except (OSError, http.client.HTTPException, RuntimeError, ValueError) as e:
+        result["error"] = str(e)
+    finally:
+        stop.set()
+
+
+def selftest_failures(result):
+    """Steps within the meter's pulse envelope that did not count exactly."""
+    if result.get("state") != "done":
+        return ["self-test did not finish: %s" % result.get("error", result.get("state"))]
+    failures = []
+    for step in result["steps"]:
+        gap = step["periodMs"] - step["widthMs"]
+        if step["widthMs"] >= PULSE_MIN_MS and gap >= PULSE_MIN_MS and step["generated"] != step["counted"]:
+            failures.append("%.2f Hz / %d ms: generated %d, counted %d" % (
+                step["hz"], step["widthMs"], step["generated"], step["counted"]))
+    return failures
+
+
+def upload(host, port, image, result, timeout):
+    digest = hashlib.sha256(image).hexdigest()
+    start = time.monotonic()
+    try:
+        conn = http.client.HTTPConnection(host, port, timeout=timeout)
+        conn.request("POST", "/update", body=image, headers={
+            "Content-Type": "application/octet-stream",
+            "X-Firmware-SHA256": digest,
+        })
+        response = conn.getresponse()
+        result["status"] = response.status
+        result["response"] = response.read().decode(errors="replace")
+        conn.close()
+    except (OSError, http.client.HTTPException) as e:
+        result["error"] = str(e)
+    result["seconds"] = round(time.monotonic() - start, 2)
+    result["bytes"] = len(image)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("host")
+    parser.add_argument("--port", type=int, default=80)
+    parser.add_argument("--clients", type=int, default=4, help="concurrent keep-alive clients (default 4)")
+    parser.add_argument("--seconds", type=float, default=20, help="test duration (default 20)")
+    parser.add_argument("--routes", default=",".join(DEFAULT_ROUTES), help="comma-separated GET routes")
+    parser.add_argument("--timeout", type=float, default=10, help="per-request timeout in seconds")
+    parser.add_argument("--firmware", help="also upload this image to /update (the device restarts on success)")
+    parser.add_argument("--selftest", action="store_true",
+                        help="inject pulses with the self-test on the virtual input and run until it is done")
+    parser.add_argument("--step-seconds", type=int, default=5, help="self-test step length (5-600, default 5)")
+    parser.add_argument("--pulses", type=int,
+                        help="pulses an external source feeds to the reed input during the run")
+    parser.add_argument("--settle", type=float, default=3,
+                        help="seconds to wait for the last pulse before reading pulseCount (default 3)")
+    args = parser.parse_args()
+
+    routes = [r for r in args.routes.split(",") if r]
+    stats = {route: RouteStats() for route in routes}
+    stop = threading.Event()
+    count_before = pulse_count(args.host, args.port)
+    # the self-test decides when the run ends
+    deadline = float("inf") if args.selftest else time.monotonic() + args.seconds
+    threads = [threading.Thread(target=poll,
+                                args=(args.host, args.port, routes, n, stats, deadline, stop, args.timeout))
+               for n in range(args.clients)]
+    selftest_result = {}
+    if args.selftest:
+        threads.append(threading.Thread(target=run_selftest,
+                                        args=(args.host, args.port, args.step_seconds, selftest_result, stop)))
+    upload_result = {}
+    if args.firmware:
+        with open(args.firmware, "rb") as f:
+            image = f.read()
+        threads.append(threading.Thread(target=upload, args=(args.host, args.port, image, upload_result, 120)))
+    start = time.monotonic()
+    for t in threads:
+        t.start()
+    print("ready", file=sys.stderr, flush=True)
+    for t in threads:
+        t.join()
+    elapsed = time.monotonic() - start
+    time.sleep(args.settle)
+    count_after = pulse_count(args.host, args.port)
+
+    report = {
+        "host": args.host,
+        "clients": args.clients,
+        "seconds": round(elapsed, 2),
+        "routes": {route: s.summary(elapsed) for route, s in stats.items()},
+    }
+    if args.firmware:
+        report["upload"] = upload_result
+
+    failures = []
+    # a real meter pulse during the self-test also shows up here, so it is only checked with --pulses
+    report["pulseCount"] = {"before": count_before, "after": count_after, "counted": count_after - count_before}
+    if args.pulses is not None:
+        report["pulseCount"]["expected"] = args.pulses
+        if count_after - count_before != args.pulses:
+            failures.append("pulseCount grew by %d, expected %d" % (count_after - count_before, args.pulses))
+    if args.selftest:
+        report["selftest"] = selftest_result
+        failures += selftest_failures(selftest_result)
+    report["failures"] = failures
+    print(json.dumps(report, indent=2))
+    sys.exit(1 if failures else 0)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,266 @@
+/*
+ * Receiver and latency benchmark for the gas meter's UDP pulse datagrams.
+ *
+ *   cc -O2 -o udp_pulse_receiver udp_pulse_receiver.c -lm
+ *   ./udp_pulse_receiver [-p port] [-g multicast-group] [-n count] [-q]
+ *
+ * Prints one line per datagram and, on Ctrl-C or after -n datagrams, a summary with
+ * lost/duplicate/reordered datagrams and the delivery latency distribution.
+ *
+ * Latency: device and host clocks are not synchronised, so the one-way delay is known
+ * only up to a constant. The receive time (kernel timestamp) minus the device timestamp
+ * is fitted linearly over the run, which removes the offset and the clock drift; the
+ * residuals above the fastest delivery are reported as latency. This is the delay added
+ * by WiFi, the device's send path and the network on top of the best case.
+ */
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <errno.h>
+#include <math.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Same layout as PulseDatagram in include/PulseBroadcaster.h (little-endian) */
+#define DATAGRAM_SIZE 24
+#define DATAGRAM_VERSION 1
+#define MAX_SAMPLES 1000000
+
+static volatile sig_atomic_t stop;
+
+static void on_signal(int sig)
+{
+    (void)sig;
+    stop = 1;
+}
+
+static uint32_t le32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static uint64_t le64(const uint8_t *p)
+{
+    return (uint64_t)le32(p) | (uint64_t)le32(p + 4) << 32;
+}
+
+static int compare_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double percentile(const double *sorted, size_t n, double p)
+{
+    size_t i = (size_t)(p * (n - 1) + 0.5);
+    return sorted[i];
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [-p port] [-g multicast-group] [-n count] [-q]\n", name);
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    int port = 4210;
+    const char *group = NULL;
+    long limit = 0;
+    int quiet = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "p:g:n:q")) != -1)
+    {
+        switch (opt)
+        {
+        case 'p': port = atoi(optarg); break;
+        case 'g': group = optarg; break;
+        case 'n': limit = atol(optarg); break;
+        case 'q': quiet = 1; break;
+        default: usage(argv[0]);
+        }
+    }
+
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0)
+    {
+        perror("socket");
+        return 1;
+    }
+    int on = 1;
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    setsockopt(sock, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on));
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        perror("bind");
+        return 1;
+    }
+    if (group)
+    {
+        struct ip_mreq mreq = {0};
+        if (inet_aton(group, &mreq.imr_multiaddr) == 0)
+        {
+            fprintf(stderr, "invalid group %s\n", group);
+            return 1;
+        }
+        mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+        if (setsockopt(sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0)
+        {
+            perror("IP_ADD_MEMBERSHIP");
+            return 1;
+        }
+    }
+    struct sigaction sa = {0};
+    sa.sa_handler = on_signal; /* no SA_RESTART, so recvmsg() returns on Ctrl-C */
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    double *devUs = malloc(MAX_SAMPLES * sizeof(double));
+    double *delayUs = malloc(MAX_SAMPLES * sizeof(double));
+    if (!devUs || !delayUs)
+    {
+        perror("malloc");
+        return 1;
+    }
+    size_t samples = 0;
+    long received = 0, invalid = 0, lost = 0, duplicates = 0, reordered = 0;
+    int haveSeq = 0;
+    uint32_t nextSeq = 0;
+    uint64_t lastTimestampUs = 0;
+
+    while (!stop && (limit == 0 || received < limit))
+    {
+        uint8_t buf[64];
+        char control[256];
+        struct sockaddr_in from;
+        struct iovec iov = {buf, sizeof(buf)};
+        struct msghdr msg = {0};
+        msg.msg_name = &from;
+        msg.msg_namelen = sizeof(from);
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        ssize_t len = recvmsg(sock, &msg, 0);
+        if (len < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            perror("recvmsg");
+            break;
+        }
+
+        struct timespec rx;
+        clock_gettime(CLOCK_REALTIME, &rx);
+        for (struct cmsghdr *c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c))
+        {
+            if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_TIMESTAMPNS)
+                memcpy(&rx, CMSG_DATA(c), sizeof(rx));
+        }
+
+        if (len != DATAGRAM_SIZE || buf[0] != 'G' || buf[1] != 'P' || buf[2] != DATAGRAM_VERSION)
+        {
+            invalid++;
+            continue;
+        }
+        received++;
+        uint8_t channel = buf[3];
+        uint32_t seq = le32(buf + 4);
+        uint64_t timestampUs = le64(buf + 8);
+        uint32_t total = le32(buf + 16);
+        uint32_t intervalMs = le32(buf + 20);
+
+        /* Sequence and device clock both going back means the device rebooted */
+        if (!haveSeq || (seq < nextSeq && timestampUs < lastTimestampUs))
+        {
+            if (haveSeq && !quiet)
+                printf("# sequence restarted at %u (device rebooted?)\n", seq);
+            nextSeq = seq;
+            haveSeq = 1;
+            samples = 0; /* the device clock restarted too */
+        }
+        if (seq == nextSeq)
+        {
+            nextSeq++;
+        }
+        else if (seq > nextSeq)
+        {
+            lost += seq - nextSeq;
+            nextSeq = seq + 1;
+        }
+        else if (seq + 1 == nextSeq)
+        {
+            duplicates++;
+        }
+        else
+        {
+            reordered++;
+            if (lost > 0)
+                lost--; /* counted as lost when the gap was seen */
+        }
+        lastTimestampUs = timestampUs;
+
+        if (samples < MAX_SAMPLES)
+        {
+            devUs[samples] = (double)timestampUs;
+            delayUs[samples] = (rx.tv_sec * 1e6 + rx.tv_nsec / 1e3) - (double)timestampUs;
+            samples++;
+        }
+        if (!quiet)
+        {
+            printf("%s ch=%u seq=%u total=%u interval=%ums t=%.3fs\n", inet_ntoa(from.sin_addr), channel, seq, total,
+                   intervalMs, timestampUs / 1e6);
+            fflush(stdout);
+        }
+    }
+
+    printf("\nreceived %ld, lost %ld, duplicates %ld, reordered %ld, invalid %ld\n", received, lost, duplicates, reordered,
+           invalid);
+    if (samples < 3)
+    {
+        printf("too few datagrams for latency figures\n");
+        return 0;
+    }
+
+    /* least squares: delay = a + b * deviceTime */
+    double sx = 0, sy = 0, sxx = 0, sxy = 0;
+    for (size_t i = 0; i < samples; i++)
+    {
+        double x = devUs[i] - devUs[0];
+        sx += x;
+        sy += delayUs[i];
+        sxx += x * x;
+        sxy += x * delayUs[i];
+    }
+    double n = (double)samples;
+    double denom = n * sxx - sx * sx;
+    double b = denom != 0 ? (n * sxy - sx * sy) / denom : 0;
+    double a = (sy - b * sx) / n;
+    double minResidual = INFINITY;
+    for (size_t i = 0; i < samples; i++)
+    {
+        delayUs[i] -= a + b * (devUs[i] - devUs[0]);
+        if (delayUs[i] < minResidual)
+            minResidual = delayUs[i];
+    }
+    for (size_t i = 0; i < samples; i++)
+        delayUs[i] -= minResidual;
+    qsort(delayUs, samples, sizeof(double), compare_double);
+    printf("latency above best case (ms): p50 %.3f  p95 %.3f  p99 %.3f  max %.3f\n",
+           percentile(delayUs, samples, 0.50) / 1e3, percentile(delayUs, samples, 0.95) / 1e3,
+           percentile(delayUs, samples, 0.99) / 1e3, delayUs[samples - 1] / 1e3);
+    printf("clock drift device vs host: %.1f ppm over %zu datagrams\n", b * 1e6, samples);
+    free(devUs);
+    free(delayUs);
+    close(sock);
+    return 0;
+}
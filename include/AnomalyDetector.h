@@ -0,0 +1,100 @@
+#ifndef ANOMALY_DETECTOR_H
+#define ANOMALY_DETECTOR_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+// Thresholds as exchanged with the web API and /anomaly.json; 0 disables a rule
+struct AnomalyConfig {
+    uint16_t minGapMinutes = 30;    // leak: no pause at least this long within 24 h
+    uint16_t flowGapMinutes = 10;   // pulses closer than this count as one continuous flow
+    uint16_t maxFlowMinutes = 240;  // continuous flow longer than this
+    float deviationFactor = 3.0f;   // hour uses more than factor x its time-of-day baseline ...
+    uint16_t deviationMinPulses = 20; // ... and at least this many pulses above it
+};
+
+// Incremental anomaly rules on the gas meter's pulse stream. Memory is fixed (24 hourly slots for
+// the gap window, 24 time-of-day baselines) and a pulse costs O(1).
+//  - EWMA pulse rates with 5 and 60 minute time constants
+//  - longest pause between pulses within the last 24 h (hourly slots on uptime)
+//  - duration of the current continuous flow
+//  - pulses per hour compared with an EWMA baseline for the same hour of day
+class AnomalyDetector {
+public:
+    enum Alert : uint8_t {
+        ALERT_LEAK = 1 << 0,
+        ALERT_CONTINUOUS_FLOW = 1 << 1,
+        ALERT_UNUSUAL_USAGE = 1 << 2,
+    };
+    static const uint8_t ALERT_COUNT = 3;
+    static const char* alertName(uint8_t index);
+
+    struct Status {
+        uint8_t alerts;
+        float rateShort;           // pulses per hour
+        float rateLong;
+        uint32_t longestGapMs;     // within the last 24 h, including the current pause
+        uint32_t flowMs;           // 0 while no continuous flow
+        uint32_t observedMs;       // capped at 24 h; the leak rule waits for a full window
+        int16_t lastHourPulses;    // -1 until a full hour was seen
+        float lastHourBaseline;    // -1 while the baseline for that hour is not trained yet
+    };
+
+    AnomalyDetector();
+
+    void setConfig(const AnomalyConfig& config) { _config = config; }
+    const AnomalyConfig& config() const { return _config; }
+
+    void onPulse(unsigned long now);
+    // Advances the hourly slots and evaluates the rules; hourOfDay selects the baseline.
+    // Returns true if the alert set changed.
+    bool tick(unsigned long now, uint8_t hourOfDay);
+
+    // The hour of day jumped (clock set); the running hour is not a full baseline sample
+    void restartHour() { _partialHour = true; }
+
+    uint8_t alerts() const { return _alerts; }
+    Status status(unsigned long now) const;
+
+    static void configToJson(const AnomalyConfig& in, JsonObject out);
+    static void configFromJson(JsonObjectConst in, AnomalyConfig& out);
+    static void statusToJson(const Status& in, JsonObject out);
+
+private:
+    static const uint8_t SLOTS = 24;
+    static const uint32_t HOUR_MS = 60UL * 60 * 1000;
+    static const uint8_t BASELINE_MIN_DAYS = 3;
+
+    void closeHour();
+    uint32_t longestGap(unsigned long now) const;
+
+    AnomalyConfig _config;
+    unsigned long _startMs = 0;
+    unsigned long _lastPulseMs = 0;
+    bool _hasPulse = false;
+
+    float _rateShort = 0;
+    float _rateLong = 0;
+
+    // longest pause that ended in each uptime hour of the last day
+    uint32_t _gapMax[SLOTS] = {};
+    uint8_t _slot = 0;
+    unsigned long _slotStartMs = 0;
+
+    bool _flowing = false;
+    unsigned long _flowStartMs = 0;
+
+    // time-of-day baseline in pulses per hour
+    float _baseline[SLOTS] = {};
+    uint8_t _baselineDays[SLOTS] = {};
+    int8_t _hourOfDay = -1;
+    bool _partialHour = true; // the hour running at boot (or after a clock jump) is not a full sample
+    uint16_t _hourPulses = 0;
+    int16_t _lastHourPulses = -1;
+    float _lastHourBaseline = -1;
+    bool _unusual = false;
+
+    uint8_t _alerts = 0;
+};
+
+#endif // ANOMALY_DETECTOR_H
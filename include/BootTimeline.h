@@ -0,0 +1,48 @@
+#ifndef BOOT_TIMELINE_H
+#define BOOT_TIMELINE_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+// Boot phases, in the order they are normally reached
+enum BootMilestone : uint8_t {
+    BOOT_SPIFFS_MOUNTED,
+    BOOT_DATA_LOADED,
+    BOOT_COUNTING_STARTED,
+    BOOT_DISPLAY_READY,
+    BOOT_WIFI_CONNECTED,
+    BOOT_MQTT_CONNECTED,
+    BOOT_FIRST_PUBLISH,
+    BOOT_FIRST_PULSE,
+    BOOT_MILESTONE_COUNT
+};
+
+const char* bootMilestoneName(BootMilestone milestone);
+
+// millis() at which each boot phase was first reached (0 = not yet)
+class BootTimeline {
+public:
+    static const uint32_t FIRST_PUBLISH_TARGET_MS = 5000;
+
+    // Records the first occurrence only; returns true if this call recorded it
+    bool mark(BootMilestone milestone);
+    uint32_t at(BootMilestone milestone) const { return _at[milestone]; }
+    bool reached(BootMilestone milestone) const { return _at[milestone] != 0; }
+    // Changes whenever a milestone is recorded, so a report can be republished
+    uint8_t version() const { return _version; }
+
+    // How WiFi came up first: "cached", "full" or "portal"
+    void setWiFiPath(const char* path) { _wifiPath = path; }
+    const char* wifiPath() const { return _wifiPath; }
+
+    void toJson(JsonObject out) const;
+
+private:
+    volatile uint32_t _at[BOOT_MILESTONE_COUNT] = {};
+    const char* _wifiPath = "none";
+    volatile uint8_t _version = 0;
+};
+
+extern BootTimeline bootTimeline;
+
+#endif // BOOT_TIMELINE_H
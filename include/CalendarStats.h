@@ -0,0 +1,49 @@
+#ifndef CALENDAR_STATS_H
+#define CALENDAR_STATS_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <time.h>
+
+// Pulses per local calendar day, ISO week (Monday start) and month, with the previous period kept
+// for "yesterday"/"last week"/"last month". Counting is incremental; tick() rolls a period over once
+// the clock (SNTP, TZ from setenv/tzset) passed its boundary. Persisted so a reboot keeps the totals.
+class CalendarStats {
+public:
+    enum Period : uint8_t {
+        PERIOD_DAY,
+        PERIOD_WEEK,
+        PERIOD_MONTH,
+        PERIOD_COUNT
+    };
+    static const char* periodName(uint8_t period);
+
+    void onPulse();
+    // Needs a synced clock. Returns true if a period was rolled over.
+    bool tick(time_t now);
+
+    uint32_t current(uint8_t period) const { return _current[period]; }
+    // 0 if the device did not run through the whole previous period
+    uint32_t previous(uint8_t period) const { return _previous[period]; }
+    // Local start of the running period, 0 until the first tick() with a synced clock
+    time_t start(uint8_t period) const { return _start[period]; }
+
+    // Local start of the period containing now, or 'back' periods before it
+    static time_t periodStart(time_t now, uint8_t period, int back = 0);
+
+    void toJson(JsonObject out) const;
+    void fromJson(JsonObjectConst in);
+    bool dirty() const { return _dirty; }
+    void clearDirty() { _dirty = false; }
+
+private:
+    uint32_t _current[PERIOD_COUNT] = {};
+    uint32_t _previous[PERIOD_COUNT] = {};
+    time_t _start[PERIOD_COUNT] = {};
+    bool _dirty = false;
+};
+
+// Gas consumption per period in m³, as published to MQTT and served by the web API
+void calendarStatsToJson(const CalendarStats& stats, bool synced, JsonObject out);
+
+#endif // CALENDAR_STATS_H
@@ -0,0 +1,33 @@
+#ifndef CONSUMPTION_HISTORY_H
+#define CONSUMPTION_HISTORY_H
+
+#include <Arduino.h>
+
+// Pulse counts of the last 24 h in fixed time buckets, plus the current flow rate.
+// Written by loop(), read by the display task.
+class ConsumptionHistory {
+public:
+    static const uint16_t BUCKETS = 240;                            // one display column each
+    static const uint32_t BUCKET_MS = 24UL * 60 * 60 * 1000 / BUCKETS; // 6 minutes
+
+    ConsumptionHistory();
+
+    void onPulse(unsigned long now);
+    // Advances to the bucket for 'now'; returns true if a new bucket was started
+    bool tick(unsigned long now);
+
+    // Copies the ring oldest-first (out[BUCKETS - 1] is the running bucket);
+    // head is the running bucket's sequence number
+    void copy(uint16_t* out, uint32_t& head) const;
+    float flowRateM3h(unsigned long now) const;
+
+private:
+    uint16_t _buckets[BUCKETS] = {};
+    uint32_t _head = 0;
+    unsigned long _bucketStart = 0;
+    unsigned long _lastPulse = 0;
+    uint32_t _lastInterval = 0;
+    mutable portMUX_TYPE _mux;
+};
+
+#endif // CONSUMPTION_HISTORY_H
@@ -0,0 +1,114 @@
+#ifndef DISPLAY_RENDERER_H
+#define DISPLAY_RENDERER_H
+
+#include <Arduino.h>
+#include <TFT_eSPI.h>
+#include "ConsumptionHistory.h"
+
+// Everything a TFT page shows. updateDisplay() fills it, the renderer diffs it against what is on the panel.
+struct ScreenModel {
+    enum Layout : uint8_t { LAYOUT_STANDARD, LAYOUT_EDIT, LAYOUT_HISTORY };
+
+    Layout layout = LAYOUT_STANDARD;
+    uint8_t page = 0; // displayMode, used to attribute render cost
+    char title[16] = "";
+    char line1[64] = "";
+    char line2[64] = "";
+    char action[24] = "";
+    bool wifiConnected = false;
+    bool mqttConnected = false;
+    // meter edit page
+    char editValue[24] = "";
+    int16_t cursorX = -1;
+    uint8_t cursorWidth = 0;
+    // history page: pulses per bucket, oldest first, and the running bucket's sequence number
+    uint16_t history[ConsumptionHistory::BUCKETS] = {};
+    uint32_t historyHead = 0;
+};
+
+// Retained-mode renderer: only widgets whose content changed are redrawn. Text is rendered into a
+// full-width strip sprite and sent in one DMA transfer, so the panel never shows a cleared screen.
+// Only the display task renders; other users of the panel (screenshots) take lock() first.
+class DisplayRenderer {
+public:
+    enum Power : uint8_t { POWER_ON, POWER_DIM, POWER_OFF };
+
+    explicit DisplayRenderer(TFT_eSPI& tft);
+
+    void begin();
+    void invalidate();
+    void render(const ScreenModel& model);
+
+    bool lock(TickType_t timeout = portMAX_DELAY);
+    void unlock();
+
+    // Backlight level and panel sleep. Leaving POWER_OFF wakes the panel and keeps the
+    // backlight dark until the next render() has drawn the current view.
+    void setPower(Power power);
+    Power power() const { return _power; }
+
+    uint32_t lastRenderUs() const { return _lastRenderUs; }
+    uint32_t lastSpiBytes() const { return _lastSpiBytes; }
+    uint32_t renderCount() const { return _renderCount; }
+    uint64_t totalSpiBytes() const;
+
+    static const uint8_t MAX_PAGES = 6;
+    // Render cost of one display page
+    struct PageStats {
+        uint32_t renders;
+        uint32_t lastPixels;
+        uint32_t lastSpiBytes;
+        uint32_t maxSpiBytes;
+        uint32_t maxRenderUs;
+        uint64_t totalSpiBytes;
+    };
+    PageStats pageStats(uint8_t page) const;
+
+private:
+    struct Strip {
+        int16_t y;
+        int16_t h;
+    };
+
+    void drawChrome(ScreenModel::Layout layout);
+    void drawStrip(const Strip& strip, uint16_t bg, const char* text, int16_t textX, int16_t textY,
+                   uint8_t size, uint16_t fg, int16_t cursorX = -1, uint8_t cursorWidth = 0);
+    void drawIcon(int16_t x, const unsigned short* icon, bool ok);
+    void drawGraph(const ScreenModel& model, bool full);
+    void drawGraphColumn(int16_t x, uint16_t value, bool running);
+    void push(TFT_eSprite& sprite, int16_t x, int16_t y, int16_t w, int16_t h);
+    void countTransfer(int32_t w, int32_t h);
+    void setBacklight(Power power);
+
+    static const int16_t WIDTH = 240;
+    static const int16_t HEIGHT = 135;
+    static const int16_t STRIP_MAX_H = 47;
+    static const int16_t ICON_SIZE = 24;
+    static const int16_t GRAPH_Y = 75;
+    static const int16_t GRAPH_H = 40;
+    static const uint8_t BACKLIGHT_CHANNEL = 7; // LEDC channel, unused elsewhere
+    static const uint8_t BACKLIGHT_DIM_DUTY = 24; // of 255
+
+    TFT_eSPI& _tft;
+    TFT_eSprite _strip;
+    TFT_eSprite _icon;
+    TFT_eSprite _graph; // only allocated while the history page is shown
+    uint16_t _graphScale = 0;
+    ScreenModel _shown;
+    bool _valid = false;
+    bool _dma = false;
+    Power _power = POWER_ON;
+    bool _backlightPending = false;
+    SemaphoreHandle_t _mutex = nullptr;
+
+    uint32_t _frameBytes = 0;
+    uint32_t _framePixels = 0;
+    PageStats _pages[MAX_PAGES] = {};
+    volatile uint32_t _lastRenderUs = 0;
+    volatile uint32_t _lastSpiBytes = 0;
+    volatile uint32_t _renderCount = 0;
+    uint64_t _totalSpiBytes = 0;
+    mutable portMUX_TYPE _statsMux = portMUX_INITIALIZER_UNLOCKED; // 64-bit totals are read from the HTTP task
+};
+
+#endif // DISPLAY_RENDERER_H
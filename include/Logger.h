@@ -0,0 +1,91 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <Arduino.h>
+#include <atomic>
+
+enum LogLevel : uint8_t {
+    LOG_LEVEL_ERROR,
+    LOG_LEVEL_WARN,
+    LOG_LEVEL_INFO,
+    LOG_LEVEL_DEBUG,
+    LOG_LEVEL_COUNT
+};
+
+// Leveled log into a fixed RAM ring. log() only formats into a slot (no UART wait) and never
+// blocks: writers reserve slots with an atomic counter and publish them with a sequence number.
+// A low-priority task drains the ring to the serial port; the web API reads the tail.
+// If the drain falls a full ring behind, the oldest lines are overwritten and counted as dropped.
+class Logger {
+public:
+    static const uint8_t SLOTS = 64;
+    static const uint8_t LINE_LENGTH = 104;
+    static const uint8_t MAX_SECRETS = 2;
+
+    // Starts the drain task; lines logged before are kept and printed then
+    void begin(Print& out);
+
+    void setLevel(LogLevel level) { _level = level; }
+    LogLevel level() const { return _level; }
+    bool enabled(LogLevel level) const { return level <= _level; }
+    static const char* levelName(uint8_t level);
+    static bool parseLevel(const char* name, LogLevel& level);
+
+    // Buffers whose current content is replaced by *** in every line (e.g. the MQTT password)
+    void addSecret(const char* secret);
+
+    void log(LogLevel level, const char* fmt, ...) __attribute__((format(printf, 3, 4)));
+
+    struct Line {
+        uint32_t seq;
+        uint32_t ms;
+        uint8_t level;
+        char text[LINE_LENGTH];
+    };
+    typedef bool (*LineSink)(void* ctx, const Line& line);
+    // Hands up to maxLines of the newest lines to sink, oldest first; returns the number sent
+    size_t tail(size_t maxLines, LineSink sink, void* ctx) const;
+
+    uint32_t written() const { return _head.load(std::memory_order_relaxed); }
+    uint32_t dropped() const { return _dropped.load(std::memory_order_relaxed); }
+
+private:
+    struct Slot {
+        std::atomic<uint32_t> seq; // seq + 1 once written, 0 while a writer fills it
+        uint32_t ms;
+        uint8_t level;
+        char text[LINE_LENGTH];
+    };
+
+    static void drainTask(void* arg);
+    void drain();
+    // Copies line 'seq' if it is complete and was not overwritten while copying
+    bool read(uint32_t seq, Line& out) const;
+    void redact(char* text) const;
+
+    Slot _slots[SLOTS];
+    std::atomic<uint32_t> _head{0};
+    std::atomic<uint32_t> _dropped{0};
+    uint32_t _tail = 0; // drain task only
+    volatile LogLevel _level = LOG_LEVEL_INFO;
+    const char* _secrets[MAX_SECRETS] = {};
+    uint8_t _secretCount = 0;
+    Print* _out = nullptr;
+    TaskHandle_t _task = nullptr;
+};
+
+extern Logger logger;
+
+// The level check comes first so disabled lines cost no formatting
+#define LOG_AT(level, ...)                  \
+    do                                      \
+    {                                       \
+        if (logger.enabled(level))          \
+            logger.log(level, __VA_ARGS__); \
+    } while (0)
+#define LOG_ERROR(...) LOG_AT(LOG_LEVEL_ERROR, __VA_ARGS__)
+#define LOG_WARN(...) LOG_AT(LOG_LEVEL_WARN, __VA_ARGS__)
+#define LOG_INFO(...) LOG_AT(LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_DEBUG(...) LOG_AT(LOG_LEVEL_DEBUG, __VA_ARGS__)
+
+#endif // LOGGER_H
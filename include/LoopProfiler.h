@@ -0,0 +1,81 @@
+#ifndef LOOP_PROFILER_H
+#define LOOP_PROFILER_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+// One stage per scheduler job (the buttons job is split per button), in registration order
+enum LoopStage : uint8_t {
+    STAGE_SAMPLING,
+    STAGE_PULSE,
+    STAGE_BUTTON1,
+    STAGE_BUTTON2,
+    STAGE_CONNECTION,
+    STAGE_CONNECTION_CHANGE,
+    STAGE_WIFI_RETRY,
+    STAGE_MQTT_RETRY,
+    STAGE_WEB_COMMANDS,
+    STAGE_CONFIG_CHANGE,
+    STAGE_WM_PROCESS,
+    STAGE_MQTT,
+    STAGE_PUBLISH,
+    STAGE_SAVE,
+    STAGE_HOUSEKEEPING,
+    STAGE_ANOMALY,
+    STAGE_CALENDAR,
+    STAGE_SELFTEST,
+    STAGE_COUNT
+};
+
+const char* loopStageName(LoopStage stage);
+
+#ifdef LOOP_PROFILER
+
+// Per-stage log2 histograms of cycle-counter durations. Only built with -D LOOP_PROFILER.
+// record() runs in loop(); reset() and the reports may run in the HTTP task.
+class LoopProfiler {
+public:
+    static const uint8_t BUCKETS = 21; // bucket i: [2^(i-1), 2^i) us, last one open-ended
+
+    void record(LoopStage stage, uint32_t cycles);
+    uint32_t percentileUs(LoopStage stage, uint8_t pct) const;
+    void reset();
+    void dump(Print& out) const;
+    void toJson(JsonObject out) const;
+
+private:
+    struct StageStats {
+        uint32_t buckets[BUCKETS];
+        uint32_t count;
+        uint32_t maxUs;
+        uint64_t totalUs;
+    };
+    // Copy of one stage, so a report never mixes counts from before and after a record()
+    StageStats snapshot(LoopStage stage) const;
+    static uint32_t percentileUs(const StageStats& s, uint8_t pct);
+
+    StageStats _stats[STAGE_COUNT] = {};
+    mutable portMUX_TYPE _mux = portMUX_INITIALIZER_UNLOCKED;
+};
+
+extern LoopProfiler loopProfiler;
+
+class ProfileScope {
+public:
+    explicit ProfileScope(LoopStage stage) : _stage(stage), _start(ESP.getCycleCount()) {}
+    ~ProfileScope() { loopProfiler.record(_stage, ESP.getCycleCount() - _start); }
+
+private:
+    LoopStage _stage;
+    uint32_t _start;
+};
+
+#define PROFILE_SCOPE(stage) ProfileScope _profileScope(stage)
+
+#else
+
+#define PROFILE_SCOPE(stage) do {} while (0)
+
+#endif // LOOP_PROFILER
+
+#endif // LOOP_PROFILER_H
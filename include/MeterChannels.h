@@ -0,0 +1,82 @@
+#ifndef METER_CHANNELS_H
+#define METER_CHANNELS_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+// One meter input as exchanged with the web API and /channels.json
+struct ChannelConfig {
+    bool enabled = false;
+    uint8_t pin = 0;
+    bool activeLow = false; // S0 outputs pull the input low; a reed contact to 3.3 V drives it high
+    bool pullup = false;
+    uint16_t debounceMs = 10; // the input must rest this long before a pulse counts; below the 30 ms S0 pulse
+    float unitsPerPulse = 0.001f;
+    char name[16] = "";
+    char unit[8] = "";
+    char deviceClass[12] = ""; // Home Assistant device_class (gas, water, energy)
+    char topic[48] = "";       // below <clientID>/
+};
+
+// Meter inputs as a struct-of-arrays table.
+// Channel 0 is the gas meter: loop() samples it through the ADC hysteresis and its counters are
+// the global pulseCount/offset. The other channels are counted in GPIO interrupts, so short S0
+// pulses are not lost while loop() is busy, and collect() moves them into the counters in one pass.
+class MeterChannels {
+public:
+    static const uint8_t MAX_CHANNELS = 4;
+
+    // Applies a channel's configuration; (re)attaches the interrupt for channels >= 1
+    void configure(uint8_t ch, const ChannelConfig& config);
+    ChannelConfig config(uint8_t ch) const;
+    bool enabled(uint8_t ch) const { return ch < MAX_CHANNELS && _enabled[ch]; }
+    // Pins that can take a meter input on the T-Display (not used by TFT, buttons or the reed contact)
+    static bool pinAvailable(uint8_t pin);
+
+    // Adds the pulses counted by the interrupts; returns a bit mask of the channels that changed
+    uint32_t collect();
+
+    double value(uint8_t ch) const { return (static_cast<double>(pulses[ch]) + offset[ch]) * _unitsPerPulse[ch]; }
+    // Sets the meter reading by adjusting the offset
+    void setValue(uint8_t ch, double value);
+
+    // Channels >= 1 with configuration and counters; dirty() tells whether a save is due
+    void toJson(JsonArray out) const;
+    void fromJson(JsonArrayConst in);
+    bool dirty() const { return _dirty; }
+    void clearDirty() { _dirty = false; }
+
+    // Counters in pulses. [0] aliases the gas meter's pulseCount/offset.
+    uint32_t pulses[MAX_CHANNELS] = {};
+    uint32_t offset[MAX_CHANNELS] = {};
+
+private:
+    struct IsrArg {
+        MeterChannels* self;
+        uint8_t ch;
+    };
+    static void IRAM_ATTR onEdge(void* arg);
+
+    // configuration
+    bool _enabled[MAX_CHANNELS] = {};
+    uint8_t _pin[MAX_CHANNELS] = {};
+    bool _activeLow[MAX_CHANNELS] = {};
+    bool _pullup[MAX_CHANNELS] = {};
+    uint16_t _debounceMs[MAX_CHANNELS] = {};
+    float _unitsPerPulse[MAX_CHANNELS] = {};
+    char _name[MAX_CHANNELS][16] = {};
+    char _unit[MAX_CHANNELS][8] = {};
+    char _deviceClass[MAX_CHANNELS][12] = {};
+    char _topic[MAX_CHANNELS][48] = {};
+
+    // interrupt state
+    IsrArg _args[MAX_CHANNELS] = {};
+    volatile uint32_t _pending[MAX_CHANNELS] = {};
+    volatile int64_t _lastEdgeUs[MAX_CHANNELS] = {}; // last level change, counted or not
+    volatile bool _active[MAX_CHANNELS] = {};
+    portMUX_TYPE _mux = portMUX_INITIALIZER_UNLOCKED;
+
+    bool _dirty = false;
+};
+
+#endif // METER_CHANNELS_H
@@ -0,0 +1,111 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <Arduino.h>
+#include <esp_http_server.h>
+#include <ArduinoJson.h>
+
+// 64-bit counter that other tasks can read without tearing. The ESP32 has no 64-bit
+// atomics, so a plain volatile uint64_t can be read half-updated.
+class Counter64 {
+public:
+    void add(uint64_t v)
+    {
+        portENTER_CRITICAL(&_mux);
+        _value += v;
+        portEXIT_CRITICAL(&_mux);
+    }
+    uint64_t get() const
+    {
+        portENTER_CRITICAL(&_mux);
+        uint64_t v = _value;
+        portEXIT_CRITICAL(&_mux);
+        return v;
+    }
+
+private:
+    uint64_t _value = 0;
+    mutable portMUX_TYPE _mux = portMUX_INITIALIZER_UNLOCKED;
+};
+
+// Fixed-bucket latency histogram (microseconds). Each instance has a single writer task.
+struct LatencyHistogram {
+    static const uint8_t BUCKETS = 10;
+    static const uint32_t BOUNDS_US[BUCKETS];
+
+    volatile uint32_t counts[BUCKETS + 1] = {}; // last slot is +Inf
+    Counter64 sumUs;
+    volatile uint32_t maxUs = 0; // since boot; the buckets cannot tell a 1.1 s outlier from a 60 s one
+
+    void observe(uint32_t us);
+    // count, avg/max in ms and the non-empty buckets keyed by upper bound in ms
+    void toJson(JsonObject out) const;
+};
+
+struct Metrics {
+    LatencyHistogram loopLatency;
+    LatencyHistogram httpLatency;
+    LatencyHistogram displayRenderLatency;
+
+    volatile uint32_t mqttPublishOk = 0;
+    volatile uint32_t mqttPublishFailed = 0;
+    volatile uint32_t mqttReconnects = 0;
+    volatile uint32_t mqttReconnectFailures = 0;
+    volatile uint32_t mqttReconnectLastMs = 0;
+    Counter64 mqttReconnectTotalMs;
+    LatencyHistogram mqttPublishLatency;
+    Counter64 mqttPublishBytes;
+    volatile uint32_t mqttDiscoveryRuns = 0;
+    volatile uint32_t mqttDiscoveryLastMs = 0;
+    volatile uint32_t mqttSetCount = 0;
+    volatile uint32_t mqttSetLastUs = 0; // value received on the current topic until the new state is published
+    volatile unsigned long mqttOutageStart = 0;
+    volatile uint32_t mqttOutages = 0;
+    volatile uint32_t mqttRecoveryLastMs = 0;
+    volatile uint32_t mqttRecoveryMaxMs = 0;
+
+    volatile uint32_t displayRequests = 0;
+
+    volatile uint32_t screenshotCaptureMs = 0;
+    volatile uint32_t screenshotRawBytes = 0;
+    volatile uint32_t screenshotEncodedBytes = 0;
+
+    volatile uint32_t spiffsWrites = 0;
+    Counter64 spiffsBytes;
+
+    volatile unsigned long lastPulseTime = 0;
+    volatile uint32_t lastPulseIntervalMs = 0;
+
+    void recordPulse(unsigned long now);
+    // Pulses per hour derived from the last interval; decays once no pulse arrives for longer
+    float pulseRatePerHour(unsigned long now) const;
+};
+
+extern Metrics metrics;
+
+// Writes Prometheus text exposition format straight into chunked HTTP responses
+class MetricsWriter {
+public:
+    explicit MetricsWriter(httpd_req_t* req);
+
+    void counter(const char* name, const char* help, uint64_t value);
+    // Counter in fractional units such as seconds
+    void fractionalCounter(const char* name, const char* help, double value);
+    void gauge(const char* name, const char* help, double value);
+    void histogram(const char* name, const char* help, const LatencyHistogram& h);
+    // Labelled series: one header(), then a sample() per label set
+    void header(const char* name, const char* help, const char* type);
+    void sample(const char* name, const char* labels, double value);
+    esp_err_t finish();
+
+private:
+    void printf(const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+    void flush();
+
+    httpd_req_t* _req;
+    char _buf[512];
+    size_t _len = 0;
+    esp_err_t _err = ESP_OK;
+};
+
+#endif // METRICS_H
@@ -0,0 +1,55 @@
+#ifndef MQTT_H
+#define MQTT_H
+
+#include <Arduino.h>
+#include <PubSubClient.h>
+#include "AnomalyDetector.h"
+#include "CalendarStats.h"
+#include "MeterChannels.h"
+#include "Scheduler.h"
+
+// MQTT layer: broker connection, the gas/channel/anomaly/calendar state topics, Home Assistant
+// discovery and the current-value topic. Runs in loop() (and once in networkBootTask before loop()
+// takes over). Kept out of main.cpp so test/mqtt/ builds the same code on Linux against a broker.
+
+bool mqttPublish(const char *topic, const char *payload, bool retained = false);
+boolean reconnect_mqtt();
+void publishGasVolume();
+void publishChannels();
+void publishAnomaly();
+void publishCalendarStats();
+void publishHassDiscovery();
+void MQTTcallbackReceive(char *topic, byte *payload, unsigned int length);
+
+// Broker settings and topics (mutable so the web UI can change them at runtime)
+extern char mqtt_server[40];
+extern char mqtt_port[6];
+extern char mqtt_user[40];
+extern char mqtt_password[40];
+extern String mqtt_topic_gas;
+extern String mqtt_topic_currentVal;
+
+extern PubSubClient client;
+// Diagnostics
+extern char lastMqttStatus[48];
+extern volatile unsigned long lastMqttAttemptTime; // millis()
+extern int lastMqttErrorCode;
+extern bool hassDiscoveryPublished;
+extern uint8_t publishedAlerts; // alert set last sent; 0xFF forces the first publish
+
+// Provided by main.cpp (or the host benchmark)
+extern String clientID;
+extern const char *const version;
+extern uint32_t &pulseCount;
+extern uint32_t &offset;
+extern MeterChannels meterChannels;
+extern AnomalyDetector anomalyDetector;
+extern CalendarStats calendarStats;
+extern bool clockSynced;
+extern volatile bool networkReady;
+extern Scheduler scheduler;
+extern Scheduler::JobId jobPublish;
+void updateDisplay();
+void saveDataToSPIFFS();
+
+#endif // MQTT_H
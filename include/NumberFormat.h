@@ -0,0 +1,45 @@
+#ifndef NUMBER_FORMAT_H
+#define NUMBER_FORMAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Separators used when printing a meter value
+enum NumberStyle {
+    NUMBER_STYLE_C,  // 12345.67
+    NUMBER_STYLE_EN, // 12,345.67
+    NUMBER_STYLE_DE  // 12.345,67
+};
+
+constexpr char decimalSeparator(NumberStyle style)
+{
+    return style == NUMBER_STYLE_DE ? ',' : '.';
+}
+
+// 0 for no grouping
+constexpr char groupSeparator(NumberStyle style)
+{
+    return style == NUMBER_STYLE_EN ? ',' : (style == NUMBER_STYLE_DE ? '.' : 0);
+}
+
+// Digits before the decimal separator of a centi value (at least one)
+constexpr uint8_t integerDigits(uint32_t value)
+{
+    return value < 1000 ? 1 : 1 + integerDigits(value / 10);
+}
+
+// Characters formatCentiValue() prints, without the terminator
+constexpr size_t centiValueLength(uint32_t value, NumberStyle style)
+{
+    return integerDigits(value) + (groupSeparator(style) ? (integerDigits(value) - 1) / 3 : 0) + 3;
+}
+
+// Enough for the largest uint32_t in any style ("42.949.672,95")
+static const size_t NUMBER_BUFFER_SIZE = 16;
+static_assert(centiValueLength(UINT32_MAX, NUMBER_STYLE_DE) < NUMBER_BUFFER_SIZE, "number buffer too small");
+
+// Prints a centi-m3 fixed-point value with two decimals into buf.
+// No heap or locale use; returns the length like snprintf (output is truncated to len - 1).
+size_t formatCentiValue(uint32_t value, char *buf, size_t len, NumberStyle style = NUMBER_STYLE_C);
+
+#endif // NUMBER_FORMAT_H
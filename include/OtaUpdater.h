@@ -0,0 +1,51 @@
+#ifndef OTA_UPDATER_H
+#define OTA_UPDATER_H
+
+#include <Arduino.h>
+#include <mbedtls/sha256.h>
+
+// Streams an uploaded image into the OTA partition. Progress is readable from any task,
+// but the upload runs in the HTTP task, so during an upload it only reaches clients via MQTT.
+class OtaUpdater {
+public:
+    enum State : uint8_t { IDLE, RUNNING, SUCCESS, FAILED };
+
+    OtaUpdater();
+    ~OtaUpdater();
+
+    // expectedSha256Hex may be null/empty to skip verification
+    bool begin(size_t totalSize, const char* expectedSha256Hex);
+    bool write(const uint8_t* data, size_t len);
+    bool finish();
+    void abort(const char* reason);
+
+    State state() const { return _state; }
+    size_t bytesReceived() const { return _received; }
+    size_t totalSize() const { return _total; }
+    uint8_t percent() const;
+    uint32_t bytesPerSecond() const;
+    const char* lastError() const { return _error; }
+    const char* sha256() const { return _digestHex; }
+
+    // Rollback handling for the image booted after an update
+    void checkPendingVerify();
+    bool pendingVerify() const { return _pendingVerify; }
+    void confirmBoot();
+    void rollbackBoot();
+
+private:
+    void fail(const char* reason);
+
+    mbedtls_sha256_context _sha;
+    char _expectedHex[65] = "";
+    char _digestHex[65] = "";
+    char _error[48] = "";
+    volatile State _state = IDLE;
+    volatile size_t _received = 0;
+    size_t _total = 0;
+    unsigned long _startTime = 0;
+    unsigned long _endTime = 0;
+    bool _pendingVerify = false;
+};
+
+#endif // OTA_UPDATER_H
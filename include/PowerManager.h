@@ -0,0 +1,74 @@
+#ifndef POWER_MANAGER_H
+#define POWER_MANAGER_H
+
+#include <Arduino.h>
+#include <sdkconfig.h>
+
+// Automatic light sleep needs a tickless-idle sdkconfig; the stock Arduino core only gets DFS and modem sleep
+#if defined(CONFIG_PM_ENABLE) && defined(CONFIG_FREERTOS_USE_TICKLESS_IDLE)
+#define POWER_LIGHT_SLEEP 1
+#else
+#define POWER_LIGHT_SLEEP 0
+#endif
+
+// loop() blocks in idle() until a wake() from another task or its own next deadline. The optional
+// low-power mode adds edges on the wake pins as wake events, uses WiFi modem sleep and lowers the
+// CPU clock.
+class PowerManager {
+public:
+    static const uint8_t MAX_WAKE_PINS = 3;
+    static const uint32_t LOW_POWER_CPU_MHZ = 80; // lowest clock with WiFi and an 80 MHz APB (SPI, UART)
+
+    // Call from setup(); the calling task is the one idle() blocks
+    void begin();
+    // Pins whose edges end an idle period
+    void addWakePin(uint8_t pin);
+    void setEnabled(bool enabled);
+    bool enabled() const { return _enabled; }
+    bool lightSleep() const { return _pmActive && POWER_LIGHT_SLEEP; }
+
+    // Ends the current idle period early; safe from any task
+    void wake();
+    // Blocks for at most maxMs unless a wake event arrives
+    void idle(uint32_t maxMs);
+    // analogRead() of a wake pin. The ADC takes the pad away from its edge interrupt, so in
+    // low-power mode the pin is detached for the conversion and made a digital input again after.
+    uint16_t readAnalog(uint8_t pin);
+    // millis() of the last wake pin edge
+    unsigned long lastEdgeMs() const { return static_cast<unsigned long>(_edgeUs / 1000); }
+
+    // Share of the last window spent outside idle()
+    float dutyCycle() const { return _dutyCycle; }
+    // Time from a wake pin edge until idle() returned
+    uint32_t lastWakeLatencyUs() const { return _lastWakeLatencyUs; }
+    uint32_t maxWakeLatencyUs() const { return _maxWakeLatencyUs; }
+    uint32_t edgeWakeups() const { return _edgeWakeups; }
+    uint32_t idleCount() const { return _idleCount; }
+
+private:
+    static void IRAM_ATTR onEdge(void* arg);
+    void armLevelWake();
+    void disarmLevelWake();
+    void resetWindow();
+
+    static const int64_t DUTY_WINDOW_US = 10 * 1000 * 1000;
+
+    TaskHandle_t _task = nullptr;
+    uint8_t _pins[MAX_WAKE_PINS];
+    uint8_t _pinCount = 0;
+    bool _enabled = false;
+    bool _pmActive = false; // esp_pm_configure() accepted the config
+
+    volatile int64_t _edgeUs = 0;
+    volatile bool _edgePending = false;
+
+    int64_t _windowStartUs = 0;
+    int64_t _windowIdleUs = 0;
+    float _dutyCycle = 1.0f;
+    uint32_t _lastWakeLatencyUs = 0;
+    uint32_t _maxWakeLatencyUs = 0;
+    uint32_t _edgeWakeups = 0;
+    uint32_t _idleCount = 0;
+};
+
+#endif // POWER_MANAGER_H
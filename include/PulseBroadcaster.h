@@ -0,0 +1,48 @@
+#ifndef PULSE_BROADCASTER_H
+#define PULSE_BROADCASTER_H
+
+#include <Arduino.h>
+
+// Datagram sent per gas pulse, 24 bytes, little-endian. contrib/udp_pulse_receiver.c
+// decodes the same layout.
+struct __attribute__((packed)) PulseDatagram {
+    uint8_t magic[2];     // 'G', 'P'
+    uint8_t version;      // PulseBroadcaster::VERSION
+    uint8_t channel;      // 0 = gas meter
+    uint32_t sequence;    // +1 per datagram since boot; gaps mean lost datagrams
+    uint64_t timestampUs; // esp_timer time of the detected edge
+    uint32_t total;       // meter reading in pulses (pulse count + offset)
+    uint32_t intervalMs;  // time since the previous pulse; 0 for the first one after boot
+};
+
+// Sends a PulseDatagram to a unicast or multicast IPv4 address straight from the sampling
+// path: one sendto() on a non-blocking socket, no allocation, no JSON. Runs in loop().
+class PulseBroadcaster {
+public:
+    static const uint8_t VERSION = 1;
+
+    // An empty or invalid address disables sending; returns false for an invalid one
+    bool configure(const char* address, uint16_t port);
+    bool enabled() const { return _enabled; }
+
+    void send(uint8_t channel, uint32_t total, uint32_t intervalMs, int64_t timestampUs);
+
+    uint32_t sent() const { return _sent; }
+    uint32_t failed() const { return _failed; }
+
+private:
+    bool openSocket();
+
+    bool _enabled = false;
+    bool _multicast = false;
+    uint32_t _address = 0; // network byte order
+    uint16_t _port = 0;
+    int _socket = -1;
+    uint32_t _sequence = 0;
+    volatile uint32_t _sent = 0;
+    volatile uint32_t _failed = 0;
+};
+
+extern PulseBroadcaster pulseBroadcaster;
+
+#endif // PULSE_BROADCASTER_H
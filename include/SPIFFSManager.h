@@ -4,8 +4,24 @@
 #include <SPIFFS.h>
 #include <ArduinoJson.h>
 
+// JSON files on SPIFFS. A save goes to <file>.tmp first and replaces the file only once
+// it is complete, so a power cut mid-write leaves either the old or the new version.
 class SPIFFSManager {
 public:
+    static const uint8_t FILE_COUNT = 5;
+
+    // Per-file timings and write volume since boot
+    struct FileStats {
+        uint32_t saves;
+        uint32_t failures;
+        uint64_t bytes;           // JSON bytes written
+        uint64_t estimatedProgrammedBytes; // flash bytes programmed for them, counted as whole pages plus index
+        uint32_t lastSaveUs;
+        uint32_t maxSaveUs;
+        uint32_t loadUs;
+        bool recovered; // the last load fell back to the .tmp copy
+    };
+
     SPIFFSManager();
     ~SPIFFSManager();
 
@@ -13,11 +29,38 @@ public:
     void end();
     bool saveData(uint32_t pulseCount, uint32_t offset, char* mqtt_server, char* mqtt_port, char *mqtt_user, char *mqtt_password, char* mqtt_clientid, char* mqtt_topic_gas, char* mqtt_topic_current);
     bool loadData(uint32_t& pulseCount, uint32_t& offset, char* mqtt_server, char* mqtt_port, char *mqtt_user, char *mqtt_password, char* mqtt_clientid, char* mqtt_topic_gas, char* mqtt_topic_current);
+    // Device settings live in their own file so they survive a reset of the counter data
+    bool saveSettings(const JsonDocument& doc) { return saveJson(SETTINGS_FILE, doc); }
+    bool loadSettings(JsonDocument& doc) { return loadJson(SETTINGS_FILE, doc); }
+    // Configuration and counters of the additional meter channels
+    bool saveChannels(const JsonDocument& doc) { return saveJson(CHANNELS_FILE, doc); }
+    bool loadChannels(JsonDocument& doc) { return loadJson(CHANNELS_FILE, doc); }
+    // Thresholds of the anomaly rules
+    bool saveAnomaly(const JsonDocument& doc) { return saveJson(ANOMALY_FILE, doc); }
+    bool loadAnomaly(JsonDocument& doc) { return loadJson(ANOMALY_FILE, doc); }
+    // Day/week/month consumption
+    bool saveStats(const JsonDocument& doc) { return saveJson(STATS_FILE, doc); }
+    bool loadStats(JsonDocument& doc) { return loadJson(STATS_FILE, doc); }
     void listFiles();
+    size_t lastWriteSize() const { return _lastWriteSize; }
+    // Per-file figures, partition usage and an estimate of the erase cycles per block and year
+    void statsToJson(JsonObject out) const;
 
 private:
     bool mountSPIFFS();
+    bool saveJson(const char* path, const JsonDocument& doc);
+    bool loadJson(const char* path, JsonDocument& doc);
+    bool readJson(const char* path, JsonDocument& doc);
+    FileStats* statsFor(const char* path);
     static const char* DATA_FILE;
+    static const char* SETTINGS_FILE;
+    static const char* CHANNELS_FILE;
+    static const char* ANOMALY_FILE;
+    static const char* STATS_FILE;
+    static const char* const FILES[FILE_COUNT];
+    size_t _lastWriteSize = 0;
+    FileStats _stats[FILE_COUNT] = {};
+    mutable portMUX_TYPE _statsMux = portMUX_INITIALIZER_UNLOCKED;
 };
 
 #endif // SPIFFS_MANAGER_H
\ No newline at end of file
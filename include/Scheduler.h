@@ -0,0 +1,83 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+// Cooperative job scheduler for loop(). Timed jobs sit in a hashed timer wheel (TICK_MS slots,
+// longer delays wrap around in rounds); event jobs run when signal()led from any task.
+// run() executes what is due and returns how long loop() may block until the next job.
+class Scheduler {
+public:
+    typedef void (*JobFn)();
+    typedef int8_t JobId;
+
+    static const uint8_t MAX_JOBS = 24; // main.cpp registers 17
+    static_assert(MAX_JOBS <= 32, "signal and ready sets are 32-bit masks");
+    static const uint32_t TICK_MS = 10;
+    static const uint8_t SLOTS = 32;
+
+    // The task that runs loop(); signal() notifies it
+    void begin();
+
+    // Periodic job, first run after intervalMs (0: on the next run())
+    JobId every(const char* name, uint32_t intervalMs, JobFn fn, uint32_t firstMs = 0);
+    // One-shot job, armed with schedule()
+    JobId once(const char* name, JobFn fn);
+    // Job that only runs when signalled
+    JobId onEvent(const char* name, JobFn fn);
+
+    // (Re)arms a timed job to run delayMs from now
+    void schedule(JobId id, uint32_t delayMs);
+    // Marks a job to run on the next pass and wakes loop(); safe from any task
+    void signal(JobId id);
+
+    // Runs all due and signalled jobs once; returns ms until the next timed job (at most one wheel turn)
+    uint32_t run();
+    // ms until the given job is due (UINT32_MAX if it is not armed)
+    uint32_t msUntil(JobId id) const;
+
+    void toJson(JsonArray out) const;
+
+    struct JobStats {
+        const char* name;
+        uint32_t runs;
+        uint64_t totalUs;
+        uint32_t maxUs;
+        uint32_t lastJitterMs; // how late the last run started
+        uint32_t maxJitterMs;
+    };
+    uint8_t jobCount() const { return _count; }
+    // Copy taken under the lock, so other tasks see a consistent set
+    JobStats stats(JobId id) const;
+
+private:
+    struct Job {
+        JobFn fn;
+        uint32_t intervalMs; // 0 for one-shot and event jobs
+        uint32_t due;        // millis()
+        uint16_t rounds;     // wheel turns left before due
+        JobId next;          // next job in the same slot, -1 ends the list
+        int8_t slot;         // -1 while not armed
+        JobStats stats;
+    };
+
+    JobId add(const char* name, uint32_t intervalMs, JobFn fn);
+    void insert(JobId id, uint32_t due);
+    void unlink(JobId id);
+    void advance(uint32_t now, uint32_t& readyMask);
+    void execute(JobId id, uint32_t now, bool timed);
+
+    Job _jobs[MAX_JOBS];
+    uint8_t _count = 0;
+    JobId _slots[SLOTS];
+    uint8_t _cursor = 0;
+    uint32_t _wheelTime = 0; // millis() of the slot under the cursor
+    bool _started = false;
+
+    TaskHandle_t _task = nullptr;
+    volatile uint32_t _signalled = 0;
+    mutable portMUX_TYPE _mux = portMUX_INITIALIZER_UNLOCKED;
+};
+
+#endif // SCHEDULER_H
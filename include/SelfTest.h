@@ -0,0 +1,96 @@
+#ifndef SELF_TEST_H
+#define SELF_TEST_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <esp_timer.h>
+
+// Options of one self-test run as passed from the web API
+struct SelfTestOptions {
+    uint8_t pin = 0;           // output wired to the reed input; 0 feeds a virtual input instead
+    uint16_t stepSeconds = 20; // length of one sweep step
+    bool load = true;          // publish, redraw and query the web server while the sweep runs
+};
+
+// Pulse generator and sweep for finding the highest pulse rate and shortest pulse the
+// gas input counts reliably. An esp_timer emits an exact number of pulses per step,
+// either on a test pin looped back to the reed input or on a virtual input that the
+// sampling job runs through a detector of its own. Generated and counted pulses are
+// compared once the generator has stopped and the detector has settled.
+// start()/stop()/tick()/onSample() run in loop(); toJson() may be called from any task.
+class SelfTest {
+public:
+    static const uint8_t FREQUENCY_STEPS = 9; // 50 % duty, 0.5 Hz up to 10 Hz
+    static const uint8_t WIDTH_STEPS = 9;     // 1 Hz, 200 ms down to 30 ms
+    static const uint8_t STEPS = FREQUENCY_STEPS + WIDTH_STEPS;
+
+    struct Step {
+        uint16_t periodMs;
+        uint16_t widthMs;
+        uint32_t generated;
+        uint32_t counted;
+        uint16_t maxSampleGapMs; // longest time between two sampling passes in this step
+    };
+
+    SelfTest();
+
+    bool start(const SelfTestOptions& options);
+    void stop();
+    bool running() const { return _state == STATE_RUNNING; }
+    bool loopback() const { return _options.pin != 0; }
+    bool loadEnabled() const { return _options.load; }
+
+    // Every sampling pass; without loopback it also samples the virtual input
+    void onSample(uint32_t nowUs);
+    // A rising edge on the reed input while the loopback test runs
+    void onPulse() { _counted++; }
+    // Advances the sweep; returns false once it has finished
+    bool tick();
+
+    // Load counters, written by whoever generates the load
+    void countPublish() { _publishes++; }
+    void countHttpRequest(bool ok) { ok ? _httpRequests++ : _httpErrors++; }
+
+    void toJson(JsonObject out) const;
+
+private:
+    enum State : uint8_t { STATE_IDLE, STATE_RUNNING, STATE_DONE, STATE_STOPPED };
+    enum Phase : uint8_t { PHASE_PULSES, PHASE_SETTLE };
+
+    static void onTimer(void* arg);
+    void beginStep();
+    void finishStep();
+    void stopGenerator();
+
+    SelfTestOptions _options;
+    volatile State _state = STATE_IDLE;
+    Phase _phase = PHASE_PULSES;
+    uint8_t _step = 0;
+    unsigned long _settleStart = 0;
+    Step _results[STEPS] = {};
+
+    // generator, driven by the esp_timer task
+    esp_timer_handle_t _timer = nullptr;
+    volatile bool _level = false;
+    volatile uint32_t _generated = 0;
+    volatile uint32_t _remaining = 0;
+    int64_t _nextUs = 0;
+    uint32_t _periodUs = 0;
+    uint32_t _widthUs = 0;
+
+    // detector
+    bool _virtualState = false;
+    uint32_t _counted = 0;
+    uint32_t _lastSampleUs = 0;
+    uint32_t _maxGapUs = 0;
+
+    volatile uint32_t _publishes = 0;
+    volatile uint32_t _httpRequests = 0;
+    volatile uint32_t _httpErrors = 0;
+
+    mutable portMUX_TYPE _mux = portMUX_INITIALIZER_UNLOCKED;
+};
+
+extern SelfTest selfTest;
+
+#endif // SELF_TEST_H
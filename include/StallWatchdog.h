@@ -0,0 +1,113 @@
+#ifndef STALL_WATCHDOG_H
+#define STALL_WATCHDOG_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+// Tasks whose trace points are followed
+enum TraceContext : uint8_t {
+    TRACE_CTX_LOOP,
+    TRACE_CTX_HTTP,
+    TRACE_CTX_DISPLAY,
+    TRACE_CTX_NETBOOT,
+    TRACE_CTX_COUNT
+};
+
+enum TracePoint : uint8_t {
+    TRACE_LOOP,          // one loop() pass
+    TRACE_JOB,           // a scheduler job, detail = job name
+    TRACE_MQTT_CONNECT,  // reconnect_mqtt()
+    TRACE_HTTP_HANDLER,  // detail = URI
+    TRACE_SPIFFS_SAVE,   // saveDataToSPIFFS()
+    TRACE_DISPLAY_RENDER,
+    TRACE_POINT_COUNT
+};
+
+const char* traceContextName(uint8_t context);
+const char* tracePointName(uint8_t point);
+
+// Stall detector with a postmortem ring. Trace points push the running stage on a small per-task
+// stack; a watchdog task records a STALL when the innermost stage runs longer than the budget, and
+// leaving a stage that took too long records SLOW. Stacks and events live in RTC memory that
+// survives software, panic and watchdog resets, so after a reboot the ring shows what each task was
+// doing when the device went down, next to the reset reason.
+class StallWatchdog {
+public:
+    static const uint8_t MAX_EVENTS = 48;
+    static const uint8_t MAX_DEPTH = 4;
+    static const uint8_t DETAIL_LENGTH = 16;
+    static const uint32_t CHECK_INTERVAL_MS = 100;
+
+    enum EventKind : uint8_t {
+        EVENT_BOOT,     // detail = reset reason
+        EVENT_AT_RESET, // stage that was running when the previous boot ended
+        EVENT_STALL,    // still running past the budget
+        EVENT_SLOW      // finished, but over the budget
+    };
+
+    struct Event {
+        uint32_t atMs;       // uptime of that boot when the stage started
+        uint32_t durationMs;
+        uint16_t boot;
+        uint16_t repeat;     // identical events in a row are folded
+        uint8_t kind;
+        uint8_t context;
+        uint8_t point;
+        uint8_t parent;      // enclosing trace point, TRACE_POINT_COUNT if none
+        char detail[DETAIL_LENGTH];
+    };
+
+    // Call early in setup() from the loop task: turns the previous boot's stacks into events
+    void begin(uint32_t budgetMs);
+    void setBudget(uint32_t budgetMs) { _budgetMs = budgetMs; }
+    uint32_t budget() const { return _budgetMs; }
+
+    // The calling task reports under this context from now on
+    void attach(TraceContext context);
+
+    // Used by TraceScope; enter() returns the context or -1 for tasks that are not attached
+    int8_t enter(TracePoint point, const char* detail);
+    void leave(int8_t context);
+
+    uint16_t bootCount() const;
+    const char* resetReason() const;
+    // Incremented with every recorded event
+    uint32_t version() const { return _version; }
+    uint32_t stallCount() const { return _stalls; }
+
+    // Events oldest first (maxEvents newest), plus the stacks that are open right now
+    void toJson(JsonObject out, uint8_t maxEvents = MAX_EVENTS) const;
+
+private:
+    static void watchTask(void* arg);
+    void check();
+    // Event for the stage at 'depth' of a context; the frames must not change meanwhile
+    Event frameEvent(uint8_t kind, uint8_t context, uint8_t depth, uint32_t atMs, uint32_t durationMs) const;
+    void recordRaw(const Event& event);
+
+    TaskHandle_t _tasks[TRACE_CTX_COUNT] = {};
+    volatile uint32_t _budgetMs = 500;
+    volatile uint32_t _version = 0;
+    volatile uint32_t _stalls = 0;
+    // guards the event ring and the trace stacks, which the watchdog task reads and flags
+    mutable portMUX_TYPE _mux = portMUX_INITIALIZER_UNLOCKED;
+};
+
+extern StallWatchdog stallWatchdog;
+
+class TraceScope {
+public:
+    TraceScope(TracePoint point, const char* detail = nullptr) : _context(stallWatchdog.enter(point, detail)) {}
+    ~TraceScope()
+    {
+        if (_context >= 0)
+            stallWatchdog.leave(_context);
+    }
+
+private:
+    int8_t _context;
+};
+
+#define TRACE_SCOPE(...) TraceScope _traceScope(__VA_ARGS__)
+
+#endif // STALL_WATCHDOG_H
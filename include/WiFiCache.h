@@ -0,0 +1,41 @@
+#ifndef WIFI_CACHE_H
+#define WIFI_CACHE_H
+
+#include <Arduino.h>
+#include <Preferences.h>
+
+// Last good access point (BSSID, channel) and IP configuration, kept in NVS.
+// With it the station associates without a scan and skips DHCP; the normal path is the fallback.
+class WiFiCache {
+public:
+    // Reads the cache and the stored credentials; call after WiFi.mode(WIFI_STA)
+    void begin();
+    bool valid() const { return _entry.valid; }
+
+    // Blocking scan-free connect for boot; false if the cache is empty or the AP did not answer in time
+    bool connect(uint32_t timeoutMs);
+    // Non-blocking variants for reconnects from loop()
+    bool beginCached();
+    void beginFull();
+
+    // Remember the current connection; NVS is only written when something changed
+    void store();
+
+private:
+    struct Entry {
+        bool valid;
+        uint8_t bssid[6];
+        uint8_t channel;
+        uint32_t ip;
+        uint32_t gateway;
+        uint32_t subnet;
+        uint32_t dns;
+    };
+
+    Entry _entry = {};
+    char _ssid[33] = "";
+    char _pass[65] = "";
+    Preferences _prefs;
+};
+
+#endif // WIFI_CACHE_H
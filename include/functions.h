@@ -3,27 +3,86 @@
 #define FUNCTIONS_H
 
 #include <Arduino.h>
+#include <esp_http_server.h>
+#include "DisplayRenderer.h"
+#include "SelfTest.h"
 
 // declarations
-String formatWithHundredsSeparator(uint32_t value);
-void publishGasVolume();
 void saveDataToSPIFFS();
 void updateDisplay();
+void setDisplayPower(DisplayRenderer::Power power);
+void handleDisplayTimeout();
+void displayTask(void *);
 void captureAndSendScreenshotRLE(TFT_eSPI &tft);
 void incrementDigit();
 void moveCursor();
+void handleButtonPressed(Button2 &btn);
 void handleButton1Click(Button2 &btn);
 void handleButton2Click(Button2 &btn);
 void handleButton2LongPress(Button2 &btn);
-void MQTTcallbackReceive(char *topic, byte *payload, unsigned int length);
-boolean reconnect_mqtt();
 void handleButtons();
 void WMsaveParamsCallback();
+void handleOtaState();
+void handleSerialCommands();
+void publishStatusSnapshot();
+void processWebCommands();
+uint32_t idleBudget(uint32_t wait);
+void registerJobs();
+void samplingJob();
+void pulseJob();
+void buttonsJob();
+void connectionJob();
+void connectionChangeJob();
+void wifiRetryJob();
+void mqttRetryJob();
+void webCommandsJob();
+void configChangeJob();
+void wifiManagerJob();
+void mqttJob();
+void publishJob();
+void saveJob();
+void housekeepingJob();
+void anomalyJob();
+uint8_t currentHourOfDay();
+void loadAnomalyConfig();
+void saveAnomalyConfig();
+void selfTestJob();
+void startSelfTest(const SelfTestOptions &options);
+void selfTestHttpLoadTask(void *);
+void calendarJob();
+void loadCalendarStats();
+void saveCalendarStats();
+void loadSettings();
+void saveSettings();
+void applySettings();
+void loadChannels();
+void saveChannels();
 void setupWebInterface();
-void handleRootRequest();
-void handleStatusRequest();
-void handleConsumptionUpdate();
-void handleMqttConfigUpdate();
-void handleFirmwareUpload();
+void networkBootTask(void *);
+void publishBootReport();
+void publishPostmortem();
+esp_err_t handleRootRequest(httpd_req_t *req);
+esp_err_t handleStatusRequest(httpd_req_t *req);
+esp_err_t handleConsumptionUpdate(httpd_req_t *req);
+esp_err_t handleMqttConfigUpdate(httpd_req_t *req);
+esp_err_t handleFirmwareUpload(httpd_req_t *req);
+esp_err_t handleRestartRequest(httpd_req_t *req);
+esp_err_t handleSettingsRequest(httpd_req_t *req);
+esp_err_t handleSettingsUpdate(httpd_req_t *req);
+esp_err_t handleChannelsRequest(httpd_req_t *req);
+esp_err_t handleChannelUpdate(httpd_req_t *req);
+esp_err_t handleSchedulerRequest(httpd_req_t *req);
+esp_err_t handleAnomalyRequest(httpd_req_t *req);
+esp_err_t handleAnomalyUpdate(httpd_req_t *req);
+esp_err_t handleStatsRequest(httpd_req_t *req);
+esp_err_t handleLogRequest(httpd_req_t *req);
+esp_err_t handleLogLevelUpdate(httpd_req_t *req);
+esp_err_t handlePostmortemRequest(httpd_req_t *req);
+esp_err_t handleSelfTestRequest(httpd_req_t *req);
+esp_err_t handleMqttStatsRequest(httpd_req_t *req);
+esp_err_t handleStorageRequest(httpd_req_t *req);
+esp_err_t handleSelfTestUpdate(httpd_req_t *req);
+esp_err_t handleMetricsRequest(httpd_req_t *req);
+esp_err_t handleScreenshotRequest(httpd_req_t *req);
 
 #endif // FUNCTIONS_H
\ No newline at end of file
@@ -4,6 +4,21 @@
 #include <Arduino.h>
 #include <TFT_eSPI.h>
 
+// Receives encoded screenshot data; returns false to abort the capture
+typedef bool (*ScreenshotSink)(void* ctx, const uint8_t* data, size_t len);
+
+struct ScreenshotStats {
+    uint32_t rawBytes = 0;     // RGB565 size of the frame
+    uint32_t encodedBytes = 0; // bytes handed to the sink
+    uint32_t captureMs = 0;
+    bool ok = false;
+};
+
+// Binary RLE: "RLE1", width and height (uint16 LE), then runs of uint16 count + uint16 RGB565 colour (LE)
+ScreenshotStats streamScreenshotRLE(TFT_eSPI& tft, ScreenshotSink sink, void* ctx);
+// 16-bit top-down BMP (BI_BITFIELDS, RGB565)
+ScreenshotStats streamScreenshotBMP(TFT_eSPI& tft, ScreenshotSink sink, void* ctx);
+// Binary RLE as hex on the serial console, decoded by contrib/rle_to_rgb565_to_png.html
 void captureAndSendScreenshotRLE(TFT_eSPI& tft);
 
-#endif // SCREENSHOT_H
\ No newline at end of file
+#endif // SCREENSHOT_H
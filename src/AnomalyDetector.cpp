@@ -0,0 +1,173 @@
+#include "AnomalyDetector.h"
+#include <math.h>
+
+namespace {
+const float TAU_SHORT_MS = 5 * 60 * 1000.0f;
+const float TAU_LONG_MS = 60 * 60 * 1000.0f;
+const float BASELINE_ALPHA = 0.25f; // roughly the last week of days counts
+}
+
+const char* AnomalyDetector::alertName(uint8_t index)
+{
+    static const char* const names[ALERT_COUNT] = {"leak", "continuous_flow", "unusual_usage"};
+    return index < ALERT_COUNT ? names[index] : "unknown";
+}
+
+AnomalyDetector::AnomalyDetector()
+{
+    _startMs = millis();
+    _slotStartMs = _startMs;
+}
+
+void AnomalyDetector::onPulse(unsigned long now)
+{
+    if (_hasPulse)
+    {
+        uint32_t gap = now - _lastPulseMs;
+        if (gap > _gapMax[_slot])
+            _gapMax[_slot] = gap;
+
+        // EWMA over irregular samples: the weight follows the time since the last pulse
+        float rate = gap > 0 ? 3600000.0f / gap : 0;
+        _rateShort += (1.0f - expf(-gap / TAU_SHORT_MS)) * (rate - _rateShort);
+        _rateLong += (1.0f - expf(-gap / TAU_LONG_MS)) * (rate - _rateLong);
+
+        if (_config.flowGapMinutes > 0 && gap <= _config.flowGapMinutes * 60000UL)
+        {
+            if (!_flowing)
+            {
+                _flowing = true;
+                _flowStartMs = _lastPulseMs;
+            }
+        }
+        else
+        {
+            _flowing = false;
+        }
+    }
+    else
+    {
+        // the pause before the first pulse lasted at least since boot
+        if (now - _startMs > _gapMax[_slot])
+            _gapMax[_slot] = now - _startMs;
+    }
+    _lastPulseMs = now;
+    _hasPulse = true;
+    if (_hourPulses < UINT16_MAX)
+        _hourPulses++;
+}
+
+bool AnomalyDetector::tick(unsigned long now, uint8_t hourOfDay)
+{
+    while (now - _slotStartMs >= HOUR_MS)
+    {
+        _slotStartMs += HOUR_MS;
+        _slot = (_slot + 1) % SLOTS;
+        _gapMax[_slot] = 0;
+    }
+
+    if (hourOfDay != _hourOfDay)
+    {
+        if (_hourOfDay >= 0)
+            closeHour();
+        _hourOfDay = hourOfDay;
+        _hourPulses = 0;
+    }
+
+    if (_flowing && now - _lastPulseMs > _config.flowGapMinutes * 60000UL)
+        _flowing = false;
+
+    uint8_t alerts = 0;
+    if (_config.minGapMinutes > 0 && now - _startMs >= SLOTS * HOUR_MS && longestGap(now) < _config.minGapMinutes * 60000UL)
+        alerts |= ALERT_LEAK;
+    if (_config.maxFlowMinutes > 0 && _flowing && now - _flowStartMs >= _config.maxFlowMinutes * 60000UL)
+        alerts |= ALERT_CONTINUOUS_FLOW;
+    if (_unusual)
+        alerts |= ALERT_UNUSUAL_USAGE;
+
+    bool changed = alerts != _alerts;
+    _alerts = alerts;
+    return changed;
+}
+
+// Compares the finished hour with its baseline, then trains the baseline with it
+void AnomalyDetector::closeHour()
+{
+    if (_partialHour)
+    {
+        _partialHour = false;
+        return;
+    }
+    uint8_t h = _hourOfDay;
+    float baseline = _baseline[h];
+    bool trained = _baselineDays[h] >= BASELINE_MIN_DAYS;
+    _lastHourPulses = _hourPulses;
+    _lastHourBaseline = trained ? baseline : -1;
+    _unusual = trained && _config.deviationFactor > 0 && _hourPulses > baseline * _config.deviationFactor &&
+               _hourPulses >= baseline + _config.deviationMinPulses;
+
+    if (_baselineDays[h] == 0)
+        _baseline[h] = _hourPulses;
+    else
+        _baseline[h] += BASELINE_ALPHA * (_hourPulses - baseline);
+    if (_baselineDays[h] < UINT8_MAX)
+        _baselineDays[h]++;
+}
+
+uint32_t AnomalyDetector::longestGap(unsigned long now) const
+{
+    uint32_t longest = now - (_hasPulse ? _lastPulseMs : _startMs);
+    for (uint8_t i = 0; i < SLOTS; i++)
+    {
+        if (_gapMax[i] > longest)
+            longest = _gapMax[i];
+    }
+    return longest;
+}
+
+AnomalyDetector::Status AnomalyDetector::status(unsigned long now) const
+{
+    Status s;
+    s.alerts = _alerts;
+    // the averages only move on pulses; a pause longer than the implied interval caps them
+    float cap = _hasPulse && now != _lastPulseMs ? 3600000.0f / (now - _lastPulseMs) : 0;
+    s.rateShort = _hasPulse ? min(_rateShort, cap) : 0;
+    s.rateLong = _hasPulse ? min(_rateLong, cap) : 0;
+    s.longestGapMs = longestGap(now);
+    s.flowMs = _flowing ? now - _flowStartMs : 0;
+    s.observedMs = min<uint32_t>(now - _startMs, SLOTS * HOUR_MS);
+    s.lastHourPulses = _lastHourPulses;
+    s.lastHourBaseline = _lastHourBaseline;
+    return s;
+}
+
+void AnomalyDetector::configToJson(const AnomalyConfig& in, JsonObject out)
+{
+    out["minGapMinutes"] = in.minGapMinutes;
+    out["flowGapMinutes"] = in.flowGapMinutes;
+    out["maxFlowMinutes"] = in.maxFlowMinutes;
+    out["deviationFactor"] = in.deviationFactor;
+    out["deviationMinPulses"] = in.deviationMinPulses;
+}
+
+void AnomalyDetector::configFromJson(JsonObjectConst in, AnomalyConfig& out)
+{
+    out.minGapMinutes = in["minGapMinutes"] | out.minGapMinutes;
+    out.flowGapMinutes = in["flowGapMinutes"] | out.flowGapMinutes;
+    out.maxFlowMinutes = in["maxFlowMinutes"] | out.maxFlowMinutes;
+    out.deviationFactor = in["deviationFactor"] | out.deviationFactor;
+    out.deviationMinPulses = in["deviationMinPulses"] | out.deviationMinPulses;
+}
+
+void AnomalyDetector::statusToJson(const Status& in, JsonObject out)
+{
+    for (uint8_t i = 0; i < ALERT_COUNT; i++)
+        out[alertName(i)] = (in.alerts & (1 << i)) != 0;
+    out["rateShort"] = in.rateShort;
+    out["rateLong"] = in.rateLong;
+    out["longestGapMinutes"] = in.longestGapMs / 60000;
+    out["flowMinutes"] = in.flowMs / 60000;
+    out["observedHours"] = in.observedMs / 3600000;
+    out["lastHourPulses"] = in.lastHourPulses;
+    out["lastHourBaseline"] = in.lastHourBaseline;
+}
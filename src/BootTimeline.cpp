@@ -0,0 +1,37 @@
+#include "BootTimeline.h"
+#include "Logger.h"
+
+BootTimeline bootTimeline;
+
+const char* bootMilestoneName(BootMilestone milestone)
+{
+    static const char* const names[BOOT_MILESTONE_COUNT] = {
+        "spiffs_mounted", "data_loaded", "counting_started", "display_ready",
+        "wifi_connected", "mqtt_connected", "first_publish", "first_pulse"};
+    return milestone < BOOT_MILESTONE_COUNT ? names[milestone] : "unknown";
+}
+
+bool BootTimeline::mark(BootMilestone milestone)
+{
+    if (_at[milestone] != 0)
+        return false;
+    uint32_t now = millis();
+    _at[milestone] = now == 0 ? 1 : now;
+    _version = _version + 1;
+    LOG_INFO("Boot: %s after %u ms", bootMilestoneName(milestone), _at[milestone]);
+    return true;
+}
+
+void BootTimeline::toJson(JsonObject out) const
+{
+    JsonObject ms = out.createNestedObject("milestonesMs");
+    for (uint8_t i = 0; i < BOOT_MILESTONE_COUNT; i++)
+    {
+        if (_at[i] != 0)
+            ms[bootMilestoneName(static_cast<BootMilestone>(i))] = _at[i];
+    }
+    out["wifiPath"] = _wifiPath;
+    out["firstPublishTargetMs"] = FIRST_PUBLISH_TARGET_MS;
+    if (reached(BOOT_FIRST_PUBLISH))
+        out["firstPublishOnTarget"] = at(BOOT_FIRST_PUBLISH) <= FIRST_PUBLISH_TARGET_MS;
+}
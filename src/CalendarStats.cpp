@@ -0,0 +1,98 @@
+#include "CalendarStats.h"
+
+const char* CalendarStats::periodName(uint8_t period)
+{
+    static const char* const names[PERIOD_COUNT] = {"day", "week", "month"};
+    return period < PERIOD_COUNT ? names[period] : "unknown";
+}
+
+void CalendarStats::onPulse()
+{
+    for (uint8_t p = 0; p < PERIOD_COUNT; p++)
+        _current[p]++;
+    _dirty = true;
+}
+
+bool CalendarStats::tick(time_t now)
+{
+    bool rolled = false;
+    for (uint8_t p = 0; p < PERIOD_COUNT; p++)
+    {
+        time_t start = periodStart(now, p);
+        if (start <= _start[p])
+            continue; // same period, or the clock stepped back
+        if (_start[p] == 0)
+        {
+            // first synced tick: what was counted so far belongs to the running period
+            _start[p] = start;
+            _dirty = true;
+            continue;
+        }
+        _previous[p] = _start[p] == periodStart(now, p, 1) ? _current[p] : 0;
+        _current[p] = 0;
+        _start[p] = start;
+        _dirty = true;
+        rolled = true;
+    }
+    return rolled;
+}
+
+time_t CalendarStats::periodStart(time_t now, uint8_t period, int back)
+{
+    struct tm t;
+    localtime_r(&now, &t);
+    t.tm_hour = 0;
+    t.tm_min = 0;
+    t.tm_sec = 0;
+    switch (period)
+    {
+    case PERIOD_DAY:
+        t.tm_mday -= back;
+        break;
+    case PERIOD_WEEK:
+        t.tm_mday -= (t.tm_wday + 6) % 7 + 7 * back;
+        break;
+    default:
+        t.tm_mday = 1;
+        t.tm_mon -= back;
+        break;
+    }
+    t.tm_isdst = -1; // mktime() normalises the fields and picks the DST offset of the result
+    return mktime(&t);
+}
+
+void CalendarStats::toJson(JsonObject out) const
+{
+    for (uint8_t p = 0; p < PERIOD_COUNT; p++)
+    {
+        JsonObject o = out.createNestedObject(periodName(p));
+        o["start"] = static_cast<uint32_t>(_start[p]);
+        o["current"] = _current[p];
+        o["previous"] = _previous[p];
+    }
+}
+
+void CalendarStats::fromJson(JsonObjectConst in)
+{
+    for (uint8_t p = 0; p < PERIOD_COUNT; p++)
+    {
+        JsonObjectConst o = in[periodName(p)];
+        _start[p] = o["start"] | 0UL;
+        _current[p] = o["current"] | 0UL;
+        _previous[p] = o["previous"] | 0UL;
+    }
+    _dirty = false;
+}
+
+void calendarStatsToJson(const CalendarStats& stats, bool synced, JsonObject out)
+{
+    static const char* const currentKeys[CalendarStats::PERIOD_COUNT] = {"today", "week", "month"};
+    static const char* const previousKeys[CalendarStats::PERIOD_COUNT] = {"yesterday", "lastWeek", "lastMonth"};
+    for (uint8_t p = 0; p < CalendarStats::PERIOD_COUNT; p++)
+    {
+        out[currentKeys[p]] = stats.current(p) / 100.0;
+        out[previousKeys[p]] = stats.previous(p) / 100.0;
+    }
+    out["clockSynced"] = synced;
+    out["dayStart"] = static_cast<uint32_t>(stats.start(CalendarStats::PERIOD_DAY));
+}
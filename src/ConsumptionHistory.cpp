@@ -0,0 +1,63 @@
+#include "ConsumptionHistory.h"
+
+// One pulse is 0.01 m3
+static const float M3_PER_PULSE = 0.01f;
+// No pulse for this long means the flow has stopped
+static const uint32_t FLOW_TIMEOUT_MS = 30UL * 60 * 1000;
+
+ConsumptionHistory::ConsumptionHistory()
+{
+    _mux = portMUX_INITIALIZER_UNLOCKED;
+}
+
+void ConsumptionHistory::onPulse(unsigned long now)
+{
+    tick(now);
+    portENTER_CRITICAL(&_mux);
+    uint16_t& bucket = _buckets[_head % BUCKETS];
+    if (bucket < UINT16_MAX)
+        bucket++;
+    if (_lastPulse != 0)
+        _lastInterval = now - _lastPulse;
+    _lastPulse = now;
+    portEXIT_CRITICAL(&_mux);
+}
+
+bool ConsumptionHistory::tick(unsigned long now)
+{
+    if (now - _bucketStart < BUCKET_MS)
+        return false;
+    portENTER_CRITICAL(&_mux);
+    // catch up on buckets without pulses, at most one full turn
+    uint32_t elapsed = (now - _bucketStart) / BUCKET_MS;
+    for (uint32_t i = 0; i < elapsed && i < BUCKETS; i++)
+        _buckets[(_head + 1 + i) % BUCKETS] = 0;
+    _head += elapsed;
+    _bucketStart += elapsed * BUCKET_MS;
+    portEXIT_CRITICAL(&_mux);
+    return true;
+}
+
+void ConsumptionHistory::copy(uint16_t* out, uint32_t& head) const
+{
+    portENTER_CRITICAL(&_mux);
+    head = _head;
+    for (uint16_t i = 0; i < BUCKETS; i++)
+        out[i] = _buckets[(_head + 1 + i) % BUCKETS];
+    portEXIT_CRITICAL(&_mux);
+}
+
+float ConsumptionHistory::flowRateM3h(unsigned long now) const
+{
+    portENTER_CRITICAL(&_mux);
+    uint32_t interval = _lastInterval;
+    uint32_t sinceLast = now - _lastPulse;
+    portEXIT_CRITICAL(&_mux);
+
+    if (interval == 0 || sinceLast > FLOW_TIMEOUT_MS)
+        return 0.0f;
+    // a longer pause than the last interval already bounds the current rate
+    if (sinceLast > interval)
+        interval = sinceLast;
+    return M3_PER_PULSE * 3600000.0f / interval;
+}
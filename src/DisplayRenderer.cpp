@@ -0,0 +1,332 @@
+#include "DisplayRenderer.h"
+#include "Logger.h"
+#include "icons.h"
+
+// Approximate command overhead of one windowed write (CASET + RASET + RAMWR)
+static const uint32_t WINDOW_OVERHEAD_BYTES = 11;
+
+DisplayRenderer::DisplayRenderer(TFT_eSPI& tft) : _tft(tft), _strip(&tft), _icon(&tft), _graph(&tft) {}
+
+void DisplayRenderer::begin()
+{
+    _mutex = xSemaphoreCreateMutex();
+    _dma = _tft.initDMA();
+    // Without memory for the sprites the widgets are drawn straight to the panel (see drawStrip)
+    if (_strip.createSprite(WIDTH, STRIP_MAX_H) == nullptr)
+        LOG_WARN("Display: no memory for strip sprite, drawing directly");
+    _icon.createSprite(ICON_SIZE, ICON_SIZE);
+#ifdef TFT_BL
+    ledcSetup(BACKLIGHT_CHANNEL, 5000, 8);
+    ledcAttachPin(TFT_BL, BACKLIGHT_CHANNEL);
+#endif
+    setBacklight(POWER_ON);
+    invalidate();
+}
+
+void DisplayRenderer::setPower(Power power)
+{
+    if (power == _power || !lock())
+        return;
+    if (power == POWER_OFF)
+    {
+        setBacklight(POWER_OFF);
+        _tft.writecommand(TFT_SLPIN);
+        vTaskDelay(pdMS_TO_TICKS(5));
+    }
+    else if (_power == POWER_OFF)
+    {
+        _tft.writecommand(TFT_SLPOUT);
+        vTaskDelay(pdMS_TO_TICKS(120)); // ST7789 needs 120 ms after sleep out
+        invalidate();
+        _backlightPending = true;
+    }
+    else
+    {
+        setBacklight(power);
+    }
+    _power = power;
+    unlock();
+}
+
+void DisplayRenderer::setBacklight(Power power)
+{
+#ifdef TFT_BL
+    uint8_t duty = power == POWER_ON ? 255 : (power == POWER_DIM ? BACKLIGHT_DIM_DUTY : 0);
+#if defined(TFT_BACKLIGHT_ON) && TFT_BACKLIGHT_ON == LOW
+    duty = 255 - duty;
+#endif
+    ledcWrite(BACKLIGHT_CHANNEL, duty);
+#endif
+}
+
+void DisplayRenderer::invalidate()
+{
+    _valid = false;
+}
+
+bool DisplayRenderer::lock(TickType_t timeout)
+{
+    return _mutex == nullptr || xSemaphoreTake(_mutex, timeout) == pdTRUE;
+}
+
+void DisplayRenderer::unlock()
+{
+    if (_mutex != nullptr)
+        xSemaphoreGive(_mutex);
+}
+
+void DisplayRenderer::render(const ScreenModel& model)
+{
+    if (!lock())
+        return;
+    unsigned long start = micros();
+    _frameBytes = 0;
+    _framePixels = 0;
+
+    bool full = !_valid || model.layout != _shown.layout;
+    if (full)
+        drawChrome(model.layout);
+
+    if (model.layout != ScreenModel::LAYOUT_EDIT)
+    {
+        if (full || strcmp(model.title, _shown.title) != 0)
+        {
+            // the status bar strip also covers the icons, so they need to be redrawn afterwards
+            drawStrip({0, 27}, TFT_DARKGREY, model.title, 2, 3, 3, TFT_BLACK);
+            drawIcon(188, wifiIcon, model.wifiConnected);
+            drawIcon(215, mqttIcon, model.mqttConnected);
+        }
+        else
+        {
+            if (model.wifiConnected != _shown.wifiConnected)
+                drawIcon(188, wifiIcon, model.wifiConnected);
+            if (model.mqttConnected != _shown.mqttConnected)
+                drawIcon(215, mqttIcon, model.mqttConnected);
+        }
+        if (full || strcmp(model.line1, _shown.line1) != 0)
+            drawStrip({28, 47}, TFT_BLACK, model.line1, 2, 7, 2, TFT_WHITE);
+        if (model.layout == ScreenModel::LAYOUT_HISTORY)
+            drawGraph(model, full);
+        else if (full || strcmp(model.line2, _shown.line2) != 0)
+            drawStrip({75, 40}, TFT_BLACK, model.line2, 2, 0, 2, TFT_WHITE);
+    }
+    else
+    {
+        if (full || strcmp(model.editValue, _shown.editValue) != 0 ||
+            model.cursorX != _shown.cursorX || model.cursorWidth != _shown.cursorWidth)
+            drawStrip({60, 20}, TFT_BLACK, model.editValue, 30, 0, 2, TFT_WHITE, model.cursorX, model.cursorWidth);
+    }
+
+    if (full || strcmp(model.action, _shown.action) != 0)
+        drawStrip({116, HEIGHT - 116}, TFT_BLACK, model.action, 0, 4, 2, TFT_WHITE);
+
+    _shown = model;
+    _valid = true;
+    if (_backlightPending)
+    {
+        setBacklight(_power);
+        _backlightPending = false;
+    }
+
+    _lastRenderUs = micros() - start;
+    _lastSpiBytes = _frameBytes;
+    _renderCount = _renderCount + 1;
+
+    portENTER_CRITICAL(&_statsMux);
+    _totalSpiBytes += _frameBytes;
+    if (model.page < MAX_PAGES)
+    {
+        PageStats& page = _pages[model.page];
+        page.renders++;
+        page.lastPixels = _framePixels;
+        page.lastSpiBytes = _frameBytes;
+        page.totalSpiBytes += _frameBytes;
+        if (_frameBytes > page.maxSpiBytes)
+            page.maxSpiBytes = _frameBytes;
+        if (_lastRenderUs > page.maxRenderUs)
+            page.maxRenderUs = _lastRenderUs;
+    }
+    portEXIT_CRITICAL(&_statsMux);
+    unlock();
+}
+
+DisplayRenderer::PageStats DisplayRenderer::pageStats(uint8_t page) const
+{
+    PageStats stats = {};
+    portENTER_CRITICAL(&_statsMux);
+    if (page < MAX_PAGES)
+        stats = _pages[page];
+    portEXIT_CRITICAL(&_statsMux);
+    return stats;
+}
+
+uint64_t DisplayRenderer::totalSpiBytes() const
+{
+    portENTER_CRITICAL(&_statsMux);
+    uint64_t total = _totalSpiBytes;
+    portEXIT_CRITICAL(&_statsMux);
+    return total;
+}
+
+// Static parts of a layout; only drawn when the layout changes
+void DisplayRenderer::drawChrome(ScreenModel::Layout layout)
+{
+    _tft.fillScreen(TFT_BLACK);
+    countTransfer(WIDTH, HEIGHT);
+    if (layout != ScreenModel::LAYOUT_HISTORY)
+        _graph.deleteSprite();
+    if (layout != ScreenModel::LAYOUT_EDIT)
+    {
+        _tft.fillRect(0, 115, WIDTH, 1, TFT_DARKGREY); // Accent line
+        countTransfer(WIDTH, 1);
+    }
+    else
+    {
+        _tft.setTextColor(TFT_WHITE, TFT_BLACK);
+        _tft.setTextSize(2);
+        _tft.setCursor(0, 10);
+        _tft.print("             next >");
+        countTransfer(WIDTH, 16);
+    }
+}
+
+void DisplayRenderer::drawStrip(const Strip& strip, uint16_t bg, const char* text, int16_t textX, int16_t textY,
+                                uint8_t size, uint16_t fg, int16_t cursorX, uint8_t cursorWidth)
+{
+    bool useSprite = _strip.created();
+    TFT_eSPI& gfx = useSprite ? static_cast<TFT_eSPI&>(_strip) : _tft;
+    int16_t originY = useSprite ? 0 : strip.y;
+
+    gfx.fillRect(0, originY, WIDTH, strip.h, bg);
+    gfx.setTextColor(fg, bg);
+    gfx.setTextSize(size);
+    gfx.setCursor(textX, originY + textY);
+    gfx.print(text);
+    if (cursorX >= 0)
+        gfx.drawRect(cursorX, originY + 17, cursorWidth, 2, TFT_RED);
+
+    if (useSprite)
+        push(_strip, 0, strip.y, WIDTH, strip.h);
+    countTransfer(WIDTH, strip.h);
+}
+
+void DisplayRenderer::drawIcon(int16_t x, const unsigned short* icon, bool ok)
+{
+    uint16_t color = ok ? TFT_GREEN : TFT_RED;
+    if (!_icon.created())
+    {
+        _tft.fillRect(x, 1, ICON_SIZE, ICON_SIZE, color);
+        _tft.pushImage(x, 1, ICON_SIZE, ICON_SIZE, icon, TFT_WHITE);
+        countTransfer(ICON_SIZE, ICON_SIZE);
+        return;
+    }
+
+    // white icon pixels are transparent and show the status colour
+    _icon.fillSprite(color);
+    for (int16_t y = 0; y < ICON_SIZE; y++)
+        for (int16_t i = 0; i < ICON_SIZE; i++)
+        {
+            uint16_t px = pgm_read_word(&icon[y * ICON_SIZE + i]);
+            if (px != TFT_WHITE)
+                _icon.drawPixel(i, y, px);
+        }
+    push(_icon, x, 1, ICON_SIZE, ICON_SIZE);
+    countTransfer(ICON_SIZE, ICON_SIZE);
+}
+
+// Smallest 1/2/5 * 10^n that fits the peak, so the scale (and a full redraw) changes rarely
+static uint16_t niceScale(uint16_t peak)
+{
+    uint32_t decade = 1;
+    for (;;)
+    {
+        if (peak <= decade)
+            return decade;
+        if (peak <= 2 * decade)
+            return 2 * decade;
+        if (peak <= 5 * decade)
+            return 5 * decade;
+        decade *= 10;
+        if (decade > 10000)
+            return UINT16_MAX;
+    }
+}
+
+// The graph is a persistent sprite: when buckets roll over it is scrolled left and only the
+// new columns are drawn; a pulse only redraws the running column.
+void DisplayRenderer::drawGraph(const ScreenModel& model, bool full)
+{
+    const uint16_t columns = ConsumptionHistory::BUCKETS;
+    uint16_t peak = 0;
+    for (uint16_t i = 0; i < columns; i++)
+        if (model.history[i] > peak)
+            peak = model.history[i];
+    uint16_t scale = niceScale(peak);
+
+    if (!_graph.created())
+    {
+        _graph.setColorDepth(8);
+        if (_graph.createSprite(WIDTH, GRAPH_H) == nullptr)
+            return;
+        full = true;
+    }
+
+    bool rescale = scale != _graphScale;
+    _graphScale = scale;
+
+    uint32_t shift = model.historyHead - _shown.historyHead;
+    if (full || rescale || shift >= columns)
+    {
+        _graph.fillSprite(TFT_BLACK);
+        for (uint16_t x = 0; x < columns; x++)
+            drawGraphColumn(x, model.history[x], x == columns - 1);
+    }
+    else if (shift > 0)
+    {
+        _graph.scroll(-static_cast<int16_t>(shift), 0);
+        // the previously running bucket got its final count, plus every new one
+        for (uint16_t x = columns - 1 - shift; x < columns; x++)
+            drawGraphColumn(x, model.history[x], x == columns - 1);
+    }
+    else if (model.history[columns - 1] != _shown.history[columns - 1])
+    {
+        drawGraphColumn(columns - 1, model.history[columns - 1], true);
+    }
+    else
+    {
+        return;
+    }
+
+    _graph.pushSprite(0, GRAPH_Y);
+    countTransfer(WIDTH, GRAPH_H);
+}
+
+void DisplayRenderer::drawGraphColumn(int16_t x, uint16_t value, bool running)
+{
+    int16_t h = static_cast<uint32_t>(value) * GRAPH_H / _graphScale;
+    if (h == 0 && value > 0)
+        h = 1;
+    _graph.drawFastVLine(x, 0, GRAPH_H, TFT_BLACK);
+    _graph.drawFastVLine(x, GRAPH_H - h, h, running ? TFT_YELLOW : TFT_ORANGE);
+}
+
+// Send the first h rows of a sprite. With DMA the task sleeps in dmaWait() while the SPI
+// peripheral streams the buffer, instead of spinning on every byte.
+void DisplayRenderer::push(TFT_eSprite& sprite, int16_t x, int16_t y, int16_t w, int16_t h)
+{
+    if (!_dma)
+    {
+        sprite.pushSprite(x, y, 0, 0, w, h);
+        return;
+    }
+    _tft.startWrite();
+    _tft.pushImageDMA(x, y, w, h, static_cast<uint16_t*>(sprite.getPointer()));
+    _tft.dmaWait(); // the sprite buffer is reused for the next widget
+    _tft.endWrite();
+}
+
+void DisplayRenderer::countTransfer(int32_t w, int32_t h)
+{
+    _framePixels += w * h;
+    _frameBytes += w * h * 2 + WINDOW_OVERHEAD_BYTES;
+}
@@ -0,0 +1,146 @@
+#include "Logger.h"
+#include <stdarg.h>
+
+Logger logger;
+
+const char* Logger::levelName(uint8_t level)
+{
+    static const char* const names[LOG_LEVEL_COUNT] = {"error", "warn", "info", "debug"};
+    return level < LOG_LEVEL_COUNT ? names[level] : "unknown";
+}
+
+bool Logger::parseLevel(const char* name, LogLevel& level)
+{
+    for (uint8_t i = 0; i < LOG_LEVEL_COUNT; i++)
+    {
+        if (strcasecmp(name, levelName(i)) == 0)
+        {
+            level = static_cast<LogLevel>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+void Logger::begin(Print& out)
+{
+    _out = &out;
+    // below loop() and the network stack; printing is never urgent
+    xTaskCreatePinnedToCore(drainTask, "log", 3072, this, tskIDLE_PRIORITY + 1, &_task, 0);
+}
+
+void Logger::addSecret(const char* secret)
+{
+    if (_secretCount < MAX_SECRETS)
+        _secrets[_secretCount++] = secret;
+}
+
+void Logger::log(LogLevel level, const char* fmt, ...)
+{
+    uint32_t seq = _head.fetch_add(1, std::memory_order_relaxed);
+    Slot& slot = _slots[seq % SLOTS];
+    slot.seq.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.ms = millis();
+    slot.level = level;
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(slot.text, sizeof(slot.text), fmt, args);
+    va_end(args);
+    redact(slot.text);
+
+    slot.seq.store(seq + 1, std::memory_order_release);
+    if (_task != nullptr)
+        xTaskNotifyGive(_task);
+}
+
+void Logger::redact(char* text) const
+{
+    for (uint8_t i = 0; i < _secretCount; i++)
+    {
+        const char* secret = _secrets[i];
+        size_t len = strlen(secret);
+        if (len < 3)
+            continue; // empty or too short to tell apart from ordinary text
+        // resume behind the mask, so a secret that matches *** cannot be found again
+        char* from = text;
+        char* hit;
+        while ((hit = strstr(from, secret)) != nullptr)
+        {
+            memcpy(hit, "***", 3);
+            memmove(hit + 3, hit + len, strlen(hit + len) + 1);
+            from = hit + 3;
+        }
+    }
+}
+
+bool Logger::read(uint32_t seq, Line& out) const
+{
+    const Slot& slot = _slots[seq % SLOTS];
+    uint32_t before = slot.seq.load(std::memory_order_acquire);
+    if (before != seq + 1)
+        return false;
+    out.seq = seq;
+    out.ms = slot.ms;
+    out.level = slot.level;
+    memcpy(out.text, slot.text, sizeof(out.text));
+    out.text[sizeof(out.text) - 1] = '\0';
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot.seq.load(std::memory_order_relaxed) == before;
+}
+
+void Logger::drain()
+{
+    static const char levelTags[LOG_LEVEL_COUNT] = {'E', 'W', 'I', 'D'};
+    uint32_t head = _head.load(std::memory_order_acquire);
+    if (head - _tail > SLOTS)
+    {
+        _dropped.fetch_add(head - _tail - SLOTS, std::memory_order_relaxed);
+        _tail = head - SLOTS;
+    }
+    Line line;
+    while (_tail != head)
+    {
+        if (!read(_tail, line))
+        {
+            if (_slots[_tail % SLOTS].seq.load(std::memory_order_acquire) == 0)
+                break; // still being written; the writer notifies again
+            _dropped.fetch_add(1, std::memory_order_relaxed); // overwritten before it was printed
+            _tail++;
+            continue;
+        }
+        _out->printf("[%6lu.%03lu] %c %s\n", static_cast<unsigned long>(line.ms / 1000),
+                     static_cast<unsigned long>(line.ms % 1000), levelTags[line.level % LOG_LEVEL_COUNT], line.text);
+        _tail++;
+    }
+}
+
+void Logger::drainTask(void* arg)
+{
+    Logger* self = static_cast<Logger*>(arg);
+    for (;;)
+    {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(1000));
+        self->drain();
+    }
+}
+
+size_t Logger::tail(size_t maxLines, LineSink sink, void* ctx) const
+{
+    uint32_t head = _head.load(std::memory_order_acquire);
+    uint32_t count = head < SLOTS ? head : SLOTS;
+    if (maxLines < count)
+        count = maxLines;
+    size_t sent = 0;
+    Line line;
+    for (uint32_t seq = head - count; seq != head; seq++)
+    {
+        if (!read(seq, line))
+            continue;
+        if (!sink(ctx, line))
+            break;
+        sent++;
+    }
+    return sent;
+}
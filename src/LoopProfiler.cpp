@@ -0,0 +1,97 @@
+#include "LoopProfiler.h"
+
+const char* loopStageName(LoopStage stage)
+{
+    static const char* const names[STAGE_COUNT] = {
+        "sampling", "pulse", "button1", "button2", "connection", "connection_change",
+        "wifi_retry", "mqtt_retry", "web_commands", "config_change", "wm_process", "mqtt",
+        "publish", "save", "housekeeping", "anomaly", "calendar", "selftest"};
+    return stage < STAGE_COUNT ? names[stage] : "unknown";
+}
+
+#ifdef LOOP_PROFILER
+
+LoopProfiler loopProfiler;
+
+void LoopProfiler::record(LoopStage stage, uint32_t cycles)
+{
+    // the cycle counter wraps after ~17 s at 240 MHz, longer stalls are not representable
+    uint32_t us = cycles / getCpuFrequencyMhz();
+    uint8_t bucket = us == 0 ? 0 : 32 - __builtin_clz(us);
+    if (bucket >= BUCKETS)
+        bucket = BUCKETS - 1;
+
+    portENTER_CRITICAL(&_mux);
+    StageStats& s = _stats[stage];
+    s.buckets[bucket]++;
+    s.count++;
+    s.totalUs += us;
+    if (us > s.maxUs)
+        s.maxUs = us;
+    portEXIT_CRITICAL(&_mux);
+}
+
+LoopProfiler::StageStats LoopProfiler::snapshot(LoopStage stage) const
+{
+    portENTER_CRITICAL(&_mux);
+    StageStats s = _stats[stage];
+    portEXIT_CRITICAL(&_mux);
+    return s;
+}
+
+// Upper bound of the bucket that contains the requested percentile
+uint32_t LoopProfiler::percentileUs(const StageStats& s, uint8_t pct)
+{
+    if (s.count == 0)
+        return 0;
+    uint32_t target = (static_cast<uint64_t>(s.count) * pct + 99) / 100;
+    uint32_t seen = 0;
+    for (uint8_t i = 0; i < BUCKETS; i++)
+    {
+        seen += s.buckets[i];
+        if (seen >= target)
+            return min(static_cast<uint32_t>(1UL << i), s.maxUs);
+    }
+    return s.maxUs;
+}
+
+uint32_t LoopProfiler::percentileUs(LoopStage stage, uint8_t pct) const
+{
+    return percentileUs(snapshot(stage), pct);
+}
+
+void LoopProfiler::reset()
+{
+    portENTER_CRITICAL(&_mux);
+    memset(_stats, 0, sizeof(_stats));
+    portEXIT_CRITICAL(&_mux);
+}
+
+void LoopProfiler::dump(Print& out) const
+{
+    out.println("stage                 count     avg_us    p99_us    max_us");
+    for (uint8_t i = 0; i < STAGE_COUNT; i++)
+    {
+        StageStats s = snapshot(static_cast<LoopStage>(i));
+        out.printf("%-19s %8u %10u %9u %9u\n", loopStageName(static_cast<LoopStage>(i)), s.count,
+                   s.count ? static_cast<uint32_t>(s.totalUs / s.count) : 0, percentileUs(s, 99), s.maxUs);
+    }
+}
+
+void LoopProfiler::toJson(JsonObject out) const
+{
+    for (uint8_t i = 0; i < STAGE_COUNT; i++)
+    {
+        StageStats s = snapshot(static_cast<LoopStage>(i));
+        JsonObject stage = out.createNestedObject(loopStageName(static_cast<LoopStage>(i)));
+        stage["count"] = s.count;
+        stage["avgUs"] = s.count ? static_cast<uint32_t>(s.totalUs / s.count) : 0;
+        stage["p99Us"] = percentileUs(s, 99);
+        stage["maxUs"] = s.maxUs;
+        JsonArray hist = stage.createNestedArray("histogram");
+        for (uint8_t b = 0; b < BUCKETS; b++)
+            hist.add(s.buckets[b]);
+    }
+}
+
+#endif // LOOP_PROFILER
@@ -0,0 +1,173 @@
+#include "MeterChannels.h"
+#include <driver/gpio.h>
+
+bool MeterChannels::pinAvailable(uint8_t pin)
+{
+    static const uint8_t freePins[] = {12, 13, 15, 17, 21, 22, 25, 26, 27, 33, 36, 37, 38, 39};
+    for (uint8_t i = 0; i < sizeof(freePins); i++)
+    {
+        if (freePins[i] == pin)
+            return true;
+    }
+    return false;
+}
+
+void MeterChannels::configure(uint8_t ch, const ChannelConfig& config)
+{
+    if (ch >= MAX_CHANNELS)
+        return;
+    if (ch > 0 && _enabled[ch])
+        detachInterrupt(_pin[ch]);
+
+    _enabled[ch] = config.enabled;
+    _pin[ch] = config.pin;
+    _activeLow[ch] = config.activeLow;
+    _pullup[ch] = config.pullup;
+    _debounceMs[ch] = config.debounceMs;
+    _unitsPerPulse[ch] = config.unitsPerPulse > 0 ? config.unitsPerPulse : 1.0f;
+    strlcpy(_name[ch], config.name, sizeof(_name[ch]));
+    strlcpy(_unit[ch], config.unit, sizeof(_unit[ch]));
+    strlcpy(_deviceClass[ch], config.deviceClass, sizeof(_deviceClass[ch]));
+    strlcpy(_topic[ch], config.topic, sizeof(_topic[ch]));
+    _dirty = true;
+
+    if (ch == 0 || !config.enabled)
+        return;
+    pinMode(config.pin, config.pullup ? INPUT_PULLUP : INPUT);
+    _args[ch].self = this;
+    _args[ch].ch = ch;
+    _active[ch] = (digitalRead(config.pin) == LOW) == config.activeLow;
+    _lastEdgeUs[ch] = esp_timer_get_time();
+    attachInterruptArg(config.pin, onEdge, &_args[ch], CHANGE);
+}
+
+ChannelConfig MeterChannels::config(uint8_t ch) const
+{
+    ChannelConfig config;
+    if (ch >= MAX_CHANNELS)
+        return config;
+    config.enabled = _enabled[ch];
+    config.pin = _pin[ch];
+    config.activeLow = _activeLow[ch];
+    config.pullup = _pullup[ch];
+    config.debounceMs = _debounceMs[ch];
+    config.unitsPerPulse = _unitsPerPulse[ch];
+    strlcpy(config.name, _name[ch], sizeof(config.name));
+    strlcpy(config.unit, _unit[ch], sizeof(config.unit));
+    strlcpy(config.deviceClass, _deviceClass[ch], sizeof(config.deviceClass));
+    strlcpy(config.topic, _topic[ch], sizeof(config.topic));
+    return config;
+}
+
+// Every level change is tracked, so the state never drifts from the pin. Only the counting edge is
+// filtered: a change to the active level counts if the input was inactive for at least debounceMs
+// before it, which skips contact bounce at both ends of a pulse.
+void IRAM_ATTR MeterChannels::onEdge(void* arg)
+{
+    IsrArg* a = static_cast<IsrArg*>(arg);
+    MeterChannels* self = a->self;
+    uint8_t ch = a->ch;
+    bool active = (gpio_get_level(static_cast<gpio_num_t>(self->_pin[ch])) == 0) == self->_activeLow[ch];
+    if (active == self->_active[ch])
+        return;
+    int64_t now = esp_timer_get_time();
+    int64_t restedUs = now - self->_lastEdgeUs[ch];
+    self->_lastEdgeUs[ch] = now;
+    self->_active[ch] = active;
+    if (active && restedUs >= static_cast<int64_t>(self->_debounceMs[ch]) * 1000)
+    {
+        portENTER_CRITICAL_ISR(&self->_mux);
+        self->_pending[ch] = self->_pending[ch] + 1;
+        portEXIT_CRITICAL_ISR(&self->_mux);
+    }
+}
+
+uint32_t MeterChannels::collect()
+{
+    uint32_t taken[MAX_CHANNELS];
+    portENTER_CRITICAL(&_mux);
+    for (uint8_t ch = 1; ch < MAX_CHANNELS; ch++)
+    {
+        taken[ch] = _pending[ch];
+        _pending[ch] = 0;
+    }
+    portEXIT_CRITICAL(&_mux);
+
+    uint32_t changed = 0;
+    for (uint8_t ch = 1; ch < MAX_CHANNELS; ch++)
+    {
+        if (taken[ch] == 0)
+            continue;
+        pulses[ch] += taken[ch];
+        changed |= 1UL << ch;
+    }
+    if (changed)
+        _dirty = true;
+    return changed;
+}
+
+void MeterChannels::setValue(uint8_t ch, double value)
+{
+    if (ch >= MAX_CHANNELS)
+        return;
+    double target = value / _unitsPerPulse[ch] + 0.5;
+    uint32_t targetPulses = target > 0 ? static_cast<uint32_t>(target) : 0;
+    if (targetPulses >= pulses[ch])
+    {
+        offset[ch] = targetPulses - pulses[ch];
+    }
+    else
+    {
+        offset[ch] = targetPulses;
+        pulses[ch] = 0;
+    }
+    _dirty = true;
+}
+
+void MeterChannels::toJson(JsonArray out) const
+{
+    for (uint8_t ch = 1; ch < MAX_CHANNELS; ch++)
+    {
+        JsonObject o = out.createNestedObject();
+        o["enabled"] = _enabled[ch];
+        o["pin"] = _pin[ch];
+        o["activeLow"] = _activeLow[ch];
+        o["pullup"] = _pullup[ch];
+        o["debounceMs"] = _debounceMs[ch];
+        o["unitsPerPulse"] = _unitsPerPulse[ch];
+        o["name"] = _name[ch];
+        o["unit"] = _unit[ch];
+        o["deviceClass"] = _deviceClass[ch];
+        o["topic"] = _topic[ch];
+        o["count"] = pulses[ch];
+        o["offset"] = offset[ch];
+    }
+}
+
+void MeterChannels::fromJson(JsonArrayConst in)
+{
+    uint8_t ch = 1;
+    for (JsonObjectConst o : in)
+    {
+        if (ch >= MAX_CHANNELS)
+            break;
+        ChannelConfig config;
+        config.enabled = o["enabled"] | false;
+        config.pin = o["pin"] | 0;
+        config.activeLow = o["activeLow"] | false;
+        config.pullup = o["pullup"] | false;
+        config.debounceMs = o["debounceMs"] | config.debounceMs;
+        config.unitsPerPulse = o["unitsPerPulse"] | 0.001f;
+        strlcpy(config.name, o["name"] | "", sizeof(config.name));
+        strlcpy(config.unit, o["unit"] | "", sizeof(config.unit));
+        strlcpy(config.deviceClass, o["deviceClass"] | "", sizeof(config.deviceClass));
+        strlcpy(config.topic, o["topic"] | "", sizeof(config.topic));
+        if (config.enabled && !pinAvailable(config.pin))
+            config.enabled = false;
+        pulses[ch] = o["count"].as<uint32_t>();
+        offset[ch] = o["offset"].as<uint32_t>();
+        configure(ch, config);
+        ch++;
+    }
+    _dirty = false;
+}
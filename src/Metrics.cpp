@@ -0,0 +1,150 @@
+#include "Metrics.h"
+#include <stdarg.h>
+#include "Logger.h"
+
+Metrics metrics;
+
+const uint32_t LatencyHistogram::BOUNDS_US[LatencyHistogram::BUCKETS] = {
+    100, 250, 500, 1000, 2500, 5000, 10000, 25000, 100000, 1000000};
+
+void LatencyHistogram::observe(uint32_t us)
+{
+    uint8_t i = 0;
+    while (i < BUCKETS && us > BOUNDS_US[i])
+        i++;
+    counts[i] = counts[i] + 1;
+    sumUs.add(us);
+    if (us > maxUs)
+        maxUs = us;
+}
+
+void LatencyHistogram::toJson(JsonObject out) const
+{
+    uint32_t count = 0;
+    for (uint8_t i = 0; i <= BUCKETS; i++)
+        count += counts[i];
+    out["count"] = count;
+    out["avgMs"] = count ? sumUs.get() / 1000.0 / count : 0.0;
+    out["maxMs"] = maxUs / 1000.0;
+    JsonObject buckets = out.createNestedObject("buckets");
+    char key[16];
+    for (uint8_t i = 0; i <= BUCKETS; i++)
+    {
+        if (counts[i] == 0)
+            continue;
+        if (i < BUCKETS)
+            snprintf(key, sizeof(key), "%g", BOUNDS_US[i] / 1000.0);
+        else
+            strlcpy(key, "+Inf", sizeof(key));
+        buckets[key] = counts[i]; // ArduinoJson copies the char[] key
+    }
+}
+
+void Metrics::recordPulse(unsigned long now)
+{
+    if (lastPulseTime != 0)
+        lastPulseIntervalMs = now - lastPulseTime;
+    lastPulseTime = now;
+}
+
+float Metrics::pulseRatePerHour(unsigned long now) const
+{
+    uint32_t interval = lastPulseIntervalMs;
+    if (interval == 0)
+        return 0.0f;
+    uint32_t sinceLast = now - lastPulseTime;
+    if (sinceLast > interval)
+        interval = sinceLast;
+    return 3600000.0f / interval;
+}
+
+MetricsWriter::MetricsWriter(httpd_req_t* req) : _req(req)
+{
+    httpd_resp_set_type(req, "text/plain; version=0.0.4");
+}
+
+void MetricsWriter::counter(const char* name, const char* help, uint64_t value)
+{
+    header(name, help, "counter");
+    printf("%s %llu\n", name, (unsigned long long)value);
+}
+
+void MetricsWriter::fractionalCounter(const char* name, const char* help, double value)
+{
+    header(name, help, "counter");
+    printf("%s %.3f\n", name, value);
+}
+
+void MetricsWriter::gauge(const char* name, const char* help, double value)
+{
+    header(name, help, "gauge");
+    printf("%s %.3f\n", name, value);
+}
+
+void MetricsWriter::histogram(const char* name, const char* help, const LatencyHistogram& h)
+{
+    header(name, help, "histogram");
+    uint32_t cumulative = 0;
+    for (uint8_t i = 0; i < LatencyHistogram::BUCKETS; i++)
+    {
+        cumulative += h.counts[i];
+        printf("%s_bucket{le=\"%g\"} %u\n", name, LatencyHistogram::BOUNDS_US[i] / 1e6, cumulative);
+    }
+    cumulative += h.counts[LatencyHistogram::BUCKETS];
+    printf("%s_bucket{le=\"+Inf\"} %u\n", name, cumulative);
+    printf("%s_sum %.6f\n", name, h.sumUs.get() / 1e6);
+    printf("%s_count %u\n", name, cumulative);
+}
+
+void MetricsWriter::sample(const char* name, const char* labels, double value)
+{
+    printf("%s{%s} %.6g\n", name, labels, value);
+}
+
+esp_err_t MetricsWriter::finish()
+{
+    flush();
+    if (_err == ESP_OK)
+        _err = httpd_resp_send_chunk(_req, nullptr, 0);
+    return _err;
+}
+
+void MetricsWriter::header(const char* name, const char* help, const char* type)
+{
+    printf("# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+// Formats straight into the chunk buffer. A line that does not fit behind what is buffered is
+// formatted again after a flush; one longer than the whole buffer is dropped, because a cut line
+// loses its newline and would run into the next sample.
+void MetricsWriter::printf(const char* fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    va_list retry;
+    va_copy(retry, args);
+    int n = vsnprintf(_buf + _len, sizeof(_buf) - _len, fmt, args);
+    va_end(args);
+    if (n > 0 && _len + n >= sizeof(_buf))
+    {
+        flush();
+        if (static_cast<size_t>(n) < sizeof(_buf))
+            vsnprintf(_buf, sizeof(_buf), fmt, retry);
+        else
+        {
+            LOG_WARN("metrics line of %d bytes dropped", n);
+            n = 0;
+        }
+    }
+    va_end(retry);
+    if (n > 0)
+        _len += n;
+}
+
+void MetricsWriter::flush()
+{
+    // after a failed send the rest is discarded
+    if (_len > 0 && _err == ESP_OK)
+        _err = httpd_resp_send_chunk(_req, _buf, _len);
+    _len = 0;
+}
@@ -0,0 +1,434 @@
+#include "Mqtt.h"
+#include <WiFi.h>
+#include <ArduinoJson.h>
+#include "BootTimeline.h"
+#include "Logger.h"
+#include "Metrics.h"
+#include "NumberFormat.h"
+#include "StallWatchdog.h"
+
+constexpr unsigned long PUBLISH_INTERVAL = 1 * 60 * 1000; // 60 seconds
+
+// Default uses a Home Assistant friendly path under the clientID: clientID/measurement/gas
+String mqtt_topic_gas = "measurement/gas";
+String mqtt_topic_currentVal = "measurement/current";
+char mqtt_server[40] = "192.168.178.203";
+char mqtt_port[6] = "1883";
+char mqtt_user[40] = "mqtt";
+char mqtt_password[40] = "foobar";
+
+WiFiClient espClient;
+PubSubClient client(espClient);
+char lastMqttStatus[48] = "never"; // plain buffer: written by the boot task, read for the status snapshot
+volatile unsigned long lastMqttAttemptTime = 0;
+int lastMqttErrorCode = 0;
+bool hassDiscoveryPublished = false;
+uint8_t publishedAlerts = 0xFF;
+
+static uint32_t gasVolume = 0;
+
+// Publish and account the result in the metrics
+bool mqttPublish(const char *topic, const char *payload, bool retained)
+{
+    uint32_t start = micros();
+    bool ok = client.publish(topic, payload, retained);
+    metrics.mqttPublishLatency.observe(micros() - start);
+    if (ok)
+    {
+        metrics.mqttPublishOk++;
+        metrics.mqttPublishBytes.add(strlen(topic) + strlen(payload));
+    }
+    else
+        metrics.mqttPublishFailed++;
+    return ok;
+}
+
+static void recordMqttReconnect(unsigned long start, bool ok)
+{
+    uint32_t duration = millis() - start;
+    metrics.mqttReconnects++;
+    if (!ok)
+        metrics.mqttReconnectFailures++;
+    metrics.mqttReconnectLastMs = duration;
+    metrics.mqttReconnectTotalMs.add(duration);
+}
+
+// Function to reconnect to the MQTT broker
+boolean reconnect_mqtt()
+{
+    TRACE_SCOPE(TRACE_MQTT_CONNECT, mqtt_server);
+    // Set up MQTT client
+    uint16_t port = static_cast<uint16_t>(std::stoi(mqtt_port));
+    client.setServer(mqtt_server, port);
+    client.setCallback(MQTTcallbackReceive);
+    LOG_INFO("Trying to connect to MQTT server %s:%s (user:%s) ...", mqtt_server, mqtt_port, mqtt_user);
+
+    lastMqttAttemptTime = millis();
+    unsigned long attemptStart = millis();
+
+    // Quick TCP connectivity check before attempting the PubSubClient connect
+    {
+        WiFiClient testClient;
+        LOG_DEBUG("Testing TCP connection to %s:%u ...", mqtt_server, port);
+        bool tcpOk = testClient.connect(mqtt_server, port);
+        if (!tcpOk)
+        {
+            strlcpy(lastMqttStatus, "TCP connect failed", sizeof(lastMqttStatus));
+            lastMqttErrorCode = -1;
+            LOG_WARN("TCP connection to MQTT broker failed; skipping MQTT connect");
+            testClient.stop();
+            recordMqttReconnect(attemptStart, false);
+            return false;
+        }
+        LOG_DEBUG("TCP connection OK");
+        testClient.stop();
+    }
+
+    // Attempt MQTT connect (with Last Will set to 'offline' on availability topic)
+    String availTopic = clientID + "/availability";
+
+    // Non-blocking wait for 50ms to allow broker to process connection
+    unsigned long waitStart = millis();
+    while (millis() - waitStart < 50)
+    {
+        client.loop();
+        delay(1);
+    }
+
+    // Attempt MQTT connect with LWT
+    bool connected = client.connect(
+        clientID.c_str(),
+        strlen(mqtt_user) ? mqtt_user : nullptr,
+        strlen(mqtt_password) ? mqtt_password : nullptr,
+        availTopic.c_str(),
+        1,
+        true,
+        "offline");
+
+    if (connected)
+    {
+        strlcpy(lastMqttStatus, "connected", sizeof(lastMqttStatus));
+        lastMqttErrorCode = 0;
+        LOG_INFO("MQTT connected to %s", mqtt_server);
+        bootTimeline.mark(BOOT_MQTT_CONNECTED);
+        mqttPublish(availTopic.c_str(), "online", true);
+        client.loop();
+        delay(50);
+        String mqttTopic = clientID + "/" + mqtt_topic_currentVal;
+        client.subscribe(mqttTopic.c_str());
+        publishHassDiscovery();
+    }
+    else
+    {
+        lastMqttErrorCode = client.state();
+        snprintf(lastMqttStatus, sizeof(lastMqttStatus), "connect failed (state=%d)", lastMqttErrorCode);
+        LOG_WARN("Failed to connect to MQTT server. Error: %i", lastMqttErrorCode);
+    }
+
+    recordMqttReconnect(attemptStart, client.connected());
+    return client.connected();
+}
+
+// Function to publish gas volume via MQTT
+void publishGasVolume()
+{
+    scheduler.schedule(jobPublish, PUBLISH_INTERVAL);
+    if (!client.connected())
+    {
+        LOG_WARN("Publishing not possible! MQTT not connected.");
+        return;
+    }
+    gasVolume = pulseCount + offset;
+    // Human readable (kept for backwards compatibility)
+    char humanMsg[NUMBER_BUFFER_SIZE];
+    formatCentiValue(gasVolume, humanMsg, sizeof(humanMsg));
+    String mqttTopicHuman = clientID + "/" + mqtt_topic_gas;
+    mqttPublish(mqttTopicHuman.c_str(), humanMsg);
+
+    // Numeric raw value (Home Assistant friendly) - retained so HA can read it after restarts
+    char rawMsg[32];
+    float rawValue = static_cast<float>(gasVolume) / 100.0f;
+    snprintf(rawMsg, sizeof(rawMsg), "%.2f", rawValue);
+    String mqttTopicRaw = mqttTopicHuman + "/state";
+    bool ok = mqttPublish(mqttTopicRaw.c_str(), rawMsg, true);
+    if (ok)
+    {
+        bootTimeline.mark(BOOT_FIRST_PUBLISH);
+    }
+
+    LOG_INFO("Gas volume published: %s m3 (raw: %s)", humanMsg, rawMsg);
+
+    // If discovery hasn't been published yet, try now (first successful publish)
+    if (!hassDiscoveryPublished && ok) {
+        publishHassDiscovery();
+    }
+
+    publishChannels();
+    publishAnomaly();
+    publishCalendarStats();
+}
+
+// Retained JSON at <clientID>/stats with today/yesterday/week/lastWeek/month/lastMonth in m³
+void publishCalendarStats()
+{
+    if (!networkReady || !client.connected())
+    {
+        return;
+    }
+    DynamicJsonDocument doc(384);
+    calendarStatsToJson(calendarStats, clockSynced, doc.to<JsonObject>());
+    char payload[256];
+    serializeJson(doc, payload, sizeof(payload));
+    mqttPublish((clientID + "/stats").c_str(), payload, true);
+}
+
+// Numeric retained state of the additional meter channels: <clientID>/<topic>/state
+void publishChannels()
+{
+    char payload[24];
+    for (uint8_t ch = 1; ch < MeterChannels::MAX_CHANNELS; ch++)
+    {
+        if (!meterChannels.enabled(ch))
+        {
+            continue;
+        }
+        ChannelConfig config = meterChannels.config(ch);
+        snprintf(payload, sizeof(payload), "%.3f", meterChannels.value(ch));
+        mqttPublish((clientID + "/" + config.topic + "/state").c_str(), payload, true);
+    }
+}
+
+// Retained ON/OFF per alert at <clientID>/alert/<name>, details as JSON at <clientID>/anomaly
+void publishAnomaly()
+{
+    if (!networkReady || !client.connected())
+    {
+        return;
+    }
+    uint8_t alerts = anomalyDetector.alerts();
+    bool ok = true;
+    for (uint8_t i = 0; i < AnomalyDetector::ALERT_COUNT; i++)
+    {
+        String topic = clientID + "/alert/" + AnomalyDetector::alertName(i);
+        ok = mqttPublish(topic.c_str(), (alerts & (1 << i)) ? "ON" : "OFF", true) && ok;
+    }
+    DynamicJsonDocument doc(384);
+    AnomalyDetector::statusToJson(anomalyDetector.status(millis()), doc.to<JsonObject>());
+    char payload[320];
+    serializeJson(doc, payload, sizeof(payload));
+    ok = mqttPublish((clientID + "/anomaly").c_str(), payload, true) && ok;
+    if (ok)
+    {
+        if (alerts != publishedAlerts && publishedAlerts != 0xFF)
+        {
+            LOG_WARN("Anomaly alerts changed: 0x%02x -> 0x%02x", publishedAlerts, alerts);
+        }
+        publishedAlerts = alerts;
+    }
+}
+
+// Publish Home Assistant MQTT discovery payloads for this device
+void publishHassDiscovery()
+{
+    if (!client.connected()) return;
+    unsigned long discoveryStart = millis();
+
+    String baseHuman = clientID + "/" + mqtt_topic_gas; // human readable topic
+    String baseRaw = baseHuman + "/state";                 // numeric state topic
+    String currentTopic = clientID + "/" + mqtt_topic_currentVal;
+    String availTopic = clientID + "/availability";
+
+    // Track publish results
+    bool ok1 = false;
+    bool ok2 = false;
+    bool ok3 = true;
+
+    // Device info block
+    DynamicJsonDocument device(256);
+    device["identifiers"]; // placeholder to ensure key exists
+    device["name"] = clientID;
+    device["sw_version"] = version;
+    JsonArray ids = device.createNestedArray("identifiers");
+    ids.add(clientID);
+    device["model"] = "Gaszaehler";
+    device["manufacturer"] = "DIY";
+
+    // Sensor: total (cumulative) gas volume
+    {
+        DynamicJsonDocument doc(512);
+        doc["name"] = String(clientID + " Gas Volume");
+        doc["unique_id"] = String(clientID + "_gas_volume");
+        doc["state_topic"] = baseHuman + "/state"; // Change to new state topic
+        doc["unit_of_measurement"] = "m³";
+        doc["value_template"] = "{{ value | float }}";
+        doc["state_class"] = "total_increasing";
+        doc["device_class"] = "gas";
+        doc["icon"] = "mdi:fire";
+        doc["availability_topic"] = availTopic;
+        doc["device"] = device;
+
+        String payload;
+        serializeJson(doc, payload);
+        String discoveryTopic = String("homeassistant/sensor/") + clientID + "_gas_volume/config";
+        ok1 = mqttPublish(discoveryTopic.c_str(), payload.c_str(), true);
+        LOG_DEBUG("Discovery %s (%u bytes): %s", discoveryTopic.c_str(), (unsigned)payload.length(), ok1 ? "ok" : "failed");
+    }
+
+    // Sensor: current instantaneous value
+    {
+        DynamicJsonDocument doc(512);
+        doc["name"] = String(clientID + " Current Value");
+        doc["unique_id"] = String(clientID + "_current_value");
+        doc["state_topic"] = currentTopic;
+        doc["unit_of_measurement"] = "m³";
+        doc["value_template"] = "{{ value | float }}";
+        doc["state_class"] = "total_increasing";
+        doc["device_class"] = "gas";
+        doc["icon"] = "mdi:fire";
+        doc["availability_topic"] = availTopic;
+        doc["device"] = device;
+
+        String payload;
+        serializeJson(doc, payload);
+        String discoveryTopic = String("homeassistant/sensor/") + clientID + "_current_value/config";
+        ok2 = mqttPublish(discoveryTopic.c_str(), payload.c_str(), true);
+        LOG_DEBUG("Discovery %s (%u bytes): %s", discoveryTopic.c_str(), (unsigned)payload.length(), ok2 ? "ok" : "failed");
+    }
+    // Sensors: additional meter channels
+    for (uint8_t ch = 1; ch < MeterChannels::MAX_CHANNELS; ch++)
+    {
+        ChannelConfig config = meterChannels.config(ch);
+        String uniqueId = clientID + "_ch" + String(ch);
+        String discoveryTopic = String("homeassistant/sensor/") + uniqueId + "/config";
+        if (!config.enabled)
+        {
+            // an empty retained config removes the entity
+            mqttPublish(discoveryTopic.c_str(), "", true);
+            continue;
+        }
+        DynamicJsonDocument doc(768);
+        doc["name"] = clientID + " " + config.name;
+        doc["unique_id"] = uniqueId;
+        doc["state_topic"] = clientID + "/" + config.topic + "/state";
+        doc["unit_of_measurement"] = config.unit;
+        doc["value_template"] = "{{ value | float }}";
+        doc["state_class"] = "total_increasing";
+        if (strlen(config.deviceClass) > 0)
+        {
+            doc["device_class"] = config.deviceClass;
+        }
+        doc["availability_topic"] = availTopic;
+        doc["device"] = device;
+
+        String payload;
+        serializeJson(doc, payload);
+        if (!mqttPublish(discoveryTopic.c_str(), payload.c_str(), true))
+        {
+            ok3 = false;
+        }
+    }
+
+    // Sensors: consumption per calendar period from <clientID>/stats
+    {
+        struct StatsEntity
+        {
+            const char *key;
+            const char *name;
+            const char *stateClass;
+        };
+        static const StatsEntity entities[] = {
+            {"today", "Gas Today", "total_increasing"},
+            {"yesterday", "Gas Yesterday", "total"},
+            {"week", "Gas This Week", "total_increasing"},
+            {"lastWeek", "Gas Last Week", "total"},
+            {"month", "Gas This Month", "total_increasing"},
+            {"lastMonth", "Gas Last Month", "total"},
+        };
+        for (const StatsEntity &entity : entities)
+        {
+            String uniqueId = clientID + "_gas_" + entity.key;
+            DynamicJsonDocument doc(768);
+            doc["name"] = clientID + " " + entity.name;
+            doc["unique_id"] = uniqueId;
+            doc["state_topic"] = clientID + "/stats";
+            doc["value_template"] = String("{{ value_json.") + entity.key + " }}";
+            doc["unit_of_measurement"] = "m³";
+            doc["device_class"] = "gas";
+            doc["state_class"] = entity.stateClass;
+            doc["availability_topic"] = availTopic;
+            doc["device"] = device;
+
+            String payload;
+            serializeJson(doc, payload);
+            String discoveryTopic = String("homeassistant/sensor/") + uniqueId + "/config";
+            if (!mqttPublish(discoveryTopic.c_str(), payload.c_str(), true))
+            {
+                ok3 = false;
+            }
+        }
+    }
+
+    // Binary sensors: anomaly alerts, with the detector's figures as attributes
+    for (uint8_t i = 0; i < AnomalyDetector::ALERT_COUNT; i++)
+    {
+        const char *name = AnomalyDetector::alertName(i);
+        String uniqueId = clientID + "_" + name;
+        DynamicJsonDocument doc(768);
+        doc["name"] = clientID + " " + name;
+        doc["unique_id"] = uniqueId;
+        doc["state_topic"] = clientID + "/alert/" + name;
+        doc["payload_on"] = "ON";
+        doc["payload_off"] = "OFF";
+        doc["device_class"] = (1 << i) == AnomalyDetector::ALERT_LEAK ? "gas" : "problem";
+        doc["json_attributes_topic"] = clientID + "/anomaly";
+        doc["availability_topic"] = availTopic;
+        doc["device"] = device;
+
+        String payload;
+        serializeJson(doc, payload);
+        String discoveryTopic = String("homeassistant/binary_sensor/") + uniqueId + "/config";
+        if (!mqttPublish(discoveryTopic.c_str(), payload.c_str(), true))
+        {
+            ok3 = false;
+        }
+    }
+
+    // Publish availability as online (retain)
+    ok3 = mqttPublish((clientID + "/availability").c_str(), "online", true) && ok3;
+
+    // Mark discovery published only if all publishes succeeded
+    if (ok1 && ok2 && ok3) {
+        hassDiscoveryPublished = true;
+        LOG_INFO("Home Assistant discovery published (retained)");
+    } else {
+        hassDiscoveryPublished = false;
+        LOG_WARN("Home Assistant discovery publish attempt; some messages may have failed");
+    }
+    metrics.mqttDiscoveryRuns++;
+    metrics.mqttDiscoveryLastMs = millis() - discoveryStart;
+}
+
+// Callback function for receiving MQTT messages
+void MQTTcallbackReceive(char *topic, byte *payload, unsigned int length)
+{
+    String message;
+    for (unsigned int i = 0; i < length; i++)
+    {
+        message += (char)payload[i];
+    }
+    if (String(topic) == clientID + "/" + mqtt_topic_currentVal)
+    {
+        uint32_t setStart = micros();
+        offset = static_cast<uint32_t>(message.toFloat() * 100);
+        LOG_INFO("Counter value received: %s m3", message.c_str());
+        char offsetValue[NUMBER_BUFFER_SIZE];
+        formatCentiValue(offset, offsetValue, sizeof(offsetValue));
+        LOG_INFO("Calculated offset: %s m3", offsetValue);
+        pulseCount = 0;
+        updateDisplay();
+        saveDataToSPIFFS();
+        publishGasVolume();
+        metrics.mqttSetCount++;
+        metrics.mqttSetLastUs = micros() - setStart;
+    }
+}
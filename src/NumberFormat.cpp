@@ -0,0 +1,38 @@
+#include "NumberFormat.h"
+
+#include <string.h>
+
+size_t formatCentiValue(uint32_t value, char *buf, size_t len, NumberStyle style)
+{
+    const char groupSep = groupSeparator(style);
+    const size_t n = centiValueLength(value, style);
+
+    // Written backwards from the last decimal, straight into buf when it is large enough
+    char tmp[NUMBER_BUFFER_SIZE];
+    char *out = n < len ? buf : tmp;
+    char *p = out + n;
+    *p = '\0';
+    *--p = '0' + value % 10;
+    value /= 10;
+    *--p = '0' + value % 10;
+    value /= 10;
+    *--p = decimalSeparator(style);
+    uint8_t digits = 0;
+    do
+    {
+        if (groupSep && digits > 0 && digits % 3 == 0)
+        {
+            *--p = groupSep;
+        }
+        *--p = '0' + value % 10;
+        value /= 10;
+        digits++;
+    } while (value > 0);
+
+    if (out == tmp && len > 0)
+    {
+        memcpy(buf, tmp, len - 1);
+        buf[len - 1] = '\0';
+    }
+    return n;
+}
@@ -0,0 +1,143 @@
+#include "OtaUpdater.h"
+#include "Logger.h"
+#include <Update.h>
+#include <esp_ota_ops.h>
+
+#ifdef CONFIG_APP_ROLLBACK_ENABLE
+// Tell the Arduino core not to validate a freshly flashed image on its own;
+// it stays pending until WiFi/MQTT came up (see OtaUpdater::confirmBoot).
+extern "C" bool verifyRollbackLater()
+{
+    return true;
+}
+#endif
+
+OtaUpdater::OtaUpdater()
+{
+    mbedtls_sha256_init(&_sha);
+}
+
+OtaUpdater::~OtaUpdater()
+{
+    mbedtls_sha256_free(&_sha);
+}
+
+bool OtaUpdater::begin(size_t totalSize, const char* expectedSha256Hex)
+{
+    _received = 0;
+    _total = totalSize;
+    _error[0] = '\0';
+    _digestHex[0] = '\0';
+    _startTime = millis();
+    _endTime = 0;
+    strlcpy(_expectedHex, expectedSha256Hex ? expectedSha256Hex : "", sizeof(_expectedHex));
+    for (char* c = _expectedHex; *c; c++)
+        *c = tolower(*c);
+
+    if (!Update.begin(totalSize > 0 ? totalSize : UPDATE_SIZE_UNKNOWN))
+    {
+        fail(Update.errorString());
+        return false;
+    }
+    mbedtls_sha256_starts_ret(&_sha, 0);
+    _state = RUNNING;
+    LOG_INFO("OTA: Upload start (%u bytes, sha256 %s)", (unsigned)totalSize, _expectedHex[0] ? "supplied" : "not supplied");
+    return true;
+}
+
+// UpdateClass already collects the data into a sector-sized buffer and erases + programs
+// whole sectors, so the received chunks are passed straight through
+bool OtaUpdater::write(const uint8_t* data, size_t len)
+{
+    if (_state != RUNNING)
+        return false;
+    mbedtls_sha256_update_ret(&_sha, data, len);
+    if (Update.write(const_cast<uint8_t*>(data), len) != len)
+    {
+        fail(Update.errorString());
+        return false;
+    }
+    _received += len;
+    return true;
+}
+
+bool OtaUpdater::finish()
+{
+    if (_state != RUNNING)
+        return false;
+
+    uint8_t digest[32];
+    mbedtls_sha256_finish_ret(&_sha, digest);
+    for (int i = 0; i < 32; i++)
+        sprintf(_digestHex + i * 2, "%02x", digest[i]);
+
+    if (_expectedHex[0] && strcmp(_expectedHex, _digestHex) != 0)
+    {
+        fail("sha256 mismatch");
+        return false;
+    }
+    if (!Update.end(true))
+    {
+        fail(Update.errorString());
+        return false;
+    }
+    _endTime = millis();
+    _state = SUCCESS;
+    LOG_INFO("OTA: Update success (%u bytes, %u B/s, sha256 %s)", (unsigned)_received, bytesPerSecond(), _digestHex);
+    return true;
+}
+
+void OtaUpdater::abort(const char* reason)
+{
+    if (_state == RUNNING)
+        fail(reason);
+}
+
+void OtaUpdater::fail(const char* reason)
+{
+    strlcpy(_error, reason, sizeof(_error));
+    _endTime = millis();
+    _state = FAILED;
+    if (Update.isRunning())
+        Update.abort();
+    LOG_ERROR("OTA: Update failed: %s", reason);
+}
+
+uint8_t OtaUpdater::percent() const
+{
+    if (_total == 0)
+        return _state == SUCCESS ? 100 : 0;
+    return static_cast<uint8_t>((static_cast<uint64_t>(_received) * 100) / _total);
+}
+
+uint32_t OtaUpdater::bytesPerSecond() const
+{
+    unsigned long elapsed = (_endTime ? _endTime : millis()) - _startTime;
+    if (elapsed == 0)
+        return 0;
+    return static_cast<uint32_t>((static_cast<uint64_t>(_received) * 1000) / elapsed);
+}
+
+void OtaUpdater::checkPendingVerify()
+{
+    esp_ota_img_states_t otaState;
+    const esp_partition_t* running = esp_ota_get_running_partition();
+    _pendingVerify = esp_ota_get_state_partition(running, &otaState) == ESP_OK && otaState == ESP_OTA_IMG_PENDING_VERIFY;
+    if (_pendingVerify)
+        LOG_INFO("OTA: New image booted, waiting for WiFi/MQTT before marking it valid");
+}
+
+void OtaUpdater::confirmBoot()
+{
+    if (!_pendingVerify)
+        return;
+    esp_ota_mark_app_valid_cancel_rollback();
+    _pendingVerify = false;
+    LOG_INFO("OTA: Image marked valid");
+}
+
+void OtaUpdater::rollbackBoot()
+{
+    LOG_ERROR("OTA: Image not confirmed in time, rolling back");
+    esp_ota_mark_app_invalid_rollback_and_reboot();
+}
@@ -0,0 +1,161 @@
+#include "PowerManager.h"
+#include "Logger.h"
+#include <WiFi.h>
+#include <esp_pm.h>
+#include <esp_sleep.h>
+#include <driver/gpio.h>
+#if POWER_LIGHT_SLEEP
+#include <hal/gpio_ll.h>
+#endif
+
+void PowerManager::begin()
+{
+    _task = xTaskGetCurrentTaskHandle();
+}
+
+void PowerManager::addWakePin(uint8_t pin)
+{
+    if (_pinCount < MAX_WAKE_PINS)
+        _pins[_pinCount++] = pin;
+}
+
+void PowerManager::setEnabled(bool enabled)
+{
+    if (enabled == _enabled)
+        return;
+    _enabled = enabled;
+
+    for (uint8_t i = 0; i < _pinCount; i++)
+    {
+        if (enabled)
+            attachInterruptArg(_pins[i], onEdge, this, CHANGE);
+        else
+            detachInterrupt(_pins[i]);
+    }
+
+    // Max modem sleep skips DTIM beacons; min modem sleep is the core's default
+    WiFi.setSleep(enabled ? WIFI_PS_MAX_MODEM : WIFI_PS_MIN_MODEM);
+
+    // Keep the minimum at 80 MHz: the display SPI and UART baud rates assume an 80 MHz APB
+    esp_pm_config_esp32_t pm = {};
+    pm.max_freq_mhz = enabled ? LOW_POWER_CPU_MHZ : 240;
+    pm.min_freq_mhz = enabled ? LOW_POWER_CPU_MHZ : 240;
+    pm.light_sleep_enable = enabled && POWER_LIGHT_SLEEP;
+    _pmActive = esp_pm_configure(&pm) == ESP_OK;
+    if (!_pmActive)
+        setCpuFrequencyMhz(enabled ? LOW_POWER_CPU_MHZ : 240);
+
+    if (enabled)
+        esp_sleep_enable_gpio_wakeup();
+    resetWindow();
+    _dutyCycle = 1.0f;
+    LOG_INFO("Low-power mode %s (CPU %u MHz, light sleep %s)", enabled ? "on" : "off",
+                  getCpuFrequencyMhz(), lightSleep() ? "on" : "off");
+}
+
+void IRAM_ATTR PowerManager::onEdge(void* arg)
+{
+    PowerManager* self = static_cast<PowerManager*>(arg);
+    self->_edgeUs = esp_timer_get_time();
+    self->_edgePending = true;
+#if POWER_LIGHT_SLEEP
+    // A level wake-up interrupt keeps firing until its type changes. gpio_wakeup_disable() is not
+    // IRAM-safe, so only the register is switched back to edges here; idle() disarms the wake-up.
+    for (uint8_t i = 0; i < self->_pinCount; i++)
+        gpio_ll_set_intr_type(&GPIO, static_cast<gpio_num_t>(self->_pins[i]), GPIO_INTR_ANYEDGE);
+#endif
+    BaseType_t woken = pdFALSE;
+    if (self->_task != nullptr)
+        vTaskNotifyGiveFromISR(self->_task, &woken);
+    if (woken)
+        portYIELD_FROM_ISR();
+}
+
+uint16_t PowerManager::readAnalog(uint8_t pin)
+{
+    if (!_enabled)
+        return analogRead(pin);
+    // detached, so switching the pad between ADC and digital input does not count as an edge
+    detachInterrupt(pin);
+    uint16_t value = analogRead(pin);
+    pinMode(pin, INPUT);
+    attachInterruptArg(pin, onEdge, this, CHANGE);
+    return value;
+}
+
+void PowerManager::wake()
+{
+    if (_task != nullptr)
+        xTaskNotifyGive(_task);
+}
+
+// Edge interrupts do not run in light sleep, so wake on the opposite of each pin's current level
+void PowerManager::armLevelWake()
+{
+#if POWER_LIGHT_SLEEP
+    if (!_pmActive)
+        return;
+    for (uint8_t i = 0; i < _pinCount; i++)
+    {
+        gpio_num_t pin = static_cast<gpio_num_t>(_pins[i]);
+        gpio_wakeup_enable(pin, gpio_get_level(pin) ? GPIO_INTR_LOW_LEVEL : GPIO_INTR_HIGH_LEVEL);
+    }
+#endif
+}
+
+void PowerManager::disarmLevelWake()
+{
+#if POWER_LIGHT_SLEEP
+    for (uint8_t i = 0; i < _pinCount; i++)
+        gpio_wakeup_disable(static_cast<gpio_num_t>(_pins[i]));
+#endif
+}
+
+void PowerManager::idle(uint32_t maxMs)
+{
+    if (maxMs == 0)
+        return;
+
+    if (_enabled)
+        armLevelWake();
+    int64_t start = esp_timer_get_time();
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(maxMs));
+    int64_t end = esp_timer_get_time();
+#if POWER_LIGHT_SLEEP
+    if (_enabled && _pmActive)
+    {
+        disarmLevelWake();
+        for (uint8_t i = 0; i < _pinCount; i++)
+            gpio_set_intr_type(static_cast<gpio_num_t>(_pins[i]), GPIO_INTR_ANYEDGE);
+    }
+#endif
+
+    _idleCount++;
+    _windowIdleUs += end - start;
+    if (_edgePending)
+    {
+        _edgePending = false;
+        int64_t edge = _edgeUs;
+        // edges while awake are handled without waiting; only count the ones that ended a sleep
+        if (edge >= start)
+        {
+            _edgeWakeups++;
+            _lastWakeLatencyUs = static_cast<uint32_t>(end - edge);
+            if (_lastWakeLatencyUs > _maxWakeLatencyUs)
+                _maxWakeLatencyUs = _lastWakeLatencyUs;
+        }
+    }
+
+    int64_t window = end - _windowStartUs;
+    if (window >= DUTY_WINDOW_US)
+    {
+        _dutyCycle = 1.0f - static_cast<float>(_windowIdleUs) / window;
+        resetWindow();
+    }
+}
+
+void PowerManager::resetWindow()
+{
+    _windowStartUs = esp_timer_get_time();
+    _windowIdleUs = 0;
+}
@@ -0,0 +1,67 @@
+#include "PulseBroadcaster.h"
+#include <lwip/sockets.h>
+#include "Logger.h"
+
+PulseBroadcaster pulseBroadcaster;
+
+bool PulseBroadcaster::configure(const char* address, uint16_t port)
+{
+    _enabled = false;
+    if (address == nullptr || address[0] == '\0' || port == 0)
+        return true;
+    in_addr addr;
+    if (inet_aton(address, &addr) == 0)
+    {
+        LOG_WARN("UDP pulse target %s is not an IPv4 address", address);
+        return false;
+    }
+    _address = addr.s_addr;
+    _port = port;
+    _multicast = IN_MULTICAST(ntohl(_address));
+    _enabled = true;
+    LOG_INFO("UDP pulse datagrams to %s:%u%s", address, port, _multicast ? " (multicast)" : "");
+    return true;
+}
+
+// Deferred to the first pulse, so configure() may run before the network is up
+bool PulseBroadcaster::openSocket()
+{
+    _socket = lwip_socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (_socket < 0)
+        return false;
+    int flags = lwip_fcntl(_socket, F_GETFL, 0);
+    lwip_fcntl(_socket, F_SETFL, flags | O_NONBLOCK);
+    uint8_t ttl = 1; // stay on the local network
+    lwip_setsockopt(_socket, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+    return true;
+}
+
+void PulseBroadcaster::send(uint8_t channel, uint32_t total, uint32_t intervalMs, int64_t timestampUs)
+{
+    if (!_enabled)
+        return;
+    if (_socket < 0 && !openSocket())
+    {
+        _failed++;
+        return;
+    }
+    // the ESP32 is little-endian, so the struct is already in wire order
+    PulseDatagram d;
+    d.magic[0] = 'G';
+    d.magic[1] = 'P';
+    d.version = VERSION;
+    d.channel = channel;
+    d.sequence = _sequence++;
+    d.timestampUs = timestampUs;
+    d.total = total;
+    d.intervalMs = intervalMs;
+
+    sockaddr_in to = {};
+    to.sin_family = AF_INET;
+    to.sin_port = htons(_port);
+    to.sin_addr.s_addr = _address;
+    if (lwip_sendto(_socket, &d, sizeof(d), 0, reinterpret_cast<sockaddr*>(&to), sizeof(to)) == sizeof(d))
+        _sent++;
+    else
+        _failed++;
+}
@@ -1,8 +1,16 @@
 #include "SPIFFSManager.h"
 #include <SPIFFS.h>
 #include <ArduinoJson.h>
+#include <esp_timer.h>
+#include "Logger.h"
 
 const char *SPIFFSManager::DATA_FILE = "/data.json";
+const char *SPIFFSManager::SETTINGS_FILE = "/settings.json";
+const char *SPIFFSManager::CHANNELS_FILE = "/channels.json";
+const char *SPIFFSManager::ANOMALY_FILE = "/anomaly.json";
+const char *SPIFFSManager::STATS_FILE = "/stats.json";
+// the files above, for the per-file statistics
+const char *const SPIFFSManager::FILES[SPIFFSManager::FILE_COUNT] = {"/data.json", "/settings.json", "/channels.json", "/anomaly.json", "/stats.json"};
 
 SPIFFSManager::SPIFFSManager() {}
 
@@ -25,7 +33,7 @@ bool SPIFFSManager::mountSPIFFS()
 {
     if (!SPIFFS.begin(true))
     {
-        Serial.println("Error mounting SPIFFS");
+        LOG_ERROR("Error mounting SPIFFS");
         return false;
     }
     return true;
@@ -33,14 +41,6 @@ bool SPIFFSManager::mountSPIFFS()
 
 bool SPIFFSManager::saveData(uint32_t pulseCount, uint32_t offset, char *mqtt_server, char *mqtt_port, char *mqtt_user, char *mqtt_password, char *mqtt_clientid, char *mqtt_topic_gas, char *mqtt_topic_current)
 {
-    // Open in write mode and truncate to avoid stale JSON fragments
-    File file = SPIFFS.open(DATA_FILE, "w"); // truncate + write
-    if (!file)
-    {
-        Serial.println("Error opening file for writing");
-        return false;
-    }
-
     DynamicJsonDocument doc(1024);
     doc["count"] = pulseCount;
     doc["offset"] = offset;
@@ -53,41 +53,21 @@ bool SPIFFSManager::saveData(uint32_t pulseCount, uint32_t offset, char *mqtt_se
     doc["mqtt_topic_gas"] = mqtt_topic_gas;
     doc["mqtt_topic_current"] = mqtt_topic_current;
 
-    if (serializeJson(doc, file) == 0)
+    if (!saveJson(DATA_FILE, doc))
     {
-        Serial.println("Error writing data");
-        file.close();
         return false;
     }
-
-    Serial.println("Data successfully written:");
-    Serial.printf(" < Meter reading: %i\n", pulseCount);
-    Serial.printf(" < Offset: %i\n", offset);
-    Serial.printf(" < MQTT Server: %s\n", mqtt_server);
-    Serial.printf(" < MQTT Port: %s\n", mqtt_port);
-    Serial.printf(" < MQTT Username: %s\n", mqtt_user);
-    Serial.printf(" < MQTT Password: %s\n", mqtt_password);
-
-    file.close();
+    // the password is never logged
+    LOG_INFO("Data written: meter reading %u, offset %u, MQTT %s:%s (user:%s)", pulseCount, offset, mqtt_server, mqtt_port, mqtt_user);
     return true;
 }
 
 bool SPIFFSManager::loadData(uint32_t &pulseCount, uint32_t &offset, char *mqtt_server, char *mqtt_port, char *mqtt_user, char *mqtt_password, char *mqtt_clientid, char *mqtt_topic_gas, char *mqtt_topic_current)
 {
-    File file = SPIFFS.open(DATA_FILE, FILE_READ);
-    if (!file)
-    {
-        Serial.println("Error opening file for reading");
-        return false;
-    }
-
     DynamicJsonDocument doc(1024);
-    DeserializationError error = deserializeJson(doc, file);
-    file.close();
-
-    if (error)
+    if (!loadJson(DATA_FILE, doc))
     {
-        Serial.println("Error deserializing JSON data");
+        LOG_WARN("No readable %s", DATA_FILE);
         return false;
     }
 
@@ -112,25 +92,167 @@ bool SPIFFSManager::loadData(uint32_t &pulseCount, uint32_t &offset, char *mqtt_
     copyIfSet(doc["mqtt_clientid"], mqtt_clientid, 64);
     copyIfSet(doc["mqtt_topic_gas"], mqtt_topic_gas, 64);
     copyIfSet(doc["mqtt_topic_current"], mqtt_topic_current, 64);
-    
-    Serial.printf(" < Meter reading: %i\n", pulseCount);
-    Serial.printf(" < Offset: %i\n", offset);
-    Serial.printf(" < MQTT Server: %s\n", mqtt_server);
-    Serial.printf(" < MQTT Port: %s\n", mqtt_port);
-    Serial.printf(" < MQTT Username: %s\n", mqtt_user);
-    Serial.printf(" < MQTT Password: %s\n", mqtt_password);
 
+    LOG_INFO("Data loaded: meter reading %u, offset %u, MQTT %s:%s (user:%s)", pulseCount, offset, mqtt_server, mqtt_port, mqtt_user);
+
+    return true;
+}
+
+SPIFFSManager::FileStats *SPIFFSManager::statsFor(const char *path)
+{
+    for (uint8_t i = 0; i < FILE_COUNT; i++)
+    {
+        if (strcmp(FILES[i], path) == 0)
+            return &_stats[i];
+    }
+    return nullptr;
+}
+
+namespace
+{
+// SPIFFS geometry as configured by the ESP32 core: 256-byte pages with a 5-byte header
+const size_t PAGE_SIZE = 256;
+const size_t PAGE_DATA = PAGE_SIZE - 5;
+const size_t BLOCK_SIZE = 4096;
+
+// Pages programmed by writing a file of 'size' bytes: its data pages plus an object index
+// page, plus one page for flagging the replaced file's pages as deleted. An estimate: lookup
+// entries, deletion marks and garbage collection are not counted (test/storage measures them).
+size_t estimatedProgrammedBytes(size_t size)
+{
+    return ((size + PAGE_DATA - 1) / PAGE_DATA + 2) * PAGE_SIZE;
+}
+} // namespace
+
+bool SPIFFSManager::saveJson(const char *path, const JsonDocument &doc)
+{
+    uint32_t start = micros();
+    FileStats *stats = statsFor(path);
+    char tmpPath[32];
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", path);
+    File file = SPIFFS.open(tmpPath, "w");
+    if (!file)
+    {
+        LOG_ERROR("Error opening %s for writing", tmpPath);
+        if (stats)
+            stats->failures++;
+        return false;
+    }
+    _lastWriteSize = serializeJson(doc, file);
+    file.flush();
+    bool complete = _lastWriteSize > 0 && file.size() == _lastWriteSize;
+    file.close();
+    // SPIFFS cannot rename onto an existing file; until the rename a load finds the .tmp copy
+    if (!complete || (SPIFFS.exists(path) && !SPIFFS.remove(path)) || !SPIFFS.rename(tmpPath, path))
+    {
+        LOG_ERROR("Error writing %s", path);
+        if (stats)
+            stats->failures++;
+        return false;
+    }
+    if (stats)
+    {
+        uint32_t us = micros() - start;
+        portENTER_CRITICAL(&_statsMux);
+        stats->saves++;
+        stats->bytes += _lastWriteSize;
+        stats->estimatedProgrammedBytes += estimatedProgrammedBytes(_lastWriteSize);
+        stats->lastSaveUs = us;
+        if (us > stats->maxSaveUs)
+            stats->maxSaveUs = us;
+        portEXIT_CRITICAL(&_statsMux);
+    }
+    return true;
+}
+
+bool SPIFFSManager::readJson(const char *path, JsonDocument &doc)
+{
+    File file = SPIFFS.open(path, FILE_READ);
+    if (!file)
+    {
+        return false;
+    }
+    DeserializationError error = deserializeJson(doc, file);
+    file.close();
+    if (error)
+    {
+        LOG_ERROR("Error deserializing %s", path);
+        return false;
+    }
     return true;
 }
 
+// Falls back to the .tmp copy a save left behind when power failed before the rename
+bool SPIFFSManager::loadJson(const char *path, JsonDocument &doc)
+{
+    uint32_t start = micros();
+    FileStats *stats = statsFor(path);
+    bool ok = readJson(path, doc);
+    bool recovered = false;
+    if (!ok)
+    {
+        char tmpPath[32];
+        snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", path);
+        doc.clear();
+        recovered = ok = readJson(tmpPath, doc);
+        if (recovered)
+            LOG_WARN("%s restored from an interrupted save", path);
+    }
+    if (stats)
+    {
+        stats->loadUs = micros() - start;
+        stats->recovered = recovered;
+    }
+    return ok;
+}
+
+void SPIFFSManager::statsToJson(JsonObject out) const
+{
+    size_t total = SPIFFS.totalBytes();
+    out["totalBytes"] = total;
+    out["usedBytes"] = SPIFFS.usedBytes();
+    out["pageSize"] = PAGE_SIZE;
+    out["blockSize"] = BLOCK_SIZE;
+
+    // Saves run in the loop task, this in the HTTP task
+    FileStats snapshot[FILE_COUNT];
+    portENTER_CRITICAL(&_statsMux);
+    memcpy(snapshot, _stats, sizeof(snapshot));
+    portEXIT_CRITICAL(&_statsMux);
+
+    uint64_t programmed = 0;
+    JsonArray files = out.createNestedArray("files");
+    for (uint8_t i = 0; i < FILE_COUNT; i++)
+    {
+        const FileStats &s = snapshot[i];
+        programmed += s.estimatedProgrammedBytes;
+        JsonObject o = files.createNestedObject();
+        o["path"] = FILES[i];
+        o["saves"] = s.saves;
+        o["failures"] = s.failures;
+        o["bytes"] = s.bytes;
+        o["estimatedProgrammedBytes"] = s.estimatedProgrammedBytes;
+        o["estimatedWriteAmplification"] = s.bytes ? static_cast<double>(s.estimatedProgrammedBytes) / s.bytes : 0.0;
+        o["lastSaveMs"] = s.lastSaveUs / 1000.0;
+        o["maxSaveMs"] = s.maxSaveUs / 1000.0;
+        o["loadMs"] = s.loadUs / 1000.0;
+        o["recovered"] = s.recovered;
+    }
+    out["estimatedProgrammedBytes"] = programmed;
+    // Every programmed page is erased again by garbage collection eventually, and SPIFFS
+    // spreads that over all blocks, so each block sees programmed / total erases in the same time
+    // esp_timer rather than millis(), which wraps after 49 days
+    double uptimeS = esp_timer_get_time() / 1e6;
+    out["estimatedErasesPerBlockPerYear"] = (total && uptimeS > 0) ? static_cast<double>(programmed) / total * (365.0 * 24 * 3600 / uptimeS) : 0.0;
+}
+
 void SPIFFSManager::listFiles()
 {
     File root = SPIFFS.open("/");
     File file = root.openNextFile();
     while (file)
     {
-        Serial.print("FILE: ");
-        Serial.println(file.name());
+        LOG_INFO("FILE: %s", file.name());
         file = root.openNextFile();
     }
 }
\ No newline at end of file
@@ -0,0 +1,231 @@
+#include "Scheduler.h"
+#include "Logger.h"
+#include "StallWatchdog.h"
+
+void Scheduler::begin()
+{
+    _task = xTaskGetCurrentTaskHandle();
+    for (uint8_t i = 0; i < SLOTS; i++)
+        _slots[i] = -1;
+    _cursor = 0;
+    _wheelTime = millis();
+    _started = true;
+}
+
+Scheduler::JobId Scheduler::add(const char* name, uint32_t intervalMs, JobFn fn)
+{
+    if (_count >= MAX_JOBS || fn == nullptr)
+    {
+        LOG_ERROR("Scheduler: job '%s' not added (%u of %u slots used)", name, _count, MAX_JOBS);
+        return -1;
+    }
+    if (!_started)
+        begin();
+    JobId id = _count++;
+    Job& job = _jobs[id];
+    job.fn = fn;
+    job.intervalMs = intervalMs;
+    job.due = 0;
+    job.rounds = 0;
+    job.next = -1;
+    job.slot = -1;
+    job.stats = {name, 0, 0, 0, 0, 0};
+    return id;
+}
+
+Scheduler::JobId Scheduler::every(const char* name, uint32_t intervalMs, JobFn fn, uint32_t firstMs)
+{
+    JobId id = add(name, intervalMs, fn);
+    if (id >= 0)
+        insert(id, millis() + firstMs);
+    return id;
+}
+
+Scheduler::JobId Scheduler::once(const char* name, JobFn fn)
+{
+    return add(name, 0, fn);
+}
+
+Scheduler::JobId Scheduler::onEvent(const char* name, JobFn fn)
+{
+    return add(name, 0, fn);
+}
+
+void Scheduler::schedule(JobId id, uint32_t delayMs)
+{
+    if (id < 0 || id >= _count)
+        return;
+    unlink(id);
+    insert(id, millis() + delayMs);
+}
+
+void Scheduler::signal(JobId id)
+{
+    if (id < 0 || id >= _count)
+        return;
+    portENTER_CRITICAL(&_mux);
+    _signalled |= 1UL << id;
+    portEXIT_CRITICAL(&_mux);
+    if (_task != nullptr && xTaskGetCurrentTaskHandle() != _task)
+        xTaskNotifyGive(_task);
+}
+
+void Scheduler::insert(JobId id, uint32_t due)
+{
+    Job& job = _jobs[id];
+    int32_t ahead = static_cast<int32_t>(due - _wheelTime);
+    uint32_t ticks = ahead > 0 ? (static_cast<uint32_t>(ahead) + TICK_MS - 1) / TICK_MS : 0;
+    job.due = due;
+    job.rounds = ticks / SLOTS;
+    job.slot = (_cursor + ticks) % SLOTS;
+    job.next = _slots[job.slot];
+    _slots[job.slot] = id;
+}
+
+void Scheduler::unlink(JobId id)
+{
+    Job& job = _jobs[id];
+    if (job.slot < 0)
+        return;
+    JobId* link = &_slots[job.slot];
+    while (*link >= 0)
+    {
+        if (*link == id)
+        {
+            *link = job.next;
+            break;
+        }
+        link = &_jobs[*link].next;
+    }
+    job.slot = -1;
+    job.next = -1;
+}
+
+// Turns the wheel up to now; jobs whose slot comes up in their last round are collected in readyMask
+void Scheduler::advance(uint32_t now, uint32_t& readyMask)
+{
+    while (static_cast<int32_t>(now - _wheelTime) >= 0)
+    {
+        JobId id = _slots[_cursor];
+        while (id >= 0)
+        {
+            Job& job = _jobs[id];
+            JobId next = job.next;
+            if (job.rounds == 0)
+            {
+                unlink(id);
+                readyMask |= 1UL << id;
+            }
+            else
+            {
+                job.rounds--;
+            }
+            id = next;
+        }
+        _cursor = (_cursor + 1) % SLOTS;
+        _wheelTime += TICK_MS;
+    }
+}
+
+void Scheduler::execute(JobId id, uint32_t now, bool timed)
+{
+    Job& job = _jobs[id];
+    if (timed)
+    {
+        portENTER_CRITICAL(&_mux);
+        job.stats.lastJitterMs = now - job.due;
+        if (job.stats.lastJitterMs > job.stats.maxJitterMs)
+            job.stats.maxJitterMs = job.stats.lastJitterMs;
+        portEXIT_CRITICAL(&_mux);
+    }
+
+    // Re-arm before running so the job can move its own deadline
+    if (timed && job.intervalMs > 0)
+    {
+        uint32_t next = job.due + job.intervalMs;
+        if (static_cast<int32_t>(next - now) <= 0)
+            next = now + job.intervalMs; // overran: skip the missed runs instead of bursting
+        insert(id, next);
+    }
+
+    TRACE_SCOPE(TRACE_JOB, job.stats.name);
+    uint32_t start = micros();
+    job.fn();
+    uint32_t elapsed = micros() - start;
+    portENTER_CRITICAL(&_mux);
+    job.stats.runs++;
+    job.stats.totalUs += elapsed;
+    if (elapsed > job.stats.maxUs)
+        job.stats.maxUs = elapsed;
+    portEXIT_CRITICAL(&_mux);
+}
+
+Scheduler::JobStats Scheduler::stats(JobId id) const
+{
+    portENTER_CRITICAL(&_mux);
+    JobStats s = _jobs[id].stats;
+    portEXIT_CRITICAL(&_mux);
+    return s;
+}
+
+uint32_t Scheduler::run()
+{
+    uint32_t now = millis();
+
+    portENTER_CRITICAL(&_mux);
+    uint32_t ready = _signalled;
+    _signalled = 0;
+    portEXIT_CRITICAL(&_mux);
+
+    uint32_t timed = 0;
+    advance(now, timed);
+    // A timer job that is also signalled runs once, in registration order
+    ready |= timed;
+    for (JobId id = 0; id < _count; id++)
+    {
+        if (ready & (1UL << id))
+            execute(id, now, timed & (1UL << id));
+    }
+
+    if (_signalled != 0)
+        return 0;
+
+    uint32_t wait = SLOTS * TICK_MS;
+    for (JobId id = 0; id < _count; id++)
+    {
+        uint32_t until = msUntil(id);
+        if (until < wait)
+            wait = until;
+    }
+    // nothing fires before the wheel reaches its next slot
+    int32_t toSlot = static_cast<int32_t>(_wheelTime - millis());
+    if (toSlot > 0 && wait < static_cast<uint32_t>(toSlot))
+        wait = toSlot;
+    return wait;
+}
+
+uint32_t Scheduler::msUntil(JobId id) const
+{
+    if (id < 0 || id >= _count || _jobs[id].slot < 0)
+        return UINT32_MAX;
+    int32_t ahead = static_cast<int32_t>(_jobs[id].due - millis());
+    return ahead > 0 ? static_cast<uint32_t>(ahead) : 0;
+}
+
+void Scheduler::toJson(JsonArray out) const
+{
+    for (JobId id = 0; id < _count; id++)
+    {
+        JobStats s = stats(id);
+        JsonObject job = out.createNestedObject();
+        job["name"] = s.name;
+        job["interval"] = _jobs[id].intervalMs;
+        job["runs"] = s.runs;
+        job["totalUs"] = s.totalUs;
+        job["maxUs"] = s.maxUs;
+        job["avgUs"] = s.runs ? static_cast<uint32_t>(s.totalUs / s.runs) : 0;
+        job["jitterMs"] = s.lastJitterMs;
+        job["maxJitterMs"] = s.maxJitterMs;
+        job["due"] = msUntil(id) == UINT32_MAX ? -1 : static_cast<long>(msUntil(id));
+    }
+}
@@ -0,0 +1,256 @@
+#include "SelfTest.h"
+#include "Logger.h"
+
+SelfTest selfTest;
+
+namespace
+{
+struct Shape {
+    uint16_t periodMs;
+    uint16_t widthMs;
+};
+
+// Frequency sweep at 50 % duty, then pulse width at 1 Hz. The gas input is polled every
+// 50 ms, so the last steps of each half are expected to lose pulses.
+const Shape SWEEP[SelfTest::STEPS] = {
+    {2000, 1000}, {1000, 500}, {500, 250}, {333, 167}, {250, 125}, {200, 100}, {150, 75}, {125, 62}, {100, 50},
+    {1000, 200}, {1000, 150}, {1000, 120}, {1000, 100}, {1000, 80}, {1000, 60}, {1000, 50}, {1000, 40}, {1000, 30},
+};
+
+const uint32_t START_DELAY_US = 100000; // first edge of a step
+const unsigned long SETTLE_MS = 300;    // a few sampling passes after the last pulse
+} // namespace
+
+SelfTest::SelfTest()
+{
+    for (uint8_t i = 0; i < STEPS; i++)
+    {
+        _results[i].periodMs = SWEEP[i].periodMs;
+        _results[i].widthMs = SWEEP[i].widthMs;
+    }
+}
+
+bool SelfTest::start(const SelfTestOptions& options)
+{
+    if (_state == STATE_RUNNING)
+        return false;
+    if (_timer == nullptr)
+    {
+        esp_timer_create_args_t args = {};
+        args.callback = &SelfTest::onTimer;
+        args.arg = this;
+        args.name = "selftest";
+        if (esp_timer_create(&args, &_timer) != ESP_OK)
+        {
+            LOG_ERROR("Self-test: generator timer not available");
+            return false;
+        }
+    }
+    _options = options;
+    if (_options.stepSeconds == 0)
+        _options.stepSeconds = 1;
+    if (loopback())
+    {
+        pinMode(_options.pin, OUTPUT);
+        digitalWrite(_options.pin, LOW);
+    }
+    portENTER_CRITICAL(&_mux);
+    for (uint8_t i = 0; i < STEPS; i++)
+    {
+        _results[i].generated = 0;
+        _results[i].counted = 0;
+        _results[i].maxSampleGapMs = 0;
+    }
+    _step = 0;
+    _publishes = 0;
+    _httpRequests = 0;
+    _httpErrors = 0;
+    _state = STATE_RUNNING;
+    portEXIT_CRITICAL(&_mux);
+    LOG_INFO("Self-test started (%s, %u s per step, load %s)", loopback() ? "loopback" : "virtual input",
+             _options.stepSeconds, _options.load ? "on" : "off");
+    beginStep();
+    return true;
+}
+
+void SelfTest::stop()
+{
+    if (_state != STATE_RUNNING)
+        return;
+    _state = STATE_STOPPED; // keeps a callback already in flight from re-arming the timer
+    stopGenerator();
+    LOG_INFO("Self-test stopped at step %u", _step);
+}
+
+void SelfTest::stopGenerator()
+{
+    esp_timer_stop(_timer);
+    _level = false;
+    if (loopback())
+    {
+        digitalWrite(_options.pin, LOW);
+        pinMode(_options.pin, INPUT);
+    }
+}
+
+void SelfTest::beginStep()
+{
+    _periodUs = SWEEP[_step].periodMs * 1000UL;
+    _widthUs = SWEEP[_step].widthMs * 1000UL;
+    uint32_t pulses = _options.stepSeconds * 1000UL / SWEEP[_step].periodMs;
+    _generated = 0;
+    _remaining = pulses > 0 ? pulses : 1;
+    _counted = 0;
+    _virtualState = false;
+    _lastSampleUs = 0;
+    _maxGapUs = 0;
+    _phase = PHASE_PULSES;
+    _nextUs = esp_timer_get_time() + START_DELAY_US;
+    esp_timer_start_once(_timer, START_DELAY_US);
+}
+
+// Edges are scheduled from the previous target time, so callback latency does not add up
+void SelfTest::onTimer(void* arg)
+{
+    SelfTest* self = static_cast<SelfTest*>(arg);
+    if (self->_state != STATE_RUNNING)
+        return;
+    uint32_t next;
+    if (self->_level)
+    {
+        self->_level = false;
+        if (self->loopback())
+            digitalWrite(self->_options.pin, LOW);
+        if (--self->_remaining == 0)
+            return;
+        next = self->_periodUs - self->_widthUs;
+    }
+    else
+    {
+        self->_level = true;
+        self->_generated++;
+        if (self->loopback())
+            digitalWrite(self->_options.pin, HIGH);
+        next = self->_widthUs;
+    }
+    self->_nextUs += next;
+    int64_t delay = self->_nextUs - esp_timer_get_time();
+    esp_timer_start_once(self->_timer, delay > 0 ? delay : 1);
+}
+
+void SelfTest::onSample(uint32_t nowUs)
+{
+    if (_state != STATE_RUNNING)
+        return;
+    if (_lastSampleUs != 0 && nowUs - _lastSampleUs > _maxGapUs)
+        _maxGapUs = nowUs - _lastSampleUs;
+    _lastSampleUs = nowUs;
+    if (loopback())
+        return;
+    bool level = _level;
+    if (level && !_virtualState)
+        _counted++;
+    _virtualState = level;
+}
+
+bool SelfTest::tick()
+{
+    if (_state != STATE_RUNNING)
+        return false;
+    if (_phase == PHASE_PULSES)
+    {
+        if (_remaining == 0)
+        {
+            _phase = PHASE_SETTLE;
+            _settleStart = millis();
+        }
+        return true;
+    }
+    if (millis() - _settleStart < SETTLE_MS)
+        return true;
+    finishStep();
+    if (++_step < STEPS)
+    {
+        beginStep();
+        return true;
+    }
+    stopGenerator();
+    _state = STATE_DONE;
+    LOG_INFO("Self-test finished");
+    return false;
+}
+
+void SelfTest::finishStep()
+{
+    portENTER_CRITICAL(&_mux);
+    Step& r = _results[_step];
+    r.generated = _generated;
+    r.counted = _counted;
+    r.maxSampleGapMs = _maxGapUs / 1000;
+    portEXIT_CRITICAL(&_mux);
+    if (r.counted != r.generated)
+    {
+        LOG_INFO("Self-test %u ms / %u ms: %u of %u pulses counted", r.periodMs, r.widthMs, r.counted, r.generated);
+    }
+}
+
+void SelfTest::toJson(JsonObject out) const
+{
+    static const char* const STATE_NAMES[] = {"idle", "running", "done", "stopped"};
+    Step results[STEPS];
+    portENTER_CRITICAL(&_mux);
+    memcpy(results, _results, sizeof(results));
+    uint8_t step = _step;
+    State state = _state;
+    portEXIT_CRITICAL(&_mux);
+
+    out["state"] = STATE_NAMES[state];
+    if (state == STATE_IDLE)
+        return;
+    out["mode"] = loopback() ? "loopback" : "virtual";
+    if (loopback())
+        out["pin"] = _options.pin;
+    out["stepSeconds"] = _options.stepSeconds;
+    out["step"] = step;
+    JsonObject load = out.createNestedObject("load");
+    load["enabled"] = _options.load;
+    load["publishes"] = _publishes;
+    load["httpRequests"] = _httpRequests;
+    load["httpErrors"] = _httpErrors;
+
+    // Highest rate / shortest pulse up to which every step counted exactly
+    float maxReliableHz = 0;
+    uint16_t minReliableWidthMs = 0;
+    bool frequencyOk = true;
+    bool widthOk = true;
+    uint8_t finished = state == STATE_DONE ? STEPS : step;
+    JsonArray steps = out.createNestedArray("steps");
+    for (uint8_t i = 0; i < finished; i++)
+    {
+        const Step& r = results[i];
+        JsonObject o = steps.createNestedObject();
+        o["hz"] = 1000.0f / r.periodMs;
+        o["periodMs"] = r.periodMs;
+        o["widthMs"] = r.widthMs;
+        o["generated"] = r.generated;
+        o["counted"] = r.counted;
+        uint32_t diff = r.generated > r.counted ? r.generated - r.counted : r.counted - r.generated;
+        o["errorRate"] = r.generated > 0 ? static_cast<float>(diff) / r.generated : 0.0f;
+        o["maxSampleGapMs"] = r.maxSampleGapMs;
+        bool exact = diff == 0;
+        if (i < FREQUENCY_STEPS)
+        {
+            frequencyOk = frequencyOk && exact;
+            if (frequencyOk)
+                maxReliableHz = 1000.0f / r.periodMs;
+        }
+        else
+        {
+            widthOk = widthOk && exact;
+            if (widthOk)
+                minReliableWidthMs = r.widthMs;
+        }
+    }
+    out["maxReliableHz"] = maxReliableHz;
+    out["minReliableWidthMs"] = minReliableWidthMs;
+}
@@ -0,0 +1,317 @@
+#include "StallWatchdog.h"
+#include "Logger.h"
+#include <esp_system.h>
+#include <esp_attr.h>
+
+StallWatchdog stallWatchdog;
+
+namespace {
+
+const uint32_t RTC_MAGIC = 0x57A11ED1;
+
+struct Frame {
+    uint32_t startMs;
+    uint8_t point;
+    bool flagged; // already reported as STALL
+    char detail[StallWatchdog::DETAIL_LENGTH];
+};
+
+// Kept across resets except power-on; validated by the magic
+struct RtcState {
+    uint32_t magic;
+    uint16_t boot;
+    uint16_t count;
+    uint16_t head; // next slot
+    uint8_t resetReason;
+    StallWatchdog::Event events[StallWatchdog::MAX_EVENTS];
+    volatile uint8_t depth[TRACE_CTX_COUNT];
+    Frame frames[TRACE_CTX_COUNT][StallWatchdog::MAX_DEPTH];
+};
+
+RTC_NOINIT_ATTR RtcState rtc;
+
+const char* resetReasonName(uint8_t reason)
+{
+    switch (reason)
+    {
+    case ESP_RST_POWERON: return "power_on";
+    case ESP_RST_EXT: return "external";
+    case ESP_RST_SW: return "software";
+    case ESP_RST_PANIC: return "panic";
+    case ESP_RST_INT_WDT: return "int_wdt";
+    case ESP_RST_TASK_WDT: return "task_wdt";
+    case ESP_RST_WDT: return "wdt";
+    case ESP_RST_DEEPSLEEP: return "deep_sleep";
+    case ESP_RST_BROWNOUT: return "brownout";
+    case ESP_RST_SDIO: return "sdio";
+    default: return "unknown";
+    }
+}
+
+} // namespace
+
+const char* traceContextName(uint8_t context)
+{
+    static const char* const names[TRACE_CTX_COUNT] = {"loop", "http", "display", "netboot"};
+    return context < TRACE_CTX_COUNT ? names[context] : "unknown";
+}
+
+const char* tracePointName(uint8_t point)
+{
+    static const char* const names[TRACE_POINT_COUNT] = {"loop", "job", "mqtt_connect", "http_handler", "spiffs_save", "display_render"};
+    return point < TRACE_POINT_COUNT ? names[point] : "none";
+}
+
+void StallWatchdog::begin(uint32_t budgetMs)
+{
+    _budgetMs = budgetMs;
+    uint8_t reason = esp_reset_reason();
+    if (rtc.magic != RTC_MAGIC || rtc.head >= MAX_EVENTS || rtc.count > MAX_EVENTS)
+    {
+        memset(&rtc, 0, sizeof(rtc));
+        rtc.magic = RTC_MAGIC;
+    }
+    else
+    {
+        // what every task was inside of when the last boot ended
+        for (uint8_t ctx = 0; ctx < TRACE_CTX_COUNT; ctx++)
+        {
+            uint8_t depth = rtc.depth[ctx] <= MAX_DEPTH ? rtc.depth[ctx] : 0;
+            for (uint8_t d = 0; d < depth; d++)
+                recordRaw(frameEvent(EVENT_AT_RESET, ctx, d + 1, rtc.frames[ctx][d].startMs, 0));
+        }
+        rtc.boot++;
+    }
+    memset(const_cast<uint8_t*>(rtc.depth), 0, sizeof(rtc.depth));
+    rtc.resetReason = reason;
+
+    Event boot = {};
+    boot.boot = rtc.boot;
+    boot.kind = EVENT_BOOT;
+    boot.context = TRACE_CTX_LOOP;
+    boot.point = TRACE_POINT_COUNT;
+    boot.parent = TRACE_POINT_COUNT;
+    strlcpy(boot.detail, resetReasonName(reason), sizeof(boot.detail));
+    recordRaw(boot);
+
+    attach(TRACE_CTX_LOOP);
+    LOG_INFO("Boot %u, reset reason %s", rtc.boot, resetReasonName(reason));
+    // above loop() so a busy loop cannot hide its own stall
+    xTaskCreatePinnedToCore(watchTask, "stallwatch", 3072, this, 2, nullptr, 0);
+}
+
+void StallWatchdog::attach(TraceContext context)
+{
+    _tasks[context] = xTaskGetCurrentTaskHandle();
+}
+
+// A frame and the depth that makes it visible change together under _mux, so the watchdog task
+// never sees a half-written frame or flags one that is being reused for the next stage
+int8_t StallWatchdog::enter(TracePoint point, const char* detail)
+{
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    for (uint8_t ctx = 0; ctx < TRACE_CTX_COUNT; ctx++)
+    {
+        if (_tasks[ctx] != task)
+            continue;
+        uint32_t now = millis();
+        portENTER_CRITICAL(&_mux);
+        uint8_t depth = rtc.depth[ctx];
+        if (depth < MAX_DEPTH)
+        {
+            Frame& f = rtc.frames[ctx][depth];
+            f.startMs = now;
+            f.point = point;
+            f.flagged = false;
+            strlcpy(f.detail, detail != nullptr ? detail : "", sizeof(f.detail));
+        }
+        // deeper levels are counted but not recorded
+        rtc.depth[ctx] = depth + 1;
+        portEXIT_CRITICAL(&_mux);
+        return ctx;
+    }
+    return -1;
+}
+
+void StallWatchdog::leave(int8_t context)
+{
+    uint32_t now = millis();
+    Event slow;
+    bool over = false;
+    portENTER_CRITICAL(&_mux);
+    uint8_t depth = rtc.depth[context];
+    if (depth == 0)
+    {
+        portEXIT_CRITICAL(&_mux);
+        return;
+    }
+    if (depth <= MAX_DEPTH)
+    {
+        const Frame& f = rtc.frames[context][depth - 1];
+        uint32_t elapsed = now - f.startMs;
+        if (elapsed > _budgetMs)
+        {
+            slow = frameEvent(EVENT_SLOW, context, depth, f.startMs, elapsed);
+            over = true;
+        }
+    }
+    rtc.depth[context] = depth - 1;
+    portEXIT_CRITICAL(&_mux);
+    if (over)
+        recordRaw(slow);
+}
+
+// Runs on its own task; only the innermost open stage of each context is checked
+void StallWatchdog::check()
+{
+    uint32_t now = millis();
+    for (uint8_t ctx = 0; ctx < TRACE_CTX_COUNT; ctx++)
+    {
+        Event stall;
+        bool stalled = false;
+        portENTER_CRITICAL(&_mux);
+        uint8_t depth = rtc.depth[ctx];
+        if (depth > 0 && depth <= MAX_DEPTH)
+        {
+            const Frame& f = rtc.frames[ctx][depth - 1];
+            uint32_t elapsed = now - f.startMs;
+            if (!f.flagged && elapsed > _budgetMs && elapsed < 0x80000000UL)
+            {
+                // flag the enclosing stages too; they are part of the same stall
+                for (uint8_t d = 0; d < depth; d++)
+                    rtc.frames[ctx][d].flagged = true;
+                stall = frameEvent(EVENT_STALL, ctx, depth, f.startMs, elapsed);
+                stalled = true;
+            }
+        }
+        portEXIT_CRITICAL(&_mux);
+        if (stalled)
+        {
+            recordRaw(stall);
+            LOG_WARN("Stall: %s in %s %s for %u ms", traceContextName(ctx), tracePointName(stall.point), stall.detail,
+                     stall.durationMs);
+        }
+    }
+}
+
+void StallWatchdog::watchTask(void* arg)
+{
+    StallWatchdog* self = static_cast<StallWatchdog*>(arg);
+    for (;;)
+    {
+        vTaskDelay(pdMS_TO_TICKS(CHECK_INTERVAL_MS));
+        self->check();
+    }
+}
+
+StallWatchdog::Event StallWatchdog::frameEvent(uint8_t kind, uint8_t context, uint8_t depth, uint32_t atMs,
+                                               uint32_t durationMs) const
+{
+    const Frame& f = rtc.frames[context][depth - 1];
+    Event e = {};
+    e.atMs = atMs;
+    e.durationMs = durationMs;
+    e.boot = rtc.boot;
+    e.kind = kind;
+    e.context = context;
+    e.point = f.point;
+    e.parent = depth >= 2 ? rtc.frames[context][depth - 2].point : TRACE_POINT_COUNT;
+    memcpy(e.detail, f.detail, sizeof(e.detail));
+    e.detail[sizeof(e.detail) - 1] = '\0';
+    return e;
+}
+
+void StallWatchdog::recordRaw(const Event& event)
+{
+    portENTER_CRITICAL(&_mux);
+    uint16_t last = (rtc.head + MAX_EVENTS - 1) % MAX_EVENTS;
+    Event& prev = rtc.events[last];
+    if (rtc.count > 0 && prev.boot == event.boot && prev.kind == event.kind && prev.context == event.context &&
+        prev.point == event.point && prev.parent == event.parent && strcmp(prev.detail, event.detail) == 0 && prev.repeat < UINT16_MAX)
+    {
+        // e.g. every failed MQTT reconnect: keep the latest timing, count the rest
+        prev.repeat++;
+        prev.atMs = event.atMs;
+        if (event.durationMs > prev.durationMs)
+            prev.durationMs = event.durationMs;
+    }
+    else
+    {
+        rtc.events[rtc.head] = event;
+        rtc.events[rtc.head].repeat = 1;
+        rtc.head = (rtc.head + 1) % MAX_EVENTS;
+        if (rtc.count < MAX_EVENTS)
+            rtc.count++;
+    }
+    if (event.kind == EVENT_STALL || event.kind == EVENT_SLOW)
+        _stalls = _stalls + 1;
+    _version = _version + 1;
+    portEXIT_CRITICAL(&_mux);
+}
+
+uint16_t StallWatchdog::bootCount() const
+{
+    return rtc.boot;
+}
+
+const char* StallWatchdog::resetReason() const
+{
+    return resetReasonName(rtc.resetReason);
+}
+
+void StallWatchdog::toJson(JsonObject out, uint8_t maxEvents) const
+{
+    static const char* const kinds[] = {"boot", "at_reset", "stall", "slow"};
+    out["boot"] = rtc.boot;
+    out["resetReason"] = resetReason();
+    out["budgetMs"] = _budgetMs;
+
+    JsonArray events = out.createNestedArray("events");
+    uint16_t count = rtc.count < maxEvents ? rtc.count : maxEvents;
+    for (uint16_t i = 0; i < count; i++)
+    {
+        Event e;
+        portENTER_CRITICAL(&_mux);
+        e = rtc.events[(rtc.head + MAX_EVENTS - count + i) % MAX_EVENTS];
+        portEXIT_CRITICAL(&_mux);
+        JsonObject o = events.createNestedObject();
+        o["boot"] = e.boot;
+        o["kind"] = kinds[e.kind & 3];
+        if (e.kind == EVENT_BOOT)
+        {
+            o["resetReason"] = e.detail;
+            continue;
+        }
+        o["context"] = traceContextName(e.context);
+        o["stage"] = tracePointName(e.point);
+        if (e.detail[0])
+            o["detail"] = e.detail;
+        if (e.parent < TRACE_POINT_COUNT)
+            o["in"] = tracePointName(e.parent);
+        o["atMs"] = e.atMs;
+        if (e.kind != EVENT_AT_RESET)
+            o["durationMs"] = e.durationMs;
+        if (e.repeat > 1)
+            o["repeat"] = e.repeat;
+    }
+
+    JsonObject running = out.createNestedObject("running");
+    for (uint8_t ctx = 0; ctx < TRACE_CTX_COUNT; ctx++)
+    {
+        Frame f;
+        portENTER_CRITICAL(&_mux);
+        uint8_t depth = rtc.depth[ctx];
+        if (depth > 0 && depth <= MAX_DEPTH)
+            f = rtc.frames[ctx][depth - 1];
+        portEXIT_CRITICAL(&_mux);
+        if (depth == 0 || depth > MAX_DEPTH)
+            continue;
+        // after the copy, so a stage entered meanwhile does not come out negative
+        uint32_t now = millis();
+        JsonObject o = running.createNestedObject(traceContextName(ctx));
+        o["stage"] = tracePointName(f.point);
+        if (f.detail[0])
+            o["detail"] = f.detail;
+        o["forMs"] = now - f.startMs;
+    }
+}
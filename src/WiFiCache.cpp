@@ -0,0 +1,92 @@
+#include "WiFiCache.h"
+#include "Logger.h"
+#include <WiFi.h>
+#include <esp_wifi.h>
+
+static const char* NVS_NAMESPACE = "wificache";
+static const char* NVS_KEY = "entry";
+
+void WiFiCache::begin()
+{
+    // credentials saved by WiFiManager live in the WiFi driver's own NVS config
+    wifi_config_t conf;
+    if (esp_wifi_get_config(WIFI_IF_STA, &conf) == ESP_OK)
+    {
+        strlcpy(_ssid, reinterpret_cast<const char*>(conf.sta.ssid), sizeof(_ssid));
+        strlcpy(_pass, reinterpret_cast<const char*>(conf.sta.password), sizeof(_pass));
+    }
+
+    _prefs.begin(NVS_NAMESPACE, false);
+    if (_prefs.getBytes(NVS_KEY, &_entry, sizeof(_entry)) != sizeof(_entry))
+        _entry.valid = false;
+    if (strlen(_ssid) == 0)
+        _entry.valid = false;
+}
+
+bool WiFiCache::beginCached()
+{
+    if (!_entry.valid)
+        return false;
+    WiFi.config(IPAddress(_entry.ip), IPAddress(_entry.gateway), IPAddress(_entry.subnet), IPAddress(_entry.dns));
+    // not persisted: a BSSID-locked config in NVS would also pin WiFiManager's connects
+    WiFi.persistent(false);
+    WiFi.begin(_ssid, _pass, _entry.channel, _entry.bssid);
+    WiFi.persistent(true);
+    return true;
+}
+
+void WiFiCache::beginFull()
+{
+    WiFi.disconnect();
+    WiFi.config(INADDR_NONE, INADDR_NONE, INADDR_NONE); // back to DHCP
+    if (strlen(_ssid) == 0)
+    {
+        WiFi.reconnect();
+        return;
+    }
+    WiFi.persistent(false);
+    WiFi.begin(_ssid, _pass);
+    WiFi.persistent(true);
+}
+
+bool WiFiCache::connect(uint32_t timeoutMs)
+{
+    if (!beginCached())
+        return false;
+    unsigned long start = millis();
+    while (WiFi.status() != WL_CONNECTED && millis() - start < timeoutMs)
+        delay(10);
+    if (WiFi.status() == WL_CONNECTED)
+    {
+        LOG_INFO("WiFi: cached AP on channel %u connected in %lu ms", _entry.channel, millis() - start);
+        return true;
+    }
+    LOG_WARN("WiFi: cached AP not reachable, falling back to a full connect");
+    WiFi.disconnect();
+    WiFi.config(INADDR_NONE, INADDR_NONE, INADDR_NONE);
+    return false;
+}
+
+void WiFiCache::store()
+{
+    if (WiFi.status() != WL_CONNECTED)
+        return;
+
+    Entry entry = {};
+    entry.valid = true;
+    memcpy(entry.bssid, WiFi.BSSID(), sizeof(entry.bssid));
+    entry.channel = WiFi.channel();
+    entry.ip = WiFi.localIP();
+    entry.gateway = WiFi.gatewayIP();
+    entry.subnet = WiFi.subnetMask();
+    entry.dns = WiFi.dnsIP();
+    // the portal may have changed the credentials
+    strlcpy(_ssid, WiFi.SSID().c_str(), sizeof(_ssid));
+    strlcpy(_pass, WiFi.psk().c_str(), sizeof(_pass));
+
+    if (memcmp(&entry, &_entry, sizeof(entry)) == 0)
+        return;
+    _entry = entry;
+    _prefs.putBytes(NVS_KEY, &_entry, sizeof(_entry));
+    LOG_INFO("WiFi: cached AP %s, channel %u", WiFi.BSSIDstr().c_str(), entry.channel);
+}
@@ -4,25 +4,56 @@
 #include <WiFiManager.h>
 #include <Button2.h>
 #include <TFT_eSPI.h>
-#include <WebServer.h>
+#include <esp_http_server.h>
 #include <Update.h>
-#include <PubSubClient.h>
 #include <ArduinoJson.h>
-#include <sstream>
-#include <iomanip>
+#include <atomic>
 
 // own files
-#include "icons.h"
 #include "SPIFFSManager.h"
 #include "functions.h" // Include the header file
+#include "Mqtt.h"
 #include "screenshot.h"
+#include "OtaUpdater.h"
+#include "Metrics.h"
+#include "LoopProfiler.h"
+#include "DisplayRenderer.h"
+#include "ConsumptionHistory.h"
+#include "NumberFormat.h"
+#include "PowerManager.h"
+#include "WiFiCache.h"
+#include "BootTimeline.h"
+#include "MeterChannels.h"
+#include "Scheduler.h"
+#include "AnomalyDetector.h"
+#include "CalendarStats.h"
+#include "Logger.h"
+#include "StallWatchdog.h"
+#include "SelfTest.h"
+#include "PulseBroadcaster.h"
 
 // Global variables and constants
 SPIFFSManager spiffsManager;
+OtaUpdater otaUpdater;
+PowerManager powerManager;
+WiFiCache wifiCache;
+AnomalyDetector anomalyDetector;
+CalendarStats calendarStats;
+bool clockSynced = false; // SNTP delivered the time at least once
+// loop() jobs; timed jobs are armed in registerJobs(), events are signalled from where they happen
+Scheduler scheduler;
+Scheduler::JobId jobSampling, jobPulse, jobButtons, jobConnection, jobConnectionChange, jobWiFiRetry, jobMqttRetry;
+Scheduler::JobId jobWebCommands, jobConfigChange, jobWiFiManager, jobMqtt, jobPublish, jobSave, jobHousekeeping, jobAnomaly, jobCalendar, jobSelfTest;
+unsigned long lastOtaProgressPublish = 0;
 
 // Version
 const char *const version = "V 0.1.0";
 
+// Separators for values shown on the TFT and web page (MQTT keeps the plain C format)
+#ifndef DISPLAY_NUMBER_STYLE
+#define DISPLAY_NUMBER_STYLE NUMBER_STYLE_C
+#endif
+
 // Pin definitions
 #define REED_PIN 32 // ADC1 pin
 #define BUTTON_1 35
@@ -31,24 +62,34 @@ const char *const version = "V 0.1.0";
 #define HYSTERESIS_HIGH 4000.0
 
 // Time intervals
-constexpr unsigned long PUBLISH_INTERVAL = 1 * 60 * 1000;        // 60 seconds
 constexpr unsigned long INTERRUPT_INTERVAL = 50;                 // 50 milliseconds
-constexpr unsigned long SAVE_INTERVAL = 10 * 60 * 10000;         // 10 minutes
+constexpr unsigned long SAVE_INTERVAL = 100 * 60 * 1000;         // 100 minutes, spares the flash
 constexpr unsigned long WIFI_RECONNECT_INTERVAL = 1 * 20 * 1000; // 20 seconds
+constexpr unsigned long WIFI_FAST_CONNECT_TIMEOUT = 3000;        // cached AP must answer within 3 seconds
 constexpr unsigned long MQTT_RECONNECT_INTERVAL = 1 * 30 * 1000; // 30 seconds
-
-// MQTT Topics (mutable so web UI can change them at runtime)
-// Default now uses a Home Assistant friendly path under the clientID: clientID/measurement/gas
-String mqtt_topic_gas = "measurement/gas";
-String mqtt_topic_currentVal = "measurement/current";
+constexpr unsigned long OTA_VERIFY_TIMEOUT = 10 * 60 * 1000;     // 10 minutes to reach WiFi+MQTT after an update
+constexpr unsigned long OTA_PROGRESS_INTERVAL = 1000;            // 1 second
+constexpr unsigned long DISPLAY_FRAME_TIME = 20;                 // redraw requests within 20 ms share one frame
+constexpr unsigned long LOW_POWER_POLL_INTERVAL = 250;           // longest sleep in low-power mode (MQTT and buttons are polled)
+constexpr unsigned long LOW_POWER_SETTLE_TIME = 1000;            // stay awake this long after a reed or button edge
+constexpr unsigned long BUTTON_POLL_INTERVAL = 20;               // Button2 debounces over several polls
+constexpr unsigned long CLIENT_POLL_INTERVAL = 50;               // wm.process() and client.loop()
+constexpr unsigned long CONNECTION_CHECK_INTERVAL = 250;         // WiFi/MQTT state changes
+constexpr unsigned long HOUSEKEEPING_INTERVAL = 100;             // OTA state, serial commands, display timeout
+constexpr unsigned long NETWORK_WAIT_INTERVAL = 1000;            // publish retry while networkBootTask runs
+constexpr unsigned long ANOMALY_CHECK_INTERVAL = 10 * 1000;      // 10 seconds
+constexpr unsigned long CALENDAR_CHECK_INTERVAL = 10 * 1000;     // day/week/month rollover
+constexpr int HTTP_RECV_RETRIES = 3;                             // receive timeouts (5 s each) before a request body is given up
+constexpr unsigned long SELFTEST_TICK_INTERVAL = 100;             // sweep step changes
+constexpr unsigned long SELFTEST_PUBLISH_INTERVAL = 500;          // MQTT load while the self-test runs
+constexpr unsigned long SELFTEST_HTTP_TIMEOUT = 2000;             // one request of the HTTP load
+constexpr time_t CLOCK_VALID_AFTER = 1609459200;                 // 2021-01-01; earlier means SNTP has not answered yet
 
 // State values
-uint32_t offset = 0;
-char mqtt_server[40] = "192.168.178.203";
-char mqtt_port[6] = "1883";
-char mqtt_user[40] = "mqtt";
-char mqtt_password[40] = "foobar";
-uint32_t pulseCount = 0;
+// Meter inputs; channel 0 is the gas meter, whose counters keep their historic names
+MeterChannels meterChannels;
+uint32_t &pulseCount = meterChannels.pulses[0];
+uint32_t &offset = meterChannels.offset[0];
 
 struct ConnectionStatus
 {
@@ -60,21 +101,17 @@ struct ConnectionStatus
 
 struct TimeStamps
 {
-    volatile unsigned long lastPublishTime = 0;
-    volatile unsigned long lastSaveTime = 0;
-    volatile unsigned long lastInterruptTime = 0;
-    volatile unsigned long lastMQTTreconnectTime = 0;
     volatile unsigned long lastWiFiconnectTime = 0;
 };
 
 ConnectionStatus connectionStatus;
 TimeStamps timeStamps;
 
-uint32_t gasVolume = 0;
 volatile bool lastState = false;
+unsigned long lastPulseTime = 0; // millis() of the last gas pulse, handed to the pulse job
 uint32_t prevPulseCount = 0;
 uint32_t prevOffset = 0;
-int displayMode = 0;
+int displayMode = 0; // 0 gas, 1 wifi, 2 mqtt, 3 misc., 4 edit meter value, 5 history
 char prevMqttServer[40];
 char prevMqttPort[6];
 char prevMqttUser[40];
@@ -90,13 +127,12 @@ const int maxDigits = 9; // 6 Vorkomma + Dezimalpunkt + 2 Nachkomma
 
 // Display
 TFT_eSPI tft = TFT_eSPI();
+DisplayRenderer displayRenderer(tft);
+ConsumptionHistory consumptionHistory;
+TaskHandle_t displayTaskHandle = nullptr;
 String chipID;
 String clientID;
 
-// Forward declarations
-void publishHassDiscovery();
-void handleRestartRequest();
-
 void snapshotPersistentState()
 {
     prevPulseCount = pulseCount;
@@ -116,17 +152,121 @@ WiFiManagerParameter custom_mqtt_server("server", "mqtt server", mqtt_server, 40
 WiFiManagerParameter custom_mqtt_port("port", "mqtt port", mqtt_port, 6);
 WiFiManagerParameter custom_mqtt_user("username", "mqtt username", mqtt_user, 40);
 WiFiManagerParameter custom_mqtt_password("password", "mqtt password", mqtt_password, 40);
-// PubSub (MQTT)
-WiFiClient espClient;
-PubSubClient client(espClient);
-// MQTT diagnostics
-String lastMqttStatus = "never";
-unsigned long lastMqttAttemptTime = 0; // millis()
-int lastMqttErrorCode = 0;
-// Home Assistant discovery published flag
-bool hassDiscoveryPublished = false;
-// Web server
-WebServer webServer(80);
+// Set by networkBootTask once WiFi, web server and MQTT have been brought up
+volatile bool networkReady = false;
+// Boot milestones are (re)published whenever one was added since the last report
+uint8_t bootReportVersion = 0;
+// Same for the stall/postmortem events
+uint32_t postmortemVersion = 0;
+unsigned long lastSelfTestPublish = 0;
+// Web server (esp_http_server runs in its own task with several keep-alive sockets)
+httpd_handle_t webServer = nullptr;
+unsigned long lastWebServerStartAttempt = 0;
+
+// Device settings changed via /api/settings, persisted in /settings.json
+struct DeviceSettings
+{
+    bool lowPower = false;
+    uint32_t displayDimSeconds = 60;  // 0 = never
+    uint32_t displayOffSeconds = 300; // 0 = never
+    char timezone[48] = "CET-1CEST,M3.5.0,M10.5.0/3"; // POSIX TZ, default Germany
+    char ntpServer[40] = "pool.ntp.org";
+    LogLevel logLevel = LOG_LEVEL_INFO;
+    uint32_t stallBudgetMs = 500; // a loop() pass, job, handler or render taking longer is recorded
+    char udpTarget[40] = "";      // IPv4 unicast or multicast address for pulse datagrams; empty = off
+    uint16_t udpPort = 4210;
+};
+DeviceSettings settings;
+// Backlight / panel state, driven by button activity and the timeouts above
+DisplayRenderer::Power displayPower = DisplayRenderer::POWER_ON;
+unsigned long lastButtonActivity = 0;
+bool swallowButtonClick = false; // the press that woke the display does nothing else
+
+// Consistent copy of the state shown by the web API. Written by loop(), read by the HTTP and display tasks.
+struct StatusSnapshot
+{
+    uint32_t pulseCount = 0;
+    uint32_t offset = 0;
+    bool wifiConnected = false;
+    bool mqttConnected = false;
+    bool hasPassword = false;
+    int mqttLastError = 0;
+    unsigned long mqttLastAttemptTime = 0;
+    int displayMode = 0;
+    long editNumber = 0;
+    int cursorPosition = 0;
+    char mqttServer[40] = "";
+    char mqttPort[6] = "";
+    char mqttUser[40] = "";
+    char clientID[64] = "";
+    char topicGas[64] = "";
+    char topicCurrent[64] = "";
+    char mqttLastStatus[48] = "";
+    DeviceSettings settings;
+    DisplayRenderer::Power displayPower = DisplayRenderer::POWER_ON;
+    // additional meter channels (index 0 is the gas meter above)
+    ChannelConfig channelConfig[MeterChannels::MAX_CHANNELS];
+    uint32_t channelPulses[MeterChannels::MAX_CHANNELS] = {};
+    double channelValue[MeterChannels::MAX_CHANNELS] = {};
+    AnomalyConfig anomalyConfig;
+    AnomalyDetector::Status anomaly = {};
+    CalendarStats calendar;
+    bool clockSynced = false;
+};
+// Double buffer: publish number n goes to statusSnapshots[n & 1], so loop() fills the buffer readers are
+// not using and never blocks them. A reader retries if another publish finished during its copy.
+StatusSnapshot statusSnapshots[2];
+std::atomic<uint32_t> statusSnapshotSeq{0};
+
+// State changes requested by the HTTP task are applied by loop(), which owns MQTT, TFT and SPIFFS
+enum WebCommandType : uint8_t
+{
+    WEB_CMD_SET_CONSUMPTION,
+    WEB_CMD_SET_MQTT,
+    WEB_CMD_SET_SETTINGS,
+    WEB_CMD_SET_CHANNEL,
+    WEB_CMD_SET_ANOMALY,
+    WEB_CMD_SELFTEST_START,
+    WEB_CMD_SELFTEST_STOP,
+    WEB_CMD_RESTART
+};
+
+// Fields of a channel update that were posted; the others keep what loop() has configured
+enum ChannelField : uint16_t
+{
+    CHANNEL_ENABLED = 1 << 0,
+    CHANNEL_PIN = 1 << 1,
+    CHANNEL_ACTIVE_LOW = 1 << 2,
+    CHANNEL_PULLUP = 1 << 3,
+    CHANNEL_DEBOUNCE = 1 << 4,
+    CHANNEL_UNITS_PER_PULSE = 1 << 5,
+    CHANNEL_NAME = 1 << 6,
+    CHANNEL_UNIT = 1 << 7,
+    CHANNEL_DEVICE_CLASS = 1 << 8,
+    CHANNEL_TOPIC = 1 << 9
+};
+
+struct WebCommand
+{
+    WebCommandType type;
+    uint32_t value;
+    char server[40];
+    char port[6];
+    char user[40];
+    char password[40];
+    char clientid[64];
+    char topic[64];
+    char topicCurrent[64];
+    DeviceSettings settings;
+    uint8_t channel;
+    ChannelConfig channelConfig; // only the channelFields are set
+    uint16_t channelFields;
+    bool setReading;
+    double reading;
+    AnomalyConfig anomaly;
+    SelfTestOptions selfTestOptions;
+};
+QueueHandle_t webCommandQueue = nullptr;
 // Button2 instances
 Button2 button1;
 Button2 button2;
@@ -320,6 +460,9 @@ input, select, textarea { width: 100%; box-sizing: border-box; }
         <form id="ota-form" action="/update" method="POST" enctype="multipart/form-data">
             <label for="firmware" id="lbl-fw">Firmware (.bin)</label>
             <input type="file" id="firmware" name="firmware" accept=".bin" required>
+            <label for="firmware-sha" id="lbl-fw-sha">SHA-256 (optional)</label>
+            <input type="text" id="firmware-sha" name="sha256" pattern="[0-9a-fA-F]{64}" autocomplete="off">
+            <progress id="ota-progress" max="100" value="0" style="width:100%;display:none;"></progress>
             <button type="submit" id="btn-upload">Upload & Flash</button>
             <span class="feedback" id="ota-feedback"></span>
         </form>
@@ -329,6 +472,11 @@ input, select, textarea { width: 100%; box-sizing: border-box; }
         <p class="muted" id="restart-desc">Remote restart of the device (will reconnect to WiFi/MQTT on boot)</p>
         <button id="btn-restart">Restart Device</button>
         <span class="feedback" id="restart-feedback"></span>
+        <label style="display:flex;gap:8px;align-items:center;margin-top:12px;">
+            <input type="checkbox" id="low-power" style="width:auto;">
+            <span id="lbl-low-power">Low-power mode</span>
+        </label>
+        <p class="muted" id="power-info"></p>
     </section>
 </main>
 <script>
@@ -345,6 +493,8 @@ const otaForm = document.getElementById('ota-form');
 const otaFeedback = document.getElementById('ota-feedback');
 const restartBtn = document.getElementById('btn-restart');
 const restartFeedback = document.getElementById('restart-feedback');
+const lowPowerInput = document.getElementById('low-power');
+const powerInfo = document.getElementById('power-info');
 
 const nf = new Intl.NumberFormat('de-DE', { minimumFractionDigits: 2, maximumFractionDigits: 2 });
 
@@ -374,6 +524,10 @@ async function refreshStatus() {
         if (document.activeElement !== mqttForm.clientid) mqttForm.clientid.value = data.clientID || '';
         if (document.activeElement !== mqttForm.topic) mqttForm.topic.value = data.mqttTopicBase || '';
         if (document.activeElement !== mqttForm.topic_current) mqttForm.topic_current.value = data.mqttTopicCurrentBase || '';
+        if (data.power) {
+            lowPowerInput.checked = data.power.lowPower;
+            powerInfo.textContent = `CPU ${data.power.cpuMhz} MHz · awake ${(data.power.dutyCycle * 100).toFixed(1)}% · wake ${data.power.wakeLatencyUs} µs`;
+        }
     } catch (error) {
         mqttInfo.textContent = t('statusUnavailable');
     }
@@ -393,7 +547,6 @@ const translations = {
         mqttApplying: 'Applying new parameters...',
         otaUploading: 'Upload in progress...',
         otaNoFile: 'Please select a firmware file.',
-        connected: 'Connected.',
         settingsSavedAttempting: 'Settings saved, attempting connection...',
         statusUnavailable: 'Status not available',
         restartPrompt: 'Restart device?',
@@ -406,7 +559,6 @@ const translations = {
         mqttApplying: 'Neue Parameter werden übernommen...',
         otaUploading: 'Upload läuft...',
         otaNoFile: 'Bitte eine Firmware auswählen.',
-        connected: 'Verbunden.',
         settingsSavedAttempting: 'Einstellungen gespeichert, Verbinden...',
         statusUnavailable: 'Status nicht verfügbar',
         restartPrompt: 'Gerät neu starten?',
@@ -477,18 +629,14 @@ mqttForm.addEventListener('submit', async (event) => {
             body: formData
         });
         if (!response.ok) throw new Error('HTTP ' + response.status);
-        const data = await response.json();
-        if (data.mqttConnected) {
-            mqttFeedback.textContent = t('connected');
-        } else {
-            mqttFeedback.textContent = data.mqttLastStatus || t('settingsSavedAttempting');
-        }
+        await response.json();
+        mqttFeedback.textContent = t('settingsSavedAttempting');
         await refreshStatus();
     } catch (error) {
         mqttFeedback.textContent = 'Error: ' + error.message;
     }
 });
-otaForm.addEventListener('submit', async (event) => {
+otaForm.addEventListener('submit', (event) => {
     event.preventDefault();
     const file = document.getElementById('firmware').files[0];
     if (!file) {
@@ -496,20 +644,33 @@ otaForm.addEventListener('submit', async (event) => {
         return;
     }
     otaFeedback.textContent = t('otaUploading');
-    const formData = new FormData();
-    formData.append('firmware', file, file.name);
-    try {
-        const response = await fetch('/update', { method: 'POST', body: formData });
-        const data = await response.json();
-        if (response.ok && data.success) {
+    const progress = document.getElementById('ota-progress');
+    const sha = document.getElementById('firmware-sha').value.trim();
+    const started = Date.now();
+    // XHR instead of fetch for upload progress; the raw body is streamed straight into flash
+    const xhr = new XMLHttpRequest();
+    xhr.open('POST', '/update');
+    xhr.setRequestHeader('Content-Type', 'application/octet-stream');
+    if (sha) xhr.setRequestHeader('X-Firmware-SHA256', sha);
+    progress.style.display = 'block';
+    xhr.upload.onprogress = (e) => {
+        if (!e.lengthComputable) return;
+        progress.value = Math.round(e.loaded * 100 / e.total);
+        const kbps = e.loaded / Math.max(1, Date.now() - started);
+        otaFeedback.textContent = `${t('otaUploading')} ${progress.value}% · ${kbps.toFixed(1)} kB/s`;
+    };
+    xhr.onload = () => {
+        let data = {};
+        try { data = JSON.parse(xhr.responseText); } catch (e) { }
+        if (xhr.status === 200 && data.success) {
             otaFeedback.textContent = 'Update successful. Device will restart.';
             setTimeout(() => location.reload(), 3000);
         } else {
-            throw new Error(data.message || 'Update failed');
+            otaFeedback.textContent = 'Error: ' + (data.message || 'Update failed');
         }
-    } catch (error) {
-        otaFeedback.textContent = 'Error: ' + error.message;
-    }
+    };
+    xhr.onerror = () => { otaFeedback.textContent = 'Error: upload failed'; };
+    xhr.send(file);
 });
 
 // Restart button handler
@@ -526,6 +687,20 @@ restartBtn.addEventListener('click', async () => {
     }
 });
 
+lowPowerInput.addEventListener('change', async () => {
+    try {
+        const body = new URLSearchParams({ lowPower: lowPowerInput.checked ? '1' : '0' });
+        const response = await fetch('/api/settings', {
+            method: 'POST',
+            headers: { 'Content-Type': 'application/x-www-form-urlencoded' },
+            body
+        });
+        if (!response.ok) throw new Error('HTTP ' + response.status);
+    } catch (error) {
+        powerInfo.textContent = 'Error: ' + error.message;
+    }
+});
+
 // Language toggle handlers
 document.getElementById('lang-en').addEventListener('click', () => { setLanguage('en'); });
 document.getElementById('lang-de').addEventListener('click', () => { setLanguage('de'); });
@@ -545,6 +720,7 @@ function setLanguage(lang) {
         document.getElementById('btn-upload').textContent = 'Upload & Flash';
         document.getElementById('lbl-restart').textContent = 'Device Control';
         document.getElementById('btn-restart').textContent = 'Restart Device';
+        document.getElementById('lbl-low-power').textContent = 'Low-power mode';
         document.getElementById('restart-desc').textContent = t('restartDesc');
     } else {
         document.getElementById('hdr-title').textContent = 'Gaszähler';
@@ -559,6 +735,7 @@ function setLanguage(lang) {
         document.getElementById('btn-upload').textContent = 'Upload & Flash';
         document.getElementById('lbl-restart').textContent = 'Gerätsteuerung';
         document.getElementById('btn-restart').textContent = 'Neustart';
+        document.getElementById('lbl-low-power').textContent = 'Stromsparmodus';
         document.getElementById('restart-desc').textContent = t('restartDesc');
     }
 }
@@ -575,7 +752,10 @@ setInterval(refreshStatus, 5000);
 void setup()
 {
     Serial.begin(115200);
-    Serial.println("Starting gas meter " + String(version));
+    logger.begin(Serial);
+    logger.addSecret(mqtt_password);
+    stallWatchdog.begin(settings.stallBudgetMs);
+    LOG_INFO("Starting gas meter %s", version);
 
     // Retrieve the individual chip ID of the ESP32
     chipID = String((uint32_t)ESP.getEfuseMac(), HEX);
@@ -583,10 +763,13 @@ void setup()
     // Build the client name with the chip ID
     clientID = "Gaszaehler_" + chipID;
 
+    otaUpdater.checkPendingVerify();
+
     // Initialize SPIFFS
     if (spiffsManager.begin())
     {
-        Serial.println("SPIFFS successfully initialized");
+        LOG_INFO("SPIFFS successfully initialized");
+        bootTimeline.mark(BOOT_SPIFFS_MOUNTED);
         // Load data
         {
             char storedClientID[64] = "";
@@ -594,58 +777,43 @@ void setup()
                 char storedTopicCurrent[64] = "";
                 if (spiffsManager.loadData(pulseCount, offset, mqtt_server, mqtt_port, mqtt_user, mqtt_password, storedClientID, storedTopic, storedTopicCurrent))
             {
-                Serial.println("Data successfully loaded");
+                LOG_INFO("Data successfully loaded");
                 if (strlen(storedClientID) > 0) {
                     clientID = String(storedClientID);
-                    Serial.printf("Loaded clientID: %s\n", clientID.c_str());
+                    LOG_INFO("Loaded clientID: %s", clientID.c_str());
                 }
                 if (strlen(storedTopic) > 0) {
                     mqtt_topic_gas = String(storedTopic);
-                    Serial.printf("Loaded mqtt topic base: %s\n", mqtt_topic_gas.c_str());
+                    LOG_INFO("Loaded mqtt topic base: %s", mqtt_topic_gas.c_str());
                 }
                     if (strlen(storedTopicCurrent) > 0) {
                         mqtt_topic_currentVal = String(storedTopicCurrent);
-                        Serial.printf("Loaded mqtt topic current: %s\n", mqtt_topic_currentVal.c_str());
+                        LOG_INFO("Loaded mqtt topic current: %s", mqtt_topic_currentVal.c_str());
                     }
             }
         }
     }
     else
     {
-        Serial.println("SPIFFS initialization failed");
+        LOG_ERROR("SPIFFS initialization failed");
     }
+    loadSettings();
+    loadChannels();
+    loadAnomalyConfig();
+    loadCalendarStats();
+    bootTimeline.mark(BOOT_DATA_LOADED);
 
         snapshotPersistentState();
 
-    WiFi.mode(WIFI_STA); // Explicitly set mode, ESP defaults to STA+AP
-
-    wm.addParameter(&custom_mqtt_server);
-    wm.addParameter(&custom_mqtt_port);
-    wm.addParameter(&custom_mqtt_user);
-    client.setBufferSize(MQTT_MAX_PACKET_SIZE);
-
-    wm.setConfigPortalBlocking(false);
-    wm.setSaveParamsCallback(WMsaveParamsCallback);
-    wm.setConfigPortalTimeout(60);
-
-    // Allow larger MQTT messages (e.g., HA discovery payloads)
-    client.setBufferSize(1024);
-
-    if (wm.autoConnect("GaszaehlerAP"))
-    {
-        Serial.println("connected...yeey :)");
-        timeStamps.lastWiFiconnectTime = millis();
-    }
-    else
-    {
-        Serial.println("Config portal running");
-    }
-
+    // Counting and the display come first; the network is brought up by networkBootTask in the background
     // Initialize display
     tft.init();
     tft.setRotation(1);
     tft.fillScreen(TFT_BLACK);
     tft.setTextColor(TFT_WHITE, TFT_BLACK);
+    displayRenderer.begin();
+    // low priority on core 0, next to the network stack; loop() on core 1 never waits for the panel
+    xTaskCreatePinnedToCore(displayTask, "display", 6144, nullptr, 1, &displayTaskHandle, 0);
 
     // Initialize reed contact and buttons
     pinMode(REED_PIN, INPUT);
@@ -659,761 +827,2383 @@ void setup()
     button2.setClickHandler(handleButton2Click);
     button2.setLongClickDetectedHandler(handleButton2LongPress);
     button2.setLongClickTime(400);
+    button1.setPressedHandler(handleButtonPressed);
+    button2.setPressedHandler(handleButtonPressed);
 
-    setupWebInterface();
-    reconnect_mqtt();
+    WiFi.mode(WIFI_STA); // Explicitly set mode, ESP defaults to STA+AP
+
+    // reed and button edges end a low-power idle period
+    powerManager.begin();
+    powerManager.addWakePin(REED_PIN);
+    powerManager.addWakePin(BUTTON_1);
+    powerManager.addWakePin(BUTTON_2);
+    applySettings();
+
+    webCommandQueue = xQueueCreate(4, sizeof(WebCommand));
+    registerJobs();
     updateDisplay();
-    timeStamps.lastMQTTreconnectTime = millis();
+    publishStatusSnapshot();
+    bootTimeline.mark(BOOT_COUNTING_STARTED);
+
+    xTaskCreatePinnedToCore(networkBootTask, "netboot", 8192, nullptr, 1, nullptr, 0);
 
-    Serial.println("Setup completed.");
+    LOG_INFO("Setup completed.");
 }
 
-// Main loop
-void loop()
+// WiFi, web server and the first MQTT connect, off the loop task. Until networkReady is set this
+// task owns wm, client and the web server; loop() skips everything that touches them.
+void networkBootTask(void *)
 {
-    connectionStatus.wifiConnected = (WiFi.status() == WL_CONNECTED);
-    connectionStatus.mqttConnected = client.connected();
+    stallWatchdog.attach(TRACE_CTX_NETBOOT);
+    wm.addParameter(&custom_mqtt_server);
+    wm.addParameter(&custom_mqtt_port);
+    wm.addParameter(&custom_mqtt_user);
+    wm.setConfigPortalBlocking(false);
+    wm.setSaveParamsCallback(WMsaveParamsCallback);
+    wm.setConfigPortalTimeout(60);
+
+    // Allow larger MQTT messages (e.g., HA discovery payloads)
+    client.setBufferSize(1024);
 
-    if (!connectionStatus.wifiConnected && millis() - timeStamps.lastWiFiconnectTime >= WIFI_RECONNECT_INTERVAL)
+    // Scan-free association with the last good AP first, WiFiManager's full connect/portal otherwise
+    wifiCache.begin();
+    if (wifiCache.connect(WIFI_FAST_CONNECT_TIMEOUT))
     {
-        WiFi.reconnect();
+        bootTimeline.setWiFiPath("cached");
         timeStamps.lastWiFiconnectTime = millis();
     }
-
-    if (connectionStatus.wifiConnected != connectionStatus.prevWifiStatus || connectionStatus.mqttConnected != connectionStatus.prevMqttStatus)
+    else if (wm.autoConnect("GaszaehlerAP"))
     {
-        updateDisplay();
+        LOG_INFO("WiFi connected");
+        bootTimeline.setWiFiPath("full");
+        timeStamps.lastWiFiconnectTime = millis();
+    }
+    else
+    {
+        LOG_WARN("Config portal running");
+        bootTimeline.setWiFiPath("portal");
     }
 
-    wm.process();
-    webServer.handleClient();
-
-    // Check MQTT connection
-    if (connectionStatus.wifiConnected && !connectionStatus.mqttConnected && millis() - timeStamps.lastMQTTreconnectTime >= MQTT_RECONNECT_INTERVAL)
+    if (WiFi.status() == WL_CONNECTED)
     {
+        bootTimeline.mark(BOOT_WIFI_CONNECTED);
+        wifiCache.store();
+        setupWebInterface();
         reconnect_mqtt();
     }
-    else
+    lastMqttAttemptTime = millis();
+
+    networkReady = true;
+    // commands queued during bring-up and the WiFi retry were held back until now
+    scheduler.signal(jobWebCommands);
+    if (WiFi.status() != WL_CONNECTED)
+    {
+        scheduler.signal(jobWiFiRetry);
+    }
+    LOG_INFO("Network bring-up finished after %lu ms", millis());
+    vTaskDelete(nullptr);
+}
+
+// Main loop: run whatever the scheduler has due, then block until the next job, a signal or a pin edge
+void loop()
+{
+    uint32_t wait;
     {
-        client.loop();
+        TRACE_SCOPE(TRACE_LOOP);
+        unsigned long loopStart = micros();
+        wait = scheduler.run();
+        publishStatusSnapshot();
+        metrics.loopLatency.observe(micros() - loopStart);
     }
+    powerManager.idle(idleBudget(wait));
+}
 
-    // Read reed contact analog and apply hysteresis
-    float voltage = analogRead(REED_PIN);
-    if (millis() - timeStamps.lastInterruptTime >= INTERRUPT_INTERVAL)
+// Jobs in registration order; jobs due in the same pass run in this order
+void registerJobs()
+{
+    scheduler.begin();
+    jobSampling = scheduler.every("sampling", INTERRUPT_INTERVAL, samplingJob);
+    jobPulse = scheduler.onEvent("pulse", pulseJob);
+    jobButtons = scheduler.every("buttons", BUTTON_POLL_INTERVAL, buttonsJob);
+    jobConnection = scheduler.every("connection", CONNECTION_CHECK_INTERVAL, connectionJob);
+    jobConnectionChange = scheduler.onEvent("connection_change", connectionChangeJob);
+    jobWiFiRetry = scheduler.once("wifi_retry", wifiRetryJob);
+    jobMqttRetry = scheduler.once("mqtt_retry", mqttRetryJob);
+    jobWebCommands = scheduler.onEvent("web_commands", webCommandsJob);
+    jobConfigChange = scheduler.onEvent("config_change", configChangeJob);
+    jobWiFiManager = scheduler.every("wifimanager", CLIENT_POLL_INTERVAL, wifiManagerJob);
+    jobMqtt = scheduler.every("mqtt", CLIENT_POLL_INTERVAL, mqttJob);
+    jobPublish = scheduler.once("publish", publishJob);
+    jobSave = scheduler.once("save", saveJob);
+    jobHousekeeping = scheduler.every("housekeeping", HOUSEKEEPING_INTERVAL, housekeepingJob);
+    jobAnomaly = scheduler.every("anomaly", ANOMALY_CHECK_INTERVAL, anomalyJob);
+    jobCalendar = scheduler.every("calendar", CALENDAR_CHECK_INTERVAL, calendarJob);
+    jobSelfTest = scheduler.once("selftest", selfTestJob);
+
+    // A job that did not fit never runs, and schedule()/signal() ignore its id
+    const Scheduler::JobId jobs[] = {jobSampling, jobPulse, jobButtons, jobConnection, jobConnectionChange, jobWiFiRetry,
+                                     jobMqttRetry, jobWebCommands, jobConfigChange, jobWiFiManager, jobMqtt, jobPublish,
+                                     jobSave, jobHousekeeping, jobAnomaly, jobCalendar, jobSelfTest};
+    const size_t jobCount = sizeof(jobs) / sizeof(jobs[0]);
+    for (size_t i = 0; i < jobCount; i++)
     {
-        timeStamps.lastInterruptTime = millis();
-        if (lastState && voltage <= HYSTERESIS_LOW)
-        {
-            lastState = false;
-        }
-        else if (!lastState && voltage > HYSTERESIS_HIGH)
+        if (jobs[i] < 0)
         {
-            Serial.printf("Pulse registered.\n");
-            lastState = true;
-            pulseCount++;
-            updateDisplay();
+            LOG_ERROR("Job %u of %u not registered, raise Scheduler::MAX_JOBS", static_cast<unsigned>(i + 1),
+                      static_cast<unsigned>(jobCount));
         }
     }
 
-    button1.loop();
-    button2.loop();
+    scheduler.schedule(jobPublish, 0);
+    scheduler.schedule(jobSave, SAVE_INTERVAL);
+}
 
-    if (millis() - timeStamps.lastPublishTime >= PUBLISH_INTERVAL)
+void samplingJob()
+{
+    PROFILE_SCOPE(STAGE_SAMPLING);
+    // Read reed contact analog and apply hysteresis, in low-power mode too: the digital input has
+    // no hysteresis of its own, and the edge interrupt only needs to wake loop()
+    float voltage = powerManager.readAnalog(REED_PIN);
+    selfTest.onSample(micros());
+    if (lastState && voltage <= HYSTERESIS_LOW)
+    {
+        lastState = false;
+    }
+    else if (!lastState && voltage > HYSTERESIS_HIGH && selfTest.running() && selfTest.loopback())
     {
-        publishGasVolume(); // MQTT publishing
+        lastState = true;
+        selfTest.onPulse(); // the reed input carries the test pin's pulses, not the meter's
     }
-    if (millis() - timeStamps.lastSaveTime >= SAVE_INTERVAL)
+    else if (!lastState && voltage > HYSTERESIS_HIGH)
     {
-        saveDataToSPIFFS(); // SPIFFS saving
+        lastState = true;
+        pulseCount++;
+        unsigned long now = millis();
+        if (networkReady)
+        {
+            // straight from the edge, ahead of the pulse job and MQTT
+            pulseBroadcaster.send(0, pulseCount + offset, lastPulseTime ? now - lastPulseTime : 0, esp_timer_get_time());
+        }
+        lastPulseTime = now;
+        scheduler.signal(jobPulse);
     }
+    // the other channels are counted by their interrupts; pick up all of them at once
+    meterChannels.collect();
+}
 
-    connectionStatus.prevWifiStatus = connectionStatus.wifiConnected; // Update previous status
-    connectionStatus.prevMqttStatus = connectionStatus.mqttConnected; // Update previous status
+void pulseJob()
+{
+    PROFILE_SCOPE(STAGE_PULSE);
+    LOG_DEBUG("Pulse registered.");
+    bootTimeline.mark(BOOT_FIRST_PULSE);
+    metrics.recordPulse(lastPulseTime);
+    consumptionHistory.onPulse(lastPulseTime);
+    anomalyDetector.onPulse(lastPulseTime);
+    calendarStats.onPulse(); // a pulse just after midnight may still count for the day before (<= 10 s)
+    updateDisplay();
 }
 
-// Function to save the counter value to SPIFFS
-void saveDataToSPIFFS()
+// Advances the self-test sweep and, with load enabled, keeps publisher and display busy
+void selfTestJob()
 {
-    // Only write if something has changed (better to set a dirty flag?)
-    if (pulseCount == prevPulseCount && offset == prevOffset &&
-        strcmp(mqtt_server, prevMqttServer) == 0 && strcmp(mqtt_port, prevMqttPort) == 0 &&
-        strcmp(mqtt_user, prevMqttUser) == 0 && strcmp(mqtt_password, prevMqttPassword) == 0 &&
-        strcmp(clientID.c_str(), prevClientID) == 0 && strcmp(mqtt_topic_gas.c_str(), prevMqttTopic) == 0 && strcmp(mqtt_topic_currentVal.c_str(), prevMqttTopicCurrent) == 0)
+    PROFILE_SCOPE(STAGE_SELFTEST);
+    if (!selfTest.tick())
     {
-        Serial.println("No new data to save");
         return;
     }
-    if (spiffsManager.saveData(pulseCount, offset, mqtt_server, mqtt_port, mqtt_user, mqtt_password, (char*)clientID.c_str(), (char*)mqtt_topic_gas.c_str(), (char*)mqtt_topic_currentVal.c_str()))
+    if (selfTest.loadEnabled())
     {
-        snapshotPersistentState();
-        timeStamps.lastSaveTime = millis();
-        // If MQTT is connected and discovery not yet published (or topics changed), attempt publishing discovery
-        if (client.connected() && !hassDiscoveryPublished) {
-            publishHassDiscovery();
+        updateDisplay();
+        if (networkReady && client.connected() && millis() - lastSelfTestPublish >= SELFTEST_PUBLISH_INTERVAL)
+        {
+            lastSelfTestPublish = millis();
+            publishGasVolume();
+            selfTest.countPublish();
         }
     }
+    scheduler.schedule(jobSelfTest, SELFTEST_TICK_INTERVAL);
 }
 
-// Function to reconnect to the MQTT broker
-boolean reconnect_mqtt()
+void startSelfTest(const SelfTestOptions &options)
 {
-    // Set up MQTT client
-    uint16_t port = static_cast<uint16_t>(std::stoi(mqtt_port));
-    client.setServer(mqtt_server, port);
-    client.setCallback(MQTTcallbackReceive);
-    Serial.printf("Trying to connect to MQTT server %s:%s (user:%s) ... \n", mqtt_server, mqtt_port, mqtt_user);
-
-    lastMqttAttemptTime = millis();
-    timeStamps.lastMQTTreconnectTime = millis();
+    for (uint8_t ch = 1; ch < MeterChannels::MAX_CHANNELS; ch++)
+    {
+        if (options.pin != 0 && meterChannels.enabled(ch) && meterChannels.config(ch).pin == options.pin)
+        {
+            LOG_WARN("Self-test: GPIO %u is meter input %u", options.pin, ch);
+            return;
+        }
+    }
+    if (!selfTest.start(options))
+    {
+        return;
+    }
+    lastSelfTestPublish = 0;
+    scheduler.schedule(jobSelfTest, SELFTEST_TICK_INTERVAL);
+    if (options.load && webServer != nullptr)
+    {
+        xTaskCreatePinnedToCore(selfTestHttpLoadTask, "selftest_http", 4096, nullptr, 1, nullptr, 0);
+    }
+}
 
-    // Quick TCP connectivity check before attempting the PubSubClient connect
+// HTTP load for the self-test: fetches /api/status and /metrics from our own server back to back
+void selfTestHttpLoadTask(void *)
+{
+    static const char *const paths[] = {"/api/status", "/metrics"};
+    uint8_t next = 0;
+    char head[16];
+    while (selfTest.running())
     {
-        WiFiClient testClient;
-        Serial.printf("Testing TCP connection to %s:%u ...\n", mqtt_server, port);
-        bool tcpOk = testClient.connect(mqtt_server, port);
-        if (!tcpOk)
+        WiFiClient http;
+        bool ok = false;
+        if (http.connect(WiFi.localIP(), 80))
         {
-            lastMqttStatus = "TCP connect failed";
-            lastMqttErrorCode = -1;
-            Serial.println("TCP connection to MQTT broker failed; skipping MQTT connect");
-            testClient.stop();
-            return false;
+            http.printf("GET %s HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n", paths[next++ % 2]);
+            size_t received = 0;
+            unsigned long start = millis();
+            while ((http.connected() || http.available()) && millis() - start < SELFTEST_HTTP_TIMEOUT)
+            {
+                if (!http.available())
+                {
+                    delay(1);
+                    continue;
+                }
+                int c = http.read();
+                if (received < sizeof(head) - 1)
+                {
+                    head[received++] = c;
+                }
+            }
+            head[received] = '\0';
+            ok = strncmp(head, "HTTP/1.1 200", 12) == 0;
         }
-        Serial.println("TCP connection OK");
-        testClient.stop();
+        http.stop();
+        selfTest.countHttpRequest(ok);
+        delay(20);
     }
+    vTaskDelete(nullptr);
+}
 
-    // Attempt MQTT connect (with Last Will set to 'offline' on availability topic)
-    String availTopic = clientID + "/availability";
+void buttonsJob()
+{
+    {
+        PROFILE_SCOPE(STAGE_BUTTON1);
+        button1.loop();
+    }
+    {
+        PROFILE_SCOPE(STAGE_BUTTON2);
+        button2.loop();
+    }
+}
 
-    // Non-blocking wait for 50ms to allow broker to process connection
-    unsigned long waitStart = millis();
-    while (millis() - waitStart < 50)
+// Network jobs wait until networkBootTask has handed over WiFi, web server and MQTT
+void connectionJob()
+{
+    if (!networkReady)
+    {
+        return;
+    }
+    PROFILE_SCOPE(STAGE_CONNECTION);
+    connectionStatus.wifiConnected = (WiFi.status() == WL_CONNECTED);
+    connectionStatus.mqttConnected = client.connected();
+    if (connectionStatus.wifiConnected != connectionStatus.prevWifiStatus || connectionStatus.mqttConnected != connectionStatus.prevMqttStatus)
     {
-        client.loop();
-        delay(1);
+        scheduler.signal(jobConnectionChange);
     }
 
-    // Attempt MQTT connect with LWT
-    bool connected = client.connect(
-        clientID.c_str(),
-        strlen(mqtt_user) ? mqtt_user : nullptr,
-        strlen(mqtt_password) ? mqtt_password : nullptr,
-        availTopic.c_str(),
-        1,
-        true,
-        "offline");
+    // The config portal occupies port 80 while it runs; start our server once it is gone
+    if (webServer == nullptr && connectionStatus.wifiConnected && !wm.getConfigPortalActive() &&
+        millis() - lastWebServerStartAttempt >= WIFI_RECONNECT_INTERVAL)
+    {
+        setupWebInterface();
+    }
+}
 
-    if (connected)
+void connectionChangeJob()
+{
+    PROFILE_SCOPE(STAGE_CONNECTION_CHANGE);
+    if (connectionStatus.wifiConnected && !connectionStatus.prevWifiStatus)
     {
-        lastMqttStatus = "connected";
-        lastMqttErrorCode = 0;
-        Serial.printf("MQTT connected to %s\n", mqtt_server);
-        client.publish(availTopic.c_str(), "online", true);
-        client.loop();
-        delay(50);
-        String mqttTopic = clientID + "/" + mqtt_topic_currentVal;
-        client.subscribe(mqttTopic.c_str());
-        publishHassDiscovery();
+        bootTimeline.mark(BOOT_WIFI_CONNECTED);
+        wifiCache.store();
     }
-    else
+    else if (!connectionStatus.wifiConnected && connectionStatus.prevWifiStatus)
+    {
+        if (wifiCache.valid())
+        {
+            // just dropped: retry the known AP right away, without a scan
+            wifiCache.beginCached();
+            timeStamps.lastWiFiconnectTime = millis();
+        }
+        scheduler.schedule(jobWiFiRetry, WIFI_RECONNECT_INTERVAL);
+    }
+
+    if (connectionStatus.wifiConnected && !connectionStatus.mqttConnected && scheduler.msUntil(jobMqttRetry) == UINT32_MAX)
+    {
+        unsigned long sinceAttempt = millis() - lastMqttAttemptTime;
+        scheduler.schedule(jobMqttRetry, sinceAttempt >= MQTT_RECONNECT_INTERVAL ? 0 : MQTT_RECONNECT_INTERVAL - sinceAttempt);
+    }
+
+    // Broker outages: from the drop being noticed until the session is back
+    if (!connectionStatus.mqttConnected && connectionStatus.prevMqttStatus)
+    {
+        metrics.mqttOutageStart = millis();
+        metrics.mqttOutages++;
+    }
+    else if (connectionStatus.mqttConnected && !connectionStatus.prevMqttStatus && metrics.mqttOutageStart != 0)
     {
-        lastMqttErrorCode = client.state();
-        lastMqttStatus = String("connect failed (state=") + String(lastMqttErrorCode) + String(")");
-        Serial.printf("Failed to connect to MQTT server. Error: %i\n", lastMqttErrorCode);
+        uint32_t recovery = millis() - metrics.mqttOutageStart;
+        metrics.mqttRecoveryLastMs = recovery;
+        if (recovery > metrics.mqttRecoveryMaxMs)
+            metrics.mqttRecoveryMaxMs = recovery;
+        metrics.mqttOutageStart = 0;
     }
 
-    return client.connected();
+    connectionStatus.prevWifiStatus = connectionStatus.wifiConnected;
+    connectionStatus.prevMqttStatus = connectionStatus.mqttConnected;
+    updateDisplay();
 }
 
-// Function to publish gas volume via MQTT
-void publishGasVolume()
+void wifiRetryJob()
 {
-    timeStamps.lastPublishTime = millis();
-    if (!client.connected())
+    if (!networkReady || WiFi.status() == WL_CONNECTED)
     {
-        Serial.printf("Publishing not possible! MQTT not connected.\n");
         return;
     }
-    gasVolume = pulseCount + offset;
-    // Human readable (kept for backwards compatibility)
-    char humanMsg[64];
-    snprintf(humanMsg, sizeof(humanMsg), "%s", formatWithHundredsSeparator(gasVolume).c_str());
-    String mqttTopicHuman = clientID + "/" + mqtt_topic_gas;
-    client.publish(mqttTopicHuman.c_str(), humanMsg);
-
-    // Numeric raw value (Home Assistant friendly) - retained so HA can read it after restarts
-    char rawMsg[32];
-    float rawValue = static_cast<float>(gasVolume) / 100.0f;
-    snprintf(rawMsg, sizeof(rawMsg), "%.2f", rawValue);
-    String mqttTopicRaw = mqttTopicHuman + "/state";
-    bool ok = client.publish(mqttTopicRaw.c_str(), rawMsg, true);
+    PROFILE_SCOPE(STAGE_WIFI_RETRY);
+    wifiCache.beginFull();
+    timeStamps.lastWiFiconnectTime = millis();
+    scheduler.schedule(jobWiFiRetry, WIFI_RECONNECT_INTERVAL);
+}
 
-    Serial.printf("Gas volume published: %s m3 (raw: %s)\n", formatWithHundredsSeparator(gasVolume).c_str(), rawMsg);
+void mqttRetryJob()
+{
+    if (!networkReady || WiFi.status() != WL_CONNECTED || client.connected())
+    {
+        return;
+    }
+    PROFILE_SCOPE(STAGE_MQTT_RETRY);
+    if (!reconnect_mqtt())
+    {
+        scheduler.schedule(jobMqttRetry, MQTT_RECONNECT_INTERVAL);
+    }
+}
 
-    // If discovery hasn't been published yet, try now (first successful publish)
-    if (!hassDiscoveryPublished && ok) {
-        publishHassDiscovery();
+void webCommandsJob()
+{
+    if (!networkReady)
+    {
+        return; // networkBootTask signals again when it hands over
     }
+    PROFILE_SCOPE(STAGE_WEB_COMMANDS);
+    processWebCommands();
 }
 
-// Publish Home Assistant MQTT discovery payloads for this device
-void publishHassDiscovery()
-{
-    if (!client.connected()) return;
-
-    String baseHuman = clientID + "/" + mqtt_topic_gas; // human readable topic
-    String baseRaw = baseHuman + "/state";                 // numeric state topic
-    String currentTopic = clientID + "/" + mqtt_topic_currentVal;
-    String availTopic = clientID + "/availability";
-
-    // Track publish results
-    bool ok1 = false;
-    bool ok2 = false;
-    bool ok3 = false;
-
-    // Device info block
-    DynamicJsonDocument device(256);
-    device["identifiers"]; // placeholder to ensure key exists
-    device["name"] = clientID;
-    device["sw_version"] = version;
-    JsonArray ids = device.createNestedArray("identifiers");
-    ids.add(clientID);
-    device["model"] = "Gaszaehler";
-    device["manufacturer"] = "DIY";
-
-    // Sensor: total (cumulative) gas volume
-    {
-        DynamicJsonDocument doc(512);
-        doc["name"] = String(clientID + " Gas Volume");
-        doc["unique_id"] = String(clientID + "_gas_volume");
-        doc["state_topic"] = baseHuman + "/state"; // Change to new state topic
-        doc["unit_of_measurement"] = "m³";
-        doc["value_template"] = "{{ value | float }}";
-        doc["state_class"] = "total_increasing";
-        doc["device_class"] = "gas";
-        doc["icon"] = "mdi:fire";
-        doc["availability_topic"] = availTopic;
-        doc["device"] = device;
-
-        String payload;
-        serializeJson(doc, payload);
-        String discoveryTopic = String("homeassistant/sensor/") + clientID + "_gas_volume/config";
-        Serial.printf("Publishing discovery topic: %s (len=%u)\n", discoveryTopic.c_str(), (unsigned)payload.length());
-        Serial.println(payload);
-        ok1 = client.publish(discoveryTopic.c_str(), payload.c_str(), true);
-        Serial.printf(" -> publish returned: %s\n", ok1 ? "true" : "false");
-    }
-
-    // Sensor: current instantaneous value
-    {
-        DynamicJsonDocument doc(512);
-        doc["name"] = String(clientID + " Current Value");
-        doc["unique_id"] = String(clientID + "_current_value");
-        doc["state_topic"] = currentTopic;
-        doc["unit_of_measurement"] = "m³";
-        doc["value_template"] = "{{ value | float }}";
-        doc["state_class"] = "total_increasing";
-        doc["device_class"] = "gas";
-        doc["icon"] = "mdi:fire";
-        doc["availability_topic"] = availTopic;
-        doc["device"] = device;
-
-        String payload;
-        serializeJson(doc, payload);
-        String discoveryTopic = String("homeassistant/sensor/") + clientID + "_current_value/config";
-        Serial.printf("Publishing discovery topic: %s (len=%u)\n", discoveryTopic.c_str(), (unsigned)payload.length());
-        Serial.println(payload);
-        ok2 = client.publish(discoveryTopic.c_str(), payload.c_str(), true);
-        Serial.printf(" -> publish returned: %s\n", ok2 ? "true" : "false");
-    }
-    // Publish availability as online (retain)
-    Serial.printf("Publishing availability topic: %s\n", (clientID + "/availability").c_str());
-    ok3 = client.publish((clientID + "/availability").c_str(), "online", true);
-    Serial.printf(" -> publish returned: %s\n", ok3 ? "true" : "false");
-
-    // Mark discovery published only if all publishes succeeded
-    if (ok1 && ok2 && ok3) {
-        hassDiscoveryPublished = true;
-        Serial.println("Home Assistant discovery published (retained)");
-    } else {
-        hassDiscoveryPublished = false;
-        Serial.println("Home Assistant discovery publish attempt; some messages may have failed");
+// MQTT settings, channels or device settings were changed from the web UI
+void configChangeJob()
+{
+    PROFILE_SCOPE(STAGE_CONFIG_CHANGE);
+    if (networkReady && client.connected() && !hassDiscoveryPublished)
+    {
+        publishHassDiscovery();
     }
+    updateDisplay();
 }
 
-// Function to format uint32_t with thousands separator
-String formatWithHundredsSeparator(uint32_t value)
+void wifiManagerJob()
 {
-    std::ostringstream oss;
-    oss.imbue(std::locale(""));
-    oss << std::fixed << std::setprecision(2) << (value / 100.0);
-    return String(oss.str().c_str());
+    if (!networkReady)
+    {
+        return;
+    }
+    PROFILE_SCOPE(STAGE_WM_PROCESS);
+    wm.process();
 }
 
-void drawStatusBar(const String &title)
+void mqttJob()
 {
-    tft.fillRect(0, 0, 240, 27, TFT_DARKGREY);  // Status bar
-    tft.fillRect(0, 115, 240, 1, TFT_DARKGREY); // Accent line
-    tft.setCursor(2, 3);
-    tft.setTextColor(TFT_BLACK, TFT_DARKGREY);
-    tft.setTextSize(3);
-    tft.print(title);
-    tft.setTextColor(TFT_WHITE, TFT_BLACK);
-    tft.setTextSize(2);
+    if (!networkReady)
+    {
+        return;
+    }
+    PROFILE_SCOPE(STAGE_MQTT);
+    client.loop();
 }
 
-void drawWifiStatus()
+// One-shot; publishGasVolume() re-arms it, so publishes triggered elsewhere restart the interval
+void publishJob()
 {
-    bool wifiConnected = (WiFi.status() == WL_CONNECTED);
-    uint16_t wifiColor = wifiConnected ? TFT_GREEN : TFT_RED;
-    tft.fillRect(188, 1, 24, 24, wifiColor);
-    tft.pushImage(188, 1, 24, 24, wifiIcon, TFT_WHITE);
-    connectionStatus.prevWifiStatus = wifiConnected; // Update previous status
+    if (!networkReady)
+    {
+        scheduler.schedule(jobPublish, NETWORK_WAIT_INTERVAL);
+        return;
+    }
+    PROFILE_SCOPE(STAGE_PUBLISH);
+    publishGasVolume(); // MQTT publishing
 }
 
-void drawMqttStatus()
+void saveJob()
 {
-    bool mqttConnected = client.connected();
-    uint16_t mqttColor = mqttConnected ? TFT_GREEN : TFT_RED;
-    tft.fillRect(215, 1, 24, 24, mqttColor);
-    tft.pushImage(215, 1, 24, 24, mqttIcon, TFT_WHITE);
-    connectionStatus.prevMqttStatus = mqttConnected; // Update previous status
+    PROFILE_SCOPE(STAGE_SAVE);
+    saveDataToSPIFFS(); // SPIFFS saving
+    scheduler.schedule(jobSave, SAVE_INTERVAL);
 }
 
-void updateDisplay()
+void housekeepingJob()
 {
-    String title, line1, line2, actionBtn2 = "";
-    switch (displayMode)
+    PROFILE_SCOPE(STAGE_HOUSEKEEPING);
+    if (networkReady)
     {
-    case 1:
-        title = "Wifi";
-        line1 = "SSID:\n " + WiFi.SSID();
-        line2 = "IP address:\n " + WiFi.localIP().toString();
-        actionBtn2 = "reset wifi & mqtt >";
-        break;
-    case 2:
-        title = "MQTT";
-        line1 = "IP :\n " + String(mqtt_server);
-        line2 = "device name :\n " + clientID;
-        break;
-    case 3:
-        title = "misc.";
-        line1 = "Version: " + String(version);
-        line2 = "";
-        actionBtn2 = " edit meter value >";
-        break;
-    case 4:
-        tft.fillScreen(TFT_BLACK);
-        tft.setCursor(0, 10);
-        tft.print("             next >");
-        tft.setCursor(30, 60);
-
-        char buffer[15];
-        sprintf(buffer, "%06ld.%02ld  save", number / 100, number % 100);
-        tft.print(buffer);
+        handleOtaState();
+    }
+    handleSerialCommands();
 
-        // show cursor
-        int xPos;
-        xPos = 30 + cursorPosition * 12;
-        if (cursorPosition == 8)
-        {
-            xPos += 36; // For the decimal point
-            tft.drawRect(xPos, 77, 46, 2, TFT_RED);
-            tft.setCursor(0, 120);
-            tft.print("             save >");
-            return;
-        }
-        else if (cursorPosition > 5)
-        {
-            xPos += 12; // For the decimal point
-        }
-        tft.drawRect(xPos, 77, 10, 2, TFT_RED);
-        tft.setCursor(0, 120);
-        tft.print("               +1 >");
-        return;
-        break;
-    default:
-        gasVolume = pulseCount + offset;
-        title = "gas meter";
-        line1 = "value: " + formatWithHundredsSeparator(gasVolume) + " m3";
-        actionBtn2 = "             save >";
-        break;
+    if (connectionStatus.mqttConnected && bootTimeline.version() != bootReportVersion)
+    {
+        publishBootReport();
+    }
+    if (connectionStatus.mqttConnected && stallWatchdog.version() != postmortemVersion)
+    {
+        publishPostmortem();
     }
 
-    tft.setCursor(0, 28);
-    tft.fillScreen(TFT_BLACK);
-    drawStatusBar(title);
-    drawWifiStatus();
-    drawMqttStatus();
+    handleDisplayTimeout();
 
-    tft.setCursor(2, 35);
-    tft.print(line1);
-    tft.setCursor(2, 75);
-    tft.print(line2);
-    tft.setCursor(0, 120);
-    tft.print(actionBtn2);
+    // the history page scrolls by one column per bucket
+    if (consumptionHistory.tick(millis()) && displayMode == 5)
+    {
+        updateDisplay();
+    }
 }
 
-void incrementDigit()
+// Alerts go out as soon as they change; the attributes follow with every regular publish
+void anomalyJob()
 {
-    long multiplier = 1;
-    for (int i = 0; i < (7 - cursorPosition); i++)
+    PROFILE_SCOPE(STAGE_ANOMALY);
+    if (anomalyDetector.tick(millis(), currentHourOfDay()) || anomalyDetector.alerts() != publishedAlerts)
     {
-        multiplier *= 10;
+        publishAnomaly();
     }
-
-    long digit = (number / multiplier) % 10;
-    digit = (digit + 1) % 10;
-    number = (number / (multiplier * 10)) * (multiplier * 10) + digit * multiplier + number % multiplier;
-
-    updateDisplay();
 }
 
-void moveCursor()
+// Hour of day for the usage baseline; uptime hours until SNTP has set the clock
+uint8_t currentHourOfDay()
 {
-    cursorPosition = (cursorPosition + 1) % maxDigits;
-    updateDisplay();
+    time_t now = time(nullptr);
+    if (now < CLOCK_VALID_AFTER)
+    {
+        return (millis() / 3600000UL) % 24;
+    }
+    struct tm local;
+    localtime_r(&now, &local);
+    return local.tm_hour;
 }
 
-void handleButton1Click(Button2 &btn)
+// Rolls the day/week/month totals over at local midnight once the clock is set
+void calendarJob()
 {
-    if (displayMode == 4)
+    PROFILE_SCOPE(STAGE_CALENDAR);
+    time_t now = time(nullptr);
+    if (now < CLOCK_VALID_AFTER)
     {
-        moveCursor();
+        return;
     }
-    else
+    if (!clockSynced)
     {
-        number = pulseCount + offset;
-        cursorPosition = 0;
-        displayMode = (displayMode + 1) % 4;
-        updateDisplay();
+        clockSynced = true;
+        anomalyDetector.restartHour();
+        char stamp[32];
+        struct tm local;
+        localtime_r(&now, &local);
+        strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S %Z", &local);
+        LOG_INFO("Clock set by SNTP: %s", stamp);
+    }
+    if (calendarStats.tick(now))
+    {
+        saveCalendarStats();
+        publishCalendarStats();
     }
-    return;
 }
 
-void handleButton2Click(Button2 &btn)
+// How long loop() may block. Low-power mode stretches the wait to LOW_POWER_POLL_INTERVAL (the polled
+// jobs then run late), but never past the next publish.
+uint32_t idleBudget(uint32_t wait)
 {
-    switch (displayMode)
+    if (!powerManager.enabled() || !networkReady || wm.getConfigPortalActive() || otaUpdater.state() == OtaUpdater::RUNNING)
+    {
+        return wait;
+    }
+    // keep sampling at full rate while the reed contact settles or a button is in use
+    if (millis() - powerManager.lastEdgeMs() < LOW_POWER_SETTLE_TIME || displayMode == 4 ||
+        digitalRead(BUTTON_1) == LOW || digitalRead(BUTTON_2) == LOW)
+    {
+        return wait;
+    }
+    uint32_t budget = min<uint32_t>(LOW_POWER_POLL_INTERVAL, scheduler.msUntil(jobPublish));
+    return max(wait, budget);
+}
+
+void settingsToJson(const DeviceSettings &in, JsonObject out)
+{
+    out["lowPower"] = in.lowPower;
+    out["displayDimSeconds"] = in.displayDimSeconds;
+    out["displayOffSeconds"] = in.displayOffSeconds;
+    out["timezone"] = in.timezone;
+    out["ntpServer"] = in.ntpServer;
+    out["logLevel"] = Logger::levelName(in.logLevel);
+    out["stallBudgetMs"] = in.stallBudgetMs;
+    out["udpTarget"] = in.udpTarget;
+    out["udpPort"] = in.udpPort;
+}
+
+void settingsFromJson(JsonObjectConst in, DeviceSettings &out)
+{
+    out.lowPower = in["lowPower"] | out.lowPower;
+    out.displayDimSeconds = in["displayDimSeconds"] | out.displayDimSeconds;
+    out.displayOffSeconds = in["displayOffSeconds"] | out.displayOffSeconds;
+    const char *timezone = in["timezone"] | "";
+    if (strlen(timezone) > 0)
+    {
+        strlcpy(out.timezone, timezone, sizeof(out.timezone));
+    }
+    const char *ntpServer = in["ntpServer"] | "";
+    if (strlen(ntpServer) > 0)
+    {
+        strlcpy(out.ntpServer, ntpServer, sizeof(out.ntpServer));
+    }
+    Logger::parseLevel(in["logLevel"] | "", out.logLevel);
+    out.stallBudgetMs = in["stallBudgetMs"] | out.stallBudgetMs;
+    strlcpy(out.udpTarget, in["udpTarget"] | out.udpTarget, sizeof(out.udpTarget));
+    out.udpPort = in["udpPort"] | out.udpPort;
+}
+
+void loadSettings()
+{
+    DynamicJsonDocument doc(512);
+    if (spiffsManager.loadSettings(doc))
+    {
+        settingsFromJson(doc.as<JsonObjectConst>(), settings);
+        LOG_INFO("Settings loaded (low power: %d)", settings.lowPower);
+    }
+}
+
+void saveSettings()
+{
+    DynamicJsonDocument doc(512);
+    settingsToJson(settings, doc.to<JsonObject>());
+    if (spiffsManager.saveSettings(doc))
+    {
+        metrics.spiffsWrites++;
+        metrics.spiffsBytes.add(spiffsManager.lastWriteSize());
+    }
+}
+
+// Channel 0 is fixed to the gas meter; the others come from /channels.json
+void loadChannels()
+{
+    ChannelConfig gas;
+    gas.enabled = true;
+    gas.pin = REED_PIN;
+    gas.unitsPerPulse = 0.01f;
+    strlcpy(gas.name, "gas", sizeof(gas.name));
+    strlcpy(gas.unit, "m³", sizeof(gas.unit));
+    strlcpy(gas.deviceClass, "gas", sizeof(gas.deviceClass));
+    strlcpy(gas.topic, mqtt_topic_gas.c_str(), sizeof(gas.topic));
+    meterChannels.configure(0, gas);
+
+    DynamicJsonDocument doc(2048);
+    if (spiffsManager.loadChannels(doc))
+    {
+        meterChannels.fromJson(doc["channels"].as<JsonArrayConst>());
+    }
+    meterChannels.clearDirty();
+}
+
+void loadAnomalyConfig()
+{
+    DynamicJsonDocument doc(256);
+    AnomalyConfig config;
+    if (spiffsManager.loadAnomaly(doc))
+    {
+        AnomalyDetector::configFromJson(doc.as<JsonObjectConst>(), config);
+    }
+    anomalyDetector.setConfig(config);
+}
+
+void loadCalendarStats()
+{
+    DynamicJsonDocument doc(512);
+    if (spiffsManager.loadStats(doc))
+    {
+        calendarStats.fromJson(doc.as<JsonObjectConst>());
+    }
+}
+
+void saveCalendarStats()
+{
+    DynamicJsonDocument doc(512);
+    calendarStats.toJson(doc.to<JsonObject>());
+    if (spiffsManager.saveStats(doc))
+    {
+        calendarStats.clearDirty();
+        metrics.spiffsWrites++;
+        metrics.spiffsBytes.add(spiffsManager.lastWriteSize());
+    }
+}
+
+void saveAnomalyConfig()
+{
+    DynamicJsonDocument doc(256);
+    AnomalyDetector::configToJson(anomalyDetector.config(), doc.to<JsonObject>());
+    if (spiffsManager.saveAnomaly(doc))
+    {
+        metrics.spiffsWrites++;
+        metrics.spiffsBytes.add(spiffsManager.lastWriteSize());
+    }
+}
+
+void saveChannels()
+{
+    DynamicJsonDocument doc(2048);
+    meterChannels.toJson(doc.createNestedArray("channels"));
+    if (spiffsManager.saveChannels(doc))
+    {
+        meterChannels.clearDirty();
+        metrics.spiffsWrites++;
+        metrics.spiffsBytes.add(spiffsManager.lastWriteSize());
+    }
+}
+
+void applySettings()
+{
+    if (settings.lowPower)
+    {
+        pinMode(REED_PIN, INPUT); // digital input for the edge interrupt until the first readAnalog()
+    }
+    powerManager.setEnabled(settings.lowPower);
+    logger.setLevel(settings.logLevel);
+    stallWatchdog.setBudget(settings.stallBudgetMs);
+
+    // SNTP keeps the server name pointer, so pass the global settings, not a copy
+    static char appliedTimezone[sizeof(settings.timezone)] = "";
+    static char appliedNtpServer[sizeof(settings.ntpServer)] = "";
+    if (strcmp(appliedTimezone, settings.timezone) != 0 || strcmp(appliedNtpServer, settings.ntpServer) != 0)
+    {
+        configTzTime(settings.timezone, settings.ntpServer);
+        strlcpy(appliedTimezone, settings.timezone, sizeof(appliedTimezone));
+        strlcpy(appliedNtpServer, settings.ntpServer, sizeof(appliedNtpServer));
+        LOG_INFO("Time zone %s, SNTP server %s", settings.timezone, settings.ntpServer);
+    }
+    static char appliedUdpTarget[sizeof(settings.udpTarget)] = "";
+    static uint16_t appliedUdpPort = 0;
+    if (strcmp(appliedUdpTarget, settings.udpTarget) != 0 || appliedUdpPort != settings.udpPort)
+    {
+        pulseBroadcaster.configure(settings.udpTarget, settings.udpPort);
+        strlcpy(appliedUdpTarget, settings.udpTarget, sizeof(appliedUdpTarget));
+        appliedUdpPort = settings.udpPort;
+    }
+}
+
+// Retained JSON with the boot timeline, so the fleet's cold boot to first pulse/publish can be compared
+void publishBootReport()
+{
+    DynamicJsonDocument doc(512);
+    bootTimeline.toJson(doc.to<JsonObject>());
+    doc["resetReason"] = static_cast<int>(esp_reset_reason());
+    doc["version"] = version;
+    char payload[512];
+    serializeJson(doc, payload, sizeof(payload));
+    uint8_t reported = bootTimeline.version();
+    if (mqttPublish((clientID + "/boot").c_str(), payload, true))
+    {
+        bootReportVersion = reported;
+    }
+}
+
+// Retained summary at <clientID>/postmortem: reset reason and the newest stall events
+void publishPostmortem()
+{
+    DynamicJsonDocument doc(1536);
+    stallWatchdog.toJson(doc.to<JsonObject>(), 4);
+    doc.remove("running");
+    char payload[896];
+    serializeJson(doc, payload, sizeof(payload));
+    uint32_t reported = stallWatchdog.version();
+    if (mqttPublish((clientID + "/postmortem").c_str(), payload, true))
+    {
+        postmortemVersion = reported;
+    }
+}
+
+// Single-character commands on the serial console
+void handleSerialCommands()
+{
+    while (Serial.available() > 0)
+    {
+        switch (Serial.read())
+        {
+#ifdef LOOP_PROFILER
+        case 'p':
+            loopProfiler.dump(Serial);
+            break;
+        case 'P':
+            loopProfiler.reset();
+            Serial.println("Profiler reset");
+            break;
+#endif
+        default:
+            break;
+        }
+    }
+}
+
+// Stream OTA progress over MQTT and confirm or roll back a freshly booted image
+void handleOtaState()
+{
+    if (otaUpdater.pendingVerify())
+    {
+        if (connectionStatus.wifiConnected && connectionStatus.mqttConnected)
+        {
+            otaUpdater.confirmBoot();
+        }
+        else if (millis() >= OTA_VERIFY_TIMEOUT)
+        {
+            otaUpdater.rollbackBoot();
+        }
+    }
+
+    if (otaUpdater.state() == OtaUpdater::RUNNING && client.connected() &&
+        millis() - lastOtaProgressPublish >= OTA_PROGRESS_INTERVAL)
+    {
+        lastOtaProgressPublish = millis();
+        char msg[96];
+        snprintf(msg, sizeof(msg), "{\"bytes\":%u,\"total\":%u,\"percent\":%u,\"bytesPerSecond\":%u}",
+                 (unsigned)otaUpdater.bytesReceived(), (unsigned)otaUpdater.totalSize(),
+                 otaUpdater.percent(), otaUpdater.bytesPerSecond());
+        mqttPublish((clientID + "/ota/progress").c_str(), msg);
+    }
+}
+
+// Copy the state served by the web API; the HTTP task only ever reads this copy
+void publishStatusSnapshot()
+{
+    uint32_t seq = statusSnapshotSeq.load(std::memory_order_relaxed) + 1;
+    StatusSnapshot &snap = statusSnapshots[seq & 1];
+    snap.pulseCount = pulseCount;
+    snap.offset = offset;
+    snap.wifiConnected = connectionStatus.wifiConnected;
+    snap.mqttConnected = connectionStatus.mqttConnected;
+    snap.hasPassword = strlen(mqtt_password) > 0;
+    snap.mqttLastError = lastMqttErrorCode;
+    snap.mqttLastAttemptTime = lastMqttAttemptTime;
+    snap.displayMode = displayMode;
+    snap.editNumber = number;
+    snap.cursorPosition = cursorPosition;
+    strlcpy(snap.mqttServer, mqtt_server, sizeof(snap.mqttServer));
+    strlcpy(snap.mqttPort, mqtt_port, sizeof(snap.mqttPort));
+    strlcpy(snap.mqttUser, mqtt_user, sizeof(snap.mqttUser));
+    strlcpy(snap.clientID, clientID.c_str(), sizeof(snap.clientID));
+    strlcpy(snap.topicGas, mqtt_topic_gas.c_str(), sizeof(snap.topicGas));
+    strlcpy(snap.topicCurrent, mqtt_topic_currentVal.c_str(), sizeof(snap.topicCurrent));
+    strlcpy(snap.mqttLastStatus, lastMqttStatus, sizeof(snap.mqttLastStatus));
+    snap.settings = settings;
+    snap.displayPower = displayPower;
+    for (uint8_t ch = 0; ch < MeterChannels::MAX_CHANNELS; ch++)
+    {
+        snap.channelConfig[ch] = meterChannels.config(ch);
+        snap.channelPulses[ch] = meterChannels.pulses[ch];
+        snap.channelValue[ch] = meterChannels.value(ch);
+    }
+    snap.anomalyConfig = anomalyDetector.config();
+    snap.anomaly = anomalyDetector.status(millis());
+    snap.calendar = calendarStats;
+    snap.clockSynced = clockSynced;
+    statusSnapshotSeq.store(seq, std::memory_order_release);
+}
+
+void readStatusSnapshot(StatusSnapshot &snap)
+{
+    for (;;)
+    {
+        uint32_t seq = statusSnapshotSeq.load(std::memory_order_acquire);
+        snap = statusSnapshots[seq & 1];
+        std::atomic_thread_fence(std::memory_order_acquire);
+        // a newer publish means loop() may already be refilling this buffer
+        if (statusSnapshotSeq.load(std::memory_order_relaxed) == seq)
+        {
+            return;
+        }
+    }
+}
+
+// Copies the posted fields of a channel update over a configuration
+void mergeChannelConfig(ChannelConfig &config, const ChannelConfig &update, uint16_t fields)
+{
+    if (fields & CHANNEL_ENABLED)
+        config.enabled = update.enabled;
+    if (fields & CHANNEL_PIN)
+        config.pin = update.pin;
+    if (fields & CHANNEL_ACTIVE_LOW)
+        config.activeLow = update.activeLow;
+    if (fields & CHANNEL_PULLUP)
+        config.pullup = update.pullup;
+    if (fields & CHANNEL_DEBOUNCE)
+        config.debounceMs = update.debounceMs;
+    if (fields & CHANNEL_UNITS_PER_PULSE)
+        config.unitsPerPulse = update.unitsPerPulse;
+    if (fields & CHANNEL_NAME)
+        strlcpy(config.name, update.name, sizeof(config.name));
+    if (fields & CHANNEL_UNIT)
+        strlcpy(config.unit, update.unit, sizeof(config.unit));
+    if (fields & CHANNEL_DEVICE_CLASS)
+        strlcpy(config.deviceClass, update.deviceClass, sizeof(config.deviceClass));
+    if (fields & CHANNEL_TOPIC)
+        strlcpy(config.topic, update.topic, sizeof(config.topic));
+}
+
+// Why configs[index] cannot be applied next to the other channels, or nullptr if it can
+const char *channelConfigError(uint8_t index, const ChannelConfig (&configs)[MeterChannels::MAX_CHANNELS])
+{
+    const ChannelConfig &config = configs[index];
+    if (!config.enabled)
+        return nullptr;
+    if (!MeterChannels::pinAvailable(config.pin) || config.unitsPerPulse <= 0 || strlen(config.topic) == 0)
+        return "pin not available, unitsPerPulse <= 0 or topic empty";
+    for (uint8_t ch = 1; ch < MeterChannels::MAX_CHANNELS; ch++)
+    {
+        if (ch != index && configs[ch].enabled && configs[ch].pin == config.pin)
+            return "pin used by another channel";
+    }
+    return nullptr;
+}
+
+// Apply state changes queued by the HTTP task
+void processWebCommands()
+{
+    WebCommand cmd;
+    while (webCommandQueue != nullptr && xQueueReceive(webCommandQueue, &cmd, 0) == pdTRUE)
+    {
+        switch (cmd.type)
+        {
+        case WEB_CMD_SET_CONSUMPTION:
+            if (cmd.value >= pulseCount)
+            {
+                offset = cmd.value - pulseCount;
+            }
+            else
+            {
+                offset = cmd.value;
+                pulseCount = 0;
+            }
+            updateDisplay();
+            saveDataToSPIFFS();
+            publishGasVolume();
+            break;
+        case WEB_CMD_SET_MQTT:
+            strlcpy(mqtt_server, cmd.server, sizeof(mqtt_server));
+            strlcpy(mqtt_port, cmd.port, sizeof(mqtt_port));
+            strlcpy(mqtt_user, cmd.user, sizeof(mqtt_user));
+            strlcpy(mqtt_password, cmd.password, sizeof(mqtt_password));
+
+            // If currently connected, force a disconnect so reconnect attempt is clean
+            if (client.connected())
+            {
+                LOG_INFO("Disconnecting existing MQTT connection before reconfiguring");
+                // publish offline availability (retain) so Home Assistant marks device unavailable
+                String availTopic = clientID + "/availability";
+                mqttPublish(availTopic.c_str(), "offline", true);
+                client.disconnect();
+                delay(50);
+            }
+
+            // Apply optional runtime-only settings
+            if (strlen(cmd.clientid) > 0)
+            {
+                clientID = cmd.clientid;
+                LOG_INFO("Setting clientID to: %s", clientID.c_str());
+                // need to republish discovery under new clientID
+                hassDiscoveryPublished = false;
+            }
+            if (strlen(cmd.topic) > 0)
+            {
+                mqtt_topic_gas = cmd.topic;
+                LOG_INFO("Setting mqtt topic base to: %s", mqtt_topic_gas.c_str());
+                hassDiscoveryPublished = false;
+            }
+            if (strlen(cmd.topicCurrent) > 0)
+            {
+                mqtt_topic_currentVal = cmd.topicCurrent;
+                LOG_INFO("Setting mqtt topic current to: %s", mqtt_topic_currentVal.c_str());
+                hassDiscoveryPublished = false;
+            }
+
+            saveDataToSPIFFS();
+            reconnect_mqtt();
+            scheduler.signal(jobConfigChange);
+            break;
+        case WEB_CMD_SET_CHANNEL:
+        {
+            ChannelConfig configs[MeterChannels::MAX_CHANNELS];
+            for (uint8_t ch = 0; ch < MeterChannels::MAX_CHANNELS; ch++)
+            {
+                configs[ch] = meterChannels.config(ch);
+            }
+            mergeChannelConfig(configs[cmd.channel], cmd.channelConfig, cmd.channelFields);
+            const char *error = channelConfigError(cmd.channel, configs);
+            if (error)
+            {
+                // another update got in since the HTTP task checked this one
+                LOG_WARN("Channel %u not changed: %s", cmd.channel, error);
+                break;
+            }
+            meterChannels.configure(cmd.channel, configs[cmd.channel]);
+            if (cmd.setReading)
+            {
+                meterChannels.setValue(cmd.channel, cmd.reading);
+            }
+            saveChannels();
+            hassDiscoveryPublished = false; // entities follow the channel configuration
+            scheduler.signal(jobConfigChange);
+            break;
+        }
+        case WEB_CMD_SET_ANOMALY:
+            anomalyDetector.setConfig(cmd.anomaly);
+            saveAnomalyConfig();
+            scheduler.signal(jobAnomaly); // re-evaluate with the new thresholds
+            break;
+        case WEB_CMD_SELFTEST_START:
+            startSelfTest(cmd.selfTestOptions);
+            break;
+        case WEB_CMD_SELFTEST_STOP:
+            selfTest.stop();
+            break;
+        case WEB_CMD_SET_SETTINGS:
+            settings = cmd.settings;
+            saveSettings();
+            applySettings();
+            lastButtonActivity = millis(); // new timeouts count from now
+            scheduler.signal(jobConfigChange);
+            break;
+        case WEB_CMD_RESTART:
+            // give the HTTP task time to flush the response
+            delay(200);
+            ESP.restart();
+            break;
+        }
+    }
+}
+
+bool queueWebCommand(const WebCommand &cmd)
+{
+    if (webCommandQueue == nullptr || xQueueSend(webCommandQueue, &cmd, 0) != pdTRUE)
+    {
+        return false;
+    }
+    scheduler.signal(jobWebCommands); // wakes loop() if it is idling
+    return true;
+}
+
+// Function to save the counter value to SPIFFS
+void saveDataToSPIFFS()
+{
+    TRACE_SCOPE(TRACE_SPIFFS_SAVE);
+    if (meterChannels.dirty())
+    {
+        saveChannels();
+    }
+    if (calendarStats.dirty())
+    {
+        saveCalendarStats();
+    }
+    // Only write if something has changed (better to set a dirty flag?)
+    if (pulseCount == prevPulseCount && offset == prevOffset &&
+        strcmp(mqtt_server, prevMqttServer) == 0 && strcmp(mqtt_port, prevMqttPort) == 0 &&
+        strcmp(mqtt_user, prevMqttUser) == 0 && strcmp(mqtt_password, prevMqttPassword) == 0 &&
+        strcmp(clientID.c_str(), prevClientID) == 0 && strcmp(mqtt_topic_gas.c_str(), prevMqttTopic) == 0 && strcmp(mqtt_topic_currentVal.c_str(), prevMqttTopicCurrent) == 0)
+    {
+        LOG_DEBUG("No new data to save");
+        return;
+    }
+    if (spiffsManager.saveData(pulseCount, offset, mqtt_server, mqtt_port, mqtt_user, mqtt_password, (char*)clientID.c_str(), (char*)mqtt_topic_gas.c_str(), (char*)mqtt_topic_currentVal.c_str()))
+    {
+        snapshotPersistentState();
+        metrics.spiffsWrites++;
+        metrics.spiffsBytes.add(spiffsManager.lastWriteSize());
+        // If MQTT is connected and discovery not yet published (or topics changed), attempt publishing discovery
+        if (networkReady && client.connected() && !hassDiscoveryPublished) {
+            publishHassDiscovery();
+        }
+    }
+}
+
+// Ask the display task for a redraw. Requests coalesce, so this is cheap to call from any path.
+// While the panel is off nothing is drawn; waking it renders the current view.
+void updateDisplay()
+{
+    publishStatusSnapshot();
+    if (displayPower == DisplayRenderer::POWER_OFF)
+    {
+        return;
+    }
+    metrics.displayRequests++;
+    if (displayTaskHandle != nullptr)
+    {
+        xTaskNotifyGive(displayTaskHandle);
+    }
+}
+
+// The display task applies the change, so loop() never waits for the panel
+void setDisplayPower(DisplayRenderer::Power power)
+{
+    if (power == displayPower)
+    {
+        return;
+    }
+    displayPower = power;
+    publishStatusSnapshot();
+    if (displayTaskHandle != nullptr)
+    {
+        xTaskNotifyGive(displayTaskHandle);
+    }
+}
+
+// Dim and then switch off the display after the configured time without button activity
+void handleDisplayTimeout()
+{
+    unsigned long idle = millis() - lastButtonActivity;
+    DisplayRenderer::Power target = DisplayRenderer::POWER_ON;
+    if (settings.displayOffSeconds > 0 && idle >= settings.displayOffSeconds * 1000UL)
+    {
+        target = DisplayRenderer::POWER_OFF;
+    }
+    else if (settings.displayDimSeconds > 0 && idle >= settings.displayDimSeconds * 1000UL)
+    {
+        target = DisplayRenderer::POWER_DIM;
+    }
+    setDisplayPower(target);
+}
+
+void buildScreenModel(const StatusSnapshot &snap, ScreenModel &model)
+{
+    model.page = snap.displayMode;
+    model.wifiConnected = snap.wifiConnected;
+    model.mqttConnected = snap.mqttConnected;
+    switch (snap.displayMode)
+    {
+    case 1:
+        strlcpy(model.title, "Wifi", sizeof(model.title));
+        snprintf(model.line1, sizeof(model.line1), "SSID:\n %s", WiFi.SSID().c_str());
+        snprintf(model.line2, sizeof(model.line2), "IP address:\n %s", WiFi.localIP().toString().c_str());
+        strlcpy(model.action, "reset wifi & mqtt >", sizeof(model.action));
+        break;
+    case 2:
+        strlcpy(model.title, "MQTT", sizeof(model.title));
+        snprintf(model.line1, sizeof(model.line1), "IP :\n %s", snap.mqttServer);
+        snprintf(model.line2, sizeof(model.line2), "device name :\n %s", snap.clientID);
+        break;
+    case 3:
+        strlcpy(model.title, "misc.", sizeof(model.title));
+        snprintf(model.line1, sizeof(model.line1), "Version: %s", version);
+        strlcpy(model.action, " edit meter value >", sizeof(model.action));
+        break;
+    case 4:
+    {
+        model.layout = ScreenModel::LAYOUT_EDIT;
+        snprintf(model.editValue, sizeof(model.editValue), "%06ld.%02ld  save", snap.editNumber / 100, snap.editNumber % 100);
+
+        // show cursor
+        int xPos = 30 + snap.cursorPosition * 12;
+        if (snap.cursorPosition == 8)
+        {
+            xPos += 36; // For the decimal point
+            model.cursorWidth = 46;
+            strlcpy(model.action, "             save >", sizeof(model.action));
+        }
+        else
+        {
+            if (snap.cursorPosition > 5)
+            {
+                xPos += 12; // For the decimal point
+            }
+            model.cursorWidth = 10;
+            strlcpy(model.action, "               +1 >", sizeof(model.action));
+        }
+        model.cursorX = xPos;
+        break;
+    }
+    case 5:
+    {
+        model.layout = ScreenModel::LAYOUT_HISTORY;
+        strlcpy(model.title, "history", sizeof(model.title));
+        consumptionHistory.copy(model.history, model.historyHead);
+        uint32_t dayPulses = 0;
+        for (uint16_t i = 0; i < ConsumptionHistory::BUCKETS; i++)
+        {
+            dayPulses += model.history[i];
+        }
+        char dayValue[NUMBER_BUFFER_SIZE];
+        formatCentiValue(dayPulses, dayValue, sizeof(dayValue), DISPLAY_NUMBER_STYLE);
+        snprintf(model.line1, sizeof(model.line1), "flow: %.2f m3/h\n24h:  %s m3",
+                 consumptionHistory.flowRateM3h(millis()), dayValue);
+        strlcpy(model.action, "             save >", sizeof(model.action));
+        break;
+    }
+    default:
+    {
+        strlcpy(model.title, "gas meter", sizeof(model.title));
+        char value[NUMBER_BUFFER_SIZE];
+        formatCentiValue(snap.pulseCount + snap.offset, value, sizeof(value), DISPLAY_NUMBER_STYLE);
+        snprintf(model.line1, sizeof(model.line1), "value: %s m3", value);
+        strlcpy(model.action, "             save >", sizeof(model.action));
+        break;
+    }
+    }
+
+}
+
+// Renders at most one frame per DISPLAY_FRAME_TIME from the latest state snapshot
+void displayTask(void *)
+{
+    stallWatchdog.attach(TRACE_CTX_DISPLAY);
+    for (;;)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        // let the rest of this frame's requests arrive, then draw them as one
+        vTaskDelay(pdMS_TO_TICKS(DISPLAY_FRAME_TIME));
+        ulTaskNotifyTake(pdTRUE, 0);
+
+        StatusSnapshot snap;
+        readStatusSnapshot(snap);
+        displayRenderer.setPower(snap.displayPower);
+        if (snap.displayPower == DisplayRenderer::POWER_OFF)
+        {
+            continue;
+        }
+        ScreenModel model;
+        buildScreenModel(snap, model);
+        {
+            TRACE_SCOPE(TRACE_DISPLAY_RENDER);
+            displayRenderer.render(model);
+        }
+        bootTimeline.mark(BOOT_DISPLAY_READY);
+        metrics.displayRenderLatency.observe(displayRenderer.lastRenderUs());
+    }
+}
+
+void incrementDigit()
+{
+    long multiplier = 1;
+    for (int i = 0; i < (7 - cursorPosition); i++)
+    {
+        multiplier *= 10;
+    }
+
+    long digit = (number / multiplier) % 10;
+    digit = (digit + 1) % 10;
+    number = (number / (multiplier * 10)) * (multiplier * 10) + digit * multiplier + number % multiplier;
+
+    updateDisplay();
+}
+
+void moveCursor()
+{
+    cursorPosition = (cursorPosition + 1) % maxDigits;
+    updateDisplay();
+}
+
+// Any press counts as activity; a press on a dimmed or dark display only wakes it
+void handleButtonPressed(Button2 &btn)
+{
+    lastButtonActivity = millis();
+    swallowButtonClick = displayPower != DisplayRenderer::POWER_ON;
+    setDisplayPower(DisplayRenderer::POWER_ON);
+}
+
+void handleButton1Click(Button2 &btn)
+{
+    if (swallowButtonClick)
+    {
+        swallowButtonClick = false;
+        return;
+    }
+    if (displayMode == 4)
+    {
+        moveCursor();
+    }
+    else
+    {
+        number = pulseCount + offset;
+        cursorPosition = 0;
+        // page order: gas, wifi, mqtt, misc., history (the editor is entered from misc.)
+        displayMode = displayMode == 3 ? 5 : (displayMode == 5 ? 0 : displayMode + 1);
+        updateDisplay();
+    }
+    return;
+}
+
+void handleButton2Click(Button2 &btn)
+{
+    if (swallowButtonClick)
+    {
+        swallowButtonClick = false;
+        return;
+    }
+    switch (displayMode)
     {
     case 0: // same as 1
     case 1:
+        if (!networkReady)
+        {
+            break; // still booting; the network task owns MQTT and WiFiManager
+        }
         reconnect_mqtt();
         saveDataToSPIFFS();
         publishGasVolume();
         if (displayMode == 1)
         {
-            wm.resetSettings();
-            delay(20);
-            ESP.restart();
+            wm.resetSettings();
+            delay(20);
+            ESP.restart();
+        }
+        break;
+    case 3:
+        displayMode = 4;
+        updateDisplay();
+        break;
+    case 4:
+        if (cursorPosition == 8)
+        {
+            pulseCount = 0;
+            offset = number;
+            displayMode = 0;
+            saveDataToSPIFFS();
+            publishGasVolume();
+        }
+        else
+        {
+            incrementDigit();
+        }
+        updateDisplay();
+        break;
+    default:
+        saveDataToSPIFFS();
+        publishGasVolume();
+        break;
+    }
+    return;
+}
+
+void handleButton2LongPress(Button2 &btn)
+{
+    if (swallowButtonClick)
+    {
+        swallowButtonClick = false;
+        return;
+    }
+    LOG_DEBUG("Button 2 long press detected");
+    displayRenderer.lock();
+    captureAndSendScreenshotRLE(tft);
+    displayRenderer.unlock();
+}
+
+// Callback function for saving WiFiManager parameters
+void WMsaveParamsCallback()
+{
+    strcpy(mqtt_server, custom_mqtt_server.getValue());
+    strcpy(mqtt_port, custom_mqtt_port.getValue());
+    strcpy(mqtt_user, custom_mqtt_user.getValue());
+    strcpy(mqtt_password, custom_mqtt_password.getValue());
+    LOG_INFO("Got MQTT params from WifiManager: %s:%s (user:%s)", mqtt_server, mqtt_port, mqtt_user);
+    saveDataToSPIFFS();
+    reconnect_mqtt();
+}
+
+// Decode an application/x-www-form-urlencoded value in place
+void urlDecode(char *str)
+{
+    char *out = str;
+    for (char *in = str; *in; in++)
+    {
+        if (*in == '+')
+        {
+            *out++ = ' ';
+        }
+        else if (*in == '%' && isxdigit((unsigned char)in[1]) && isxdigit((unsigned char)in[2]))
+        {
+            char hex[3] = {in[1], in[2], '\0'};
+            *out++ = static_cast<char>(strtol(hex, nullptr, 16));
+            in += 2;
+        }
+        else
+        {
+            *out++ = *in;
+        }
+    }
+    *out = '\0';
+}
+
+// Read the (small) request body into buf; fails if it does not fit
+bool readRequestBody(httpd_req_t *req, char *buf, size_t len)
+{
+    if (req->content_len >= len)
+    {
+        return false;
+    }
+    size_t received = 0;
+    int timeouts = 0; // consecutive, as in the OTA upload
+    while (received < req->content_len)
+    {
+        int ret = httpd_req_recv(req, buf + received, req->content_len - received);
+        if (ret == HTTPD_SOCK_ERR_TIMEOUT && ++timeouts < HTTP_RECV_RETRIES)
+        {
+            continue;
+        }
+        if (ret <= 0)
+        {
+            return false;
+        }
+        timeouts = 0;
+        received += ret;
+    }
+    buf[received] = '\0';
+    return true;
+}
+
+// Fetch a decoded form field; returns false if the key is absent
+bool getFormArg(const char *body, const char *key, char *out, size_t len)
+{
+    if (httpd_query_key_value(body, key, out, len) != ESP_OK)
+    {
+        out[0] = '\0';
+        return false;
+    }
+    urlDecode(out);
+    return true;
+}
+
+esp_err_t sendJson(httpd_req_t *req, const char *status, const JsonDocument &doc)
+{
+    String payload;
+    serializeJson(doc, payload);
+    httpd_resp_set_status(req, status);
+    httpd_resp_set_type(req, "application/json");
+    return httpd_resp_send(req, payload.c_str(), payload.length());
+}
+
+esp_err_t sendJsonError(httpd_req_t *req, const char *status, const char *json)
+{
+    httpd_resp_set_status(req, status);
+    httpd_resp_set_type(req, "application/json");
+    return httpd_resp_send(req, json, HTTPD_RESP_USE_STRLEN);
+}
+
+esp_err_t handleRootRequest(httpd_req_t *req)
+{
+    httpd_resp_set_type(req, "text/html");
+    return httpd_resp_send(req, WEB_DASHBOARD, HTTPD_RESP_USE_STRLEN);
+}
+
+esp_err_t handleStatusRequest(httpd_req_t *req)
+{
+    StatusSnapshot snap;
+    readStatusSnapshot(snap);
+
+    DynamicJsonDocument doc(3072);
+    uint32_t currentVolume = snap.pulseCount + snap.offset;
+    doc["gasVolumeRaw"] = currentVolume;
+    doc["gasVolumeM3"] = static_cast<float>(currentVolume) / 100.0f;
+    char formatted[NUMBER_BUFFER_SIZE];
+    formatCentiValue(currentVolume, formatted, sizeof(formatted), DISPLAY_NUMBER_STYLE);
+    doc["gasVolumeFormatted"] = formatted;
+    doc["mqttConnected"] = snap.mqttConnected;
+    doc["mqttServer"] = snap.mqttServer;
+    doc["mqttPort"] = snap.mqttPort;
+    doc["mqttUser"] = snap.mqttUser;
+    doc["maskedPassword"] = snap.hasPassword ? "********" : "";
+    doc["wifiConnected"] = snap.wifiConnected;
+    doc["uptimeSeconds"] = millis() / 1000;
+    doc["version"] = version;
+    doc["clientID"] = snap.clientID;
+    doc["mqttTopicGas"] = String(snap.clientID) + "/" + snap.topicGas;
+    doc["mqttTopicCurrent"] = String(snap.clientID) + "/" + snap.topicCurrent;
+    doc["mqttTopicBase"] = snap.topicGas;
+    doc["mqttTopicCurrentBase"] = snap.topicCurrent;
+    doc["offset"] = snap.offset;
+    doc["pulseCount"] = snap.pulseCount;
+    doc["mqttLastStatus"] = snap.mqttLastStatus;
+    doc["mqttLastAttemptUptime"] = static_cast<uint32_t>(snap.mqttLastAttemptTime / 1000);
+    doc["mqttLastError"] = snap.mqttLastError;
+
+    static const char *const otaStates[] = {"idle", "running", "success", "failed"};
+    JsonObject ota = doc.createNestedObject("ota");
+    ota["state"] = otaStates[otaUpdater.state()];
+    ota["bytes"] = otaUpdater.bytesReceived();
+    ota["total"] = otaUpdater.totalSize();
+    ota["percent"] = otaUpdater.percent();
+    ota["bytesPerSecond"] = otaUpdater.bytesPerSecond();
+    ota["error"] = otaUpdater.lastError();
+    ota["pendingVerify"] = otaUpdater.pendingVerify();
+
+    bootTimeline.toJson(doc.createNestedObject("boot"));
+
+    JsonArray channels = doc.createNestedArray("channels");
+    for (uint8_t ch = 1; ch < MeterChannels::MAX_CHANNELS; ch++)
+    {
+        if (snap.channelConfig[ch].enabled)
+        {
+            JsonObject channel = channels.createNestedObject();
+            channel["index"] = ch;
+            channel["pulses"] = snap.channelPulses[ch];
+            channel["value"] = snap.channelValue[ch];
+        }
+    }
+
+    AnomalyDetector::statusToJson(snap.anomaly, doc.createNestedObject("anomaly"));
+    calendarStatsToJson(snap.calendar, snap.clockSynced, doc.createNestedObject("stats"));
+
+    JsonObject power = doc.createNestedObject("power");
+    power["lowPower"] = snap.settings.lowPower;
+    power["lightSleep"] = powerManager.lightSleep();
+    power["cpuMhz"] = getCpuFrequencyMhz();
+    power["dutyCycle"] = powerManager.dutyCycle();
+    power["wakeLatencyUs"] = powerManager.lastWakeLatencyUs();
+    power["wakeLatencyMaxUs"] = powerManager.maxWakeLatencyUs();
+    power["edgeWakeups"] = powerManager.edgeWakeups();
+    static const char *const displayStates[] = {"on", "dimmed", "off"};
+    power["display"] = displayStates[snap.displayPower];
+
+    return sendJson(req, HTTPD_200, doc);
+}
+
+esp_err_t handleConsumptionUpdate(httpd_req_t *req)
+{
+    char body[128];
+    char target[32];
+    if (!readRequestBody(req, body, sizeof(body)) || !getFormArg(body, "value", target, sizeof(target)))
+    {
+        return sendJsonError(req, HTTPD_400, "{\"error\":\"value missing\"}");
+    }
+    String value(target);
+    value.trim();
+    value.replace(',', '.');
+    if (value.length() == 0)
+    {
+        return sendJsonError(req, HTTPD_400, "{\"error\":\"value empty\"}");
+    }
+    double newValue = value.toDouble();
+    if (newValue < 0)
+    {
+        return sendJsonError(req, HTTPD_400, "{\"error\":\"value negative\"}");
+    }
+
+    WebCommand cmd = {};
+    cmd.type = WEB_CMD_SET_CONSUMPTION;
+    cmd.value = static_cast<uint32_t>(newValue * 100.0 + 0.5);
+    if (!queueWebCommand(cmd))
+    {
+        return sendJsonError(req, "503 Service Unavailable", "{\"error\":\"busy\"}");
+    }
+
+    DynamicJsonDocument doc(256);
+    doc["status"] = "ok";
+    doc["value"] = static_cast<float>(cmd.value) / 100.0f;
+    char formatted[NUMBER_BUFFER_SIZE];
+    formatCentiValue(cmd.value, formatted, sizeof(formatted), DISPLAY_NUMBER_STYLE);
+    doc["gasVolumeFormatted"] = formatted;
+    return sendJson(req, HTTPD_200, doc);
+}
+
+esp_err_t handleMqttConfigUpdate(httpd_req_t *req)
+{
+    char body[512];
+    if (!readRequestBody(req, body, sizeof(body)))
+    {
+        return sendJsonError(req, HTTPD_400, "{\"error\":\"invalid input\"}");
+    }
+
+    WebCommand cmd = {};
+    cmd.type = WEB_CMD_SET_MQTT;
+    char portArg[8];
+    if (!getFormArg(body, "server", cmd.server, sizeof(cmd.server)) || !getFormArg(body, "port", portArg, sizeof(portArg)))
+    {
+        return sendJsonError(req, HTTPD_400, "{\"error\":\"server and port required\"}");
+    }
+    String serverArg(cmd.server);
+    serverArg.trim();
+    String portString(portArg);
+    portString.trim();
+    if (serverArg.isEmpty() || portString.isEmpty())
+    {
+        return sendJsonError(req, HTTPD_400, "{\"error\":\"invalid input\"}");
+    }
+
+    long portLong = portString.toInt();
+    if (portLong <= 0 || portLong > 65535)
+    {
+        return sendJsonError(req, HTTPD_400, "{\"error\":\"port out of range\"}");
+    }
+
+    strlcpy(cmd.server, serverArg.c_str(), sizeof(cmd.server));
+    strlcpy(cmd.port, portString.c_str(), sizeof(cmd.port));
+    getFormArg(body, "username", cmd.user, sizeof(cmd.user));
+    getFormArg(body, "password", cmd.password, sizeof(cmd.password));
+    getFormArg(body, "clientid", cmd.clientid, sizeof(cmd.clientid));
+    getFormArg(body, "topic", cmd.topic, sizeof(cmd.topic));
+    getFormArg(body, "topic_current", cmd.topicCurrent, sizeof(cmd.topicCurrent));
+
+    if (!queueWebCommand(cmd))
+    {
+        return sendJsonError(req, "503 Service Unavailable", "{\"error\":\"busy\"}");
+    }
+
+    // The reconnect runs in loop(); the dashboard picks up the result via /api/status
+    DynamicJsonDocument doc(512);
+    doc["status"] = "ok";
+    doc["mqttServer"] = cmd.server;
+    doc["mqttPort"] = cmd.port;
+    doc["clientID"] = cmd.clientid;
+    doc["mqttTopicBase"] = cmd.topic;
+    doc["mqttTopicCurrentBase"] = cmd.topicCurrent;
+    return sendJson(req, HTTPD_200, doc);
+}
+
+// Streams the raw firmware body into the OTA partition. Runs in the HTTP task, so loop() keeps counting.
+// An expected SHA-256 can be supplied as X-Firmware-SHA256 header or ?sha256= query parameter.
+esp_err_t handleFirmwareUpload(httpd_req_t *req)
+{
+    char expected[65] = "";
+    if (httpd_req_get_hdr_value_str(req, "X-Firmware-SHA256", expected, sizeof(expected)) != ESP_OK)
+    {
+        char query[96];
+        if (httpd_req_get_url_query_str(req, query, sizeof(query)) != ESP_OK ||
+            httpd_query_key_value(query, "sha256", expected, sizeof(expected)) != ESP_OK)
+        {
+            expected[0] = '\0';
         }
-        break;
-    case 3:
-        displayMode = 4;
-        updateDisplay();
-        break;
-    case 4:
-        if (cursorPosition == 8)
+    }
+
+    if (otaUpdater.state() == OtaUpdater::RUNNING)
+    {
+        return sendJsonError(req, "409 Conflict", "{\"success\":false,\"message\":\"update already running\"}");
+    }
+
+    if (otaUpdater.begin(req->content_len, expected))
+    {
+        uint8_t buf[1460]; // one TCP segment per receive
+        size_t remaining = req->content_len;
+        int timeouts = 0; // consecutive; a stalled client must not hold the only HTTP task forever
+        while (remaining > 0 && otaUpdater.state() == OtaUpdater::RUNNING)
         {
-            pulseCount = 0;
-            offset = number;
-            displayMode = 0;
-            saveDataToSPIFFS();
-            publishGasVolume();
+            int received = httpd_req_recv(req, reinterpret_cast<char *>(buf), remaining < sizeof(buf) ? remaining : sizeof(buf));
+            if (received == HTTPD_SOCK_ERR_TIMEOUT && ++timeouts < HTTP_RECV_RETRIES)
+            {
+                continue;
+            }
+            if (received <= 0)
+            {
+                otaUpdater.abort(received == HTTPD_SOCK_ERR_TIMEOUT ? "upload stalled" : "upload aborted");
+                return ESP_FAIL;
+            }
+            timeouts = 0;
+            otaUpdater.write(buf, received);
+            remaining -= received;
         }
-        else
+        otaUpdater.finish();
+    }
+
+    bool success = otaUpdater.state() == OtaUpdater::SUCCESS;
+    DynamicJsonDocument doc(256);
+    doc["success"] = success;
+    doc["message"] = success ? "Update erfolgreich" : otaUpdater.lastError();
+    doc["sha256"] = otaUpdater.sha256();
+    doc["bytesPerSecond"] = otaUpdater.bytesPerSecond();
+    esp_err_t err = sendJson(req, success ? HTTPD_200 : HTTPD_500, doc);
+    if (success)
+    {
+        WebCommand cmd = {};
+        cmd.type = WEB_CMD_RESTART;
+        queueWebCommand(cmd);
+    }
+    return err;
+}
+
+esp_err_t handleSettingsRequest(httpd_req_t *req)
+{
+    StatusSnapshot snap;
+    readStatusSnapshot(snap);
+    DynamicJsonDocument doc(512);
+    settingsToJson(snap.settings, doc.to<JsonObject>());
+    return sendJson(req, HTTPD_200, doc);
+}
+
+// Form fields that are left out keep their current value
+esp_err_t handleSettingsUpdate(httpd_req_t *req)
+{
+    char body[384];
+    if (!readRequestBody(req, body, sizeof(body)))
+    {
+        return sendJsonError(req, HTTPD_400, "{\"error\":\"invalid input\"}");
+    }
+    StatusSnapshot snap;
+    readStatusSnapshot(snap);
+
+    WebCommand cmd = {};
+    cmd.type = WEB_CMD_SET_SETTINGS;
+    cmd.settings = snap.settings;
+    char arg[12];
+    if (getFormArg(body, "lowPower", arg, sizeof(arg)))
+    {
+        cmd.settings.lowPower = strcmp(arg, "1") == 0 || strcmp(arg, "true") == 0;
+    }
+    if (getFormArg(body, "displayDimSeconds", arg, sizeof(arg)))
+    {
+        cmd.settings.displayDimSeconds = strtoul(arg, nullptr, 10);
+    }
+    if (getFormArg(body, "displayOffSeconds", arg, sizeof(arg)))
+    {
+        cmd.settings.displayOffSeconds = strtoul(arg, nullptr, 10);
+    }
+    if (getFormArg(body, "stallBudgetMs", arg, sizeof(arg)))
+    {
+        cmd.settings.stallBudgetMs = strtoul(arg, nullptr, 10);
+        if (cmd.settings.stallBudgetMs < 50)
         {
-            incrementDigit();
+            return sendJsonError(req, HTTPD_400, "{\"error\":\"stallBudgetMs must be at least 50\"}");
         }
-        updateDisplay();
-        break;
-    default:
-        saveDataToSPIFFS();
-        publishGasVolume();
-        break;
     }
-    return;
+    char text[48];
+    if (getFormArg(body, "timezone", text, sizeof(text)) && strlen(text) > 0)
+    {
+        strlcpy(cmd.settings.timezone, text, sizeof(cmd.settings.timezone));
+    }
+    if (getFormArg(body, "ntpServer", text, sizeof(text)) && strlen(text) > 0)
+    {
+        strlcpy(cmd.settings.ntpServer, text, sizeof(cmd.settings.ntpServer));
+    }
+    if (getFormArg(body, "logLevel", text, sizeof(text)) && !Logger::parseLevel(text, cmd.settings.logLevel))
+    {
+        return sendJsonError(req, HTTPD_400, "{\"error\":\"logLevel must be error, warn, info or debug\"}");
+    }
+    if (getFormArg(body, "udpTarget", text, sizeof(text)))
+    {
+        IPAddress ip;
+        if (strlen(text) > 0 && !ip.fromString(text))
+        {
+            return sendJsonError(req, HTTPD_400, "{\"error\":\"udpTarget must be an IPv4 address or empty\"}");
+        }
+        strlcpy(cmd.settings.udpTarget, text, sizeof(cmd.settings.udpTarget));
+    }
+    if (getFormArg(body, "udpPort", arg, sizeof(arg)))
+    {
+        cmd.settings.udpPort = strtoul(arg, nullptr, 10);
+        if (cmd.settings.udpPort == 0)
+        {
+            return sendJsonError(req, HTTPD_400, "{\"error\":\"udpPort must be 1..65535\"}");
+        }
+    }
+    if (!queueWebCommand(cmd))
+    {
+        return sendJsonError(req, "503 Service Unavailable", "{\"error\":\"busy\"}");
+    }
+
+    DynamicJsonDocument doc(512);
+    settingsToJson(cmd.settings, doc.to<JsonObject>());
+    return sendJson(req, HTTPD_200, doc);
 }
 
-void handleButton2LongPress(Button2 &btn)
+// Configuration and readings of all meter channels (channel 0 is the gas meter and read-only)
+esp_err_t handleChannelsRequest(httpd_req_t *req)
 {
-    Serial.println("Button 2 long press detected");
-    captureAndSendScreenshotRLE(tft);
+    StatusSnapshot snap;
+    readStatusSnapshot(snap);
+    DynamicJsonDocument doc(3072);
+    JsonArray out = doc.to<JsonArray>();
+    for (uint8_t ch = 0; ch < MeterChannels::MAX_CHANNELS; ch++)
+    {
+        const ChannelConfig &config = snap.channelConfig[ch];
+        JsonObject o = out.createNestedObject();
+        o["index"] = ch;
+        o["enabled"] = config.enabled;
+        o["pin"] = config.pin;
+        o["activeLow"] = config.activeLow;
+        o["pullup"] = config.pullup;
+        o["debounceMs"] = config.debounceMs;
+        o["unitsPerPulse"] = config.unitsPerPulse;
+        o["name"] = config.name;
+        o["unit"] = config.unit;
+        o["deviceClass"] = config.deviceClass;
+        o["topic"] = config.topic;
+        o["pulses"] = snap.channelPulses[ch];
+        o["value"] = snap.channelValue[ch];
+    }
+    return sendJson(req, HTTPD_200, doc);
 }
 
-// Callback function for saving WiFiManager parameters
-void WMsaveParamsCallback()
+// Form fields that are left out keep the channel's current configuration. The update is checked
+// against the snapshot here and again by loop(), which merges it into the configuration it applies.
+esp_err_t handleChannelUpdate(httpd_req_t *req)
 {
-    strcpy(mqtt_server, custom_mqtt_server.getValue());
-    strcpy(mqtt_port, custom_mqtt_port.getValue());
-    strcpy(mqtt_user, custom_mqtt_user.getValue());
-    strcpy(mqtt_password, custom_mqtt_password.getValue());
-    Serial.printf("Got MQTT params from WifiManager: %s:%s:%s:%s\n", mqtt_server, mqtt_port, mqtt_user, mqtt_password);
-    saveDataToSPIFFS();
-    reconnect_mqtt();
+    char body[512];
+    char arg[48];
+    if (!readRequestBody(req, body, sizeof(body)) || !getFormArg(body, "index", arg, sizeof(arg)))
+    {
+        return sendJsonError(req, HTTPD_400, "{\"error\":\"index missing\"}");
+    }
+    long index = strtol(arg, nullptr, 10);
+    if (index < 1 || index >= MeterChannels::MAX_CHANNELS)
+    {
+        return sendJsonError(req, HTTPD_400, "{\"error\":\"index out of range\"}");
+    }
+
+    WebCommand cmd = {};
+    cmd.type = WEB_CMD_SET_CHANNEL;
+    cmd.channel = index;
+    ChannelConfig &update = cmd.channelConfig;
+    uint16_t &fields = cmd.channelFields;
+    if (getFormArg(body, "enabled", arg, sizeof(arg)))
+    {
+        update.enabled = strcmp(arg, "1") == 0 || strcmp(arg, "true") == 0;
+        fields |= CHANNEL_ENABLED;
+    }
+    if (getFormArg(body, "pin", arg, sizeof(arg)))
+    {
+        update.pin = strtoul(arg, nullptr, 10);
+        fields |= CHANNEL_PIN;
+    }
+    if (getFormArg(body, "activeLow", arg, sizeof(arg)))
+    {
+        update.activeLow = strcmp(arg, "1") == 0 || strcmp(arg, "true") == 0;
+        fields |= CHANNEL_ACTIVE_LOW;
+    }
+    if (getFormArg(body, "pullup", arg, sizeof(arg)))
+    {
+        update.pullup = strcmp(arg, "1") == 0 || strcmp(arg, "true") == 0;
+        fields |= CHANNEL_PULLUP;
+    }
+    if (getFormArg(body, "debounceMs", arg, sizeof(arg)))
+    {
+        update.debounceMs = strtoul(arg, nullptr, 10);
+        fields |= CHANNEL_DEBOUNCE;
+    }
+    if (getFormArg(body, "unitsPerPulse", arg, sizeof(arg)))
+    {
+        update.unitsPerPulse = strtof(arg, nullptr);
+        fields |= CHANNEL_UNITS_PER_PULSE;
+    }
+    if (getFormArg(body, "name", update.name, sizeof(update.name)))
+        fields |= CHANNEL_NAME;
+    if (getFormArg(body, "unit", update.unit, sizeof(update.unit)))
+        fields |= CHANNEL_UNIT;
+    if (getFormArg(body, "deviceClass", update.deviceClass, sizeof(update.deviceClass)))
+        fields |= CHANNEL_DEVICE_CLASS;
+    if (getFormArg(body, "topic", update.topic, sizeof(update.topic)))
+        fields |= CHANNEL_TOPIC;
+    if (getFormArg(body, "value", arg, sizeof(arg)))
+    {
+        cmd.setReading = true;
+        cmd.reading = strtod(arg, nullptr);
+    }
+
+    StatusSnapshot snap;
+    readStatusSnapshot(snap);
+    mergeChannelConfig(snap.channelConfig[index], update, fields);
+    const char *error = channelConfigError(index, snap.channelConfig);
+    if (error)
+    {
+        char json[96];
+        snprintf(json, sizeof(json), "{\"error\":\"%s\"}", error);
+        return sendJsonError(req, HTTPD_400, json);
+    }
+    if (!queueWebCommand(cmd))
+    {
+        return sendJsonError(req, "503 Service Unavailable", "{\"error\":\"busy\"}");
+    }
+    DynamicJsonDocument doc(64);
+    doc["status"] = "ok";
+    return sendJson(req, HTTPD_200, doc);
+}
+
+bool sendLogLine(void *ctx, const Logger::Line &line)
+{
+    static const char levelTags[LOG_LEVEL_COUNT] = {'E', 'W', 'I', 'D'};
+    char buf[Logger::LINE_LENGTH + 32];
+    snprintf(buf, sizeof(buf), "%lu [%6lu.%03lu] %c %s\n", static_cast<unsigned long>(line.seq),
+             static_cast<unsigned long>(line.ms / 1000), static_cast<unsigned long>(line.ms % 1000),
+             levelTags[line.level % LOG_LEVEL_COUNT], line.text);
+    return httpd_resp_sendstr_chunk(static_cast<httpd_req_t *>(ctx), buf) == ESP_OK;
+}
+
+// Newest log lines as plain text (?lines=N, default 50), read from the ring without locking
+esp_err_t handleLogRequest(httpd_req_t *req)
+{
+    char query[32];
+    char arg[8];
+    size_t lines = 50;
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+        httpd_query_key_value(query, "lines", arg, sizeof(arg)) == ESP_OK)
+    {
+        lines = strtoul(arg, nullptr, 10);
+    }
+    httpd_resp_set_type(req, "text/plain; charset=utf-8");
+    char header[96];
+    snprintf(header, sizeof(header), "# level %s, %u lines written, %u dropped\n", Logger::levelName(logger.level()),
+             logger.written(), logger.dropped());
+    httpd_resp_sendstr_chunk(req, header);
+    logger.tail(lines, sendLogLine, req);
+    return httpd_resp_sendstr_chunk(req, nullptr);
 }
 
-// Callback function for receiving MQTT messages
-void MQTTcallbackReceive(char *topic, byte *payload, unsigned int length)
+// Changes the log level (level=error|warn|info|debug); persisted with the device settings
+esp_err_t handleLogLevelUpdate(httpd_req_t *req)
 {
-    String message;
-    for (unsigned int i = 0; i < length; i++)
+    char body[64];
+    char arg[12];
+    StatusSnapshot snap;
+    readStatusSnapshot(snap);
+    WebCommand cmd = {};
+    cmd.type = WEB_CMD_SET_SETTINGS;
+    cmd.settings = snap.settings;
+    if (!readRequestBody(req, body, sizeof(body)) || !getFormArg(body, "level", arg, sizeof(arg)) ||
+        !Logger::parseLevel(arg, cmd.settings.logLevel))
     {
-        message += (char)payload[i];
+        return sendJsonError(req, HTTPD_400, "{\"error\":\"level must be error, warn, info or debug\"}");
     }
-    if (String(topic) == clientID + "/" + mqtt_topic_currentVal)
+    if (!queueWebCommand(cmd))
     {
-        offset = static_cast<uint32_t>(message.toFloat() * 100);
-        Serial.printf("Counter value received: %s m3\n", message.c_str());
-        Serial.printf("Calculated offset: %s m3\n", formatWithHundredsSeparator(offset).c_str());
-        pulseCount = 0;
-        updateDisplay();
-        saveDataToSPIFFS();
-        publishGasVolume();
+        return sendJsonError(req, "503 Service Unavailable", "{\"error\":\"busy\"}");
     }
+    DynamicJsonDocument doc(64);
+    doc["level"] = Logger::levelName(cmd.settings.logLevel);
+    return sendJson(req, HTTPD_200, doc);
 }
 
-void handleRootRequest()
+// Save/load latency and flash wear of the persisted files
+esp_err_t handleStorageRequest(httpd_req_t *req)
 {
-    webServer.send_P(200, "text/html", WEB_DASHBOARD);
+    DynamicJsonDocument doc(2048);
+    spiffsManager.statsToJson(doc.to<JsonObject>());
+    return sendJson(req, HTTPD_200, doc);
 }
 
-void handleStatusRequest()
+// MQTT timings as JSON, so runs before and after a change to the MQTT code can be diffed
+esp_err_t handleMqttStatsRequest(httpd_req_t *req)
 {
-    connectionStatus.wifiConnected = (WiFi.status() == WL_CONNECTED);
-    connectionStatus.mqttConnected = client.connected();
-    DynamicJsonDocument doc(768);
-    uint32_t currentVolume = pulseCount + offset;
-    doc["gasVolumeRaw"] = currentVolume;
-    doc["gasVolumeM3"] = static_cast<float>(currentVolume) / 100.0f;
-    doc["gasVolumeFormatted"] = formatWithHundredsSeparator(currentVolume);
-    doc["mqttConnected"] = connectionStatus.mqttConnected;
-    doc["mqttServer"] = mqtt_server;
-    doc["mqttPort"] = mqtt_port;
-    doc["mqttUser"] = mqtt_user;
-    doc["maskedPassword"] = strlen(mqtt_password) ? "********" : "";
-    doc["wifiConnected"] = connectionStatus.wifiConnected;
-    doc["uptimeSeconds"] = millis() / 1000;
-    doc["version"] = version;
-    doc["clientID"] = clientID;
-    doc["mqttTopicGas"] = String(clientID + "/" + mqtt_topic_gas);
-    doc["mqttTopicCurrent"] = String(clientID + "/" + mqtt_topic_currentVal);
-    doc["mqttTopicBase"] = mqtt_topic_gas;
-    doc["mqttTopicCurrentBase"] = mqtt_topic_currentVal;
-    doc["offset"] = offset;
-    doc["pulseCount"] = pulseCount;
-    doc["mqttLastStatus"] = lastMqttStatus;
-    doc["mqttLastAttemptUptime"] = static_cast<uint32_t>(timeStamps.lastMQTTreconnectTime / 1000);
-    doc["mqttLastError"] = lastMqttErrorCode;
+    StatusSnapshot snap;
+    readStatusSnapshot(snap);
+    unsigned long now = millis();
+    DynamicJsonDocument doc(2048);
+    doc["connected"] = snap.mqttConnected;
+    doc["uptimeS"] = now / 1000;
+
+    JsonObject connect = doc.createNestedObject("connect");
+    uint32_t attempts = metrics.mqttReconnects;
+    connect["attempts"] = attempts;
+    connect["failures"] = metrics.mqttReconnectFailures;
+    connect["lastMs"] = metrics.mqttReconnectLastMs;
+    connect["avgMs"] = attempts ? static_cast<double>(metrics.mqttReconnectTotalMs.get()) / attempts : 0.0;
+
+    JsonObject discovery = doc.createNestedObject("discovery");
+    discovery["runs"] = metrics.mqttDiscoveryRuns;
+    discovery["lastMs"] = metrics.mqttDiscoveryLastMs;
+
+    JsonObject publish = doc.createNestedObject("publish");
+    publish["ok"] = metrics.mqttPublishOk;
+    publish["failed"] = metrics.mqttPublishFailed;
+    publish["bytes"] = metrics.mqttPublishBytes.get();
+    publish["messagesPerHour"] = now ? metrics.mqttPublishOk * 3600000.0 / now : 0.0;
+    metrics.mqttPublishLatency.toJson(publish.createNestedObject("latency"));
+
+    JsonObject set = doc.createNestedObject("set");
+    set["count"] = metrics.mqttSetCount;
+    set["lastMs"] = metrics.mqttSetLastUs / 1000.0;
+
+    JsonObject recovery = doc.createNestedObject("recovery");
+    recovery["outages"] = metrics.mqttOutages;
+    recovery["lastMs"] = metrics.mqttRecoveryLastMs;
+    recovery["maxMs"] = metrics.mqttRecoveryMaxMs;
+    unsigned long outageStart = metrics.mqttOutageStart;
+    recovery["currentOutageMs"] = outageStart ? now - outageStart : 0;
+    return sendJson(req, HTTPD_200, doc);
+}
 
-    String payload;
-    serializeJson(doc, payload);
-    webServer.send(200, "application/json", payload);
+// Progress and results of the pulse self-test
+esp_err_t handleSelfTestRequest(httpd_req_t *req)
+{
+    DynamicJsonDocument doc(4096);
+    selfTest.toJson(doc.to<JsonObject>());
+    return sendJson(req, HTTPD_200, doc);
 }
 
-void handleConsumptionUpdate()
+// action=stop ends a running test; otherwise starts one with pin (0 = virtual input),
+// stepSeconds and load (0/1)
+esp_err_t handleSelfTestUpdate(httpd_req_t *req)
 {
-    if (!webServer.hasArg("value"))
+    char body[128];
+    if (!readRequestBody(req, body, sizeof(body)))
     {
-        webServer.send(400, "application/json", "{\"error\":\"value missing\"}");
-        return;
+        return sendJsonError(req, HTTPD_400, "{\"error\":\"invalid input\"}");
     }
-    String target = webServer.arg("value");
-    target.trim();
-    target.replace(',', '.');
-    if (target.length() == 0)
+    WebCommand cmd = {};
+    cmd.type = WEB_CMD_SELFTEST_START;
+    SelfTestOptions &options = cmd.selfTestOptions;
+    options = SelfTestOptions();
+    char arg[12];
+    if (getFormArg(body, "action", arg, sizeof(arg)) && strcmp(arg, "stop") == 0)
+        cmd.type = WEB_CMD_SELFTEST_STOP;
+    if (getFormArg(body, "pin", arg, sizeof(arg)))
+        options.pin = strtoul(arg, nullptr, 10);
+    if (getFormArg(body, "stepSeconds", arg, sizeof(arg)))
+        options.stepSeconds = strtoul(arg, nullptr, 10);
+    if (getFormArg(body, "load", arg, sizeof(arg)))
+        options.load = strcmp(arg, "0") != 0;
+
+    // the test pin drives the reed input, so it must be a free output-capable GPIO
+    if (options.pin != 0 && (!MeterChannels::pinAvailable(options.pin) || options.pin >= 34))
     {
-        webServer.send(400, "application/json", "{\"error\":\"value empty\"}");
-        return;
+        return sendJsonError(req, HTTPD_400, "{\"error\":\"pin must be 0 or a free output GPIO\"}");
     }
-    double newValue = target.toDouble();
-    if (newValue < 0)
+    if (options.stepSeconds < 5 || options.stepSeconds > 600)
     {
-        webServer.send(400, "application/json", "{\"error\":\"value negative\"}");
-        return;
+        return sendJsonError(req, HTTPD_400, "{\"error\":\"stepSeconds must be 5..600\"}");
     }
-    uint32_t scaled = static_cast<uint32_t>(newValue * 100.0 + 0.5);
-    if (scaled >= pulseCount)
+    if (!queueWebCommand(cmd))
     {
-        offset = scaled - pulseCount;
+        return sendJsonError(req, "503 Service Unavailable", "{\"error\":\"busy\"}");
     }
-    else
+    DynamicJsonDocument doc(64);
+    doc["status"] = cmd.type == WEB_CMD_SELFTEST_STOP ? "stopping" : "starting";
+    return sendJson(req, HTTPD_200, doc);
+}
+
+// Reset reason, stall events of this and earlier boots, and the stages running right now
+esp_err_t handlePostmortemRequest(httpd_req_t *req)
+{
+    DynamicJsonDocument doc(12288);
+    stallWatchdog.toJson(doc.to<JsonObject>());
+    return sendJson(req, HTTPD_200, doc);
+}
+
+// Consumption per calendar period plus the local time it is based on
+esp_err_t handleStatsRequest(httpd_req_t *req)
+{
+    StatusSnapshot snap;
+    readStatusSnapshot(snap);
+    DynamicJsonDocument doc(512);
+    JsonObject root = doc.to<JsonObject>();
+    calendarStatsToJson(snap.calendar, snap.clockSynced, root);
+    if (snap.clockSynced)
     {
-        offset = scaled;
-        pulseCount = 0;
+        time_t now = time(nullptr);
+        struct tm local;
+        localtime_r(&now, &local);
+        char stamp[32];
+        strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%S%z", &local);
+        root["localTime"] = stamp;
     }
+    root["timezone"] = snap.settings.timezone;
+    return sendJson(req, HTTPD_200, doc);
+}
 
-    updateDisplay();
-    saveDataToSPIFFS();
-    publishGasVolume();
-
-    DynamicJsonDocument doc(256);
-    doc["status"] = "ok";
-    doc["value"] = static_cast<float>(scaled) / 100.0f;
-    doc["gasVolumeFormatted"] = formatWithHundredsSeparator(pulseCount + offset);
-    String payload;
-    serializeJson(doc, payload);
-    webServer.send(200, "application/json", payload);
+// Thresholds and current figures of the anomaly rules
+esp_err_t handleAnomalyRequest(httpd_req_t *req)
+{
+    StatusSnapshot snap;
+    readStatusSnapshot(snap);
+    DynamicJsonDocument doc(768);
+    AnomalyDetector::configToJson(snap.anomalyConfig, doc.createNestedObject("config"));
+    AnomalyDetector::statusToJson(snap.anomaly, doc.createNestedObject("status"));
+    return sendJson(req, HTTPD_200, doc);
 }
 
-void handleMqttConfigUpdate()
+// Form fields that are left out keep their current value; 0 disables a rule
+esp_err_t handleAnomalyUpdate(httpd_req_t *req)
 {
-    if (!webServer.hasArg("server") || !webServer.hasArg("port"))
+    char body[256];
+    if (!readRequestBody(req, body, sizeof(body)))
     {
-        webServer.send(400, "application/json", "{\"error\":\"server and port required\"}");
-        return;
+        return sendJsonError(req, HTTPD_400, "{\"error\":\"invalid input\"}");
     }
-    String serverArg = webServer.arg("server");
-    serverArg.trim();
-    String portArg = webServer.arg("port");
-    portArg.trim();
-    if (serverArg.isEmpty() || portArg.isEmpty())
+    StatusSnapshot snap;
+    readStatusSnapshot(snap);
+
+    WebCommand cmd = {};
+    cmd.type = WEB_CMD_SET_ANOMALY;
+    cmd.anomaly = snap.anomalyConfig;
+    AnomalyConfig &config = cmd.anomaly;
+    char arg[12];
+    if (getFormArg(body, "minGapMinutes", arg, sizeof(arg)))
+        config.minGapMinutes = strtoul(arg, nullptr, 10);
+    if (getFormArg(body, "flowGapMinutes", arg, sizeof(arg)))
+        config.flowGapMinutes = strtoul(arg, nullptr, 10);
+    if (getFormArg(body, "maxFlowMinutes", arg, sizeof(arg)))
+        config.maxFlowMinutes = strtoul(arg, nullptr, 10);
+    if (getFormArg(body, "deviationFactor", arg, sizeof(arg)))
+        config.deviationFactor = strtof(arg, nullptr);
+    if (getFormArg(body, "deviationMinPulses", arg, sizeof(arg)))
+        config.deviationMinPulses = strtoul(arg, nullptr, 10);
+
+    if (config.deviationFactor < 0 || (config.maxFlowMinutes > 0 && config.flowGapMinutes == 0))
     {
-        webServer.send(400, "application/json", "{\"error\":\"invalid input\"}");
-        return;
+        return sendJsonError(req, HTTPD_400, "{\"error\":\"deviationFactor < 0 or maxFlowMinutes without flowGapMinutes\"}");
     }
-
-    long portLong = portArg.toInt();
-    if (portLong <= 0 || portLong > 65535)
+    if (!queueWebCommand(cmd))
     {
-        webServer.send(400, "application/json", "{\"error\":\"port out of range\"}");
-        return;
+        return sendJsonError(req, "503 Service Unavailable", "{\"error\":\"busy\"}");
     }
+    DynamicJsonDocument doc(256);
+    AnomalyDetector::configToJson(cmd.anomaly, doc.to<JsonObject>());
+    return sendJson(req, HTTPD_200, doc);
+}
 
-    String userArg = webServer.hasArg("username") ? webServer.arg("username") : "";
-    String passArg = webServer.hasArg("password") ? webServer.arg("password") : "";
-    String clientIdArg = webServer.hasArg("clientid") ? webServer.arg("clientid") : "";
-    String topicArg = webServer.hasArg("topic") ? webServer.arg("topic") : "";
-    String topicCurrentArg = webServer.hasArg("topic_current") ? webServer.arg("topic_current") : "";
-
-    strlcpy(mqtt_server, serverArg.c_str(), sizeof(mqtt_server));
-    strlcpy(mqtt_port, portArg.c_str(), sizeof(mqtt_port));
-    strlcpy(mqtt_user, userArg.c_str(), sizeof(mqtt_user));
-    strlcpy(mqtt_password, passArg.c_str(), sizeof(mqtt_password));
+esp_err_t handleRestartRequest(httpd_req_t *req)
+{
+    DynamicJsonDocument doc(128);
+    doc["status"] = "restarting";
+    doc["message"] = "Device will restart now";
+    esp_err_t err = sendJson(req, HTTPD_200, doc);
+    WebCommand cmd = {};
+    cmd.type = WEB_CMD_RESTART;
+    queueWebCommand(cmd);
+    return err;
+}
 
-    // Apply optional runtime-only settings
-    if (clientIdArg.length() > 0) {
-        clientID = clientIdArg;
-        Serial.printf("Setting clientID to: %s\n", clientID.c_str());
-        // need to republish discovery under new clientID
-        hassDiscoveryPublished = false;
-    }
-    if (topicArg.length() > 0) {
-        mqtt_topic_gas = topicArg;
-        Serial.printf("Setting mqtt topic base to: %s\n", mqtt_topic_gas.c_str());
-        hassDiscoveryPublished = false;
-    }
-    if (topicCurrentArg.length() > 0) {
-        mqtt_topic_currentVal = topicCurrentArg;
-        Serial.printf("Setting mqtt topic current to: %s\n", mqtt_topic_currentVal.c_str());
-        hassDiscoveryPublished = false;
+// Per-page render cost, so layout changes that make a page more expensive are visible
+void writeDisplayPageMetrics(MetricsWriter &out)
+{
+    static const char *const pageNames[DisplayRenderer::MAX_PAGES] = {"gas", "wifi", "mqtt", "misc", "edit", "history"};
+    struct Series
+    {
+        const char *name;
+        const char *help;
+        const char *type;
+    };
+    static const Series series[] = {
+        {"gasmeter_display_page_renders_total", "Renders per display page", "counter"},
+        {"gasmeter_display_page_last_pixels", "Pixels sent by the last render of a page", "gauge"},
+        {"gasmeter_display_page_last_spi_bytes", "SPI bytes of the last render of a page", "gauge"},
+        {"gasmeter_display_page_max_spi_bytes", "Largest render of a page in SPI bytes", "gauge"},
+        {"gasmeter_display_page_spi_bytes_total", "SPI bytes sent per display page", "counter"},
+        {"gasmeter_display_page_render_max_seconds", "Slowest render of a page", "gauge"},
+    };
+    char label[24];
+    for (uint8_t k = 0; k < sizeof(series) / sizeof(series[0]); k++)
+    {
+        out.header(series[k].name, series[k].help, series[k].type);
+        for (uint8_t page = 0; page < DisplayRenderer::MAX_PAGES; page++)
+        {
+            DisplayRenderer::PageStats stats = displayRenderer.pageStats(page);
+            const double values[] = {static_cast<double>(stats.renders), static_cast<double>(stats.lastPixels),
+                                     static_cast<double>(stats.lastSpiBytes), static_cast<double>(stats.maxSpiBytes),
+                                     static_cast<double>(stats.totalSpiBytes), stats.maxRenderUs / 1e6};
+            snprintf(label, sizeof(label), "page=\"%s\"", pageNames[page]);
+            out.sample(series[k].name, label, values[k]);
+        }
     }
+}
 
-    // If currently connected, force a disconnect so reconnect attempt is clean
-    if (client.connected())
+// Heap low-water mark and fragmentation plus per-task stack headroom, for spotting slow leaks in long runs
+void writeHeapMetrics(MetricsWriter &out)
+{
+    uint32_t freeHeap = ESP.getFreeHeap();
+    uint32_t largestBlock = ESP.getMaxAllocHeap();
+    out.gauge("gasmeter_heap_size_bytes", "Total heap", ESP.getHeapSize());
+    out.gauge("gasmeter_heap_free_bytes", "Free heap", freeHeap);
+    out.gauge("gasmeter_heap_min_free_bytes", "Lowest free heap since boot", ESP.getMinFreeHeap());
+    out.gauge("gasmeter_heap_largest_free_block_bytes", "Largest allocatable heap block", largestBlock);
+    out.gauge("gasmeter_heap_fragmentation_ratio", "1 - largest free block / free heap",
+              freeHeap ? 1.0 - static_cast<double>(largestBlock) / freeHeap : 0.0);
+
+    static const char *const tasks[] = {"loopTask", "display", "netboot", "log", "stallwatch", "httpd", "selftest_http"};
+    out.header("gasmeter_task_stack_free_min_bytes", "Least free stack a task has had since it started", "gauge");
+    char label[32];
+    for (uint8_t i = 0; i < sizeof(tasks) / sizeof(tasks[0]); i++)
     {
-        Serial.println("Disconnecting existing MQTT connection before reconfiguring");
-        // publish offline availability (retain) so Home Assistant marks device unavailable
-        String availTopic = clientID + "/availability";
-        client.publish(availTopic.c_str(), "offline", true);
-        client.disconnect();
-        delay(50);
+        TaskHandle_t task = xTaskGetHandle(tasks[i]);
+        if (task != nullptr)
+        {
+            snprintf(label, sizeof(label), "task=\"%s\"", tasks[i]);
+            out.sample("gasmeter_task_stack_free_min_bytes", label, uxTaskGetStackHighWaterMark(task));
+        }
     }
-
-    saveDataToSPIFFS();
-    bool connected = reconnect_mqtt();
-
-    DynamicJsonDocument doc(512);
-    doc["status"] = "ok";
-    doc["mqttConnected"] = connected;
-    doc["mqttServer"] = mqtt_server;
-    doc["mqttPort"] = mqtt_port;
-    doc["mqttLastStatus"] = lastMqttStatus;
-    doc["mqttLastError"] = lastMqttErrorCode;
-    doc["mqttLastAttemptUptime"] = static_cast<uint32_t>(timeStamps.lastMQTTreconnectTime / 1000);
-    doc["clientID"] = clientID;
-    doc["mqttTopicBase"] = mqtt_topic_gas;
-    doc["mqttTopicCurrentBase"] = mqtt_topic_currentVal;
-    String payload;
-    serializeJson(doc, payload);
-    webServer.send(200, "application/json", payload);
 }
 
-void handleFirmwareUpload()
+// CPU time and start delay per loop() job
+void writeSchedulerMetrics(MetricsWriter &out)
 {
-    HTTPUpload &upload = webServer.upload();
-    if (upload.status == UPLOAD_FILE_START)
+    struct Series
     {
-        Serial.printf("OTA: Upload start %s\n", upload.filename.c_str());
-        if (!Update.begin(UPDATE_SIZE_UNKNOWN))
+        const char *name;
+        const char *help;
+        const char *type;
+    };
+    static const Series series[] = {
+        {"gasmeter_job_runs_total", "Runs per loop() job", "counter"},
+        {"gasmeter_job_cpu_seconds_total", "Time spent in a loop() job", "counter"},
+        {"gasmeter_job_max_seconds", "Longest single run of a loop() job", "gauge"},
+        {"gasmeter_job_jitter_seconds", "How late the last run of a timed job started", "gauge"},
+        {"gasmeter_job_jitter_max_seconds", "Largest start delay of a timed job", "gauge"},
+    };
+    char label[32];
+    for (uint8_t k = 0; k < sizeof(series) / sizeof(series[0]); k++)
+    {
+        out.header(series[k].name, series[k].help, series[k].type);
+        for (Scheduler::JobId id = 0; id < scheduler.jobCount(); id++)
         {
-            Update.printError(Serial);
+            Scheduler::JobStats stats = scheduler.stats(id);
+            const double values[] = {static_cast<double>(stats.runs), stats.totalUs / 1e6, stats.maxUs / 1e6,
+                                     stats.lastJitterMs / 1e3, stats.maxJitterMs / 1e3};
+            snprintf(label, sizeof(label), "job=\"%s\"", stats.name);
+            out.sample(series[k].name, label, values[k]);
         }
     }
-    else if (upload.status == UPLOAD_FILE_WRITE)
+}
+
+// Prometheus text format, streamed in chunks without building the document in memory
+esp_err_t handleMetricsRequest(httpd_req_t *req)
+{
+    StatusSnapshot snap;
+    readStatusSnapshot(snap);
+    unsigned long now = millis();
+
+    MetricsWriter out(req);
+    out.counter("gasmeter_pulses_total", "Pulses counted since the last meter correction", snap.pulseCount);
+    out.gauge("gasmeter_volume_cubic_meters", "Current meter reading", (snap.pulseCount + snap.offset) / 100.0);
+    out.gauge("gasmeter_pulse_rate_per_hour", "Pulse rate derived from the last pulse interval", metrics.pulseRatePerHour(now));
+    out.histogram("gasmeter_loop_duration_seconds", "Duration of one loop() iteration", metrics.loopLatency);
+    out.histogram("gasmeter_http_request_duration_seconds", "HTTP handler latency", metrics.httpLatency);
+    out.gauge("gasmeter_loop_duration_max_seconds", "Longest loop() iteration since boot", metrics.loopLatency.maxUs / 1e6);
+    out.gauge("gasmeter_http_request_duration_max_seconds", "Slowest HTTP handler since boot", metrics.httpLatency.maxUs / 1e6);
+    writeHeapMetrics(out);
+    out.counter("gasmeter_mqtt_publish_success_total", "Successful MQTT publishes", metrics.mqttPublishOk);
+    out.counter("gasmeter_mqtt_publish_failure_total", "Failed MQTT publishes", metrics.mqttPublishFailed);
+    out.counter("gasmeter_mqtt_reconnects_total", "MQTT connection attempts", metrics.mqttReconnects);
+    out.counter("gasmeter_mqtt_reconnect_failures_total", "Failed MQTT connection attempts", metrics.mqttReconnectFailures);
+    out.gauge("gasmeter_mqtt_reconnect_last_seconds", "Duration of the last MQTT connection attempt", metrics.mqttReconnectLastMs / 1000.0);
+    out.fractionalCounter("gasmeter_mqtt_reconnect_seconds_total", "Time spent in MQTT connection attempts",
+                          metrics.mqttReconnectTotalMs.get() / 1000.0);
+    out.gauge("gasmeter_mqtt_connected", "MQTT connection state", snap.mqttConnected ? 1 : 0);
+    out.histogram("gasmeter_mqtt_publish_duration_seconds", "Time spent in one MQTT publish", metrics.mqttPublishLatency);
+    out.counter("gasmeter_mqtt_published_bytes_total", "Topic and payload bytes of successful publishes", metrics.mqttPublishBytes.get());
+    out.gauge("gasmeter_mqtt_discovery_last_seconds", "Duration of the last Home Assistant discovery announce", metrics.mqttDiscoveryLastMs / 1000.0);
+    out.counter("gasmeter_mqtt_outages_total", "Broker connection losses", metrics.mqttOutages);
+    out.gauge("gasmeter_mqtt_recovery_last_seconds", "Time from the last broker connection loss until reconnected", metrics.mqttRecoveryLastMs / 1000.0);
+    out.counter("gasmeter_spiffs_writes_total", "Persisted state writes", metrics.spiffsWrites);
+    out.counter("gasmeter_spiffs_written_bytes_total", "Bytes written to SPIFFS", metrics.spiffsBytes.get());
+    out.gauge("gasmeter_wifi_connected", "WiFi connection state", snap.wifiConnected ? 1 : 0);
+    out.gauge("gasmeter_wifi_rssi_dbm", "WiFi signal strength", snap.wifiConnected ? WiFi.RSSI() : 0);
+    out.histogram("gasmeter_display_render_duration_seconds", "Time spent in one display update", metrics.displayRenderLatency);
+    out.gauge("gasmeter_display_last_spi_bytes", "Bytes sent to the panel by the last display update", displayRenderer.lastSpiBytes());
+    out.counter("gasmeter_display_spi_bytes_total", "Bytes sent to the panel", displayRenderer.totalSpiBytes());
+    out.counter("gasmeter_display_requests_total", "Display redraw requests", metrics.displayRequests);
+    out.counter("gasmeter_display_updates_total", "Rendered display frames", displayRenderer.renderCount());
+    writeDisplayPageMetrics(out);
+    writeSchedulerMetrics(out);
+    out.header("gasmeter_boot_milestone_seconds", "Time from boot until a boot phase was first reached", "gauge");
+    for (uint8_t i = 0; i < BOOT_MILESTONE_COUNT; i++)
     {
-        if (Update.write(upload.buf, upload.currentSize) != upload.currentSize)
+        BootMilestone milestone = static_cast<BootMilestone>(i);
+        if (bootTimeline.reached(milestone))
         {
-            Update.printError(Serial);
+            char label[40];
+            snprintf(label, sizeof(label), "milestone=\"%s\"", bootMilestoneName(milestone));
+            out.sample("gasmeter_boot_milestone_seconds", label, bootTimeline.at(milestone) / 1000.0);
         }
     }
-    else if (upload.status == UPLOAD_FILE_END)
+    out.gauge("gasmeter_screenshot_capture_seconds", "Duration of the last screenshot capture", metrics.screenshotCaptureMs / 1000.0);
+    out.gauge("gasmeter_screenshot_compression_ratio", "Raw to encoded size of the last screenshot",
+              metrics.screenshotEncodedBytes ? static_cast<double>(metrics.screenshotRawBytes) / metrics.screenshotEncodedBytes : 0.0);
+    out.header("gasmeter_channel_pulses_total", "Pulses counted per meter channel", "counter");
+    for (uint8_t ch = 0; ch < MeterChannels::MAX_CHANNELS; ch++)
     {
-        if (Update.end(true))
+        if (snap.channelConfig[ch].enabled)
         {
-            Serial.printf("OTA: Update success (%u bytes)\n", upload.totalSize);
+            char label[16];
+            snprintf(label, sizeof(label), "channel=\"%u\"", ch);
+            out.sample("gasmeter_channel_pulses_total", label, snap.channelPulses[ch]);
         }
-        else
+    }
+    out.header("gasmeter_channel_value", "Meter reading per channel in its configured unit", "gauge");
+    for (uint8_t ch = 0; ch < MeterChannels::MAX_CHANNELS; ch++)
+    {
+        if (snap.channelConfig[ch].enabled)
         {
-            Update.printError(Serial);
+            char label[16];
+            snprintf(label, sizeof(label), "channel=\"%u\"", ch);
+            out.sample("gasmeter_channel_value", label, snap.channelValue[ch]);
         }
     }
-    else if (upload.status == UPLOAD_FILE_ABORTED)
+    out.header("gasmeter_anomaly_alert", "Anomaly alert state", "gauge");
+    for (uint8_t i = 0; i < AnomalyDetector::ALERT_COUNT; i++)
     {
-        Update.end();
-        Serial.println("OTA: Upload aborted");
+        char label[32];
+        snprintf(label, sizeof(label), "alert=\"%s\"", AnomalyDetector::alertName(i));
+        out.sample("gasmeter_anomaly_alert", label, (snap.anomaly.alerts & (1 << i)) ? 1 : 0);
     }
+    out.gauge("gasmeter_anomaly_rate_short_per_hour", "Pulse rate, 5 minute EWMA", snap.anomaly.rateShort);
+    out.gauge("gasmeter_anomaly_rate_long_per_hour", "Pulse rate, 60 minute EWMA", snap.anomaly.rateLong);
+    out.gauge("gasmeter_anomaly_longest_gap_seconds", "Longest pause between pulses within 24 h", snap.anomaly.longestGapMs / 1000.0);
+    out.gauge("gasmeter_anomaly_flow_seconds", "Duration of the current continuous flow", snap.anomaly.flowMs / 1000.0);
+    out.gauge("gasmeter_display_power_state", "Display state (0 on, 1 dimmed, 2 off)", snap.displayPower);
+    out.gauge("gasmeter_power_low_power_mode", "Low-power mode enabled", snap.settings.lowPower ? 1 : 0);
+    out.gauge("gasmeter_power_cpu_mhz", "Current CPU clock", getCpuFrequencyMhz());
+    out.gauge("gasmeter_power_duty_cycle", "Share of time the main loop was awake", powerManager.dutyCycle());
+    out.gauge("gasmeter_power_wake_latency_seconds", "Reed or button edge to loop() running again", powerManager.lastWakeLatencyUs() / 1e6);
+    out.gauge("gasmeter_power_wake_latency_max_seconds", "Largest wake latency", powerManager.maxWakeLatencyUs() / 1e6);
+    out.counter("gasmeter_power_edge_wakeups_total", "Idle periods ended by a pin edge", powerManager.edgeWakeups());
+    out.counter("gasmeter_udp_datagrams_total", "Pulse datagrams sent", pulseBroadcaster.sent());
+    out.counter("gasmeter_udp_send_failures_total", "Pulse datagrams that could not be sent", pulseBroadcaster.failed());
+    out.counter("gasmeter_stall_events_total", "Stages that ran past the stall budget since boot", stallWatchdog.stallCount());
+    out.counter("gasmeter_boots_total", "Boots since the postmortem ring was last reset (power-on)", stallWatchdog.bootCount());
+    out.counter("gasmeter_log_lines_total", "Log lines written to the ring", logger.written());
+    out.counter("gasmeter_log_dropped_total", "Log lines overwritten before they reached the serial port", logger.dropped());
+    out.gauge("gasmeter_uptime_seconds", "Time since boot", now / 1000.0);
+    return out.finish();
 }
 
-void setupWebInterface()
+bool httpChunkSink(void *ctx, const uint8_t *data, size_t len)
 {
-    webServer.on("/", HTTP_GET, handleRootRequest);
-    webServer.on("/api/status", HTTP_GET, handleStatusRequest);
-    webServer.on("/api/consumption", HTTP_POST, handleConsumptionUpdate);
-    webServer.on("/api/restart", HTTP_POST, handleRestartRequest);
-    webServer.on("/api/mqtt", HTTP_POST, handleMqttConfigUpdate);
-    webServer.on("/update", HTTP_POST,
-                 []()
-                 {
-                     bool success = !Update.hasError();
-                     DynamicJsonDocument doc(128);
-                     doc["success"] = success;
-                     doc["message"] = success ? "Update erfolgreich" : "Update fehlgeschlagen";
-                     String payload;
-                     serializeJson(doc, payload);
-                     webServer.send(success ? 200 : 500, "application/json", payload);
-                     if (success)
-                     {
-                         delay(200);
-                         ESP.restart();
-                     }
-                 },
-                 handleFirmwareUpload);
-    webServer.onNotFound([]()
-                         { webServer.send(404, "application/json", "{\"error\":\"not found\"}"); });
-    webServer.begin();
-    Serial.println("HTTP dashboard available on http://" + WiFi.localIP().toString());
-}
-
-void handleRestartRequest()
+    return httpd_resp_send_chunk(static_cast<httpd_req_t *>(ctx), reinterpret_cast<const char *>(data), len) == ESP_OK;
+}
+
+// Current panel content as BMP (default) or binary RLE (?format=rle), streamed while it is read
+esp_err_t handleScreenshotRequest(httpd_req_t *req)
 {
-    DynamicJsonDocument doc(128);
-    doc["status"] = "restarting";
-    doc["message"] = "Device will restart now";
-    String payload;
-    serializeJson(doc, payload);
-    webServer.send(200, "application/json", payload);
-    delay(150);
-    ESP.restart();
-}
\ No newline at end of file
+    char query[32];
+    char format[8] = "bmp";
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK)
+    {
+        httpd_query_key_value(query, "format", format, sizeof(format));
+    }
+    bool rle = strcmp(format, "rle") == 0;
+    httpd_resp_set_type(req, rle ? "application/octet-stream" : "image/bmp");
+    httpd_resp_set_hdr(req, "Content-Disposition", rle ? "inline; filename=\"screenshot.rle\"" : "inline; filename=\"screenshot.bmp\"");
+
+    if (!displayRenderer.lock(pdMS_TO_TICKS(1000)))
+    {
+        return sendJsonError(req, "503 Service Unavailable", "{\"error\":\"display busy\"}");
+    }
+    ScreenshotStats stats = rle ? streamScreenshotRLE(tft, httpChunkSink, req) : streamScreenshotBMP(tft, httpChunkSink, req);
+    displayRenderer.unlock();
+
+    metrics.screenshotCaptureMs = stats.captureMs;
+    metrics.screenshotRawBytes = stats.rawBytes;
+    metrics.screenshotEncodedBytes = stats.encodedBytes;
+    LOG_INFO("Screenshot (%s): %u -> %u bytes in %u ms", format, stats.rawBytes, stats.encodedBytes, stats.captureMs);
+    if (!stats.ok)
+    {
+        return ESP_FAIL;
+    }
+    return httpd_resp_send_chunk(req, nullptr, 0);
+}
+
+// Registered loop() jobs with their run counts, CPU time, jitter and next deadline
+esp_err_t handleSchedulerRequest(httpd_req_t *req)
+{
+    DynamicJsonDocument doc(6144); // up to Scheduler::MAX_JOBS (24) jobs with 10 fields each
+    JsonObject root = doc.to<JsonObject>();
+    scheduler.toJson(root.createNestedArray("jobs"));
+    root["dutyCycle"] = powerManager.dutyCycle();
+    root["uptime"] = millis();
+    return sendJson(req, HTTPD_200, doc);
+}
+
+#ifdef LOOP_PROFILER
+// Per-stage loop() timings; POST resets the histograms
+esp_err_t handleProfileRequest(httpd_req_t *req)
+{
+    if (req->method == HTTP_POST)
+    {
+        loopProfiler.reset();
+    }
+    DynamicJsonDocument doc(10240); // 18 stages with a 21-bucket histogram each
+    loopProfiler.toJson(doc.to<JsonObject>());
+    return sendJson(req, HTTPD_200, doc);
+}
+#endif
+
+esp_err_t handleNotFound(httpd_req_t *req, httpd_err_code_t err)
+{
+    sendJsonError(req, HTTPD_404, "{\"error\":\"not found\"}");
+    return ESP_OK;
+}
+
+typedef esp_err_t (*WebHandler)(httpd_req_t *);
+
+// Every route goes through here so request latency ends up in the metrics
+esp_err_t timedWebHandler(httpd_req_t *req)
+{
+    unsigned long start = micros();
+    WebHandler handler = reinterpret_cast<WebHandler>(req->user_ctx);
+    esp_err_t err;
+    if (handler == handleFirmwareUpload)
+    {
+        err = handler(req); // an upload takes many seconds by design
+    }
+    else
+    {
+        stallWatchdog.attach(TRACE_CTX_HTTP);
+        TRACE_SCOPE(TRACE_HTTP_HANDLER, req->uri);
+        err = handler(req);
+    }
+    metrics.httpLatency.observe(micros() - start);
+    return err;
+}
+
+void registerWebHandler(const char *uri, httpd_method_t method, WebHandler handler)
+{
+    httpd_uri_t route = {};
+    route.uri = uri;
+    route.method = method;
+    route.handler = timedWebHandler;
+    route.user_ctx = reinterpret_cast<void *>(handler);
+    httpd_register_uri_handler(webServer, &route);
+}
+
+void setupWebInterface()
+{
+    lastWebServerStartAttempt = millis();
+
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.max_open_sockets = 5;   // concurrent keep-alive clients (MQTT needs a socket too)
+    config.lru_purge_enable = true; // recycle the oldest idle connection instead of refusing new ones
+    config.stack_size = 8192;       // OTA receive buffer lives on this stack
+    config.core_id = 0;             // keep loop() (core 1) free for counting
+    config.max_uri_handlers = 28;
+
+    if (httpd_start(&webServer, &config) != ESP_OK)
+    {
+        webServer = nullptr;
+        LOG_WARN("HTTP server could not be started (port 80 busy?), retrying later");
+        return;
+    }
+
+    registerWebHandler("/", HTTP_GET, handleRootRequest);
+    registerWebHandler("/api/status", HTTP_GET, handleStatusRequest);
+    registerWebHandler("/api/consumption", HTTP_POST, handleConsumptionUpdate);
+    registerWebHandler("/api/restart", HTTP_POST, handleRestartRequest);
+    registerWebHandler("/api/mqtt", HTTP_POST, handleMqttConfigUpdate);
+    registerWebHandler("/update", HTTP_POST, handleFirmwareUpload);
+    registerWebHandler("/metrics", HTTP_GET, handleMetricsRequest);
+    registerWebHandler("/api/screenshot", HTTP_GET, handleScreenshotRequest);
+    registerWebHandler("/api/settings", HTTP_GET, handleSettingsRequest);
+    registerWebHandler("/api/settings", HTTP_POST, handleSettingsUpdate);
+    registerWebHandler("/api/channels", HTTP_GET, handleChannelsRequest);
+    registerWebHandler("/api/channels", HTTP_POST, handleChannelUpdate);
+    registerWebHandler("/api/scheduler", HTTP_GET, handleSchedulerRequest);
+    registerWebHandler("/api/anomaly", HTTP_GET, handleAnomalyRequest);
+    registerWebHandler("/api/stats", HTTP_GET, handleStatsRequest);
+    registerWebHandler("/api/log", HTTP_GET, handleLogRequest);
+    registerWebHandler("/api/postmortem", HTTP_GET, handlePostmortemRequest);
+    registerWebHandler("/api/selftest", HTTP_GET, handleSelfTestRequest);
+    registerWebHandler("/api/mqtt/stats", HTTP_GET, handleMqttStatsRequest);
+    registerWebHandler("/api/storage", HTTP_GET, handleStorageRequest);
+    registerWebHandler("/api/selftest", HTTP_POST, handleSelfTestUpdate);
+    registerWebHandler("/api/log", HTTP_POST, handleLogLevelUpdate);
+    registerWebHandler("/api/anomaly", HTTP_POST, handleAnomalyUpdate);
+#ifdef LOOP_PROFILER
+    registerWebHandler("/api/profile", HTTP_GET, handleProfileRequest);
+    registerWebHandler("/api/profile", HTTP_POST, handleProfileRequest);
+#endif
+    httpd_register_err_handler(webServer, HTTPD_404_NOT_FOUND, handleNotFound);
+    LOG_INFO("HTTP dashboard available on http://%s", WiFi.localIP().toString().c_str());
+}
@@ -1,37 +1,206 @@
 #include "screenshot.h"
 
-void captureAndSendScreenshotRLE(TFT_eSPI& tft) {
+// Rows fetched per readRect() call
+static const uint16_t LINES_PER_READ = 8;
+
+namespace {
+
+// Collects small writes and hands them to the sink in larger blocks
+class SinkBuffer {
+public:
+    SinkBuffer(ScreenshotSink sink, void* ctx) : _sink(sink), _ctx(ctx) {}
+
+    void put(const void* data, size_t len)
+    {
+        const uint8_t* p = static_cast<const uint8_t*>(data);
+        while (len > 0 && _ok)
+        {
+            size_t chunk = min(len, sizeof(_buf) - _len);
+            memcpy(_buf + _len, p, chunk);
+            _len += chunk;
+            p += chunk;
+            len -= chunk;
+            if (_len == sizeof(_buf))
+                flush();
+        }
+    }
+
+    void put16(uint16_t v)
+    {
+        uint8_t le[2] = {static_cast<uint8_t>(v), static_cast<uint8_t>(v >> 8)};
+        put(le, 2);
+    }
+
+    void put32(uint32_t v)
+    {
+        uint8_t le[4] = {static_cast<uint8_t>(v), static_cast<uint8_t>(v >> 8),
+                         static_cast<uint8_t>(v >> 16), static_cast<uint8_t>(v >> 24)};
+        put(le, 4);
+    }
+
+    void flush()
+    {
+        if (_len > 0 && _ok)
+            _ok = _sink(_ctx, _buf, _len);
+        _total += _len;
+        _len = 0;
+    }
+
+    bool ok() const { return _ok; }
+    uint32_t total() const { return _total + _len; }
+
+private:
+    ScreenshotSink _sink;
+    void* _ctx;
+    uint8_t _buf[512];
+    size_t _len = 0;
+    uint32_t _total = 0;
+    bool _ok = true;
+};
+
+// Reads the frame in blocks of rows and calls onRow for each row with native RGB565 values
+template <typename RowFn>
+bool readFrame(TFT_eSPI& tft, RowFn onRow)
+{
     const uint16_t width = tft.width();
     const uint16_t height = tft.height();
-    const uint32_t totalPixels = width * height;
-    Serial.println("Start of RLE Compressed Screenshot");
-    Serial.printf("Original size: %u bytes\n", totalPixels * 2);
-    uint32_t compressedSize = 0;
-    uint16_t currentColor = 0;
-    uint8_t count = 0;
+    uint16_t* lines = static_cast<uint16_t*>(malloc(width * LINES_PER_READ * sizeof(uint16_t)));
+    if (lines == nullptr)
+        return false;
 
-    for (uint16_t y = 0; y < height; y++) {
-        for (uint16_t x = 0; x < width; x++) {
-            uint16_t pixelColor = tft.readPixel(x, y);
-            if (pixelColor == currentColor && count < 255) {
+    bool ok = true;
+    for (uint16_t y = 0; y < height && ok; y += LINES_PER_READ)
+    {
+        uint16_t rows = min<uint16_t>(LINES_PER_READ, height - y);
+        tft.readRect(0, y, width, rows, lines);
+        for (uint16_t r = 0; r < rows && ok; r++)
+        {
+            uint16_t* row = lines + r * width;
+            // readRect() returns byte-swapped colours (pushRect() order)
+            for (uint16_t x = 0; x < width; x++)
+                row[x] = (row[x] >> 8) | (row[x] << 8);
+            ok = onRow(row, width);
+        }
+    }
+    free(lines);
+    return ok;
+}
+
+} // namespace
+
+ScreenshotStats streamScreenshotRLE(TFT_eSPI& tft, ScreenshotSink sink, void* ctx)
+{
+    ScreenshotStats stats;
+    unsigned long start = millis();
+    SinkBuffer out(sink, ctx);
+    out.put("RLE1", 4);
+    out.put16(tft.width());
+    out.put16(tft.height());
+
+    uint16_t currentColor = 0;
+    uint16_t count = 0;
+    bool ok = readFrame(tft, [&](const uint16_t* row, uint16_t width) {
+        for (uint16_t x = 0; x < width; x++)
+        {
+            if (row[x] == currentColor && count < UINT16_MAX)
+            {
                 count++;
-            } else {
-                if (count > 0) {
-                    Serial.printf("%02X%04X", count, currentColor);
-                    compressedSize += 3;
+            }
+            else
+            {
+                if (count > 0)
+                {
+                    out.put16(count);
+                    out.put16(currentColor);
                 }
-                currentColor = pixelColor;
+                currentColor = row[x];
                 count = 1;
             }
         }
-    }
+        return out.ok();
+    });
 
     // Output the last color block
-    if (count > 0) {
-        Serial.printf("%02X%04X", count, currentColor);
-        compressedSize += 3;
+    if (count > 0)
+    {
+        out.put16(count);
+        out.put16(currentColor);
     }
+    out.flush();
 
-    Serial.printf("\nCompressed size: %u bytes\n", compressedSize);
+    stats.rawBytes = static_cast<uint32_t>(tft.width()) * tft.height() * 2;
+    stats.encodedBytes = out.total();
+    stats.captureMs = millis() - start;
+    stats.ok = ok && out.ok();
+    return stats;
+}
+
+ScreenshotStats streamScreenshotBMP(TFT_eSPI& tft, ScreenshotSink sink, void* ctx)
+{
+    ScreenshotStats stats;
+    unsigned long start = millis();
+    const uint32_t width = tft.width();
+    const uint32_t height = tft.height();
+    const uint32_t rowBytes = (width * 2 + 3) & ~3u;
+    const uint32_t headerBytes = 14 + 40 + 12;
+    const uint32_t imageBytes = rowBytes * height;
+
+    SinkBuffer out(sink, ctx);
+    // BITMAPFILEHEADER
+    out.put("BM", 2);
+    out.put32(headerBytes + imageBytes);
+    out.put32(0);
+    out.put32(headerBytes);
+    // BITMAPINFOHEADER, negative height = top-down rows
+    out.put32(40);
+    out.put32(width);
+    out.put32(static_cast<uint32_t>(-static_cast<int32_t>(height)));
+    out.put16(1);  // planes
+    out.put16(16); // bits per pixel
+    out.put32(3);  // BI_BITFIELDS
+    out.put32(imageBytes);
+    out.put32(2835); // 72 dpi
+    out.put32(2835);
+    out.put32(0);
+    out.put32(0);
+    // RGB565 channel masks
+    out.put32(0xF800);
+    out.put32(0x07E0);
+    out.put32(0x001F);
+
+    bool ok = readFrame(tft, [&](const uint16_t* row, uint16_t w) {
+        for (uint16_t x = 0; x < w; x++)
+            out.put16(row[x]);
+        for (uint32_t pad = w * 2; pad < rowBytes; pad++)
+            out.put("\0", 1);
+        return out.ok();
+    });
+    out.flush();
+
+    stats.rawBytes = width * height * 2;
+    stats.encodedBytes = out.total();
+    stats.captureMs = millis() - start;
+    stats.ok = ok && out.ok();
+    return stats;
+}
+
+static bool serialHexSink(void*, const uint8_t* data, size_t len)
+{
+    char hex[3];
+    for (size_t i = 0; i < len; i++)
+    {
+        snprintf(hex, sizeof(hex), "%02X", data[i]);
+        Serial.print(hex);
+    }
+    return true;
+}
+
+void captureAndSendScreenshotRLE(TFT_eSPI& tft)
+{
+    Serial.println("Start of RLE Compressed Screenshot");
+    ScreenshotStats stats = streamScreenshotRLE(tft, serialHexSink, nullptr);
+    Serial.printf("\nOriginal size: %u bytes\n", stats.rawBytes);
+    Serial.printf("Compressed size: %u bytes (%.1f:1, %u ms)\n", stats.encodedBytes,
+                  stats.encodedBytes ? static_cast<float>(stats.rawBytes) / stats.encodedBytes : 0.0f, stats.captureMs);
     Serial.println("End of RLE Compressed Screenshot");
-}
\ No newline at end of file
+}
@@ -0,0 +1,154 @@
+#include "Png.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <zlib.h>
+
+namespace
+{
+const uint8_t SIGNATURE[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+
+void put32(std::vector<uint8_t>& out, uint32_t v)
+{
+    out.push_back(v >> 24);
+    out.push_back(v >> 16);
+    out.push_back(v >> 8);
+    out.push_back(v);
+}
+
+uint32_t get32(const uint8_t* p) { return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3]; }
+
+void chunk(std::vector<uint8_t>& out, const char* type, const std::vector<uint8_t>& data)
+{
+    put32(out, data.size());
+    size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data.begin(), data.end());
+    put32(out, crc32(0, &out[start], out.size() - start));
+}
+
+uint8_t paeth(int a, int b, int c)
+{
+    int p = a + b - c;
+    int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+    return pa <= pb && pa <= pc ? a : (pb <= pc ? b : c);
+}
+} // namespace
+
+bool writePng(const std::string& path, int width, int height, const uint16_t* pixels)
+{
+    std::vector<uint8_t> raw;
+    raw.reserve(static_cast<size_t>(height) * (width * 3 + 1));
+    for (int y = 0; y < height; y++)
+    {
+        raw.push_back(0); // filter: none
+        for (int x = 0; x < width; x++)
+        {
+            uint16_t c = pixels[y * width + x];
+            uint8_t r = c >> 11, g = (c >> 5) & 0x3F, b = c & 0x1F;
+            raw.push_back(r << 3 | r >> 2);
+            raw.push_back(g << 2 | g >> 4);
+            raw.push_back(b << 3 | b >> 2);
+        }
+    }
+    uLongf packedLen = compressBound(raw.size());
+    std::vector<uint8_t> packed(packedLen);
+    if (compress2(packed.data(), &packedLen, raw.data(), raw.size(), 9) != Z_OK)
+        return false;
+    packed.resize(packedLen);
+
+    std::vector<uint8_t> header;
+    put32(header, width);
+    put32(header, height);
+    header.insert(header.end(), {8, 2, 0, 0, 0}); // 8-bit RGB, no interlace
+
+    std::vector<uint8_t> file(SIGNATURE, SIGNATURE + 8);
+    chunk(file, "IHDR", header);
+    chunk(file, "IDAT", packed);
+    chunk(file, "IEND", {});
+
+    FILE* f = fopen(path.c_str(), "wb");
+    if (!f)
+        return false;
+    bool ok = fwrite(file.data(), 1, file.size(), f) == file.size();
+    return fclose(f) == 0 && ok;
+}
+
+// Reads 8-bit RGB and RGBA images without interlacing, whatever filters the writer chose
+bool readPng(const std::string& path, int& width, int& height, std::vector<uint16_t>& pixels)
+{
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f)
+        return false;
+    std::vector<uint8_t> file;
+    uint8_t buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+        file.insert(file.end(), buf, buf + n);
+    fclose(f);
+    if (file.size() < 8 || memcmp(file.data(), SIGNATURE, 8) != 0)
+        return false;
+
+    std::vector<uint8_t> packed;
+    int channels = 0;
+    for (size_t pos = 8; pos + 12 <= file.size();)
+    {
+        uint32_t len = get32(&file[pos]);
+        if (pos + 12 + len > file.size())
+            return false;
+        const uint8_t* type = &file[pos + 4];
+        const uint8_t* data = &file[pos + 8];
+        if (memcmp(type, "IHDR", 4) == 0)
+        {
+            width = get32(data);
+            height = get32(data + 4);
+            if (data[8] != 8 || (data[9] != 2 && data[9] != 6) || data[12] != 0)
+                return false;
+            channels = data[9] == 2 ? 3 : 4;
+        }
+        else if (memcmp(type, "IDAT", 4) == 0)
+        {
+            packed.insert(packed.end(), data, data + len);
+        }
+        pos += 12 + len;
+    }
+    if (channels == 0)
+        return false;
+
+    size_t stride = static_cast<size_t>(width) * channels;
+    std::vector<uint8_t> raw(height * (stride + 1));
+    uLongf rawLen = raw.size();
+    if (uncompress(raw.data(), &rawLen, packed.data(), packed.size()) != Z_OK || rawLen != raw.size())
+        return false;
+
+    std::vector<uint8_t> prev(stride, 0), line(stride);
+    pixels.resize(static_cast<size_t>(width) * height);
+    for (int y = 0; y < height; y++)
+    {
+        const uint8_t* in = &raw[y * (stride + 1)];
+        uint8_t filter = in[0];
+        for (size_t i = 0; i < stride; i++)
+        {
+            int a = i >= static_cast<size_t>(channels) ? line[i - channels] : 0;
+            int b = prev[i];
+            int c = i >= static_cast<size_t>(channels) ? prev[i - channels] : 0;
+            uint8_t x = in[i + 1];
+            switch (filter)
+            {
+            case 0: line[i] = x; break;
+            case 1: line[i] = x + a; break;
+            case 2: line[i] = x + b; break;
+            case 3: line[i] = x + (a + b) / 2; break;
+            case 4: line[i] = x + paeth(a, b, c); break;
+            default: return false;
+            }
+        }
+        for (int x = 0; x < width; x++)
+        {
+            const uint8_t* p = &line[x * channels];
+            pixels[y * width + x] = (p[0] >> 3) << 11 | (p[1] >> 2) << 5 | p[2] >> 3;
+        }
+        prev.swap(line);
+    }
+    return true;
+}
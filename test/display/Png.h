@@ -0,0 +1,13 @@
+#ifndef HOST_PNG_H
+#define HOST_PNG_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// RGB565 framebuffers to and from 8-bit RGB PNG files. The 565 -> 888 expansion is exact to
+// invert, so a golden image read back compares bit for bit with the framebuffer.
+bool writePng(const std::string& path, int width, int height, const uint16_t* pixels);
+bool readPng(const std::string& path, int& width, int& height, std::vector<uint16_t>& pixels);
+
+#endif // HOST_PNG_H
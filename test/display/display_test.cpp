@@ -0,0 +1,257 @@
+// Renders every display page on the emulated panel and compares it with the golden PNGs in
+// golden/, then checks what partial redraws send over SPI.
+//
+//   display_test <golden dir> <output dir> [--update]
+//
+// The PNGs of this run land in the output directory, next to a .diff.png for every page that
+// does not match (differing pixels in red). --update rewrites the golden images instead;
+// review them before committing.
+
+#include <string>
+#include <vector>
+
+#include "DisplayRenderer.h"
+#include "Png.h"
+#include "check.h"
+
+namespace
+{
+const int WIDTH = 240;
+const int HEIGHT = 135;
+const uint32_t WINDOW = 11; // CASET + RASET + RAMWR
+
+// SPI bytes of one window with w x h pixels
+uint32_t windowBytes(uint32_t w, uint32_t h) { return WINDOW + w * h * 2; }
+
+struct Page {
+    const char* name;
+    ScreenModel model;
+};
+
+// Same content buildScreenModel() in main.cpp produces for each displayMode
+std::vector<Page> pages()
+{
+    std::vector<Page> out;
+    ScreenModel m;
+
+    m = ScreenModel();
+    m.page = 0;
+    m.wifiConnected = true;
+    m.mqttConnected = true;
+    strlcpy(m.title, "gas meter", sizeof(m.title));
+    strlcpy(m.line1, "value: 12345.67 m3", sizeof(m.line1));
+    strlcpy(m.action, "             save >", sizeof(m.action));
+    out.push_back({"standard", m});
+
+    m = ScreenModel();
+    m.page = 1;
+    m.wifiConnected = true;
+    strlcpy(m.title, "Wifi", sizeof(m.title));
+    strlcpy(m.line1, "SSID:\n HomeNetwork", sizeof(m.line1));
+    strlcpy(m.line2, "IP address:\n 192.168.178.50", sizeof(m.line2));
+    strlcpy(m.action, "reset wifi & mqtt >", sizeof(m.action));
+    out.push_back({"wifi", m});
+
+    m = ScreenModel();
+    m.page = 2;
+    m.wifiConnected = true;
+    strlcpy(m.title, "MQTT", sizeof(m.title));
+    strlcpy(m.line1, "IP :\n 192.168.178.2", sizeof(m.line1));
+    strlcpy(m.line2, "device name :\n gasmeter", sizeof(m.line2));
+    out.push_back({"mqtt", m});
+
+    m = ScreenModel();
+    m.page = 3;
+    strlcpy(m.title, "misc.", sizeof(m.title));
+    strlcpy(m.line1, "Version: 1.0.0", sizeof(m.line1));
+    strlcpy(m.action, " edit meter value >", sizeof(m.action));
+    out.push_back({"misc", m});
+
+    // meter edit with the cursor on the fourth digit
+    m = ScreenModel();
+    m.page = 4;
+    m.layout = ScreenModel::LAYOUT_EDIT;
+    strlcpy(m.editValue, "012345.67  save", sizeof(m.editValue));
+    m.cursorX = 30 + 3 * 12;
+    m.cursorWidth = 10;
+    strlcpy(m.action, "               +1 >", sizeof(m.action));
+    out.push_back({"edit", m});
+
+    m.cursorX = 30 + 8 * 12 + 36;
+    m.cursorWidth = 46;
+    strlcpy(m.action, "             save >", sizeof(m.action));
+    out.push_back({"edit_save", m});
+
+    // 24 h with a heating pattern: two peaks a day, quiet at night
+    m = ScreenModel();
+    m.page = 5;
+    m.layout = ScreenModel::LAYOUT_HISTORY;
+    m.wifiConnected = true;
+    m.mqttConnected = true;
+    strlcpy(m.title, "history", sizeof(m.title));
+    for (uint16_t i = 0; i < ConsumptionHistory::BUCKETS; i++)
+    {
+        uint16_t hour = i / 10;
+        m.history[i] = (hour >= 6 && hour < 9) ? 6 + i % 5 : (hour >= 17 && hour < 22) ? 3 + i % 3 : (i % 7 == 0);
+    }
+    m.historyHead = 1000;
+    strlcpy(m.line1, "flow: 0.42 m3/h\n24h:  6.81 m3", sizeof(m.line1));
+    strlcpy(m.action, "             save >", sizeof(m.action));
+    out.push_back({"history", m});
+    return out;
+}
+
+struct Panel {
+    TFT_eSPI tft;
+    DisplayRenderer renderer{tft};
+
+    explicit Panel(bool dma)
+    {
+        tft.init();
+        tft.setRotation(1);
+        tft.setDmaAvailable(dma);
+        renderer.begin();
+        tft.resetSpi();
+    }
+
+    // SPI bytes of one render() as the emulator counted them
+    uint64_t render(const ScreenModel& model)
+    {
+        tft.resetSpi();
+        renderer.render(model);
+        return tft.spi().bytes;
+    }
+};
+
+bool samePixels(const TFT_eSPI& a, const TFT_eSPI& b)
+{
+    return memcmp(a.framebuffer(), b.framebuffer(), WIDTH * HEIGHT * sizeof(uint16_t)) == 0;
+}
+
+// Differing pixels in red over a dimmed copy of the actual frame
+void writeDiff(const std::string& path, const uint16_t* actual, const std::vector<uint16_t>& golden)
+{
+    std::vector<uint16_t> diff(WIDTH * HEIGHT);
+    for (int i = 0; i < WIDTH * HEIGHT; i++)
+        diff[i] = actual[i] != golden[i] ? TFT_RED : (actual[i] >> 2) & 0x39E7;
+    writePng(path, WIDTH, HEIGHT, diff.data());
+}
+
+void checkGolden(const std::string& goldenDir, const std::string& outDir, bool update, bool dma)
+{
+    printf("%-10s %4s %8s %10s %10s\n", "page", "dma", "pixels", "spi_bytes", "estimate");
+    for (const Page& page : pages())
+    {
+        Panel panel(dma);
+        uint64_t bytes = panel.render(page.model);
+        const uint16_t* frame = panel.tft.framebuffer();
+        printf("%-10s %4s %8llu %10llu %10u\n", page.name, dma ? "yes" : "no",
+               (unsigned long long)panel.tft.spi().pixels, (unsigned long long)bytes, panel.renderer.lastSpiBytes());
+
+        // The renderer's own accounting (GET /api/display) must stay close to what was sent
+        double estimate = panel.renderer.lastSpiBytes();
+        CHECK(estimate > bytes * 0.95 && estimate < bytes * 1.05);
+        // A full redraw should not cost much more than two full screens
+        CHECK(bytes < 2 * windowBytes(WIDTH, HEIGHT) + windowBytes(WIDTH, HEIGHT) / 2);
+
+        std::string golden = goldenDir + "/" + page.name + ".png";
+        std::string actual = outDir + "/" + page.name + (dma ? "" : "_nodma") + ".png";
+        CHECK(writePng(actual, WIDTH, HEIGHT, frame));
+        if (update)
+        {
+            if (dma)
+                CHECK(writePng(golden, WIDTH, HEIGHT, frame));
+            continue;
+        }
+        int w = 0, h = 0;
+        std::vector<uint16_t> expected;
+        if (!readPng(golden, w, h, expected))
+        {
+            fprintf(stderr, "%s: missing or unreadable, run with --update\n", golden.c_str());
+            checkFailures++;
+            continue;
+        }
+        CHECK_EQ(w, WIDTH);
+        CHECK_EQ(h, HEIGHT);
+        if (w != WIDTH || h != HEIGHT)
+            continue;
+        int differing = 0;
+        for (int i = 0; i < WIDTH * HEIGHT; i++)
+            differing += frame[i] != expected[i];
+        if (differing)
+        {
+            std::string diff = outDir + "/" + page.name + (dma ? "" : "_nodma") + ".diff.png";
+            fprintf(stderr, "%s: %d pixels differ from %s, see %s\n", page.name, differing, golden.c_str(), diff.c_str());
+            writeDiff(diff, frame, expected);
+            checkFailures++;
+        }
+    }
+}
+
+// Partial redraws must only send the widgets that changed, and end up with the same frame
+// as a full redraw of the final model
+void checkPartialRedraws()
+{
+    std::vector<Page> all = pages();
+    const ScreenModel& standard = all[0].model;
+    const ScreenModel& history = all.back().model;
+
+    Panel panel(true);
+    panel.render(standard);
+    CHECK_EQ(panel.render(standard), 0u);
+
+    ScreenModel m = standard;
+    strlcpy(m.line1, "value: 12345.68 m3", sizeof(m.line1));
+    CHECK_EQ(panel.render(m), windowBytes(WIDTH, 47));
+
+    m.mqttConnected = false;
+    CHECK_EQ(panel.render(m), windowBytes(24, 24));
+
+    Panel fresh(true);
+    fresh.render(m);
+    CHECK(samePixels(panel.tft, fresh.tft));
+
+    // history: a pulse redraws the running column, a new bucket scrolls the graph
+    Panel graph(true);
+    graph.render(history);
+    m = history;
+    m.history[ConsumptionHistory::BUCKETS - 1]++;
+    CHECK_EQ(graph.render(m), windowBytes(WIDTH, 40));
+    memmove(m.history, m.history + 1, (ConsumptionHistory::BUCKETS - 1) * sizeof(m.history[0]));
+    m.history[ConsumptionHistory::BUCKETS - 1] = 1;
+    m.historyHead++;
+    CHECK_EQ(graph.render(m), windowBytes(WIDTH, 40));
+    Panel freshGraph(true);
+    freshGraph.render(m);
+    CHECK(samePixels(graph.tft, freshGraph.tft));
+
+    // switching pages redraws everything
+    CHECK(graph.render(standard) > windowBytes(WIDTH, HEIGHT));
+    Panel freshStandard(true);
+    freshStandard.render(standard);
+    CHECK(samePixels(graph.tft, freshStandard.tft));
+
+    // nothing reaches the panel while it sleeps, and waking redraws the view
+    Panel sleeping(true);
+    sleeping.render(standard);
+    sleeping.renderer.setPower(DisplayRenderer::POWER_OFF);
+    CHECK(sleeping.tft.sleeping());
+    sleeping.renderer.setPower(DisplayRenderer::POWER_ON);
+    CHECK(!sleeping.tft.sleeping());
+    CHECK(sleeping.render(standard) > windowBytes(WIDTH, HEIGHT));
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+    if (argc < 3)
+    {
+        fprintf(stderr, "usage: %s <golden dir> <output dir> [--update]\n", argv[0]);
+        return 2;
+    }
+    bool update = argc > 3 && strcmp(argv[3], "--update") == 0;
+    checkGolden(argv[1], argv[2], update, true);
+    checkGolden(argv[1], argv[2], update, false); // pushSprite() path, same pixels expected
+    checkPartialRedraws();
+    return checkResult("display");
+}
@@ -0,0 +1,208 @@
+#include "Arduino.h"
+#include "driver/gpio.h"
+#include "esp_timer.h"
+
+#include <time.h>
+#include <unistd.h>
+
+EspClass ESP;
+HardwareSerial Serial;
+
+namespace
+{
+uint64_t nowUs = 0;
+bool wallClock = false;
+uint64_t wallStartUs = 0;
+int pinLevels[64] = {};
+uint16_t analogValues[64] = {};
+int taskHandle; // the one "task" every caller runs in
+
+struct Interrupt {
+    void (*isr)(void*);
+    void (*plainIsr)();
+    void* arg;
+    int mode;
+};
+Interrupt interrupts[64] = {};
+
+uint64_t monotonicMicros()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+uint64_t now()
+{
+    if (wallClock)
+        nowUs = monotonicMicros() - wallStartUs;
+    return nowUs;
+}
+} // namespace
+
+namespace host
+{
+uint64_t nowMicros() { return now(); }
+void setMicros(uint64_t us) { nowUs = us; }
+void advanceMicros(uint64_t us) { nowUs += us; }
+void useWallClock()
+{
+    wallStartUs = monotonicMicros() - nowUs;
+    wallClock = true;
+}
+void setPin(uint8_t pin, int level)
+{
+    int& current = pinLevels[pin % 64];
+    level = level ? HIGH : LOW;
+    if (level == current)
+        return;
+    current = level;
+    const Interrupt& irq = interrupts[pin % 64];
+    if (irq.mode == CHANGE || (irq.mode == RISING && level == HIGH) || (irq.mode == FALLING && level == LOW))
+    {
+        if (irq.isr)
+            irq.isr(irq.arg);
+        else if (irq.plainIsr)
+            irq.plainIsr();
+    }
+}
+void setAnalog(uint8_t pin, uint16_t value) { analogValues[pin % 64] = value; }
+} // namespace host
+
+// Like on the ESP32, both counters are 32 bits wide and wrap
+unsigned long millis() { return static_cast<uint32_t>(now() / 1000); }
+unsigned long micros() { return static_cast<uint32_t>(now()); }
+void delay(uint32_t ms) { delayMicroseconds(ms * 1000); }
+void delayMicroseconds(uint32_t us)
+{
+    if (wallClock)
+        usleep(us);
+    else
+        nowUs += us;
+}
+void yield() {}
+uint32_t getCpuFrequencyMhz() { return 240; }
+
+void pinMode(uint8_t, uint8_t) {}
+void digitalWrite(uint8_t pin, uint8_t value) { pinLevels[pin % 64] = value; }
+int digitalRead(uint8_t pin) { return pinLevels[pin % 64]; }
+uint16_t analogRead(uint8_t pin) { return analogValues[pin % 64]; }
+void attachInterrupt(uint8_t pin, void (*isr)(), int mode) { interrupts[pin % 64] = {nullptr, isr, nullptr, mode}; }
+void attachInterruptArg(uint8_t pin, void (*isr)(void*), void* arg, int mode)
+{
+    interrupts[pin % 64] = {isr, nullptr, arg, mode};
+}
+void detachInterrupt(uint8_t pin) { interrupts[pin % 64] = {}; }
+int gpio_get_level(gpio_num_t pin) { return pinLevels[pin % 64]; }
+int64_t esp_timer_get_time() { return static_cast<int64_t>(now()); }
+
+#if !defined(__GLIBC__) || !__GLIBC_PREREQ(2, 38)
+size_t strlcpy(char* dst, const char* src, size_t size)
+{
+    size_t len = strlen(src);
+    if (size > 0)
+    {
+        size_t n = len < size - 1 ? len : size - 1;
+        memcpy(dst, src, n);
+        dst[n] = '\0';
+    }
+    return len;
+}
+#endif
+
+uint32_t EspClass::getCycleCount() { return static_cast<uint32_t>(now() * getCpuFrequencyMhz()); }
+uint32_t EspClass::getFreeHeap() { return 200 * 1024; }
+uint32_t EspClass::getMinFreeHeap() { return 200 * 1024; }
+uint32_t EspClass::getMaxAllocHeap() { return 100 * 1024; }
+void EspClass::restart() { abort(); }
+
+size_t HardwareSerial::write(uint8_t c) { return ::write(STDOUT_FILENO, &c, 1) == 1 ? 1 : 0; }
+size_t HardwareSerial::write(const uint8_t* buf, size_t len)
+{
+    ssize_t n = ::write(STDOUT_FILENO, buf, len);
+    return n > 0 ? static_cast<size_t>(n) : 0;
+}
+
+size_t Print::write(const uint8_t* buf, size_t len)
+{
+    size_t n = 0;
+    while (len--)
+        n += write(*buf++);
+    return n;
+}
+
+size_t Print::write(const char* s) { return s ? write(reinterpret_cast<const uint8_t*>(s), strlen(s)) : 0; }
+size_t Print::print(const String& s) { return write(s.c_str(), s.length()); }
+
+size_t Print::print(long v)
+{
+    char buf[24];
+    snprintf(buf, sizeof(buf), "%ld", v);
+    return write(buf);
+}
+
+size_t Print::print(unsigned long v)
+{
+    char buf[24];
+    snprintf(buf, sizeof(buf), "%lu", v);
+    return write(buf);
+}
+
+size_t Print::print(double v, int digits)
+{
+    char buf[48];
+    snprintf(buf, sizeof(buf), "%.*f", digits, v);
+    return write(buf);
+}
+
+size_t Print::printf(const char* fmt, ...)
+{
+    char buf[512];
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    if (n < 0)
+        return 0;
+    return write(reinterpret_cast<const uint8_t*>(buf), std::min<size_t>(n, sizeof(buf) - 1));
+}
+
+size_t Stream::readBytes(char* buf, size_t len)
+{
+    size_t n = 0;
+    while (n < len)
+    {
+        int c = read();
+        if (c < 0)
+            break;
+        buf[n++] = static_cast<char>(c);
+    }
+    return n;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() { return &taskHandle; }
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t, const char*, uint32_t, void*, UBaseType_t, TaskHandle_t* handle,
+                                   BaseType_t)
+{
+    if (handle)
+        *handle = nullptr; // never started; tests call what the task would do themselves
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char* name, uint32_t stack, void* arg, UBaseType_t priority,
+                       TaskHandle_t* handle)
+{
+    return xTaskCreatePinnedToCore(fn, name, stack, arg, priority, handle, 0);
+}
+
+void vTaskDelete(TaskHandle_t) {}
+void vTaskDelay(TickType_t ticks) { delay(ticks * portTICK_PERIOD_MS); }
+TickType_t xTaskGetTickCount() { return static_cast<TickType_t>(now() / 1000 / portTICK_PERIOD_MS); }
+void xTaskNotifyGive(TaskHandle_t) {}
+uint32_t ulTaskNotifyTake(BaseType_t, TickType_t) { return 0; }
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t) { return 0; }
+
+SemaphoreHandle_t xSemaphoreCreateMutex() { return &taskHandle; }
+BaseType_t xSemaphoreTake(SemaphoreHandle_t, TickType_t) { return pdTRUE; }
+BaseType_t xSemaphoreGive(SemaphoreHandle_t) { return pdTRUE; }
@@ -0,0 +1,102 @@
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+// The part of the Arduino-ESP32 core the firmware modules use, for building them on the host.
+// Time comes from a virtual clock that only moves when a test advances it, so runs are
+// deterministic; benchmarks against real sockets switch to the wall clock. There is one thread:
+// critical sections and task notifications are no-ops.
+
+#include <math.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <algorithm>
+
+#include "esp_attr.h"
+#include "esp_timer.h" // esp32-hal.h pulls it in on the ESP32
+#include "freertos/FreeRTOS.h"
+#include "Print.h"
+#include "WString.h"
+
+#define PROGMEM
+#define pgm_read_byte(addr) (*(const uint8_t*)(addr))
+#define pgm_read_word(addr) (*(const uint16_t*)(addr))
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+#define RISING 0x01
+#define FALLING 0x02
+#define CHANGE 0x03
+
+using std::max;
+using std::min;
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#ifndef constrain
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+#endif
+
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void yield();
+uint32_t getCpuFrequencyMhz();
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+uint16_t analogRead(uint8_t pin);
+void attachInterrupt(uint8_t pin, void (*isr)(), int mode);
+void attachInterruptArg(uint8_t pin, void (*isr)(void*), void* arg, int mode);
+void detachInterrupt(uint8_t pin);
+
+#if !defined(__GLIBC__) || !__GLIBC_PREREQ(2, 38)
+size_t strlcpy(char* dst, const char* src, size_t size);
+#endif
+
+class EspClass {
+public:
+    uint32_t getCycleCount();
+    uint32_t getFreeHeap();
+    uint32_t getMinFreeHeap();
+    uint32_t getMaxAllocHeap();
+    void restart();
+};
+extern EspClass ESP;
+
+class HardwareSerial : public Stream {
+public:
+    void begin(unsigned long) {}
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* buf, size_t len) override;
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+};
+extern HardwareSerial Serial;
+
+// Virtual time and simulated inputs, driven by the tests. setPin() runs an attached interrupt
+// handler right away when the level change matches its mode.
+namespace host
+{
+uint64_t nowMicros();
+void setMicros(uint64_t us);
+void advanceMicros(uint64_t us);
+inline void advanceMillis(uint64_t ms) { advanceMicros(ms * 1000); }
+// From now on the clock follows CLOCK_MONOTONIC and delay() sleeps
+void useWallClock();
+void setPin(uint8_t pin, int level);
+void setAnalog(uint8_t pin, uint16_t value);
+} // namespace host
+
+#endif // HOST_ARDUINO_H
@@ -0,0 +1,820 @@
+#include "ArduinoJson.h"
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace hostjson
+{
+void Node::reset()
+{
+    type = NUL;
+    boolean = false;
+    float32 = false;
+    strCopied = false;
+    sint = 0;
+    uint = 0;
+    real = 0;
+    str.clear();
+    members.clear();
+    elements.clear();
+}
+
+Node* Node::find(const char* key) const
+{
+    if (type != OBJECT || key == nullptr)
+        return nullptr;
+    for (const auto& m : members)
+    {
+        if (m.first == key)
+            return m.second.get();
+    }
+    return nullptr;
+}
+
+Node* Node::addMember(const char* key, bool copyKey)
+{
+    if (type != OBJECT && !makeObject())
+        return nullptr;
+    if (!pool->reserve(SLOT_SIZE + (copyKey ? strlen(key) + 1 : 0)))
+        return nullptr;
+    members.emplace_back(key, std::unique_ptr<Node>(new Node(pool)));
+    members.back().second->keyCopied = copyKey;
+    return members.back().second.get();
+}
+
+Node* Node::addElement()
+{
+    if (type != ARRAY && !makeArray())
+        return nullptr;
+    if (!pool->reserve(SLOT_SIZE))
+        return nullptr;
+    elements.emplace_back(new Node(pool));
+    return elements.back().get();
+}
+
+bool Node::makeObject()
+{
+    if (type == OBJECT)
+        return true;
+    reset();
+    type = OBJECT;
+    return true;
+}
+
+bool Node::makeArray()
+{
+    if (type == ARRAY)
+        return true;
+    reset();
+    type = ARRAY;
+    return true;
+}
+
+bool Node::setString(const char* s, bool copy)
+{
+    reset();
+    if (s == nullptr)
+        return true; // null, like ArduinoJson
+    size_t len = strlen(s);
+    if (copy && !pool->reserve(len + 1))
+        return false;
+    type = STRING;
+    str.assign(s, len);
+    strCopied = copy;
+    return true;
+}
+
+void Node::copyFrom(const Node* other)
+{
+    reset();
+    if (other == nullptr)
+        return;
+    switch (other->type)
+    {
+    case STRING:
+        setString(other->str.c_str(), other->strCopied);
+        return;
+    case OBJECT:
+        makeObject();
+        for (const auto& m : other->members)
+        {
+            Node* child = addMember(m.first.c_str(), m.second->keyCopied);
+            if (child == nullptr)
+                return;
+            child->copyFrom(m.second.get());
+        }
+        return;
+    case ARRAY:
+        makeArray();
+        for (const auto& e : other->elements)
+        {
+            Node* child = addElement();
+            if (child == nullptr)
+                return;
+            child->copyFrom(e.get());
+        }
+        return;
+    default:
+        type = other->type;
+        boolean = other->boolean;
+        float32 = other->float32;
+        sint = other->sint;
+        uint = other->uint;
+        real = other->real;
+    }
+}
+
+String Converter<String>::as(const Node* n)
+{
+    if (n != nullptr && n->type == Node::STRING)
+        return String(n->str);
+    std::string out;
+    serializeJson(JsonVariantConst(n), out);
+    return String(out);
+}
+
+void store(Node* n, bool value)
+{
+    n->reset();
+    n->type = Node::BOOL;
+    n->boolean = value;
+}
+
+void store(Node* n, double value, bool float32)
+{
+    n->reset();
+    n->type = Node::FLOAT;
+    n->real = value;
+    n->float32 = float32;
+}
+
+void store(Node* n, const char* value, bool copy) { n->setString(value, copy); }
+void store(Node* n, const Node* value)
+{
+    if (value != n)
+        n->copyFrom(value);
+}
+void store(Node* n, const JsonVariantConst& value) { store(n, value.node()); }
+void store(Node* n, const JsonVariant& value) { store(n, value.get()); }
+void store(Node* n, const JsonObjectConst& value) { store(n, value.node()); }
+void store(Node* n, const JsonObject& value) { store(n, static_cast<const Node*>(value.node())); }
+void store(Node* n, const JsonArrayConst& value) { store(n, value.node()); }
+void store(Node* n, const JsonArray& value) { store(n, static_cast<const Node*>(value.node())); }
+void store(Node* n, const JsonDocument& value) { store(n, value.root()); }
+
+namespace
+{
+// Shortest text that reads back as the same value
+void formatNumber(const Node* n, char* buf, size_t size)
+{
+    if (n->type == Node::INT)
+    {
+        snprintf(buf, size, "%lld", static_cast<long long>(n->sint));
+        return;
+    }
+    if (n->type == Node::UINT)
+    {
+        snprintf(buf, size, "%llu", static_cast<unsigned long long>(n->uint));
+        return;
+    }
+    if (isnan(n->real) || isinf(n->real))
+    {
+        snprintf(buf, size, "null");
+        return;
+    }
+    int maxDigits = n->float32 ? 9 : 17;
+    for (int digits = 1; digits <= maxDigits; digits++)
+    {
+        snprintf(buf, size, "%.*g", digits, n->real);
+        if (n->float32 ? strtof(buf, nullptr) == static_cast<float>(n->real) : strtod(buf, nullptr) == n->real)
+            break;
+    }
+    // 1e+07 -> 1e7, like ArduinoJson
+    char* e = strchr(buf, 'e');
+    if (e != nullptr)
+    {
+        char* p = e + 1;
+        if (*p == '+')
+            memmove(p, p + 1, strlen(p));
+        if (*p == '-')
+            p++;
+        while (*p == '0' && p[1] != '\0')
+            memmove(p, p + 1, strlen(p));
+    }
+}
+
+void writeString(const std::string& s, Writer& out)
+{
+    out.write("\"", 1);
+    size_t start = 0;
+    for (size_t i = 0; i < s.size(); i++)
+    {
+        const char* esc = nullptr;
+        switch (s[i])
+        {
+        case '"': esc = "\\\""; break;
+        case '\\': esc = "\\\\"; break;
+        case '\b': esc = "\\b"; break;
+        case '\f': esc = "\\f"; break;
+        case '\n': esc = "\\n"; break;
+        case '\r': esc = "\\r"; break;
+        case '\t': esc = "\\t"; break;
+        default: continue;
+        }
+        out.write(s.data() + start, i - start);
+        out.write(esc, 2);
+        start = i + 1;
+    }
+    out.write(s.data() + start, s.size() - start);
+    out.write("\"", 1);
+}
+
+struct CountingWriter : Writer {
+    explicit CountingWriter(Writer& w) : inner(w) {}
+    void write(const char* s, size_t len) override
+    {
+        inner.write(s, len);
+        count += len;
+    }
+    Writer& inner;
+    size_t count = 0;
+};
+
+void indent(Writer& out, int depth)
+{
+    out.write("\n", 1);
+    for (int i = 0; i < depth; i++)
+        out.write("  ", 2);
+}
+
+void write(const Node* n, Writer& out, bool pretty, int depth)
+{
+    if (n == nullptr)
+    {
+        out.write("null", 4);
+        return;
+    }
+    switch (n->type)
+    {
+    case Node::NUL: out.write("null", 4); return;
+    case Node::BOOL: n->boolean ? out.write("true", 4) : out.write("false", 5); return;
+    case Node::STRING: writeString(n->str, out); return;
+    case Node::OBJECT:
+        out.write("{", 1);
+        for (size_t i = 0; i < n->members.size(); i++)
+        {
+            if (i > 0)
+                out.write(",", 1);
+            if (pretty)
+                indent(out, depth + 1);
+            writeString(n->members[i].first, out);
+            out.write(pretty ? ": " : ":", pretty ? 2 : 1);
+            write(n->members[i].second.get(), out, pretty, depth + 1);
+        }
+        if (pretty && !n->members.empty())
+            indent(out, depth);
+        out.write("}", 1);
+        return;
+    case Node::ARRAY:
+        out.write("[", 1);
+        for (size_t i = 0; i < n->elements.size(); i++)
+        {
+            if (i > 0)
+                out.write(",", 1);
+            if (pretty)
+                indent(out, depth + 1);
+            write(n->elements[i].get(), out, pretty, depth + 1);
+        }
+        if (pretty && !n->elements.empty())
+            indent(out, depth);
+        out.write("]", 1);
+        return;
+    default:
+    {
+        char buf[40];
+        formatNumber(n, buf, sizeof(buf));
+        out.write(buf, strlen(buf));
+    }
+    }
+}
+} // namespace
+
+size_t serialize(const Node* n, Writer& out, bool pretty)
+{
+    CountingWriter counter(out);
+    write(n, counter, pretty, 0);
+    return counter.count;
+}
+
+namespace
+{
+class Parser {
+public:
+    explicit Parser(Reader& in) : _in(in) {}
+
+    DeserializationError::Code parse(Node* root)
+    {
+        skipSpace();
+        if (_in.peek() < 0)
+            return DeserializationError::EmptyInput;
+        return value(root, 0);
+    }
+
+private:
+    void skipSpace()
+    {
+        while (_in.peek() == ' ' || _in.peek() == '\t' || _in.peek() == '\n' || _in.peek() == '\r')
+            _in.next();
+    }
+
+    DeserializationError::Code value(Node* n, int depth)
+    {
+        skipSpace();
+        int c = _in.peek();
+        if (c < 0)
+            return DeserializationError::IncompleteInput;
+        if (c == '{' || c == '[')
+        {
+            if (depth >= NESTING_LIMIT)
+                return DeserializationError::TooDeep;
+            return c == '{' ? object(n, depth) : array(n, depth);
+        }
+        if (c == '"')
+        {
+            std::string s;
+            DeserializationError::Code err = string(s);
+            if (err != DeserializationError::Ok)
+                return err;
+            return n->setString(s.c_str(), true) ? DeserializationError::Ok : DeserializationError::NoMemory;
+        }
+        if (c == '-' || (c >= '0' && c <= '9'))
+            return number(n);
+        return literal(n);
+    }
+
+    DeserializationError::Code object(Node* n, int depth)
+    {
+        _in.next();
+        n->makeObject();
+        skipSpace();
+        if (_in.peek() == '}')
+        {
+            _in.next();
+            return DeserializationError::Ok;
+        }
+        for (;;)
+        {
+            skipSpace();
+            if (_in.peek() < 0)
+                return DeserializationError::IncompleteInput;
+            if (_in.peek() != '"')
+                return DeserializationError::InvalidInput;
+            std::string key;
+            DeserializationError::Code err = string(key);
+            if (err != DeserializationError::Ok)
+                return err;
+            skipSpace();
+            int c = _in.next();
+            if (c < 0)
+                return DeserializationError::IncompleteInput;
+            if (c != ':')
+                return DeserializationError::InvalidInput;
+            // a repeated key replaces the earlier value
+            Node* child = n->find(key.c_str());
+            if (child == nullptr)
+                child = n->addMember(key.c_str(), true);
+            if (child == nullptr)
+                return DeserializationError::NoMemory;
+            err = value(child, depth + 1);
+            if (err != DeserializationError::Ok)
+                return err;
+            skipSpace();
+            c = _in.next();
+            if (c == '}')
+                return DeserializationError::Ok;
+            if (c < 0)
+                return DeserializationError::IncompleteInput;
+            if (c != ',')
+                return DeserializationError::InvalidInput;
+        }
+    }
+
+    DeserializationError::Code array(Node* n, int depth)
+    {
+        _in.next();
+        n->makeArray();
+        skipSpace();
+        if (_in.peek() == ']')
+        {
+            _in.next();
+            return DeserializationError::Ok;
+        }
+        for (;;)
+        {
+            Node* child = n->addElement();
+            if (child == nullptr)
+                return DeserializationError::NoMemory;
+            DeserializationError::Code err = value(child, depth + 1);
+            if (err != DeserializationError::Ok)
+                return err;
+            skipSpace();
+            int c = _in.next();
+            if (c == ']')
+                return DeserializationError::Ok;
+            if (c < 0)
+                return DeserializationError::IncompleteInput;
+            if (c != ',')
+                return DeserializationError::InvalidInput;
+        }
+    }
+
+    static void appendUtf8(std::string& s, uint32_t cp)
+    {
+        if (cp < 0x80)
+        {
+            s += static_cast<char>(cp);
+        }
+        else if (cp < 0x800)
+        {
+            s += static_cast<char>(0xC0 | (cp >> 6));
+            s += static_cast<char>(0x80 | (cp & 0x3F));
+        }
+        else if (cp < 0x10000)
+        {
+            s += static_cast<char>(0xE0 | (cp >> 12));
+            s += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            s += static_cast<char>(0x80 | (cp & 0x3F));
+        }
+        else
+        {
+            s += static_cast<char>(0xF0 | (cp >> 18));
+            s += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+            s += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            s += static_cast<char>(0x80 | (cp & 0x3F));
+        }
+    }
+
+    DeserializationError::Code hex4(uint32_t& out)
+    {
+        out = 0;
+        for (int i = 0; i < 4; i++)
+        {
+            int c = _in.next();
+            if (c < 0)
+                return DeserializationError::IncompleteInput;
+            out <<= 4;
+            if (c >= '0' && c <= '9')
+                out |= c - '0';
+            else if (c >= 'a' && c <= 'f')
+                out |= c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F')
+                out |= c - 'A' + 10;
+            else
+                return DeserializationError::InvalidInput;
+        }
+        return DeserializationError::Ok;
+    }
+
+    DeserializationError::Code string(std::string& s)
+    {
+        _in.next(); // opening quote
+        for (;;)
+        {
+            int c = _in.next();
+            if (c < 0)
+                return DeserializationError::IncompleteInput;
+            if (c == '"')
+                return DeserializationError::Ok;
+            if (c != '\\')
+            {
+                s += static_cast<char>(c);
+                continue;
+            }
+            c = _in.next();
+            switch (c)
+            {
+            case '"': s += '"'; break;
+            case '\\': s += '\\'; break;
+            case '/': s += '/'; break;
+            case 'b': s += '\b'; break;
+            case 'f': s += '\f'; break;
+            case 'n': s += '\n'; break;
+            case 'r': s += '\r'; break;
+            case 't': s += '\t'; break;
+            case 'u':
+            {
+                uint32_t cp;
+                DeserializationError::Code err = hex4(cp);
+                if (err != DeserializationError::Ok)
+                    return err;
+                if (cp >= 0xD800 && cp < 0xDC00 && _in.peek() == '\\')
+                {
+                    _in.next();
+                    if (_in.next() != 'u')
+                        return DeserializationError::InvalidInput;
+                    uint32_t low;
+                    err = hex4(low);
+                    if (err != DeserializationError::Ok)
+                        return err;
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                }
+                appendUtf8(s, cp);
+                break;
+            }
+            case -1: return DeserializationError::IncompleteInput;
+            default: return DeserializationError::InvalidInput;
+            }
+        }
+    }
+
+    DeserializationError::Code number(Node* n)
+    {
+        std::string text;
+        bool isFloat = false;
+        for (;;)
+        {
+            int c = _in.peek();
+            if ((c >= '0' && c <= '9') || c == '-' || c == '+')
+            {
+            }
+            else if (c == '.' || c == 'e' || c == 'E')
+            {
+                isFloat = true;
+            }
+            else
+            {
+                break;
+            }
+            text += static_cast<char>(_in.next());
+        }
+        char* end = nullptr;
+        errno = 0;
+        if (!isFloat)
+        {
+            if (text[0] == '-')
+            {
+                long long v = strtoll(text.c_str(), &end, 10);
+                if (*end == '\0' && errno == 0)
+                {
+                    store(n, static_cast<int64_t>(v));
+                    return DeserializationError::Ok;
+                }
+            }
+            else
+            {
+                unsigned long long v = strtoull(text.c_str(), &end, 10);
+                if (*end == '\0' && errno == 0)
+                {
+                    store(n, static_cast<uint64_t>(v));
+                    return DeserializationError::Ok;
+                }
+            }
+            errno = 0;
+        }
+        double v = strtod(text.c_str(), &end);
+        if (*end != '\0' || text.empty() || text == "-")
+            return _in.peek() < 0 ? DeserializationError::IncompleteInput : DeserializationError::InvalidInput;
+        store(n, v, false);
+        return DeserializationError::Ok;
+    }
+
+    DeserializationError::Code literal(Node* n)
+    {
+        static const char* const WORDS[] = {"true", "false", "null"};
+        int first = _in.peek();
+        for (uint8_t w = 0; w < 3; w++)
+        {
+            if (first != WORDS[w][0])
+                continue;
+            for (const char* p = WORDS[w]; *p; p++)
+            {
+                int c = _in.next();
+                if (c < 0)
+                    return DeserializationError::IncompleteInput;
+                if (c != *p)
+                    return DeserializationError::InvalidInput;
+            }
+            if (w == 2)
+                n->reset();
+            else
+                store(n, w == 0);
+            return DeserializationError::Ok;
+        }
+        return DeserializationError::InvalidInput;
+    }
+
+    Reader& _in;
+};
+
+struct BufferReader : Reader {
+    BufferReader(const char* p, const char* e) : pos(p), end(e) {}
+    int peek() override { return pos < end ? static_cast<uint8_t>(*pos) : -1; }
+    int next() override { return pos < end ? static_cast<uint8_t>(*pos++) : -1; }
+    const char* pos;
+    const char* end;
+};
+
+struct StreamReader : Reader {
+    explicit StreamReader(Stream& s) : stream(s) {}
+    int peek() override { return stream.peek(); }
+    int next() override { return stream.read(); }
+    Stream& stream;
+};
+
+struct PrintWriter : Writer {
+    explicit PrintWriter(Print& p) : out(p) {}
+    void write(const char* s, size_t len) override { out.write(s, len); }
+    Print& out;
+};
+
+struct StringWriter : Writer {
+    explicit StringWriter(std::string& s) : out(s) {}
+    void write(const char* s, size_t len) override { out.append(s, len); }
+    std::string& out;
+};
+
+struct NullWriter : Writer {
+    void write(const char*, size_t) override {}
+};
+
+DeserializationError parseInto(JsonDocument& doc, Reader& in)
+{
+    doc.clear();
+    DeserializationError::Code err = Parser(in).parse(doc.root());
+    if (err != DeserializationError::Ok)
+        doc.clear();
+    return DeserializationError(err);
+}
+} // namespace
+} // namespace hostjson
+
+using namespace hostjson;
+
+const char* DeserializationError::c_str() const
+{
+    static const char* const NAMES[] = {"Ok", "EmptyInput", "IncompleteInput", "InvalidInput", "NoMemory", "TooDeep"};
+    return NAMES[_code];
+}
+
+Node* JsonVariant::getOrCreate()
+{
+    if (!_member)
+        return _node;
+    if (_parent == nullptr)
+        return nullptr;
+    Node* n = _parent->find(_key.c_str());
+    if (n != nullptr)
+        return n;
+    if (_parent->type != Node::OBJECT && _parent->type != Node::NUL)
+        return nullptr;
+    return _parent->addMember(_key.c_str(), _copyKey);
+}
+
+JsonVariant JsonVariant::operator[](const char* key)
+{
+    Node* n = getOrCreate();
+    if (n != nullptr && n->type == Node::NUL)
+        n->makeObject();
+    return JsonVariant(n != nullptr && n->type == Node::OBJECT ? n : nullptr, key, false);
+}
+
+JsonVariant JsonVariant::operator[](const String& key)
+{
+    Node* n = getOrCreate();
+    if (n != nullptr && n->type == Node::NUL)
+        n->makeObject();
+    return JsonVariant(n != nullptr && n->type == Node::OBJECT ? n : nullptr, key.c_str(), true);
+}
+
+JsonObject JsonVariant::createNestedObject(const char* key) { return (*this)[key].to<JsonObject>(); }
+JsonArray JsonVariant::createNestedArray(const char* key) { return (*this)[key].to<JsonArray>(); }
+
+JsonObject JsonVariant::createNestedObject()
+{
+    Node* n = getOrCreate();
+    if (n == nullptr || (n->type != Node::ARRAY && !(n->type == Node::NUL && n->makeArray())))
+        return JsonObject();
+    return JsonArray(n).createNestedObject();
+}
+
+JsonArray JsonVariant::createNestedArray()
+{
+    Node* n = getOrCreate();
+    if (n == nullptr || (n->type != Node::ARRAY && !(n->type == Node::NUL && n->makeArray())))
+        return JsonArray();
+    return JsonArray(n).createNestedArray();
+}
+
+void JsonObject::remove(const char* key)
+{
+    if (_node == nullptr)
+        return;
+    for (auto it = _node->members.begin(); it != _node->members.end(); ++it)
+    {
+        if (it->first == key)
+        {
+            _node->members.erase(it); // the pool does not get the memory back, as in ArduinoJson
+            return;
+        }
+    }
+}
+
+JsonArray JsonObject::createNestedArray(const char* key) const { return (*this)[key].to<JsonArray>(); }
+JsonArray JsonObject::createNestedArray(const String& key) const { return (*this)[key].to<JsonArray>(); }
+
+bool JsonObject::set(JsonObjectConst other) const
+{
+    if (_node == nullptr)
+        return false;
+    _node->copyFrom(other.node());
+    _node->makeObject();
+    return !_node->pool->overflowed;
+}
+
+JsonArray JsonArray::createNestedArray() const { return add().to<JsonArray>(); }
+
+size_t serializeJson(JsonVariantConst source, Print& out)
+{
+    PrintWriter w(out);
+    return serialize(source.node(), w, false);
+}
+
+size_t serializeJson(JsonVariantConst source, std::string& out)
+{
+    out.clear();
+    StringWriter w(out);
+    return serialize(source.node(), w, false);
+}
+
+size_t serializeJson(JsonVariantConst source, String& out)
+{
+    std::string s;
+    size_t n = serializeJson(source, s);
+    out = String(s);
+    return n;
+}
+
+size_t serializeJson(JsonVariantConst source, char* buf, size_t size)
+{
+    std::string s;
+    serializeJson(source, s);
+    if (size == 0)
+        return 0;
+    size_t n = s.size() < size - 1 ? s.size() : size - 1;
+    memcpy(buf, s.data(), n);
+    buf[n] = '\0';
+    return n;
+}
+
+size_t serializeJsonPretty(JsonVariantConst source, Print& out)
+{
+    PrintWriter w(out);
+    return serialize(source.node(), w, true);
+}
+
+size_t serializeJsonPretty(JsonVariantConst source, String& out)
+{
+    std::string s;
+    StringWriter w(s);
+    size_t n = serialize(source.node(), w, true);
+    out = String(s);
+    return n;
+}
+
+size_t measureJson(JsonVariantConst source)
+{
+    NullWriter w;
+    return serialize(source.node(), w, false);
+}
+
+DeserializationError deserializeJson(JsonDocument& doc, const char* input)
+{
+    if (input == nullptr)
+        return deserializeJson(doc, "", 0);
+    return deserializeJson(doc, input, strlen(input));
+}
+
+DeserializationError deserializeJson(JsonDocument& doc, const char* input, size_t len)
+{
+    BufferReader r(input, input + len);
+    return parseInto(doc, r);
+}
+
+DeserializationError deserializeJson(JsonDocument& doc, const String& input)
+{
+    return deserializeJson(doc, input.c_str(), input.length());
+}
+
+DeserializationError deserializeJson(JsonDocument& doc, const std::string& input)
+{
+    return deserializeJson(doc, input.data(), input.size());
+}
+
+DeserializationError deserializeJson(JsonDocument& doc, Stream& input)
+{
+    StreamReader r(input);
+    return parseInto(doc, r);
+}
@@ -0,0 +1,903 @@
+#ifndef HOST_ARDUINOJSON_H
+#define HOST_ARDUINOJSON_H
+
+// The part of ArduinoJson 6 the firmware modules use, for host builds without the library.
+// Values live in a tree of nodes instead of ArduinoJson's memory pool, but a document still has a
+// fixed capacity that is charged like on the ESP32 (16 bytes per value, copied strings with their
+// terminator, const char* values and keys for free). Writes past the capacity are dropped and
+// overflowed() is set, deserializeJson() reports NoMemory: a document sized too small fails here
+// too. Float output is the shortest text that reads back the same, so it can differ from the
+// device in the last digits.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <limits>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "Print.h"
+#include "WString.h"
+
+class JsonVariant;
+class JsonVariantConst;
+class JsonObject;
+class JsonObjectConst;
+class JsonArray;
+class JsonArrayConst;
+class JsonDocument;
+
+namespace hostjson
+{
+const size_t SLOT_SIZE = 16; // sizeof(VariantSlot) on the ESP32
+const uint8_t NESTING_LIMIT = 10;
+
+struct Pool {
+    size_t capacity = 0;
+    size_t used = 0;
+    bool overflowed = false;
+
+    bool reserve(size_t bytes)
+    {
+        if (used + bytes > capacity)
+        {
+            overflowed = true;
+            return false;
+        }
+        used += bytes;
+        return true;
+    }
+};
+
+struct Node {
+    enum Type : uint8_t { NUL, BOOL, INT, UINT, FLOAT, STRING, OBJECT, ARRAY };
+
+    explicit Node(Pool* p) : pool(p) {}
+
+    Pool* pool;
+    Type type = NUL;
+    bool keyCopied = false; // member key charged to the pool
+    bool strCopied = false; // string value charged to the pool
+    bool boolean = false;
+    bool float32 = false; // assigned from a float; printed with float precision
+    int64_t sint = 0;
+    uint64_t uint = 0;
+    double real = 0;
+    std::string str;
+    std::vector<std::pair<std::string, std::unique_ptr<Node>>> members;
+    std::vector<std::unique_ptr<Node>> elements;
+
+    void reset();
+    Node* find(const char* key) const;
+    // New member or element; nullptr once the pool is full
+    Node* addMember(const char* key, bool copyKey);
+    Node* addElement();
+    bool makeObject();
+    bool makeArray();
+    bool setString(const char* s, bool copy);
+    void copyFrom(const Node* other); // deep copy, charged to this node's pool
+    size_t size() const { return type == OBJECT ? members.size() : type == ARRAY ? elements.size() : 0; }
+    bool isNumber() const { return type == INT || type == UINT || type == FLOAT; }
+};
+
+// Read conversions, shared by all the variant types
+template <typename T, typename Enable = void>
+struct Converter;
+
+template <typename T>
+struct Converter<T, typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value>::type> {
+    static bool is(const Node* n)
+    {
+        if (n == nullptr)
+            return false;
+        if (n->type == Node::INT)
+            return n->sint >= static_cast<int64_t>(std::numeric_limits<T>::min()) &&
+                   (n->sint < 0 || static_cast<uint64_t>(n->sint) <= static_cast<uint64_t>(std::numeric_limits<T>::max()));
+        if (n->type == Node::UINT)
+            return n->uint <= static_cast<uint64_t>(std::numeric_limits<T>::max());
+        return false;
+    }
+    static T as(const Node* n)
+    {
+        if (n == nullptr)
+            return 0;
+        if (is(n))
+            return n->type == Node::INT ? static_cast<T>(n->sint) : static_cast<T>(n->uint);
+        if (n->type == Node::FLOAT && n->real >= static_cast<double>(std::numeric_limits<T>::min()) &&
+            n->real <= static_cast<double>(std::numeric_limits<T>::max()))
+            return static_cast<T>(n->real);
+        if (n->type == Node::BOOL)
+            return n->boolean ? 1 : 0;
+        return 0;
+    }
+};
+
+template <typename T>
+struct Converter<T, typename std::enable_if<std::is_floating_point<T>::value>::type> {
+    static bool is(const Node* n) { return n != nullptr && n->isNumber(); }
+    static T as(const Node* n)
+    {
+        if (n == nullptr)
+            return 0;
+        switch (n->type)
+        {
+        case Node::INT: return static_cast<T>(n->sint);
+        case Node::UINT: return static_cast<T>(n->uint);
+        case Node::FLOAT: return static_cast<T>(n->real);
+        case Node::BOOL: return n->boolean ? 1 : 0;
+        default: return 0;
+        }
+    }
+};
+
+template <>
+struct Converter<bool> {
+    static bool is(const Node* n) { return n != nullptr && n->type == Node::BOOL; }
+    static bool as(const Node* n)
+    {
+        if (n == nullptr)
+            return false;
+        switch (n->type)
+        {
+        case Node::BOOL: return n->boolean;
+        case Node::INT: return n->sint != 0;
+        case Node::UINT: return n->uint != 0;
+        case Node::FLOAT: return n->real != 0;
+        default: return false;
+        }
+    }
+};
+
+template <>
+struct Converter<const char*> {
+    static bool is(const Node* n) { return n != nullptr && n->type == Node::STRING; }
+    static const char* as(const Node* n) { return is(n) ? n->str.c_str() : nullptr; }
+};
+
+template <>
+struct Converter<String> {
+    static bool is(const Node* n) { return n != nullptr && n->type == Node::STRING; }
+    static String as(const Node* n);
+};
+
+template <typename T>
+struct IsScalar
+    : std::integral_constant<bool, std::is_arithmetic<T>::value || std::is_same<T, const char*>::value ||
+                                       std::is_same<T, String>::value> {};
+
+template <typename T>
+struct IsSignedInt : std::integral_constant<bool, std::is_integral<T>::value && std::is_signed<T>::value &&
+                                                      !std::is_same<T, bool>::value> {};
+template <typename T>
+struct IsUnsignedInt : std::integral_constant<bool, std::is_integral<T>::value && std::is_unsigned<T>::value &&
+                                                        !std::is_same<T, bool>::value> {};
+
+// Write side: stores a value in a node that already exists
+void store(Node* n, bool value);
+void store(Node* n, double value, bool float32);
+void store(Node* n, const char* value, bool copy);
+void store(Node* n, const Node* value);
+template <typename T>
+typename std::enable_if<IsSignedInt<T>::value>::type store(Node* n, T value)
+{
+    n->reset();
+    n->type = Node::INT;
+    n->sint = value;
+}
+template <typename T>
+typename std::enable_if<IsUnsignedInt<T>::value>::type store(Node* n, T value)
+{
+    n->reset();
+    n->type = Node::UINT;
+    n->uint = value;
+}
+inline void store(Node* n, float value) { store(n, static_cast<double>(value), true); }
+inline void store(Node* n, double value) { store(n, value, false); }
+inline void store(Node* n, const char* value) { store(n, value, false); } // linked, like a string literal
+inline void store(Node* n, char* value) { store(n, value, true); }
+inline void store(Node* n, const String& value) { store(n, value.c_str(), true); }
+inline void store(Node* n, const std::string& value) { store(n, value.c_str(), true); }
+inline void store(Node* n, std::nullptr_t) { n->reset(); }
+// Deep copies; defined below the variant classes and found by argument-dependent lookup
+void store(Node* n, const JsonVariantConst& value);
+void store(Node* n, const JsonVariant& value);
+void store(Node* n, const JsonObjectConst& value);
+void store(Node* n, const JsonObject& value);
+void store(Node* n, const JsonArrayConst& value);
+void store(Node* n, const JsonArray& value);
+void store(Node* n, const JsonDocument& value);
+
+struct Writer {
+    virtual ~Writer() {}
+    virtual void write(const char* s, size_t len) = 0;
+};
+size_t serialize(const Node* n, Writer& out, bool pretty);
+
+struct Reader {
+    virtual ~Reader() {}
+    virtual int peek() = 0;
+    virtual int next() = 0;
+};
+} // namespace hostjson
+
+class DeserializationError {
+public:
+    enum Code { Ok, EmptyInput, IncompleteInput, InvalidInput, NoMemory, TooDeep };
+
+    DeserializationError(Code code = Ok) : _code(code) {}
+    Code code() const { return _code; }
+    const char* c_str() const;
+    explicit operator bool() const { return _code != Ok; }
+    bool operator==(Code code) const { return _code == code; }
+    bool operator!=(Code code) const { return _code != code; }
+
+private:
+    Code _code;
+};
+
+class JsonString {
+public:
+    JsonString(const char* s = nullptr) : _s(s) {}
+    const char* c_str() const { return _s; }
+    bool isNull() const { return _s == nullptr; }
+    operator const char*() const { return _s; }
+
+private:
+    const char* _s;
+};
+
+class JsonVariantConst {
+public:
+    JsonVariantConst(const hostjson::Node* node = nullptr) : _node(node) {}
+
+    bool isNull() const { return _node == nullptr || _node->type == hostjson::Node::NUL; }
+    size_t size() const { return _node ? _node->size() : 0; }
+    bool containsKey(const char* key) const { return _node && _node->find(key) != nullptr; }
+
+    template <typename T>
+    bool is() const;
+    template <typename T>
+    typename std::enable_if<hostjson::IsScalar<T>::value, T>::type as() const
+    {
+        return hostjson::Converter<T>::as(_node);
+    }
+    template <typename T>
+    typename std::enable_if<!hostjson::IsScalar<T>::value, T>::type as() const
+    {
+        return T(*this);
+    }
+    template <typename T, typename = typename std::enable_if<hostjson::IsScalar<T>::value>::type>
+    operator T() const
+    {
+        return as<T>();
+    }
+
+    template <typename T>
+    typename std::enable_if<hostjson::IsScalar<T>::value && !std::is_same<T, const char*>::value, T>::type
+    operator|(const T& def) const
+    {
+        return hostjson::Converter<T>::is(_node) ? as<T>() : def;
+    }
+    const char* operator|(const char* def) const
+    {
+        return hostjson::Converter<const char*>::is(_node) ? _node->str.c_str() : def;
+    }
+
+    JsonVariantConst operator[](const char* key) const { return JsonVariantConst(_node ? _node->find(key) : nullptr); }
+    JsonVariantConst operator[](const String& key) const { return (*this)[key.c_str()]; }
+    template <typename I, typename = typename std::enable_if<std::is_integral<I>::value>::type>
+    JsonVariantConst operator[](I index) const
+    {
+        if (_node == nullptr || _node->type != hostjson::Node::ARRAY || static_cast<size_t>(index) >= _node->elements.size())
+            return JsonVariantConst();
+        return JsonVariantConst(_node->elements[index].get());
+    }
+
+    const hostjson::Node* node() const { return _node; }
+
+protected:
+    const hostjson::Node* _node;
+};
+
+// A value inside a document. Members are created when written to, not when only read, like
+// ArduinoJson's MemberProxy: obj["missing"] stays absent unless something is assigned to it.
+class JsonVariant {
+public:
+    JsonVariant() {}
+    explicit JsonVariant(hostjson::Node* node) : _node(node) {}
+    JsonVariant(hostjson::Node* parent, const char* key, bool copyKey)
+        : _parent(parent), _key(key ? key : ""), _copyKey(copyKey), _member(true)
+    {
+    }
+    JsonVariant(const JsonVariant&) = default;
+
+    operator JsonVariantConst() const { return JsonVariantConst(get()); }
+
+    bool isNull() const { return JsonVariantConst(get()).isNull(); }
+    size_t size() const { return JsonVariantConst(get()).size(); }
+    bool containsKey(const char* key) const { return JsonVariantConst(get()).containsKey(key); }
+    template <typename T>
+    bool is() const
+    {
+        return JsonVariantConst(get()).is<T>();
+    }
+    template <typename T>
+    typename std::enable_if<hostjson::IsScalar<T>::value, T>::type as() const
+    {
+        return hostjson::Converter<T>::as(get());
+    }
+    template <typename T>
+    typename std::enable_if<!hostjson::IsScalar<T>::value, T>::type as() const
+    {
+        return T(*this);
+    }
+    template <typename T, typename = typename std::enable_if<hostjson::IsScalar<T>::value>::type>
+    operator T() const
+    {
+        return as<T>();
+    }
+    template <typename T>
+    auto operator|(const T& def) const -> decltype(JsonVariantConst() | def)
+    {
+        return JsonVariantConst(get()) | def;
+    }
+
+    // Assignment stores a value, it does not rebind the variant
+    JsonVariant& operator=(const JsonVariant& other)
+    {
+        set(JsonVariantConst(other));
+        return *this;
+    }
+    template <typename T>
+    JsonVariant& operator=(const T& value)
+    {
+        set(value);
+        return *this;
+    }
+    JsonVariant& operator=(const char* value)
+    {
+        set(value);
+        return *this;
+    }
+    JsonVariant& operator=(char* value)
+    {
+        set(value);
+        return *this;
+    }
+
+    template <typename T>
+    bool set(const T& value)
+    {
+        hostjson::Node* n = getOrCreate();
+        if (n == nullptr)
+            return false;
+        hostjson::store(n, value);
+        return true;
+    }
+    bool set(const char* value) { return set<const char*>(value); }
+    bool set(char* value) { return set<char*>(value); }
+
+    JsonVariant operator[](const char* key);
+    JsonVariant operator[](const String& key);
+    JsonVariantConst operator[](const char* key) const { return JsonVariantConst(get())[key]; }
+    template <typename I, typename = typename std::enable_if<std::is_integral<I>::value>::type>
+    JsonVariant operator[](I index)
+    {
+        const hostjson::Node* n = get();
+        if (n == nullptr || n->type != hostjson::Node::ARRAY || static_cast<size_t>(index) >= n->elements.size())
+            return JsonVariant();
+        return JsonVariant(n->elements[index].get());
+    }
+
+    JsonObject createNestedObject(const char* key);
+    JsonArray createNestedArray(const char* key);
+    JsonObject createNestedObject();
+    JsonArray createNestedArray();
+    template <typename T>
+    bool add(const T& value);
+    template <typename T>
+    T to();
+    void clear()
+    {
+        if (hostjson::Node* n = getMutable())
+            n->reset();
+    }
+
+    hostjson::Node* getMutable() const
+    {
+        return _member ? (_parent ? _parent->find(_key.c_str()) : nullptr) : _node;
+    }
+    const hostjson::Node* get() const { return getMutable(); }
+    hostjson::Node* getOrCreate();
+
+private:
+    hostjson::Node* _node = nullptr;
+    hostjson::Node* _parent = nullptr;
+    std::string _key;
+    bool _copyKey = false;
+    bool _member = false;
+};
+
+template <>
+JsonObject JsonVariant::to<JsonObject>();
+template <>
+JsonArray JsonVariant::to<JsonArray>();
+template <>
+JsonVariant JsonVariant::to<JsonVariant>();
+
+class JsonPairConst {
+public:
+    JsonPairConst(const char* key, const hostjson::Node* value) : _key(key), _value(value) {}
+    JsonString key() const { return _key; }
+    JsonVariantConst value() const { return _value; }
+
+private:
+    JsonString _key;
+    JsonVariantConst _value;
+};
+
+class JsonPair {
+public:
+    JsonPair(const char* key, hostjson::Node* value) : _key(key), _value(value) {}
+    JsonString key() const { return _key; }
+    JsonVariant value() const { return _value; }
+
+private:
+    JsonString _key;
+    JsonVariant _value;
+};
+
+class JsonObjectConst {
+public:
+    JsonObjectConst(const hostjson::Node* node = nullptr)
+        : _node(node && node->type == hostjson::Node::OBJECT ? node : nullptr)
+    {
+    }
+    JsonObjectConst(JsonVariantConst v) : JsonObjectConst(v.node()) {}
+    JsonObjectConst(const JsonVariant& v) : JsonObjectConst(v.get()) {}
+
+    operator JsonVariantConst() const { return JsonVariantConst(_node); }
+    bool isNull() const { return _node == nullptr; }
+    size_t size() const { return _node ? _node->size() : 0; }
+    bool containsKey(const char* key) const { return _node && _node->find(key) != nullptr; }
+    JsonVariantConst operator[](const char* key) const { return JsonVariantConst(_node ? _node->find(key) : nullptr); }
+    JsonVariantConst operator[](const String& key) const { return (*this)[key.c_str()]; }
+
+    class iterator {
+    public:
+        typedef std::vector<std::pair<std::string, std::unique_ptr<hostjson::Node>>>::const_iterator Base;
+        explicit iterator(Base it) : _it(it) {}
+        JsonPairConst operator*() const { return JsonPairConst(_it->first.c_str(), _it->second.get()); }
+        iterator& operator++()
+        {
+            ++_it;
+            return *this;
+        }
+        bool operator!=(const iterator& o) const { return _it != o._it; }
+
+    private:
+        Base _it;
+    };
+    iterator begin() const { return _node ? iterator(_node->members.begin()) : iterator(empty().begin()); }
+    iterator end() const { return _node ? iterator(_node->members.end()) : iterator(empty().end()); }
+
+    const hostjson::Node* node() const { return _node; }
+
+private:
+    static const std::vector<std::pair<std::string, std::unique_ptr<hostjson::Node>>>& empty()
+    {
+        static const std::vector<std::pair<std::string, std::unique_ptr<hostjson::Node>>> none;
+        return none;
+    }
+    const hostjson::Node* _node;
+};
+
+class JsonObject {
+public:
+    JsonObject(hostjson::Node* node = nullptr) : _node(node && node->type == hostjson::Node::OBJECT ? node : nullptr) {}
+    JsonObject(const JsonVariant& v) : JsonObject(v.getMutable()) {}
+
+    operator JsonObjectConst() const { return JsonObjectConst(_node); }
+    operator JsonVariantConst() const { return JsonVariantConst(_node); }
+    operator JsonVariant() const { return JsonVariant(_node); }
+    bool isNull() const { return _node == nullptr; }
+    size_t size() const { return _node ? _node->size() : 0; }
+    bool containsKey(const char* key) const { return _node && _node->find(key) != nullptr; }
+    void remove(const char* key);
+    void clear()
+    {
+        if (_node)
+            _node->members.clear();
+    }
+
+    JsonVariant operator[](const char* key) const { return JsonVariant(_node, key, false); }
+    JsonVariant operator[](char* key) const { return JsonVariant(_node, key, true); }
+    JsonVariant operator[](const String& key) const { return JsonVariant(_node, key.c_str(), true); }
+    JsonObject createNestedObject(const char* key) const { return (*this)[key].to<JsonObject>(); }
+    JsonObject createNestedObject(const String& key) const { return (*this)[key].to<JsonObject>(); }
+    JsonArray createNestedArray(const char* key) const;
+    JsonArray createNestedArray(const String& key) const;
+    bool set(JsonObjectConst other) const;
+
+    class iterator {
+    public:
+        typedef std::vector<std::pair<std::string, std::unique_ptr<hostjson::Node>>>::iterator Base;
+        explicit iterator(Base it) : _it(it) {}
+        JsonPair operator*() const { return JsonPair(_it->first.c_str(), _it->second.get()); }
+        iterator& operator++()
+        {
+            ++_it;
+            return *this;
+        }
+        bool operator!=(const iterator& o) const { return _it != o._it; }
+
+    private:
+        Base _it;
+    };
+    iterator begin() const { return iterator(_node ? _node->members.begin() : none().begin()); }
+    iterator end() const { return iterator(_node ? _node->members.end() : none().end()); }
+
+    hostjson::Node* node() const { return _node; }
+
+private:
+    static std::vector<std::pair<std::string, std::unique_ptr<hostjson::Node>>>& none()
+    {
+        static std::vector<std::pair<std::string, std::unique_ptr<hostjson::Node>>> empty;
+        return empty;
+    }
+    hostjson::Node* _node;
+};
+
+class JsonArrayConst {
+public:
+    JsonArrayConst(const hostjson::Node* node = nullptr) : _node(node && node->type == hostjson::Node::ARRAY ? node : nullptr) {}
+    JsonArrayConst(JsonVariantConst v) : JsonArrayConst(v.node()) {}
+    JsonArrayConst(const JsonVariant& v) : JsonArrayConst(v.get()) {}
+
+    operator JsonVariantConst() const { return JsonVariantConst(_node); }
+    bool isNull() const { return _node == nullptr; }
+    size_t size() const { return _node ? _node->size() : 0; }
+    JsonVariantConst operator[](size_t index) const
+    {
+        return JsonVariantConst(_node && index < _node->elements.size() ? _node->elements[index].get() : nullptr);
+    }
+
+    class iterator {
+    public:
+        typedef std::vector<std::unique_ptr<hostjson::Node>>::const_iterator Base;
+        explicit iterator(Base it) : _it(it) {}
+        JsonVariantConst operator*() const { return JsonVariantConst(_it->get()); }
+        iterator& operator++()
+        {
+            ++_it;
+            return *this;
+        }
+        bool operator!=(const iterator& o) const { return _it != o._it; }
+
+    private:
+        Base _it;
+    };
+    iterator begin() const { return iterator(_node ? _node->elements.begin() : empty().begin()); }
+    iterator end() const { return iterator(_node ? _node->elements.end() : empty().end()); }
+
+    const hostjson::Node* node() const { return _node; }
+
+private:
+    static const std::vector<std::unique_ptr<hostjson::Node>>& empty()
+    {
+        static const std::vector<std::unique_ptr<hostjson::Node>> none;
+        return none;
+    }
+    const hostjson::Node* _node;
+};
+
+class JsonArray {
+public:
+    JsonArray(hostjson::Node* node = nullptr) : _node(node && node->type == hostjson::Node::ARRAY ? node : nullptr) {}
+    JsonArray(const JsonVariant& v) : JsonArray(v.getMutable()) {}
+
+    operator JsonArrayConst() const { return JsonArrayConst(_node); }
+    operator JsonVariantConst() const { return JsonVariantConst(_node); }
+    operator JsonVariant() const { return JsonVariant(_node); }
+    bool isNull() const { return _node == nullptr; }
+    size_t size() const { return _node ? _node->size() : 0; }
+    JsonVariant operator[](size_t index) const
+    {
+        return JsonVariant(_node && index < _node->elements.size() ? _node->elements[index].get() : nullptr);
+    }
+    void clear() const
+    {
+        if (_node)
+            _node->elements.clear();
+    }
+
+    JsonVariant add() const { return JsonVariant(_node ? _node->addElement() : nullptr); }
+    template <typename T>
+    bool add(const T& value) const
+    {
+        hostjson::Node* n = _node ? _node->addElement() : nullptr;
+        if (n == nullptr)
+            return false;
+        hostjson::store(n, value);
+        return true;
+    }
+    bool add(const char* value) const { return add<const char*>(value); }
+    bool add(char* value) const { return add<char*>(value); }
+    JsonObject createNestedObject() const { return add().to<JsonObject>(); }
+    JsonArray createNestedArray() const;
+
+    class iterator {
+    public:
+        typedef std::vector<std::unique_ptr<hostjson::Node>>::iterator Base;
+        explicit iterator(Base it) : _it(it) {}
+        JsonVariant operator*() const { return JsonVariant(_it->get()); }
+        iterator& operator++()
+        {
+            ++_it;
+            return *this;
+        }
+        bool operator!=(const iterator& o) const { return _it != o._it; }
+
+    private:
+        Base _it;
+    };
+    iterator begin() const { return iterator(_node ? _node->elements.begin() : none().begin()); }
+    iterator end() const { return iterator(_node ? _node->elements.end() : none().end()); }
+
+    hostjson::Node* node() const { return _node; }
+
+private:
+    static std::vector<std::unique_ptr<hostjson::Node>>& none()
+    {
+        static std::vector<std::unique_ptr<hostjson::Node>> empty;
+        return empty;
+    }
+    hostjson::Node* _node;
+};
+
+template <typename T>
+bool JsonVariantConst::is() const
+{
+    return hostjson::Converter<T>::is(_node);
+}
+template <>
+inline bool JsonVariantConst::is<JsonObject>() const
+{
+    return _node && _node->type == hostjson::Node::OBJECT;
+}
+template <>
+inline bool JsonVariantConst::is<JsonObjectConst>() const
+{
+    return is<JsonObject>();
+}
+template <>
+inline bool JsonVariantConst::is<JsonArray>() const
+{
+    return _node && _node->type == hostjson::Node::ARRAY;
+}
+template <>
+inline bool JsonVariantConst::is<JsonArrayConst>() const
+{
+    return is<JsonArray>();
+}
+
+template <typename T>
+T JsonVariant::to()
+{
+    hostjson::Node* n = getOrCreate();
+    if (n != nullptr)
+        n->reset();
+    return T(n);
+}
+template <>
+inline JsonObject JsonVariant::to<JsonObject>()
+{
+    hostjson::Node* n = getOrCreate();
+    return JsonObject(n && n->makeObject() ? n : nullptr);
+}
+template <>
+inline JsonArray JsonVariant::to<JsonArray>()
+{
+    hostjson::Node* n = getOrCreate();
+    return JsonArray(n && n->makeArray() ? n : nullptr);
+}
+template <>
+inline JsonVariant JsonVariant::to<JsonVariant>()
+{
+    hostjson::Node* n = getOrCreate();
+    if (n != nullptr)
+        n->reset();
+    return JsonVariant(n);
+}
+
+template <typename T>
+bool JsonVariant::add(const T& value)
+{
+    hostjson::Node* n = getOrCreate();
+    if (n == nullptr || (n->type != hostjson::Node::ARRAY && !(n->type == hostjson::Node::NUL && n->makeArray())))
+        return false;
+    return JsonArray(n).add(value);
+}
+
+class JsonDocument {
+public:
+    JsonDocument(const JsonDocument& other) : JsonDocument(other._pool.capacity) { set(other.as<JsonVariantConst>()); }
+    JsonDocument& operator=(const JsonDocument& other)
+    {
+        if (this != &other)
+        {
+            clear();
+            set(other.as<JsonVariantConst>());
+        }
+        return *this;
+    }
+    virtual ~JsonDocument() {}
+
+    size_t capacity() const { return _pool.capacity; }
+    size_t memoryUsage() const { return _pool.used; }
+    bool overflowed() const { return _pool.overflowed; }
+    void clear()
+    {
+        _root.reset();
+        _pool.used = 0;
+        _pool.overflowed = false;
+    }
+    void garbageCollect() {}
+    void shrinkToFit() {}
+
+    bool isNull() const { return _root.type == hostjson::Node::NUL; }
+    size_t size() const { return _root.size(); }
+    bool containsKey(const char* key) const { return _root.find(key) != nullptr; }
+    void remove(const char* key) { JsonObject(&_root).remove(key); }
+
+    template <typename T>
+    typename std::enable_if<hostjson::IsScalar<T>::value, T>::type as() const
+    {
+        return hostjson::Converter<T>::as(&_root);
+    }
+    template <typename T>
+    typename std::enable_if<!hostjson::IsScalar<T>::value && !std::is_same<T, JsonObject>::value &&
+                                !std::is_same<T, JsonArray>::value && !std::is_same<T, JsonVariant>::value,
+                            T>::type
+    as() const
+    {
+        return T(JsonVariantConst(&_root));
+    }
+    template <typename T>
+    typename std::enable_if<std::is_same<T, JsonObject>::value || std::is_same<T, JsonArray>::value ||
+                                std::is_same<T, JsonVariant>::value,
+                            T>::type
+    as()
+    {
+        return T(&_root);
+    }
+    template <typename T>
+    bool is() const
+    {
+        return JsonVariantConst(&_root).is<T>();
+    }
+    template <typename T>
+    T to()
+    {
+        clear();
+        return JsonVariant(&_root).to<T>();
+    }
+    bool set(JsonVariantConst value)
+    {
+        clear();
+        return JsonVariant(&_root).set(value);
+    }
+    bool set(const JsonDocument& other) { return set(other.as<JsonVariantConst>()); }
+
+    JsonVariant operator[](const char* key) { return JsonVariant(&_root, key, false); }
+    JsonVariant operator[](char* key) { return JsonVariant(&_root, key, true); }
+    JsonVariant operator[](const String& key) { return JsonVariant(&_root, key.c_str(), true); }
+    JsonVariantConst operator[](const char* key) const { return JsonVariantConst(_root.find(key)); }
+    JsonVariantConst operator[](const String& key) const { return (*this)[key.c_str()]; }
+    template <typename I, typename = typename std::enable_if<std::is_integral<I>::value>::type>
+    JsonVariant operator[](I index)
+    {
+        return JsonVariant(&_root)[index];
+    }
+
+    JsonObject createNestedObject(const char* key) { return JsonVariant(&_root)[key].to<JsonObject>(); }
+    JsonArray createNestedArray(const char* key) { return JsonVariant(&_root).createNestedArray(key); }
+    JsonObject createNestedObject() { return JsonVariant(&_root).createNestedObject(); }
+    JsonArray createNestedArray() { return JsonVariant(&_root).createNestedArray(); }
+    template <typename T>
+    bool add(const T& value)
+    {
+        return JsonVariant(&_root).add(value);
+    }
+    bool add(const char* value) { return JsonVariant(&_root).add<const char*>(value); }
+
+    operator JsonVariantConst() const { return JsonVariantConst(&_root); }
+    operator JsonVariant() { return JsonVariant(&_root); }
+    const hostjson::Node* root() const { return &_root; }
+    hostjson::Node* root() { return &_root; }
+
+protected:
+    explicit JsonDocument(size_t capacity) : _root(&_pool) { _pool.capacity = capacity; }
+
+private:
+    hostjson::Pool _pool;
+    hostjson::Node _root;
+};
+
+class DynamicJsonDocument : public JsonDocument {
+public:
+    explicit DynamicJsonDocument(size_t capacity) : JsonDocument(capacity) {}
+    DynamicJsonDocument(const DynamicJsonDocument& other) : JsonDocument(other) {}
+    DynamicJsonDocument& operator=(const DynamicJsonDocument& other)
+    {
+        JsonDocument::operator=(other);
+        return *this;
+    }
+};
+
+template <size_t N>
+class StaticJsonDocument : public JsonDocument {
+public:
+    StaticJsonDocument() : JsonDocument(N) {}
+};
+
+#define JSON_OBJECT_SIZE(n) ((n) * hostjson::SLOT_SIZE)
+#define JSON_ARRAY_SIZE(n) ((n) * hostjson::SLOT_SIZE)
+#define JSON_STRING_SIZE(n) ((n) + 1)
+
+// serializeJson / measureJson / deserializeJson for documents and variants
+size_t serializeJson(JsonVariantConst source, Print& out);
+size_t serializeJson(JsonVariantConst source, String& out);
+size_t serializeJson(JsonVariantConst source, std::string& out);
+size_t serializeJson(JsonVariantConst source, char* buf, size_t size);
+template <size_t N>
+size_t serializeJson(JsonVariantConst source, char (&buf)[N])
+{
+    return serializeJson(source, buf, N);
+}
+size_t serializeJsonPretty(JsonVariantConst source, Print& out);
+size_t serializeJsonPretty(JsonVariantConst source, String& out);
+size_t measureJson(JsonVariantConst source);
+
+inline size_t serializeJson(const JsonDocument& doc, Print& out) { return serializeJson(JsonVariantConst(doc), out); }
+inline size_t serializeJson(const JsonDocument& doc, String& out) { return serializeJson(JsonVariantConst(doc), out); }
+inline size_t serializeJson(const JsonDocument& doc, std::string& out)
+{
+    return serializeJson(JsonVariantConst(doc), out);
+}
+inline size_t serializeJson(const JsonDocument& doc, char* buf, size_t size)
+{
+    return serializeJson(JsonVariantConst(doc), buf, size);
+}
+template <size_t N>
+size_t serializeJson(const JsonDocument& doc, char (&buf)[N])
+{
+    return serializeJson(JsonVariantConst(doc), buf, N);
+}
+inline size_t serializeJsonPretty(const JsonDocument& doc, Print& out)
+{
+    return serializeJsonPretty(JsonVariantConst(doc), out);
+}
+inline size_t serializeJsonPretty(const JsonDocument& doc, String& out)
+{
+    return serializeJsonPretty(JsonVariantConst(doc), out);
+}
+inline size_t measureJson(const JsonDocument& doc) { return measureJson(JsonVariantConst(doc)); }
+
+DeserializationError deserializeJson(JsonDocument& doc, const char* input);
+DeserializationError deserializeJson(JsonDocument& doc, const char* input, size_t len);
+DeserializationError deserializeJson(JsonDocument& doc, const String& input);
+DeserializationError deserializeJson(JsonDocument& doc, const std::string& input);
+DeserializationError deserializeJson(JsonDocument& doc, Stream& input);
+inline DeserializationError deserializeJson(JsonDocument& doc, char* input)
+{
+    return deserializeJson(doc, const_cast<const char*>(input));
+}
+inline DeserializationError deserializeJson(JsonDocument& doc, char* input, size_t len)
+{
+    return deserializeJson(doc, const_cast<const char*>(input), len);
+}
+
+#endif // HOST_ARDUINOJSON_H
@@ -0,0 +1,20 @@
+#ifndef HOST_CLIENT_H
+#define HOST_CLIENT_H
+
+// Arduino's Client interface, as PubSubClient uses it
+
+#include "Print.h"
+
+class Client : public Stream {
+public:
+    virtual int connect(const char* host, uint16_t port) = 0;
+    using Print::write;
+    virtual int read(uint8_t* buf, size_t size) = 0;
+    using Stream::read;
+    virtual void flush() = 0;
+    virtual void stop() = 0;
+    virtual uint8_t connected() = 0;
+    virtual operator bool() = 0;
+};
+
+#endif // HOST_CLIENT_H
@@ -0,0 +1,63 @@
+#ifndef HOST_FS_H
+#define HOST_FS_H
+
+// fs::File and fs::FS of the Arduino-ESP32 core, for the host SPIFFS in SPIFFS.h
+
+#include <memory>
+
+#include "Arduino.h"
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+
+namespace fs
+{
+struct FileImpl;
+
+class File : public Stream {
+public:
+    File() {}
+    explicit File(std::shared_ptr<FileImpl> impl) : _p(impl) {}
+
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* buf, size_t len) override;
+    int available() override;
+    int read() override;
+    int peek() override;
+    size_t read(uint8_t* buf, size_t len);
+    // Writes what was written so far to the flash; close() does that too
+    void flush();
+    size_t position() const;
+    size_t size() const;
+    void close();
+    operator bool() const { return _p != nullptr; }
+    const char* path() const;
+    const char* name() const; // without the directory, like core 2.x
+    bool isDirectory() const;
+    File openNextFile(const char* mode = FILE_READ);
+
+private:
+    std::shared_ptr<FileImpl> _p;
+};
+
+class FS {
+public:
+    File open(const char* path, const char* mode = FILE_READ, bool create = false);
+    File open(const String& path, const char* mode = FILE_READ, bool create = false)
+    {
+        return open(path.c_str(), mode, create);
+    }
+    bool exists(const char* path);
+    bool exists(const String& path) { return exists(path.c_str()); }
+    bool remove(const char* path);
+    bool remove(const String& path) { return remove(path.c_str()); }
+    // Fails if 'to' exists, like on SPIFFS
+    bool rename(const char* from, const char* to);
+    bool rename(const String& from, const String& to) { return rename(from.c_str(), to.c_str()); }
+};
+} // namespace fs
+
+using fs::File;
+using fs::FS;
+
+#endif // HOST_FS_H
@@ -0,0 +1,74 @@
+#include "NorFlash.h"
+
+#include <string.h>
+
+#include "Arduino.h"
+
+namespace host
+{
+NorFlash::NorFlash(size_t size) : _data(size, 0xFF), _erases(size / SECTOR_SIZE, 0) {}
+
+bool NorFlash::startOp(bool& partial)
+{
+    partial = false;
+    if (!_powered)
+        return false;
+    if (_cutIn > 0 && --_cutIn == 0)
+    {
+        _powered = false;
+        partial = true;
+    }
+    return true;
+}
+
+void NorFlash::read(size_t addr, void* dst, size_t len)
+{
+    // reading needs no special care; after a power cut nobody looks at the result
+    memcpy(dst, &_data[addr], len);
+    uint32_t us = READ_SETUP_US + len / 10;
+    _counters.reads++;
+    _counters.bytesRead += len;
+    _counters.busyUs += us;
+    advanceMicros(us);
+}
+
+void NorFlash::program(size_t addr, const void* src, size_t len)
+{
+    if (len == 0 || addr / PAGE_SIZE != (addr + len - 1) / PAGE_SIZE)
+        abort(); // the chip would wrap around within the page
+    bool partial;
+    if (!startOp(partial))
+        return;
+    size_t n = partial ? len / 2 : len;
+    const uint8_t* p = static_cast<const uint8_t*>(src);
+    for (size_t i = 0; i < n; i++)
+    {
+        if (p[i] & ~_data[addr + i])
+            _counters.bitsSet++;
+        _data[addr + i] &= p[i];
+    }
+    uint32_t us = PROGRAM_SETUP_US + n * 5 / 2;
+    _counters.programs++;
+    _counters.bytesProgrammed += n;
+    _counters.busyUs += us;
+    advanceMicros(us);
+}
+
+void NorFlash::eraseSector(size_t sector)
+{
+    bool partial;
+    if (!startOp(partial))
+        return;
+    memset(&_data[sector * SECTOR_SIZE], 0xFF, partial ? SECTOR_SIZE / 2 : SECTOR_SIZE);
+    _erases[sector]++;
+    _counters.erases++;
+    _counters.busyUs += ERASE_US;
+    advanceMicros(ERASE_US);
+}
+
+NorFlash& spiffsFlash()
+{
+    static NorFlash flash(0x160000);
+    return flash;
+}
+} // namespace host
@@ -0,0 +1,75 @@
+#ifndef HOST_NOR_FLASH_H
+#define HOST_NOR_FLASH_H
+
+// SPI NOR flash like the ESP32 modules carry, behind the host SPIFFS. Erasing sets a 4 KB sector to
+// 0xFF, programming can only clear bits and never crosses a 256-byte page. Every operation is
+// counted, erases per sector too, and charged to the virtual clock with the typical timings of a
+// W25Q32-class part, so a save takes about as long as on the device.
+//
+// Power cuts: cutPowerAfter(n) lets the n-th program or erase from now stop halfway and drops every
+// later one, until powerOn(). What the flash holds then is what a reboot finds.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace host
+{
+class NorFlash {
+public:
+    static const size_t SECTOR_SIZE = 4096;
+    static const size_t PAGE_SIZE = 256;
+
+    // Typical timings (datasheet "typ", not "max")
+    static const uint32_t READ_SETUP_US = 2;     // command and address; then 10 bytes per us
+    static const uint32_t PROGRAM_SETUP_US = 30; // then 2.5 us per byte, 670 us for a full page
+    static const uint32_t ERASE_US = 45000;
+
+    struct Counters {
+        uint64_t reads;
+        uint64_t bytesRead;
+        uint64_t programs;
+        uint64_t bytesProgrammed;
+        uint64_t erases;
+        uint64_t busyUs;   // time charged to the clock
+        uint64_t bitsSet;  // bits programmed as 1 that were 0 already, so the cell differs from what was written
+    };
+
+    explicit NorFlash(size_t size);
+
+    size_t size() const { return _data.size(); }
+    size_t sectors() const { return _erases.size(); }
+
+    void read(size_t addr, void* dst, size_t len);
+    void program(size_t addr, const void* src, size_t len);
+    void eraseSector(size_t sector);
+
+    const Counters& counters() const { return _counters; }
+    // Wear since construction; resetCounters() leaves it alone
+    uint32_t sectorErases(size_t sector) const { return _erases[sector]; }
+    void resetCounters() { _counters = Counters(); }
+
+    void cutPowerAfter(uint32_t ops) { _cutIn = ops; }
+    bool powered() const { return _powered; }
+    void powerOn()
+    {
+        _powered = true;
+        _cutIn = 0;
+    }
+
+private:
+    // false if the operation must be dropped; partial is set for the one interrupted halfway
+    bool startOp(bool& partial);
+
+    std::vector<uint8_t> _data;
+    std::vector<uint32_t> _erases;
+    Counters _counters = {};
+    uint32_t _cutIn = 0;
+    bool _powered = true;
+};
+
+// The SPIFFS partition of the default partition table (1408 KB)
+NorFlash& spiffsFlash();
+} // namespace host
+
+#endif // HOST_NOR_FLASH_H
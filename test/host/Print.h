@@ -0,0 +1,44 @@
+#ifndef HOST_PRINT_H
+#define HOST_PRINT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+class String;
+
+class Print {
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* buf, size_t len);
+    size_t write(const char* s);
+    size_t write(const char* buf, size_t len) { return write(reinterpret_cast<const uint8_t*>(buf), len); }
+
+    size_t print(const char* s) { return write(s); }
+    size_t print(const String& s);
+    size_t print(char c) { return write(static_cast<uint8_t>(c)); }
+    size_t print(int v) { return print(static_cast<long>(v)); }
+    size_t print(unsigned int v) { return print(static_cast<unsigned long>(v)); }
+    size_t print(long v);
+    size_t print(unsigned long v);
+    size_t print(double v, int digits = 2);
+    size_t println() { return write("\r\n"); }
+    template <typename T>
+    size_t println(const T& v)
+    {
+        size_t n = print(v);
+        return n + println();
+    }
+    size_t printf(const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+};
+
+class Stream : public Print {
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+    size_t readBytes(char* buf, size_t len);
+    size_t readBytes(uint8_t* buf, size_t len) { return readBytes(reinterpret_cast<char*>(buf), len); }
+};
+
+#endif // HOST_PRINT_H
@@ -0,0 +1,336 @@
+#include "PubSubClient.h"
+
+namespace
+{
+const uint8_t CONNECT = 0x10;
+const uint8_t CONNACK = 0x20;
+const uint8_t PUBLISH = 0x30;
+const uint8_t PUBACK = 0x40;
+const uint8_t SUBSCRIBE = 0x80;
+const uint8_t PINGREQ = 0xC0;
+const uint8_t PINGRESP = 0xD0;
+const uint8_t DISCONNECT = 0xE0;
+const uint8_t QOS1 = 0x02;
+} // namespace
+
+PubSubClient::PubSubClient(Client& client) : _client(&client) { setBufferSize(MQTT_MAX_PACKET_SIZE); }
+
+PubSubClient::~PubSubClient() { free(_buffer); }
+
+PubSubClient& PubSubClient::setServer(const char* domain, uint16_t port)
+{
+    _domain = domain;
+    _port = port;
+    return *this;
+}
+
+PubSubClient& PubSubClient::setCallback(Callback callback)
+{
+    _callback = callback;
+    return *this;
+}
+
+boolean PubSubClient::setBufferSize(uint16_t size)
+{
+    if (size == 0)
+        return false;
+    uint8_t* buffer = static_cast<uint8_t*>(realloc(_buffer, size));
+    if (buffer == nullptr)
+        return false;
+    _buffer = buffer;
+    _bufferSize = size;
+    return true;
+}
+
+boolean PubSubClient::connect(const char* id)
+{
+    return connect(id, nullptr, nullptr, nullptr, 0, false, nullptr);
+}
+
+boolean PubSubClient::connect(const char* id, const char* user, const char* pass, const char* willTopic,
+                              uint8_t willQos, boolean willRetain, const char* willMessage, boolean cleanSession)
+{
+    if (connected())
+        return true;
+    if (_domain == nullptr || !_client->connect(_domain, _port))
+    {
+        _state = MQTT_CONNECT_FAILED;
+        return false;
+    }
+    _nextMsgId = 1;
+    static const uint8_t protocol[7] = {0x00, 0x04, 'M', 'Q', 'T', 'T', 0x04};
+    uint16_t length = MAX_HEADER;
+    memcpy(_buffer + length, protocol, sizeof(protocol));
+    length += sizeof(protocol);
+
+    uint8_t flags = 0;
+    if (willTopic)
+        flags = 0x04 | (willQos << 3) | (willRetain << 5);
+    if (cleanSession)
+        flags |= 0x02;
+    if (user)
+    {
+        flags |= 0x80;
+        if (pass)
+            flags |= 0x40;
+    }
+    _buffer[length++] = flags;
+    _buffer[length++] = MQTT_KEEPALIVE >> 8;
+    _buffer[length++] = MQTT_KEEPALIVE & 0xFF;
+
+    length = writeString(id, length);
+    if (willTopic)
+    {
+        length = writeString(willTopic, length);
+        length = writeString(willMessage, length);
+    }
+    if (user)
+    {
+        length = writeString(user, length);
+        if (pass)
+            length = writeString(pass, length);
+    }
+    write(CONNECT, length - MAX_HEADER);
+
+    _lastInActivity = _lastOutActivity = millis();
+    while (!_client->available())
+    {
+        if (millis() - _lastInActivity >= MQTT_SOCKET_TIMEOUT * 1000UL)
+        {
+            _state = MQTT_CONNECTION_TIMEOUT;
+            _client->stop();
+            return false;
+        }
+        delay(1);
+    }
+    uint32_t len = readPacket();
+    if (len == 4 && _buffer[0] == CONNACK)
+    {
+        if (_buffer[3] == 0)
+        {
+            _lastInActivity = millis();
+            _pingOutstanding = false;
+            _state = MQTT_CONNECTED;
+            return true;
+        }
+        _state = _buffer[3];
+    }
+    _client->stop();
+    return false;
+}
+
+bool PubSubClient::readByte(uint8_t* b)
+{
+    unsigned long start = millis();
+    while (!_client->available())
+    {
+        if (millis() - start >= MQTT_SOCKET_TIMEOUT * 1000UL)
+            return false;
+        // a closed socket never becomes readable
+        if (!_client->connected())
+            return false;
+        delay(1);
+    }
+    int c = _client->read();
+    if (c < 0)
+        return false;
+    *b = static_cast<uint8_t>(c);
+    return true;
+}
+
+// Reads one packet into the buffer; 0 if it failed or did not fit (its bytes are consumed anyway)
+uint32_t PubSubClient::readPacket()
+{
+    uint16_t len = 0;
+    uint8_t b;
+    if (!readByte(&b))
+        return 0;
+    _buffer[len++] = b;
+    uint32_t remaining = 0;
+    uint32_t multiplier = 1;
+    do
+    {
+        if (len == MAX_HEADER || !readByte(&b))
+            return 0;
+        _buffer[len++] = b;
+        remaining += (b & 0x7F) * multiplier;
+        multiplier <<= 7;
+    } while (b & 0x80);
+
+    bool fits = len + remaining <= _bufferSize;
+    for (uint32_t i = 0; i < remaining; i++)
+    {
+        if (!readByte(&b))
+            return 0;
+        if (fits)
+            _buffer[len++] = b;
+    }
+    return fits ? len : 0;
+}
+
+boolean PubSubClient::loop()
+{
+    if (!connected())
+        return false;
+    unsigned long t = millis();
+    if (t - _lastInActivity > MQTT_KEEPALIVE * 1000UL || t - _lastOutActivity > MQTT_KEEPALIVE * 1000UL)
+    {
+        if (_pingOutstanding)
+        {
+            _state = MQTT_CONNECTION_TIMEOUT;
+            _client->stop();
+            return false;
+        }
+        _buffer[0] = PINGREQ;
+        _buffer[1] = 0;
+        _client->write(_buffer, 2);
+        _lastOutActivity = _lastInActivity = t;
+        _pingOutstanding = true;
+    }
+    if (_client->available())
+    {
+        uint32_t len = readPacket();
+        if (len > 0)
+        {
+            _lastInActivity = t;
+            uint8_t type = _buffer[0] & 0xF0;
+            if (type == PUBLISH && _callback)
+            {
+                // Topic and payload are handed over in place; the topic is terminated by moving it
+                // one byte down over its length field, as the library does
+                uint8_t lengthBytes = 1;
+                while (_buffer[lengthBytes] & 0x80)
+                    lengthBytes++;
+                uint8_t* p = _buffer + 1 + lengthBytes;
+                uint16_t topicLen = (p[0] << 8) | p[1];
+                memmove(p, p + 2, topicLen);
+                p[topicLen] = 0;
+                char* topic = reinterpret_cast<char*>(p);
+                uint8_t* payload = p + topicLen + 2;
+                uint32_t payloadLen = len - (payload - _buffer);
+                if (_buffer[0] & QOS1)
+                {
+                    uint16_t msgId = (payload[0] << 8) | payload[1];
+                    payload += 2;
+                    payloadLen -= 2;
+                    _callback(topic, payload, payloadLen);
+                    uint8_t ack[4] = {PUBACK, 2, static_cast<uint8_t>(msgId >> 8), static_cast<uint8_t>(msgId)};
+                    _client->write(ack, 4);
+                    _lastOutActivity = t;
+                }
+                else
+                {
+                    _callback(topic, payload, payloadLen);
+                }
+            }
+            else if (type == PINGREQ)
+            {
+                uint8_t resp[2] = {PINGRESP, 0};
+                _client->write(resp, 2);
+            }
+            else if (type == PINGRESP)
+            {
+                _pingOutstanding = false;
+            }
+        }
+        else if (!connected())
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+boolean PubSubClient::publish(const char* topic, const char* payload, boolean retained)
+{
+    return publish(topic, reinterpret_cast<const uint8_t*>(payload), payload ? strlen(payload) : 0, retained);
+}
+
+boolean PubSubClient::publish(const char* topic, const uint8_t* payload, unsigned int length, boolean retained)
+{
+    if (!connected())
+        return false;
+    if (_bufferSize < MAX_HEADER + 2 + strnlen(topic, _bufferSize) + length)
+        return false;
+    uint16_t pos = writeString(topic, MAX_HEADER);
+    memcpy(_buffer + pos, payload, length);
+    pos += length;
+    return write(PUBLISH | (retained ? 1 : 0), pos - MAX_HEADER);
+}
+
+boolean PubSubClient::subscribe(const char* topic, uint8_t qos)
+{
+    if (topic == nullptr || qos > 1 || _bufferSize < 9 + strnlen(topic, _bufferSize))
+        return false;
+    if (!connected())
+        return false;
+    uint16_t pos = MAX_HEADER;
+    if (++_nextMsgId == 0)
+        _nextMsgId = 1;
+    _buffer[pos++] = _nextMsgId >> 8;
+    _buffer[pos++] = _nextMsgId & 0xFF;
+    pos = writeString(topic, pos);
+    _buffer[pos++] = qos;
+    return write(SUBSCRIBE | QOS1, pos - MAX_HEADER);
+}
+
+void PubSubClient::disconnect()
+{
+    _buffer[0] = DISCONNECT;
+    _buffer[1] = 0;
+    _client->write(_buffer, 2);
+    _state = MQTT_DISCONNECTED;
+    _client->flush();
+    _client->stop();
+    _lastInActivity = _lastOutActivity = millis();
+}
+
+boolean PubSubClient::connected()
+{
+    if (!_client->connected())
+    {
+        if (_state == MQTT_CONNECTED)
+        {
+            _state = MQTT_CONNECTION_LOST;
+            _client->flush();
+            _client->stop();
+        }
+        return false;
+    }
+    return _state == MQTT_CONNECTED;
+}
+
+bool PubSubClient::write(uint8_t header, uint16_t length)
+{
+    // Remaining length goes right in front of the variable header, so the packet is contiguous
+    uint8_t lenBuf[4];
+    uint8_t lenLen = 0;
+    uint16_t len = length;
+    do
+    {
+        uint8_t digit = len & 0x7F;
+        len >>= 7;
+        if (len > 0)
+            digit |= 0x80;
+        lenBuf[lenLen++] = digit;
+    } while (len > 0);
+    uint8_t start = MAX_HEADER - 1 - lenLen;
+    _buffer[start] = header;
+    memcpy(_buffer + start + 1, lenBuf, lenLen);
+    size_t total = 1 + lenLen + length;
+    size_t written = _client->write(_buffer + start, total);
+    _lastOutActivity = millis();
+    return written == total;
+}
+
+uint16_t PubSubClient::writeString(const char* s, uint16_t pos)
+{
+    uint16_t start = pos;
+    pos += 2;
+    uint16_t n = 0;
+    while (s[n] && pos < _bufferSize - 2)
+        _buffer[pos++] = s[n++];
+    _buffer[start] = n >> 8;
+    _buffer[start + 1] = n & 0xFF;
+    return pos;
+}
@@ -0,0 +1,77 @@
+#ifndef HOST_PUBSUBCLIENT_H
+#define HOST_PUBSUBCLIENT_H
+
+// PubSubClient 2.8 (knolleary), the subset the firmware calls, for the host build. The library is
+// not vendored, so this is a rewrite with the same wire format (MQTT 3.1.1, QoS 0 publishes) and
+// the same behaviour where it shows in timings:
+//  - one packet buffer of setBufferSize() bytes (256 by default); a publish that does not fit fails
+//  - connect() blocks until CONNACK or MQTT_SOCKET_TIMEOUT, publish() until the socket took the packet
+//  - loop() reads at most one packet per call, answers pings and sends one after MQTT_KEEPALIVE idle
+//  - state() codes as in the library
+
+#include <functional>
+
+#include "Arduino.h"
+#include "Client.h"
+
+#define MQTT_KEEPALIVE 15
+#define MQTT_SOCKET_TIMEOUT 15
+#define MQTT_MAX_PACKET_SIZE 256
+
+#define MQTT_CONNECTION_TIMEOUT -4
+#define MQTT_CONNECTION_LOST -3
+#define MQTT_CONNECT_FAILED -2
+#define MQTT_DISCONNECTED -1
+#define MQTT_CONNECTED 0
+#define MQTT_CONNECT_BAD_PROTOCOL 1
+#define MQTT_CONNECT_BAD_CLIENT_ID 2
+#define MQTT_CONNECT_UNAVAILABLE 3
+#define MQTT_CONNECT_BAD_CREDENTIALS 4
+#define MQTT_CONNECT_UNAUTHORIZED 5
+
+class PubSubClient {
+public:
+    typedef std::function<void(char*, uint8_t*, unsigned int)> Callback;
+
+    explicit PubSubClient(Client& client);
+    ~PubSubClient();
+
+    PubSubClient& setServer(const char* domain, uint16_t port);
+    PubSubClient& setCallback(Callback callback);
+    boolean setBufferSize(uint16_t size);
+    uint16_t getBufferSize() const { return _bufferSize; }
+
+    boolean connect(const char* id);
+    boolean connect(const char* id, const char* user, const char* pass, const char* willTopic, uint8_t willQos,
+                    boolean willRetain, const char* willMessage, boolean cleanSession = true);
+    void disconnect();
+    boolean publish(const char* topic, const char* payload, boolean retained = false);
+    boolean publish(const char* topic, const uint8_t* payload, unsigned int length, boolean retained = false);
+    boolean subscribe(const char* topic, uint8_t qos = 0);
+    boolean loop();
+    boolean connected();
+    int state() const { return _state; }
+
+private:
+    bool readByte(uint8_t* b);
+    uint32_t readPacket();
+    // Fixed header in front of 'length' bytes already at _buffer + MAX_HEADER; returns false if short
+    bool write(uint8_t header, uint16_t length);
+    uint16_t writeString(const char* s, uint16_t pos);
+
+    static const uint8_t MAX_HEADER = 5;
+
+    Client* _client;
+    uint8_t* _buffer = nullptr;
+    uint16_t _bufferSize = 0;
+    uint16_t _nextMsgId = 0;
+    unsigned long _lastOutActivity = 0;
+    unsigned long _lastInActivity = 0;
+    bool _pingOutstanding = false;
+    Callback _callback;
+    const char* _domain = nullptr;
+    uint16_t _port = 0;
+    int _state = MQTT_DISCONNECTED;
+};
+
+#endif // HOST_PUBSUBCLIENT_H
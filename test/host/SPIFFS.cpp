@@ -0,0 +1,699 @@
+#include "SPIFFS.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+fs::SPIFFSFS SPIFFS;
+
+namespace
+{
+using host::NorFlash;
+
+const size_t PAGE_SIZE = NorFlash::PAGE_SIZE;
+const size_t BLOCK_SIZE = NorFlash::SECTOR_SIZE;
+const uint32_t PAGES_PER_BLOCK = BLOCK_SIZE / PAGE_SIZE;
+const uint32_t OBJ_PAGES = PAGES_PER_BLOCK - 1; // page 0 holds the lookup table
+const size_t HEADER_SIZE = 5;
+const size_t PAGE_DATA = PAGE_SIZE - HEADER_SIZE;
+const size_t NAME_LEN = 32;
+const size_t INDEX_FIXED = HEADER_SIZE + 4 + NAME_LEN;
+const size_t INDEX_ENTRIES = (PAGE_SIZE - INDEX_FIXED) / 2;
+const size_t ERASE_COUNT_OFFSET = PAGE_SIZE - 4;
+const size_t MAGIC_OFFSET = PAGE_SIZE - 2;
+const uint16_t MAGIC = 0x20AE;
+// garbage collection score per deleted page, used page and erase age, as SPIFFS's defaults
+const int GC_WEIGHT_DELETED = 5;
+const int GC_WEIGHT_USED = -1;
+const int GC_WEIGHT_ERASE_AGE = 50;
+
+// lookup table entries and object ids
+const uint16_t ID_FREE = 0xFFFF;
+const uint16_t ID_DELETED = 0;
+const uint16_t ID_INDEX = 0x8000;
+
+// page header flags, active low
+const uint8_t FLAG_USED = 0x01;
+const uint8_t FLAG_FINAL = 0x02;
+const uint8_t FLAG_INDEX = 0x04;
+const uint8_t FLAG_DELETED = 0x80;
+const uint32_t SIZE_UNDEFINED = 0xFFFFFFFF;
+
+void put16(uint8_t* p, uint16_t v)
+{
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+}
+
+void put32(uint8_t* p, uint32_t v)
+{
+    put16(p, v & 0xFFFF);
+    put16(p + 2, v >> 16);
+}
+
+uint16_t get16(const uint8_t* p) { return p[0] | p[1] << 8; }
+uint32_t get32(const uint8_t* p) { return get16(p) | static_cast<uint32_t>(get16(p + 2)) << 16; }
+
+struct Index {
+    uint32_t size = 0;
+    std::string name;
+    std::vector<uint16_t> pages; // data pages by span index
+
+    size_t dataPages() const { return size == SIZE_UNDEFINED ? 0 : (size + PAGE_DATA - 1) / PAGE_DATA; }
+};
+
+class Volume {
+public:
+    bool mounted() const { return _mounted; }
+    bool mount();
+    void unmount() { _mounted = false; }
+    bool format();
+
+    // Object id of the file, 0 if there is none
+    uint16_t find(const char* name);
+    uint16_t create(const char* name);
+    bool write(uint16_t id, const std::string& data);
+    bool read(uint16_t id, std::string& out);
+    bool remove(uint16_t id);
+    bool rename(uint16_t id, const char* to);
+    std::vector<std::string> names();
+
+    size_t totalBytes() const { return (blocks() - 1) * OBJ_PAGES * PAGE_SIZE; }
+    size_t usedBytes() const;
+
+private:
+    NorFlash& flash() const { return host::spiffsFlash(); }
+    size_t blocks() const { return flash().size() / BLOCK_SIZE; }
+    static size_t lookupAddr(uint32_t pix) { return pix / PAGES_PER_BLOCK * BLOCK_SIZE + (pix % PAGES_PER_BLOCK - 1) * 2; }
+    void readLookup(size_t block, uint16_t* ids);
+    void readIndex(uint32_t pix, Index& out);
+    uint32_t allocPage();
+    void writePage(uint32_t pix, uint16_t id, uint16_t span, const uint8_t* data, size_t len);
+    uint32_t writeIndex(uint16_t id, const Index& index);
+    void deletePage(uint32_t pix);
+    bool ensureFree(uint32_t pages);
+    bool collect();
+    void eraseBlock(size_t block);
+
+    bool _mounted = false;
+    std::map<uint16_t, uint32_t> _index; // object id -> its index page
+    std::vector<uint16_t> _used;
+    std::vector<uint16_t> _deleted;
+    std::vector<uint16_t> _eraseCount;
+    uint16_t _maxEraseCount = 0; // the count the next erased block gets
+    uint32_t _free = 0;
+    uint32_t _cursor = 0;
+    size_t _gcBlock = SIZE_MAX; // no allocations from the block being collected
+};
+
+Volume volume;
+
+void Volume::readLookup(size_t block, uint16_t* ids)
+{
+    uint8_t raw[OBJ_PAGES * 2];
+    flash().read(block * BLOCK_SIZE, raw, sizeof(raw));
+    for (uint32_t i = 0; i < OBJ_PAGES; i++)
+        ids[i] = get16(raw + i * 2);
+}
+
+void Volume::readIndex(uint32_t pix, Index& out)
+{
+    uint8_t page[PAGE_SIZE];
+    flash().read(pix * PAGE_SIZE, page, sizeof(page));
+    out.size = get32(page + HEADER_SIZE);
+    const char* name = reinterpret_cast<const char*>(page + HEADER_SIZE + 4);
+    out.name.assign(name, strnlen(name, NAME_LEN));
+    out.pages.clear();
+    for (size_t k = 0; k < out.dataPages() && k < INDEX_ENTRIES; k++)
+        out.pages.push_back(get16(page + INDEX_FIXED + k * 2));
+}
+
+// Erase count and magic go to the end of the lookup page
+void Volume::eraseBlock(size_t block)
+{
+    flash().eraseSector(block);
+    uint8_t tail[4];
+    put16(tail, _maxEraseCount);
+    put16(tail + 2, MAGIC);
+    flash().program(block * BLOCK_SIZE + ERASE_COUNT_OFFSET, tail, sizeof(tail));
+    if (block < _eraseCount.size())
+        _eraseCount[block] = _maxEraseCount;
+    _maxEraseCount++;
+}
+
+// Next free page from the cursor on, so writes walk across the whole partition
+uint32_t Volume::allocPage()
+{
+    size_t n = blocks();
+    for (size_t i = 0; i <= n; i++)
+    {
+        size_t block = (_cursor / PAGES_PER_BLOCK + i) % n;
+        if (block == _gcBlock || _used[block] + _deleted[block] == OBJ_PAGES)
+            continue;
+        uint16_t ids[OBJ_PAGES];
+        readLookup(block, ids);
+        for (uint32_t slot = 0; slot < OBJ_PAGES; slot++)
+        {
+            if (ids[slot] == ID_FREE)
+            {
+                uint32_t pix = block * PAGES_PER_BLOCK + slot + 1;
+                _cursor = pix + 1;
+                return pix;
+            }
+        }
+    }
+    abort(); // callers make sure there is a free page
+}
+
+// Lookup entry, then header and data, then the final flag: a page cut short is never final
+void Volume::writePage(uint32_t pix, uint16_t id, uint16_t span, const uint8_t* data, size_t len)
+{
+    uint8_t entry[2];
+    put16(entry, id);
+    flash().program(lookupAddr(pix), entry, 2);
+    uint8_t page[PAGE_SIZE];
+    put16(page, id);
+    put16(page + 2, span);
+    uint8_t flags = 0xFF & ~FLAG_USED;
+    if (id & ID_INDEX)
+        flags &= ~FLAG_INDEX;
+    page[4] = flags;
+    memcpy(page + HEADER_SIZE, data, len);
+    flash().program(pix * PAGE_SIZE, page, HEADER_SIZE + len);
+    flags &= ~FLAG_FINAL;
+    flash().program(pix * PAGE_SIZE + 4, &flags, 1);
+    _used[pix / PAGES_PER_BLOCK]++;
+    _free--;
+}
+
+uint32_t Volume::writeIndex(uint16_t id, const Index& index)
+{
+    uint8_t body[PAGE_SIZE - HEADER_SIZE];
+    memset(body, 0xFF, sizeof(body));
+    put32(body, index.size);
+    memset(body + 4, 0, NAME_LEN);
+    memcpy(body + 4, index.name.data(), std::min(index.name.size(), NAME_LEN - 1));
+    for (size_t k = 0; k < index.pages.size(); k++)
+        put16(body + 4 + NAME_LEN + k * 2, index.pages[k]);
+    uint32_t pix = allocPage();
+    writePage(pix, id | ID_INDEX, 0, body, 4 + NAME_LEN + index.pages.size() * 2);
+    _index[id] = pix;
+    return pix;
+}
+
+void Volume::deletePage(uint32_t pix)
+{
+    uint8_t flags;
+    flash().read(pix * PAGE_SIZE + 4, &flags, 1);
+    flags &= ~FLAG_DELETED;
+    flash().program(pix * PAGE_SIZE + 4, &flags, 1);
+    uint8_t entry[2];
+    put16(entry, ID_DELETED);
+    flash().program(lookupAddr(pix), entry, 2);
+    size_t block = pix / PAGES_PER_BLOCK;
+    _used[block]--;
+    _deleted[block]++;
+}
+
+// Garbage collection keeps one block's worth of pages in reserve for moving live pages
+bool Volume::ensureFree(uint32_t pages)
+{
+    while (_free < pages + OBJ_PAGES)
+    {
+        if (!collect())
+            break;
+    }
+    return _free >= pages + OBJ_PAGES;
+}
+
+// Erases the block that scores best (many deleted pages, few to move, erased long ago) after
+// moving its live pages elsewhere. The erase age spreads the wear over the partition.
+bool Volume::collect()
+{
+    size_t victim = SIZE_MAX;
+    int best = 0;
+    for (size_t b = 0; b < blocks(); b++)
+    {
+        uint32_t freeInBlock = OBJ_PAGES - _used[b] - _deleted[b];
+        if (_deleted[b] == 0 || _free - freeInBlock < 2 * _used[b])
+            continue;
+        uint16_t age = _maxEraseCount - _eraseCount[b];
+        int score = _deleted[b] * GC_WEIGHT_DELETED + _used[b] * GC_WEIGHT_USED + age * GC_WEIGHT_ERASE_AGE;
+        if (victim == SIZE_MAX || score > best)
+        {
+            victim = b;
+            best = score;
+        }
+    }
+    if (victim == SIZE_MAX)
+        return false;
+    _gcBlock = victim;
+
+    uint16_t ids[OBJ_PAGES];
+    readLookup(victim, ids);
+    std::vector<uint16_t> objects;
+    for (uint32_t slot = 0; slot < OBJ_PAGES; slot++)
+    {
+        uint16_t id = ids[slot] & ~ID_INDEX;
+        if (ids[slot] != ID_FREE && ids[slot] != ID_DELETED && std::find(objects.begin(), objects.end(), id) == objects.end())
+            objects.push_back(id);
+    }
+    // Each object gets copies of its pages in the victim and a new index page pointing at them
+    for (uint16_t id : objects)
+    {
+        uint32_t oldIndex = _index[id];
+        Index index;
+        readIndex(oldIndex, index);
+        std::vector<uint32_t> moved;
+        for (size_t k = 0; k < index.pages.size(); k++)
+        {
+            if (index.pages[k] / PAGES_PER_BLOCK != victim)
+                continue;
+            uint8_t page[PAGE_SIZE];
+            flash().read(index.pages[k] * PAGE_SIZE, page, sizeof(page));
+            uint32_t pix = allocPage();
+            size_t len = std::min(PAGE_DATA, index.size - k * PAGE_DATA);
+            writePage(pix, id, k, page + HEADER_SIZE, len);
+            moved.push_back(index.pages[k]);
+            index.pages[k] = pix;
+        }
+        writeIndex(id, index);
+        deletePage(oldIndex);
+        for (uint32_t pix : moved)
+            deletePage(pix);
+    }
+
+    eraseBlock(victim);
+    _free += _deleted[victim];
+    _deleted[victim] = 0;
+    _gcBlock = SIZE_MAX;
+    return true;
+}
+
+bool Volume::format()
+{
+    _mounted = false;
+    _eraseCount.clear();
+    _maxEraseCount = 0;
+    for (size_t b = 0; b < blocks(); b++)
+        eraseBlock(b);
+    return flash().powered();
+}
+
+bool Volume::mount()
+{
+    size_t n = blocks();
+    std::vector<size_t> bad;
+    _eraseCount.assign(n, 0);
+    _maxEraseCount = 0;
+    for (size_t b = 0; b < n; b++)
+    {
+        uint8_t tail[4];
+        flash().read(b * BLOCK_SIZE + ERASE_COUNT_OFFSET, tail, sizeof(tail));
+        if (get16(tail + 2) != MAGIC)
+        {
+            bad.push_back(b);
+            continue;
+        }
+        _eraseCount[b] = get16(tail);
+        // 16-bit counts wrap, so they are compared by their difference
+        if (static_cast<int16_t>(_eraseCount[b] - _maxEraseCount) >= 0)
+            _maxEraseCount = _eraseCount[b] + 1;
+    }
+    if (bad.size() > 1)
+        return false;
+    if (bad.size() == 1)
+    {
+        // an erase was cut short; whatever the block held had been moved or deleted before
+        eraseBlock(bad[0]);
+    }
+
+    _used.assign(n, 0);
+    _deleted.assign(n, 0);
+    _free = 0;
+    _cursor = 0;
+    _index.clear();
+    std::map<uint16_t, std::vector<uint32_t>> indexPages;
+    std::map<uint32_t, uint32_t> dataPages; // page -> id << 16 | span
+    std::vector<uint32_t> garbage;
+    for (size_t b = 0; b < n; b++)
+    {
+        uint16_t ids[OBJ_PAGES];
+        readLookup(b, ids);
+        for (uint32_t slot = 0; slot < OBJ_PAGES; slot++)
+        {
+            uint32_t pix = b * PAGES_PER_BLOCK + slot + 1;
+            if (ids[slot] == ID_FREE)
+            {
+                _free++;
+                continue;
+            }
+            if (ids[slot] == ID_DELETED)
+            {
+                _deleted[b]++;
+                continue;
+            }
+            _used[b]++;
+            uint8_t header[HEADER_SIZE];
+            flash().read(pix * PAGE_SIZE, header, sizeof(header));
+            uint16_t id = get16(header);
+            uint8_t flags = header[4];
+            bool index = !(flags & FLAG_INDEX);
+            bool valid = id == ids[slot] && !(flags & FLAG_USED) && !(flags & FLAG_FINAL) && (flags & FLAG_DELETED) &&
+                         index == ((id & ID_INDEX) != 0);
+            if (!valid)
+                garbage.push_back(pix);
+            else if (index)
+                indexPages[id & ~ID_INDEX].push_back(pix);
+            else
+                dataPages[pix] = static_cast<uint32_t>(id) << 16 | get16(header + 2);
+        }
+    }
+
+    // Two index pages of one file are left when power failed between writing the new one and
+    // deleting the old one; a complete one wins over one of a file still being created
+    std::map<uint32_t, bool> referenced;
+    for (auto& entry : indexPages)
+    {
+        uint16_t id = entry.first;
+        uint32_t chosen = 0;
+        bool chosenDefined = false;
+        for (uint32_t pix : entry.second)
+        {
+            Index index;
+            readIndex(pix, index);
+            bool complete = index.pages.size() == index.dataPages();
+            for (size_t k = 0; complete && k < index.pages.size(); k++)
+            {
+                auto it = dataPages.find(index.pages[k]);
+                complete = it != dataPages.end() && it->second == (static_cast<uint32_t>(id) << 16 | k);
+            }
+            bool defined = index.size != SIZE_UNDEFINED;
+            if (complete && (chosen == 0 || (defined && !chosenDefined)))
+            {
+                chosen = pix;
+                chosenDefined = defined;
+            }
+        }
+        for (uint32_t pix : entry.second)
+        {
+            if (pix != chosen)
+                garbage.push_back(pix);
+        }
+        if (chosen == 0)
+            continue;
+        _index[id] = chosen;
+        Index index;
+        readIndex(chosen, index);
+        for (uint16_t pix : index.pages)
+            referenced[pix] = true;
+    }
+    for (auto& entry : dataPages)
+    {
+        if (!referenced.count(entry.first))
+            garbage.push_back(entry.first);
+    }
+    for (uint32_t pix : garbage)
+        deletePage(pix);
+    _mounted = flash().powered();
+    return _mounted;
+}
+
+uint16_t Volume::find(const char* name)
+{
+    for (size_t b = 0; b < blocks(); b++)
+    {
+        if (_used[b] == 0)
+            continue;
+        uint16_t ids[OBJ_PAGES];
+        readLookup(b, ids);
+        for (uint32_t slot = 0; slot < OBJ_PAGES; slot++)
+        {
+            if (ids[slot] == ID_FREE || ids[slot] == ID_DELETED || !(ids[slot] & ID_INDEX))
+                continue;
+            uint32_t pix = b * PAGES_PER_BLOCK + slot + 1;
+            char stored[NAME_LEN + 1] = {};
+            flash().read(pix * PAGE_SIZE + HEADER_SIZE + 4, stored, NAME_LEN);
+            uint16_t id = ids[slot] & ~ID_INDEX;
+            if (strcmp(stored, name) == 0 && _index.count(id) && _index[id] == pix)
+                return id;
+        }
+    }
+    return 0;
+}
+
+uint16_t Volume::create(const char* name)
+{
+    if (strlen(name) >= NAME_LEN || !ensureFree(1))
+        return 0;
+    uint16_t id = 1;
+    while (_index.count(id))
+        id++;
+    Index index;
+    index.size = SIZE_UNDEFINED;
+    index.name = name;
+    writeIndex(id, index);
+    return id;
+}
+
+// New data pages and index page first, then the old ones are flagged deleted
+bool Volume::write(uint16_t id, const std::string& data)
+{
+    size_t pages = (data.size() + PAGE_DATA - 1) / PAGE_DATA;
+    if (!_index.count(id) || pages > INDEX_ENTRIES || !ensureFree(pages + 1))
+        return false;
+    Index index;
+    for (size_t k = 0; k < pages; k++)
+    {
+        uint32_t pix = allocPage();
+        size_t len = std::min(PAGE_DATA, data.size() - k * PAGE_DATA);
+        writePage(pix, id, k, reinterpret_cast<const uint8_t*>(data.data()) + k * PAGE_DATA, len);
+        index.pages.push_back(pix);
+    }
+    uint32_t oldIndex = _index[id]; // collection may have moved it
+    Index old;
+    readIndex(oldIndex, old);
+    index.size = data.size();
+    index.name = old.name;
+    writeIndex(id, index);
+    deletePage(oldIndex);
+    for (uint16_t pix : old.pages)
+        deletePage(pix);
+    return flash().powered();
+}
+
+bool Volume::read(uint16_t id, std::string& out)
+{
+    Index index;
+    readIndex(_index[id], index);
+    out.clear();
+    for (size_t k = 0; k < index.pages.size(); k++)
+    {
+        uint8_t data[PAGE_DATA];
+        size_t len = std::min(PAGE_DATA, index.size - k * PAGE_DATA);
+        flash().read(index.pages[k] * PAGE_SIZE + HEADER_SIZE, data, len);
+        out.append(reinterpret_cast<const char*>(data), len);
+    }
+    return true;
+}
+
+// The index page goes first; data pages left behind by a power cut are collected at mount
+bool Volume::remove(uint16_t id)
+{
+    uint32_t pix = _index[id];
+    Index index;
+    readIndex(pix, index);
+    deletePage(pix);
+    _index.erase(id);
+    for (uint16_t page : index.pages)
+        deletePage(page);
+    return flash().powered();
+}
+
+bool Volume::rename(uint16_t id, const char* to)
+{
+    if (strlen(to) >= NAME_LEN || !ensureFree(1))
+        return false;
+    uint32_t oldIndex = _index[id];
+    Index index;
+    readIndex(oldIndex, index);
+    index.name = to;
+    writeIndex(id, index);
+    deletePage(oldIndex);
+    return flash().powered();
+}
+
+std::vector<std::string> Volume::names()
+{
+    std::vector<std::string> out;
+    for (auto& entry : _index)
+    {
+        Index index;
+        readIndex(entry.second, index);
+        out.push_back(index.name);
+    }
+    return out;
+}
+
+size_t Volume::usedBytes() const
+{
+    size_t pages = 0;
+    for (uint16_t used : _used)
+        pages += used;
+    return pages * PAGE_SIZE;
+}
+} // namespace
+
+namespace fs
+{
+struct FileImpl {
+    std::string path;
+    bool writing = false;
+    bool directory = false;
+    uint16_t id = 0;
+    std::string data; // the whole file, read at open or written at flush
+    size_t pos = 0;
+    bool dirty = false;
+    size_t stored = 0; // bytes on the flash
+    std::vector<std::string> entries;
+    size_t nextEntry = 0;
+
+    ~FileImpl() { flush(); }
+    void flush()
+    {
+        if (!writing || !dirty)
+            return;
+        dirty = false;
+        stored = volume.mounted() && volume.write(id, data) ? data.size() : 0;
+    }
+};
+
+size_t File::write(uint8_t c) { return write(&c, 1); }
+
+size_t File::write(const uint8_t* buf, size_t len)
+{
+    if (!_p || !_p->writing)
+        return 0;
+    _p->data.append(reinterpret_cast<const char*>(buf), len);
+    _p->dirty = true;
+    return len;
+}
+
+int File::available() { return _p && !_p->writing ? static_cast<int>(_p->data.size() - _p->pos) : 0; }
+
+int File::read()
+{
+    if (!available())
+        return -1;
+    return static_cast<uint8_t>(_p->data[_p->pos++]);
+}
+
+int File::peek() { return available() ? static_cast<uint8_t>(_p->data[_p->pos]) : -1; }
+
+size_t File::read(uint8_t* buf, size_t len)
+{
+    size_t n = std::min<size_t>(len, available());
+    if (n)
+        memcpy(buf, _p->data.data() + _p->pos, n);
+    if (_p)
+        _p->pos += n;
+    return n;
+}
+
+void File::flush()
+{
+    if (_p)
+        _p->flush();
+}
+
+size_t File::position() const { return _p ? _p->pos : 0; }
+
+size_t File::size() const
+{
+    if (!_p)
+        return 0;
+    return !_p->writing || _p->dirty ? _p->data.size() : _p->stored;
+}
+
+void File::close()
+{
+    flush();
+    _p.reset();
+}
+
+const char* File::path() const { return _p ? _p->path.c_str() : ""; }
+
+const char* File::name() const
+{
+    const char* p = path();
+    const char* slash = strrchr(p, '/');
+    return slash ? slash + 1 : p;
+}
+
+bool File::isDirectory() const { return _p && _p->directory; }
+
+File File::openNextFile(const char* mode)
+{
+    if (!_p || !_p->directory || _p->nextEntry >= _p->entries.size())
+        return File();
+    return SPIFFS.open(_p->entries[_p->nextEntry++].c_str(), mode);
+}
+
+File FS::open(const char* path, const char* mode, bool)
+{
+    if (!volume.mounted())
+        return File();
+    std::shared_ptr<FileImpl> impl = std::make_shared<FileImpl>();
+    impl->path = path;
+    if (strcmp(path, "/") == 0)
+    {
+        impl->directory = true;
+        impl->entries = volume.names();
+        return File(impl);
+    }
+    uint16_t id = volume.find(path);
+    if (strcmp(mode, FILE_WRITE) == 0)
+    {
+        if (id != 0)
+            volume.remove(id);
+        impl->writing = true;
+        impl->id = volume.create(path);
+        return impl->id != 0 ? File(impl) : File();
+    }
+    if (strcmp(mode, FILE_READ) != 0 || id == 0)
+        return File();
+    impl->id = id;
+    volume.read(id, impl->data);
+    return File(impl);
+}
+
+bool FS::exists(const char* path) { return volume.mounted() && volume.find(path) != 0; }
+
+bool FS::remove(const char* path)
+{
+    uint16_t id = volume.mounted() ? volume.find(path) : 0;
+    return id != 0 && volume.remove(id);
+}
+
+bool FS::rename(const char* from, const char* to)
+{
+    if (!volume.mounted() || volume.find(to) != 0)
+        return false;
+    uint16_t id = volume.find(from);
+    return id != 0 && volume.rename(id, to);
+}
+
+bool SPIFFSFS::begin(bool formatOnFail, const char*, uint8_t, const char*)
+{
+    if (volume.mounted())
+        return true;
+    if (volume.mount())
+        return true;
+    return formatOnFail && volume.format() && volume.mount();
+}
+
+bool SPIFFSFS::format() { return volume.format() && volume.mount(); }
+size_t SPIFFSFS::totalBytes() { return volume.mounted() ? volume.totalBytes() : 0; }
+size_t SPIFFSFS::usedBytes() { return volume.mounted() ? volume.usedBytes() : 0; }
+void SPIFFSFS::end() { volume.unmount(); }
+} // namespace fs
@@ -0,0 +1,41 @@
+#ifndef HOST_SPIFFS_H
+#define HOST_SPIFFS_H
+
+// SPIFFS on the emulated NOR flash of NorFlash.h, laid out on the flash like the real one so the
+// write and erase traffic of a save is measured instead of estimated, and a remount after a power
+// cut finds what the device would:
+//  - 4 KB blocks of 16 pages of 256 bytes; the first page of a block is its lookup table
+//    (object id per page: free, deleted or in use) and ends with the block's erase count and magic
+//  - every page starts with a 5-byte header (object id, span index, flags); flags are cleared bit
+//    by bit: used, final, deleted
+//  - a file is an index page (size, name, data page list) plus data pages of 251 bytes. Creating
+//    a file writes an index page with undefined size; flush()/close() write the data pages and a
+//    new index page, then flag the old pages as deleted. A file holds at most 107 data pages.
+//  - rename writes a new index page, remove flags the index page first, then the data pages
+//  - pages are allocated from a cursor that walks the whole partition; when fewer than a block's
+//    worth of pages is free, garbage collection moves the live pages off the block with the best
+//    score (SPIFFS's weights for deleted pages, used pages and erase age) and erases it
+//  - mounting scans all blocks, erases a single block with a bad magic (an interrupted erase),
+//    keeps one complete index page per file (a finished file wins over one still being created)
+//    and flags everything unreferenced as deleted
+// Unlike SPIFFS, file contents are kept in RAM between open() and flush().
+
+#include "FS.h"
+#include "NorFlash.h"
+
+namespace fs
+{
+class SPIFFSFS : public FS {
+public:
+    bool begin(bool formatOnFail = false, const char* basePath = "/spiffs", uint8_t maxOpenFiles = 10,
+               const char* partitionLabel = nullptr);
+    bool format();
+    size_t totalBytes();
+    size_t usedBytes();
+    void end();
+};
+} // namespace fs
+
+extern fs::SPIFFSFS SPIFFS;
+
+#endif // HOST_SPIFFS_H
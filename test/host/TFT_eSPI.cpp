@@ -0,0 +1,285 @@
+#include "TFT_eSPI.h"
+
+namespace
+{
+// Classic 5x7 GLCD glyphs for 0x20..0x7E, one byte per column, bit 0 at the top
+const uint8_t FONT[][5] = {
+    {0x00, 0x00, 0x00, 0x00, 0x00}, {0x00, 0x00, 0x5F, 0x00, 0x00}, {0x00, 0x07, 0x00, 0x07, 0x00},
+    {0x14, 0x7F, 0x14, 0x7F, 0x14}, {0x24, 0x2A, 0x7F, 0x2A, 0x12}, {0x23, 0x13, 0x08, 0x64, 0x62},
+    {0x36, 0x49, 0x56, 0x20, 0x50}, {0x00, 0x08, 0x07, 0x03, 0x00}, {0x00, 0x1C, 0x22, 0x41, 0x00},
+    {0x00, 0x41, 0x22, 0x1C, 0x00}, {0x2A, 0x1C, 0x7F, 0x1C, 0x2A}, {0x08, 0x08, 0x3E, 0x08, 0x08},
+    {0x00, 0x80, 0x70, 0x30, 0x00}, {0x08, 0x08, 0x08, 0x08, 0x08}, {0x00, 0x00, 0x60, 0x60, 0x00},
+    {0x20, 0x10, 0x08, 0x04, 0x02}, {0x3E, 0x51, 0x49, 0x45, 0x3E}, {0x00, 0x42, 0x7F, 0x40, 0x00},
+    {0x72, 0x49, 0x49, 0x49, 0x46}, {0x21, 0x41, 0x49, 0x4D, 0x33}, {0x18, 0x14, 0x12, 0x7F, 0x10},
+    {0x27, 0x45, 0x45, 0x45, 0x39}, {0x3C, 0x4A, 0x49, 0x49, 0x31}, {0x41, 0x21, 0x11, 0x09, 0x07},
+    {0x36, 0x49, 0x49, 0x49, 0x36}, {0x46, 0x49, 0x49, 0x29, 0x1E}, {0x00, 0x00, 0x14, 0x00, 0x00},
+    {0x00, 0x40, 0x34, 0x00, 0x00}, {0x00, 0x08, 0x14, 0x22, 0x41}, {0x14, 0x14, 0x14, 0x14, 0x14},
+    {0x00, 0x41, 0x22, 0x14, 0x08}, {0x02, 0x01, 0x59, 0x09, 0x06}, {0x3E, 0x41, 0x5D, 0x59, 0x4E},
+    {0x7C, 0x12, 0x11, 0x12, 0x7C}, {0x7F, 0x49, 0x49, 0x49, 0x36}, {0x3E, 0x41, 0x41, 0x41, 0x22},
+    {0x7F, 0x41, 0x41, 0x41, 0x3E}, {0x7F, 0x49, 0x49, 0x49, 0x41}, {0x7F, 0x09, 0x09, 0x09, 0x01},
+    {0x3E, 0x41, 0x41, 0x51, 0x73}, {0x7F, 0x08, 0x08, 0x08, 0x7F}, {0x00, 0x41, 0x7F, 0x41, 0x00},
+    {0x20, 0x40, 0x41, 0x3F, 0x01}, {0x7F, 0x08, 0x14, 0x22, 0x41}, {0x7F, 0x40, 0x40, 0x40, 0x40},
+    {0x7F, 0x02, 0x1C, 0x02, 0x7F}, {0x7F, 0x04, 0x08, 0x10, 0x7F}, {0x3E, 0x41, 0x41, 0x41, 0x3E},
+    {0x7F, 0x09, 0x09, 0x09, 0x06}, {0x3E, 0x41, 0x51, 0x21, 0x5E}, {0x7F, 0x09, 0x19, 0x29, 0x46},
+    {0x26, 0x49, 0x49, 0x49, 0x32}, {0x03, 0x01, 0x7F, 0x01, 0x03}, {0x3F, 0x40, 0x40, 0x40, 0x3F},
+    {0x1F, 0x20, 0x40, 0x20, 0x1F}, {0x3F, 0x40, 0x38, 0x40, 0x3F}, {0x63, 0x14, 0x08, 0x14, 0x63},
+    {0x03, 0x04, 0x78, 0x04, 0x03}, {0x61, 0x59, 0x49, 0x4D, 0x43}, {0x00, 0x7F, 0x41, 0x41, 0x41},
+    {0x02, 0x04, 0x08, 0x10, 0x20}, {0x00, 0x41, 0x41, 0x41, 0x7F}, {0x04, 0x02, 0x01, 0x02, 0x04},
+    {0x40, 0x40, 0x40, 0x40, 0x40}, {0x00, 0x03, 0x07, 0x08, 0x00}, {0x20, 0x54, 0x54, 0x78, 0x40},
+    {0x7F, 0x28, 0x44, 0x44, 0x38}, {0x38, 0x44, 0x44, 0x44, 0x28}, {0x38, 0x44, 0x44, 0x28, 0x7F},
+    {0x38, 0x54, 0x54, 0x54, 0x18}, {0x00, 0x08, 0x7E, 0x09, 0x02}, {0x18, 0xA4, 0xA4, 0x9C, 0x78},
+    {0x7F, 0x08, 0x04, 0x04, 0x78}, {0x00, 0x44, 0x7D, 0x40, 0x00}, {0x20, 0x40, 0x40, 0x3D, 0x00},
+    {0x7F, 0x10, 0x28, 0x44, 0x00}, {0x00, 0x41, 0x7F, 0x40, 0x00}, {0x7C, 0x04, 0x78, 0x04, 0x78},
+    {0x7C, 0x08, 0x04, 0x04, 0x78}, {0x38, 0x44, 0x44, 0x44, 0x38}, {0xFC, 0x18, 0x24, 0x24, 0x18},
+    {0x18, 0x24, 0x24, 0x18, 0xFC}, {0x7C, 0x08, 0x04, 0x04, 0x08}, {0x48, 0x54, 0x54, 0x54, 0x24},
+    {0x04, 0x04, 0x3F, 0x44, 0x24}, {0x3C, 0x40, 0x40, 0x20, 0x7C}, {0x1C, 0x20, 0x40, 0x20, 0x1C},
+    {0x3C, 0x40, 0x30, 0x40, 0x3C}, {0x44, 0x28, 0x10, 0x28, 0x44}, {0x4C, 0x90, 0x90, 0x90, 0x7C},
+    {0x44, 0x64, 0x54, 0x4C, 0x44}, {0x00, 0x08, 0x36, 0x41, 0x00}, {0x00, 0x00, 0x77, 0x00, 0x00},
+    {0x00, 0x41, 0x36, 0x08, 0x00}, {0x02, 0x01, 0x02, 0x04, 0x02},
+};
+const uint8_t CHAR_W = 6;
+const uint8_t CHAR_H = 8;
+} // namespace
+
+TFT_eSPI::TFT_eSPI(int16_t w, int16_t h) : _width(w), _height(h), _nativeWidth(w), _nativeHeight(h) {}
+
+void TFT_eSPI::init()
+{
+    _buffer.assign(static_cast<size_t>(_width) * _height, TFT_BLACK);
+    _sleeping = false;
+}
+
+void TFT_eSPI::setRotation(uint8_t rotation)
+{
+    bool landscape = rotation & 1;
+    _width = landscape ? _nativeHeight : _nativeWidth;
+    _height = landscape ? _nativeWidth : _nativeHeight;
+    _buffer.assign(static_cast<size_t>(_width) * _height, TFT_BLACK);
+    _spi.commands++;
+}
+
+void TFT_eSPI::writecommand(uint8_t command)
+{
+    if (command == TFT_SLPIN)
+        _sleeping = true;
+    else if (command == TFT_SLPOUT)
+        _sleeping = false;
+    _spi.commands++;
+    _spi.bytes++;
+}
+
+void TFT_eSPI::transfer(int32_t w, int32_t h)
+{
+    _spi.windows++;
+    _spi.pixels += static_cast<uint64_t>(w) * h;
+    _spi.bytes += WINDOW_BYTES + static_cast<uint64_t>(w) * h * 2;
+}
+
+bool TFT_eSPI::clip(int32_t& x, int32_t& y, int32_t& w, int32_t& h) const
+{
+    if (x < 0)
+    {
+        w += x;
+        x = 0;
+    }
+    if (y < 0)
+    {
+        h += y;
+        y = 0;
+    }
+    if (x + w > _width)
+        w = _width - x;
+    if (y + h > _height)
+        h = _height - y;
+    return w > 0 && h > 0;
+}
+
+void TFT_eSPI::fillRect(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t color)
+{
+    if (!clip(x, y, w, h))
+        return;
+    uint16_t c = store(color);
+    for (int32_t row = y; row < y + h; row++)
+        std::fill_n(&_buffer[static_cast<size_t>(row) * _width + x], w, c);
+    transfer(w, h);
+}
+
+void TFT_eSPI::drawRect(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t color)
+{
+    drawFastHLine(x, y, w, color);
+    drawFastHLine(x, y + h - 1, w, color);
+    drawFastVLine(x, y + 1, h - 2, color);
+    drawFastVLine(x + w - 1, y + 1, h - 2, color);
+}
+
+uint16_t TFT_eSPI::readPixel(int32_t x, int32_t y) const
+{
+    if (x < 0 || y < 0 || x >= _width || y >= _height)
+        return 0;
+    return _buffer[static_cast<size_t>(y) * _width + x];
+}
+
+void TFT_eSPI::pushImage(int32_t x, int32_t y, int32_t w, int32_t h, const uint16_t* data)
+{
+    for (int32_t row = 0; row < h; row++)
+        for (int32_t col = 0; col < w; col++)
+        {
+            int32_t px = x + col;
+            int32_t py = y + row;
+            if (px >= 0 && py >= 0 && px < _width && py < _height)
+                _buffer[static_cast<size_t>(py) * _width + px] = store(data[row * w + col]);
+        }
+    int32_t cx = x, cy = y, cw = w, ch = h;
+    if (clip(cx, cy, cw, ch))
+        transfer(cw, ch);
+}
+
+// Transparent pixels are skipped; TFT_eSPI sends every opaque run in a window of its own
+void TFT_eSPI::pushImage(int32_t x, int32_t y, int32_t w, int32_t h, const uint16_t* data, uint16_t transparent)
+{
+    for (int32_t row = 0; row < h; row++)
+    {
+        int32_t col = 0;
+        while (col < w)
+        {
+            if (data[row * w + col] == transparent)
+            {
+                col++;
+                continue;
+            }
+            int32_t start = col;
+            while (col < w && data[row * w + col] != transparent)
+                col++;
+            pushImage(x + start, y + row, col - start, 1, &data[row * w + start]);
+        }
+    }
+}
+
+void TFT_eSPI::pushImageDMA(int32_t x, int32_t y, int32_t w, int32_t h, uint16_t* data)
+{
+    pushImage(x, y, w, h, data);
+}
+
+void TFT_eSPI::setTextColor(uint16_t fg, uint16_t bg)
+{
+    _textFg = fg;
+    _textBg = bg;
+}
+
+size_t TFT_eSPI::write(uint8_t c)
+{
+    if (c == '\n')
+    {
+        _cursorX = 0;
+        _cursorY += CHAR_H * _textSize;
+        return 1;
+    }
+    if (c == '\r')
+        return 1;
+    if (_textWrap && _cursorX + CHAR_W * _textSize > _width)
+    {
+        _cursorX = 0;
+        _cursorY += CHAR_H * _textSize;
+    }
+    drawChar(c);
+    _cursorX += CHAR_W * _textSize;
+    return 1;
+}
+
+// With a background colour the whole cell is one window; without, every set pixel is a
+// filled rectangle of textSize x textSize, which is what makes transparent text expensive
+void TFT_eSPI::drawChar(uint8_t c)
+{
+    const uint8_t* glyph = (c >= 0x20 && c < 0x7F) ? FONT[c - 0x20] : FONT['?' - 0x20];
+    int32_t s = _textSize;
+    bool opaque = _textBg != _textFg;
+    for (int32_t col = 0; col < CHAR_W; col++)
+    {
+        uint8_t bits = col < 5 ? glyph[col] : 0;
+        for (int32_t row = 0; row < CHAR_H; row++)
+        {
+            bool on = bits & (1 << row);
+            if (!on && !opaque)
+                continue;
+            int32_t x = _cursorX + col * s, y = _cursorY + row * s, w = s, h = s;
+            if (!clip(x, y, w, h))
+                continue;
+            uint16_t color = store(on ? _textFg : _textBg);
+            for (int32_t py = y; py < y + h; py++)
+                std::fill_n(&_buffer[static_cast<size_t>(py) * _width + x], w, color);
+            if (!opaque)
+                transfer(w, h);
+        }
+    }
+    if (opaque)
+    {
+        int32_t x = _cursorX, y = _cursorY, w = CHAR_W * s, h = CHAR_H * s;
+        if (clip(x, y, w, h))
+            transfer(w, h);
+    }
+}
+
+TFT_eSprite::TFT_eSprite(TFT_eSPI* tft) : TFT_eSPI(0, 0), _tft(tft) {}
+
+void* TFT_eSprite::createSprite(int16_t w, int16_t h, uint8_t)
+{
+    if (_created)
+        return _buffer.data();
+    _width = w;
+    _height = h;
+    _buffer.assign(static_cast<size_t>(w) * h, TFT_BLACK);
+    _created = true;
+    return _buffer.data();
+}
+
+void TFT_eSprite::deleteSprite()
+{
+    _buffer.clear();
+    _buffer.shrink_to_fit();
+    _width = 0;
+    _height = 0;
+    _created = false;
+}
+
+// 8-bit sprites hold RGB332; expand it back the way the panel receives it
+uint16_t TFT_eSprite::store(uint32_t color) const
+{
+    if (_depth == 16)
+        return color;
+    uint8_t r = (color >> 13) & 0x07;
+    uint8_t g = (color >> 8) & 0x07;
+    uint8_t b = (color >> 3) & 0x03;
+    return ((r * 31 / 7) << 11) | ((g * 63 / 7) << 5) | (b * 31 / 3);
+}
+
+void TFT_eSprite::pushSprite(int32_t x, int32_t y)
+{
+    if (_created)
+        _tft->pushImage(x, y, _width, _height, _buffer.data());
+}
+
+bool TFT_eSprite::pushSprite(int32_t x, int32_t y, int32_t sx, int32_t sy, int32_t sw, int32_t sh)
+{
+    if (!_created || !clip(sx, sy, sw, sh))
+        return false;
+    std::vector<uint16_t> part(static_cast<size_t>(sw) * sh);
+    for (int32_t row = 0; row < sh; row++)
+        std::copy_n(&_buffer[static_cast<size_t>(sy + row) * _width + sx], sw, &part[static_cast<size_t>(row) * sw]);
+    _tft->pushImage(x, y, sw, sh, part.data());
+    return true;
+}
+
+void TFT_eSprite::scroll(int16_t dx, int16_t dy)
+{
+    if (!_created)
+        return;
+    std::vector<uint16_t> moved(_buffer.size(), TFT_BLACK);
+    for (int32_t y = 0; y < _height; y++)
+        for (int32_t x = 0; x < _width; x++)
+        {
+            int32_t fromX = x - dx, fromY = y - dy;
+            if (fromX >= 0 && fromY >= 0 && fromX < _width && fromY < _height)
+                moved[static_cast<size_t>(y) * _width + x] = _buffer[static_cast<size_t>(fromY) * _width + fromX];
+        }
+    _buffer.swap(moved);
+}
@@ -0,0 +1,160 @@
+#ifndef HOST_TFT_ESPI_H
+#define HOST_TFT_ESPI_H
+
+#include <vector>
+#include "Arduino.h"
+
+// Framebuffer stand-in for the TFT_eSPI panel and sprite API the firmware uses. Drawing on
+// a TFT_eSPI lands in a RGB565 framebuffer and is counted as SPI traffic: every primitive
+// opens one address window (CASET + RASET + RAMWR, 11 bytes) and sends 2 bytes per pixel.
+// Sprites draw into their own buffer and only count when pushed. Text uses the 6x8 GLCD
+// font, scaled by the text size, like TFT_eSPI's built-in font 1.
+
+#ifndef TFT_WIDTH
+#define TFT_WIDTH 135
+#endif
+#ifndef TFT_HEIGHT
+#define TFT_HEIGHT 240
+#endif
+
+#define TFT_BLACK 0x0000
+#define TFT_NAVY 0x000F
+#define TFT_DARKGREEN 0x03E0
+#define TFT_DARKCYAN 0x03EF
+#define TFT_MAROON 0x7800
+#define TFT_PURPLE 0x780F
+#define TFT_OLIVE 0x7BE0
+#define TFT_LIGHTGREY 0xD69A
+#define TFT_DARKGREY 0x7BEF
+#define TFT_BLUE 0x001F
+#define TFT_GREEN 0x07E0
+#define TFT_CYAN 0x07FF
+#define TFT_RED 0xF800
+#define TFT_MAGENTA 0xF81F
+#define TFT_YELLOW 0xFFE0
+#define TFT_WHITE 0xFFFF
+#define TFT_ORANGE 0xFDA0
+#define TFT_GREENYELLOW 0xB7E0
+#define TFT_PINK 0xFE19
+
+#define TFT_SLPIN 0x10
+#define TFT_SLPOUT 0x11
+#define TFT_DISPOFF 0x28
+#define TFT_DISPON 0x29
+
+class TFT_eSPI : public Print {
+public:
+    TFT_eSPI(int16_t w = TFT_WIDTH, int16_t h = TFT_HEIGHT);
+
+    void init();
+    void begin() { init(); }
+    void setRotation(uint8_t rotation);
+    int16_t width() const { return _width; }
+    int16_t height() const { return _height; }
+
+    bool initDMA() { return _dmaAvailable; }
+    void startWrite() {}
+    void endWrite() {}
+    void dmaWait() {}
+    void pushImageDMA(int32_t x, int32_t y, int32_t w, int32_t h, uint16_t* data);
+    void pushImage(int32_t x, int32_t y, int32_t w, int32_t h, const uint16_t* data);
+    void pushImage(int32_t x, int32_t y, int32_t w, int32_t h, const uint16_t* data, uint16_t transparent);
+    void writecommand(uint8_t command);
+
+    void fillScreen(uint32_t color) { fillRect(0, 0, _width, _height, color); }
+    void fillRect(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t color);
+    void drawRect(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t color);
+    void drawFastVLine(int32_t x, int32_t y, int32_t h, uint32_t color) { fillRect(x, y, 1, h, color); }
+    void drawFastHLine(int32_t x, int32_t y, int32_t w, uint32_t color) { fillRect(x, y, w, 1, color); }
+    void drawPixel(int32_t x, int32_t y, uint32_t color) { fillRect(x, y, 1, 1, color); }
+    uint16_t readPixel(int32_t x, int32_t y) const;
+
+    void setTextColor(uint16_t fg) { setTextColor(fg, fg); }
+    void setTextColor(uint16_t fg, uint16_t bg);
+    void setTextSize(uint8_t size) { _textSize = size > 0 ? size : 1; }
+    void setTextWrap(bool wrap) { _textWrap = wrap; }
+    void setCursor(int16_t x, int16_t y)
+    {
+        _cursorX = x;
+        _cursorY = y;
+    }
+    int16_t getCursorX() const { return _cursorX; }
+    int16_t getCursorY() const { return _cursorY; }
+    size_t write(uint8_t c) override;
+    using Print::write;
+
+    static uint16_t color565(uint8_t r, uint8_t g, uint8_t b)
+    {
+        return ((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3);
+    }
+
+    // Emulator side: what went over the SPI bus since the last resetSpi()
+    struct SpiStats {
+        uint32_t windows;
+        uint32_t commands;
+        uint64_t pixels;
+        uint64_t bytes;
+    };
+    const SpiStats& spi() const { return _spi; }
+    void resetSpi() { _spi = {}; }
+    // Rows of width() RGB565 pixels, as shown on the panel
+    const uint16_t* framebuffer() const { return _buffer.data(); }
+    bool sleeping() const { return _sleeping; }
+    // Pretend the board has no DMA channel for the panel
+    void setDmaAvailable(bool available) { _dmaAvailable = available; }
+
+protected:
+    static const uint32_t WINDOW_BYTES = 11;
+
+    // Stores a colour the way the buffer holds it (sprites may be 8 bits deep)
+    virtual uint16_t store(uint32_t color) const { return color; }
+    // Counts one address window of w x h pixels; sprites count when they are pushed
+    virtual void transfer(int32_t w, int32_t h);
+    bool clip(int32_t& x, int32_t& y, int32_t& w, int32_t& h) const;
+    void drawChar(uint8_t c);
+
+    int16_t _width;
+    int16_t _height;
+    std::vector<uint16_t> _buffer;
+
+private:
+    int16_t _nativeWidth;
+    int16_t _nativeHeight;
+    int16_t _cursorX = 0;
+    int16_t _cursorY = 0;
+    uint8_t _textSize = 1;
+    uint16_t _textFg = TFT_WHITE;
+    uint16_t _textBg = TFT_WHITE; // same as fg: transparent background
+    bool _textWrap = true;
+    bool _dmaAvailable = true;
+    bool _sleeping = false;
+    SpiStats _spi = {};
+};
+
+class TFT_eSprite : public TFT_eSPI {
+public:
+    explicit TFT_eSprite(TFT_eSPI* tft);
+
+    void* createSprite(int16_t w, int16_t h, uint8_t frames = 1);
+    void deleteSprite();
+    bool created() const { return _created; }
+    void setColorDepth(int8_t bits) { _depth = bits == 8 ? 8 : 16; }
+    void* getPointer() { return _created ? _buffer.data() : nullptr; }
+
+    void fillSprite(uint32_t color) { fillRect(0, 0, _width, _height, color); }
+    void pushSprite(int32_t x, int32_t y);
+    bool pushSprite(int32_t x, int32_t y, int32_t sx, int32_t sy, int32_t sw, int32_t sh);
+    // Moves the content by dx/dy; the uncovered area is filled with black
+    void scroll(int16_t dx, int16_t dy = 0);
+
+protected:
+    uint16_t store(uint32_t color) const override;
+    void transfer(int32_t, int32_t) override {}
+
+private:
+    TFT_eSPI* _tft;
+    bool _created = false;
+    uint8_t _depth = 16;
+};
+
+#endif // HOST_TFT_ESPI_H
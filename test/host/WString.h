@@ -0,0 +1,77 @@
+#ifndef HOST_WSTRING_H
+#define HOST_WSTRING_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+// Arduino String on top of std::string
+class String {
+public:
+    String() {}
+    String(const char* s) : _s(s ? s : "") {}
+    String(const std::string& s) : _s(s) {}
+    String(char c) : _s(1, c) {}
+    String(int v) : _s(std::to_string(v)) {}
+    String(unsigned int v) : _s(std::to_string(v)) {}
+    String(long v) : _s(std::to_string(v)) {}
+    String(unsigned long v) : _s(std::to_string(v)) {}
+    String(float v, unsigned int decimals = 2) : String(static_cast<double>(v), decimals) {}
+    String(double v, unsigned int decimals = 2)
+    {
+        char buf[40];
+        snprintf(buf, sizeof(buf), "%.*f", decimals, v);
+        _s = buf;
+    }
+
+    const char* c_str() const { return _s.c_str(); }
+    unsigned int length() const { return _s.size(); }
+    bool isEmpty() const { return _s.empty(); }
+    char operator[](unsigned int i) const { return i < _s.size() ? _s[i] : 0; }
+    long toInt() const { return strtol(_s.c_str(), nullptr, 10); }
+    float toFloat() const { return strtof(_s.c_str(), nullptr); }
+    bool equals(const String& o) const { return _s == o._s; }
+    bool startsWith(const String& o) const { return _s.compare(0, o._s.size(), o._s) == 0; }
+    int indexOf(char c) const
+    {
+        size_t i = _s.find(c);
+        return i == std::string::npos ? -1 : static_cast<int>(i);
+    }
+    String substring(unsigned int from) const { return from < _s.size() ? String(_s.substr(from)) : String(); }
+    String substring(unsigned int from, unsigned int to) const
+    {
+        return from < _s.size() && to > from ? String(_s.substr(from, to - from)) : String();
+    }
+
+    String& operator+=(const String& o)
+    {
+        _s += o._s;
+        return *this;
+    }
+    String& operator+=(const char* o)
+    {
+        _s += o;
+        return *this;
+    }
+    String& operator+=(char c)
+    {
+        _s += c;
+        return *this;
+    }
+    bool operator==(const String& o) const { return _s == o._s; }
+    bool operator==(const char* o) const { return _s == o; }
+    bool operator!=(const String& o) const { return _s != o._s; }
+    bool operator!=(const char* o) const { return _s != o; }
+    bool operator<(const String& o) const { return _s < o._s; }
+
+    const std::string& str() const { return _s; }
+
+private:
+    std::string _s;
+};
+
+inline String operator+(const String& a, const String& b) { return String(a.str() + b.str()); }
+inline String operator+(const String& a, const char* b) { return String(a.str() + b); }
+inline String operator+(const char* a, const String& b) { return String(a + b.str()); }
+
+#endif // HOST_WSTRING_H
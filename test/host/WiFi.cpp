@@ -0,0 +1,122 @@
+#include "WiFi.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace
+{
+const int CONNECT_TIMEOUT_MS = 3000; // WiFiClient's default
+} // namespace
+
+int WiFiClient::connect(const char* host, uint16_t port)
+{
+    stop();
+    addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* res = nullptr;
+    char service[8];
+    snprintf(service, sizeof(service), "%u", port);
+    if (getaddrinfo(host, service, &hints, &res) != 0 || res == nullptr)
+        return 0;
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    int rc = fd < 0 ? -1 : ::connect(fd, res->ai_addr, res->ai_addrlen);
+    freeaddrinfo(res);
+    if (rc < 0 && fd >= 0 && errno == EINPROGRESS)
+    {
+        pollfd p = {fd, POLLOUT, 0};
+        int err = 0;
+        socklen_t len = sizeof(err);
+        if (poll(&p, 1, CONNECT_TIMEOUT_MS) == 1 && getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) == 0 && err == 0)
+            rc = 0;
+    }
+    if (rc < 0)
+    {
+        if (fd >= 0)
+            close(fd);
+        return 0;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    _fd = fd;
+    return 1;
+}
+
+size_t WiFiClient::write(const uint8_t* buf, size_t len)
+{
+    size_t sent = 0;
+    while (_fd >= 0 && sent < len)
+    {
+        ssize_t n = send(_fd, buf + sent, len - sent, MSG_NOSIGNAL);
+        if (n > 0)
+        {
+            sent += n;
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            pollfd p = {_fd, POLLOUT, 0};
+            poll(&p, 1, 100);
+            continue;
+        }
+        break;
+    }
+    return sent;
+}
+
+int WiFiClient::available()
+{
+    int n = 0;
+    if (_fd < 0 || ioctl(_fd, FIONREAD, &n) < 0)
+        return 0;
+    return n;
+}
+
+int WiFiClient::read()
+{
+    uint8_t c;
+    return read(&c, 1) == 1 ? c : -1;
+}
+
+int WiFiClient::read(uint8_t* buf, size_t size)
+{
+    if (_fd < 0)
+        return -1;
+    ssize_t n = recv(_fd, buf, size, 0);
+    return n > 0 ? static_cast<int>(n) : -1;
+}
+
+int WiFiClient::peek()
+{
+    uint8_t c;
+    if (_fd < 0 || recv(_fd, &c, 1, MSG_PEEK) != 1)
+        return -1;
+    return c;
+}
+
+void WiFiClient::stop()
+{
+    if (_fd >= 0)
+        close(_fd);
+    _fd = -1;
+}
+
+uint8_t WiFiClient::connected()
+{
+    if (_fd < 0)
+        return 0;
+    // Data still waiting counts as connected, like on the ESP32; a closed or reset socket does not
+    uint8_t c;
+    ssize_t n = recv(_fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+    if (n > 0 || (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)))
+        return 1;
+    stop();
+    return 0;
+}
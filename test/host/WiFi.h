@@ -0,0 +1,35 @@
+#ifndef HOST_WIFI_H
+#define HOST_WIFI_H
+
+// WiFiClient of the Arduino-ESP32 core on a POSIX TCP socket, so the MQTT code talks to a real
+// broker on the host. Like on the ESP32, connect() and write() block and connected() notices a
+// connection the peer closed. Nagle is switched off so back-to-back publishes are not held up by
+// delayed ACKs on the loopback interface, which the ESP32's lwIP would not see either.
+
+#include "Arduino.h"
+#include "Client.h"
+
+class WiFiClient : public Client {
+public:
+    WiFiClient() {}
+    ~WiFiClient() { stop(); }
+    WiFiClient(const WiFiClient&) = delete;
+    WiFiClient& operator=(const WiFiClient&) = delete;
+
+    int connect(const char* host, uint16_t port) override;
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t* buf, size_t len) override;
+    int available() override;
+    int read() override;
+    int read(uint8_t* buf, size_t size) override;
+    int peek() override;
+    void flush() override {}
+    void stop() override;
+    uint8_t connected() override;
+    operator bool() override { return connected(); }
+
+private:
+    int _fd = -1;
+};
+
+#endif // HOST_WIFI_H
@@ -0,0 +1,42 @@
+#ifndef HOST_CHECK_H
+#define HOST_CHECK_H
+
+#include <stdio.h>
+
+// Minimal assertions for the host tests: a failed check is reported and counted, the test
+// goes on, and main() returns checkResult() so ctest sees the failure.
+inline int checkFailures = 0;
+
+#define CHECK(cond)                                                                 \
+    do                                                                              \
+    {                                                                               \
+        if (!(cond))                                                                \
+        {                                                                           \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            checkFailures++;                                                        \
+        }                                                                           \
+    } while (0)
+
+#define CHECK_EQ(actual, expected)                                                                      \
+    do                                                                                                  \
+    {                                                                                                   \
+        auto a_ = (actual);                                                                             \
+        auto e_ = (expected);                                                                           \
+        if (!(a_ == e_))                                                                                \
+        {                                                                                               \
+            fprintf(stderr, "%s:%d: %s is %lld, expected %lld\n", __FILE__, __LINE__, #actual, (long long)a_, \
+                    (long long)e_);                                                                     \
+            checkFailures++;                                                                            \
+        }                                                                                               \
+    } while (0)
+
+inline int checkResult(const char* name)
+{
+    if (checkFailures)
+        fprintf(stderr, "%s: %d check(s) failed\n", name, checkFailures);
+    else
+        printf("%s: all checks passed\n", name);
+    return checkFailures ? 1 : 0;
+}
+
+#endif // HOST_CHECK_H
@@ -0,0 +1,9 @@
+#ifndef HOST_DRIVER_GPIO_H
+#define HOST_DRIVER_GPIO_H
+
+typedef int gpio_num_t;
+
+// Level as set by host::setPin()
+int gpio_get_level(gpio_num_t pin);
+
+#endif // HOST_DRIVER_GPIO_H
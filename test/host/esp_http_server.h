@@ -0,0 +1,18 @@
+#ifndef HOST_ESP_HTTP_SERVER_H
+#define HOST_ESP_HTTP_SERVER_H
+
+// Just enough of esp_http_server for Metrics.cpp; what MetricsWriter sends is dropped
+
+#include <sys/types.h>
+
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
+
+struct httpd_req_t {
+};
+
+inline esp_err_t httpd_resp_set_type(httpd_req_t*, const char*) { return ESP_OK; }
+inline esp_err_t httpd_resp_send_chunk(httpd_req_t*, const char*, ssize_t) { return ESP_OK; }
+
+#endif // HOST_ESP_HTTP_SERVER_H
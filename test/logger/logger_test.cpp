@@ -0,0 +1,87 @@
+// Secret redaction and the line ring of the Logger.
+
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "Logger.h"
+#include "check.h"
+
+namespace
+{
+bool collect(void* ctx, const Logger::Line& line)
+{
+    static_cast<std::vector<std::string>*>(ctx)->push_back(line.text);
+    return true;
+}
+
+std::string last(const Logger& log)
+{
+    std::vector<std::string> lines;
+    log.tail(1, collect, &lines);
+    return lines.empty() ? std::string() : lines.back();
+}
+
+void testRedact()
+{
+    static char password[40] = "hunter2";
+    static char user[40] = "";
+    Logger log;
+    log.addSecret(password);
+    log.addSecret(user);
+
+    log.log(LOG_LEVEL_INFO, "connect with hunter2, retry with hunter2");
+    CHECK(last(log) == "connect with ***, retry with ***");
+
+    // empty and two-character secrets are ignored
+    log.log(LOG_LEVEL_INFO, "user '%s'", user);
+    CHECK(last(log) == "user ''");
+    strcpy(user, "ab");
+    log.log(LOG_LEVEL_INFO, "ab cab");
+    CHECK(last(log) == "ab cab");
+
+    // the buffers are read at log time
+    strcpy(password, "s3cret");
+    log.log(LOG_LEVEL_INFO, "hunter2 s3crets3cret");
+    CHECK(last(log) == "hunter2 ******");
+
+    // a secret that matches its own mask used to loop forever
+    strcpy(password, "***");
+    log.log(LOG_LEVEL_INFO, "*** and ****");
+    CHECK(last(log) == "*** and ****");
+    strcpy(password, "**");
+    strcpy(user, "x**");
+    log.log(LOG_LEVEL_INFO, "xx** x**x**");
+    CHECK(last(log) == "x*** ******");
+
+    // overlapping occurrences: the first one wins, scanning goes on behind it
+    strcpy(password, "aaa");
+    log.log(LOG_LEVEL_INFO, "aaaaa");
+    CHECK(last(log) == "***aa");
+
+    // longer than a line: what is left of the secret after truncation stays visible
+    strcpy(password, "0123456789");
+    std::string longLine(Logger::LINE_LENGTH - 5, '.');
+    log.log(LOG_LEVEL_INFO, "%s0123456789", longLine.c_str());
+    CHECK(last(log) == longLine + "0123");
+}
+
+void testRing()
+{
+    Logger log;
+    for (int i = 0; i < Logger::SLOTS + 10; i++)
+        log.log(LOG_LEVEL_INFO, "line %d", i);
+    CHECK_EQ(log.written(), Logger::SLOTS + 10u);
+    std::vector<std::string> lines;
+    CHECK_EQ(log.tail(1000, collect, &lines), static_cast<size_t>(Logger::SLOTS));
+    CHECK(lines.front() == "line 10");
+    CHECK(lines.back() == "line " + std::to_string(Logger::SLOTS + 9));
+}
+} // namespace
+
+int main()
+{
+    testRedact();
+    testRing();
+    return checkResult("logger");
+}
@@ -0,0 +1,144 @@
+// Interrupt counting of the extra meter channels: S0 pulses, contact bounce and the JSON round trip.
+// host::setPin() runs the channel's edge interrupt, esp_timer_get_time() follows the virtual clock.
+
+#include "MeterChannels.h"
+#include "check.h"
+
+namespace
+{
+const uint8_t PIN = 25;
+
+// Drives the input like an open-collector S0 output or a reed contact to GND (active low). Each
+// edge can bounce: 'bounces' extra changes 200 us apart before the level settles.
+void pulse(uint32_t widthUs, uint32_t gapUs, int bounces = 0)
+{
+    for (int level : {LOW, HIGH})
+    {
+        for (int b = 0; b < bounces; b++)
+        {
+            host::setPin(PIN, level);
+            host::advanceMicros(100);
+            host::setPin(PIN, !level);
+            host::advanceMicros(100);
+        }
+        host::setPin(PIN, level);
+        host::advanceMicros(level == LOW ? widthUs : gapUs);
+    }
+}
+
+ChannelConfig s0Config()
+{
+    ChannelConfig config;
+    config.enabled = true;
+    config.pin = PIN;
+    config.activeLow = true;
+    config.pullup = true;
+    return config;
+}
+
+MeterChannels* fresh()
+{
+    static MeterChannels* channels = nullptr;
+    delete channels;
+    channels = new MeterChannels();
+    host::setPin(PIN, HIGH);
+    host::advanceMillis(1000);
+    channels->configure(1, s0Config());
+    host::advanceMillis(1000);
+    return channels;
+}
+
+// S0 (EN 62053-31): at least 30 ms active; meters pulse at up to about 10 Hz
+void testS0()
+{
+    MeterChannels& m = *fresh();
+    CHECK_EQ(ChannelConfig().debounceMs, 10u);
+    for (int i = 0; i < 100; i++)
+        pulse(30000, 70000);
+    CHECK_EQ(m.collect(), 1UL << 1);
+    CHECK_EQ(m.pulses[1], 100u);
+    CHECK_EQ(m.collect(), 0u);
+    // 16 Hz with 30 ms pulses leaves a 32 ms rest, still above the debounce time
+    for (int i = 0; i < 50; i++)
+        pulse(30000, 32000);
+    m.collect();
+    CHECK_EQ(m.pulses[1], 150u);
+}
+
+// A reed contact bounces on both edges; bounce at the release must not count as the next pulse
+void testBounce()
+{
+    MeterChannels& m = *fresh();
+    for (int i = 0; i < 40; i++)
+        pulse(400000, 1600000, 1 + i % 5);
+    m.collect();
+    CHECK_EQ(m.pulses[1], 40u);
+    // 4 ms of bounce per edge on a 30 ms S0-like pulse
+    for (int i = 0; i < 40; i++)
+        pulse(30000, 70000, 20);
+    m.collect();
+    CHECK_EQ(m.pulses[1], 80u);
+}
+
+// The ISR used to drop level changes inside the debounce window, so its state stuck at active and
+// the next pulse was lost. Now every change is tracked and only the rest before a pulse is checked.
+void testStateFollowsPin()
+{
+    MeterChannels& m = *fresh();
+    pulse(2000, 2000);   // counts: the input rested long enough before it
+    pulse(30000, 70000); // does not: 2 ms of rest is below the debounce time
+    pulse(30000, 70000);
+    m.collect();
+    CHECK_EQ(m.pulses[1], 2u);
+    // a glitch while idle: inactive -> active -> inactive in 1 ms, after a long rest, counts
+    host::setPin(PIN, LOW);
+    host::advanceMicros(1000);
+    host::setPin(PIN, HIGH);
+    host::advanceMillis(100);
+    pulse(30000, 70000);
+    m.collect();
+    CHECK_EQ(m.pulses[1], 4u);
+}
+
+void testJson()
+{
+    MeterChannels& m = *fresh();
+    for (int i = 0; i < 7; i++)
+        pulse(30000, 70000);
+    m.collect();
+    m.setValue(1, 12.5);
+    DynamicJsonDocument doc(1024);
+    m.toJson(doc.to<JsonArray>());
+    CHECK(!doc.overflowed());
+
+    MeterChannels restored;
+    host::setPin(PIN, HIGH);
+    restored.fromJson(doc.as<JsonArrayConst>());
+    CHECK(restored.enabled(1));
+    CHECK(!restored.dirty());
+    CHECK_EQ(restored.pulses[1], 7u);
+    CHECK_EQ(restored.offset[1], m.offset[1]);
+    CHECK(restored.value(1) > 12.49 && restored.value(1) < 12.51);
+    CHECK_EQ(restored.config(1).debounceMs, 10u);
+    CHECK(restored.config(1).activeLow);
+
+    // files written before debounceMs existed get the default
+    doc[0].as<JsonObject>().remove("debounceMs");
+    restored.fromJson(doc.as<JsonArrayConst>());
+    CHECK_EQ(restored.config(1).debounceMs, ChannelConfig().debounceMs);
+    // the restored channel counts through its own interrupt
+    host::advanceMillis(100);
+    pulse(30000, 70000);
+    CHECK_EQ(restored.collect(), 1UL << 1);
+    CHECK_EQ(restored.pulses[1], 8u);
+}
+} // namespace
+
+int main()
+{
+    testS0();
+    testBounce();
+    testStateFollowsPin();
+    testJson();
+    return checkResult("meter_channels");
+}
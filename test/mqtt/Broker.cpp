@@ -0,0 +1,469 @@
+#include "Broker.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+extern char** environ;
+
+namespace
+{
+const uint8_t CONNECT = 0x10;
+const uint8_t CONNACK = 0x20;
+const uint8_t PUBLISH = 0x30;
+const uint8_t PUBACK = 0x40;
+const uint8_t SUBSCRIBE = 0x80;
+const uint8_t SUBACK = 0x90;
+const uint8_t UNSUBSCRIBE = 0xA0;
+const uint8_t UNSUBACK = 0xB0;
+const uint8_t PINGREQ = 0xC0;
+const uint8_t PINGRESP = 0xD0;
+const uint8_t DISCONNECT = 0xE0;
+
+std::string findOnPath(const char* name)
+{
+    const char* path = getenv("PATH");
+    if (path == nullptr)
+        return "";
+    std::string dirs = path;
+    size_t start = 0;
+    while (start <= dirs.size())
+    {
+        size_t end = dirs.find(':', start);
+        if (end == std::string::npos)
+            end = dirs.size();
+        std::string candidate = dirs.substr(start, end - start) + "/" + name;
+        struct stat st;
+        if (end > start && stat(candidate.c_str(), &st) == 0 && S_ISREG(st.st_mode) && access(candidate.c_str(), X_OK) == 0)
+            return candidate;
+        start = end + 1;
+    }
+    return "";
+}
+
+int listenOn(uint16_t port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(fd, 8) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+uint16_t boundPort(int fd)
+{
+    sockaddr_in addr = {};
+    socklen_t len = sizeof(addr);
+    getsockname(fd, reinterpret_cast<sockaddr*>(&addr), &len);
+    return ntohs(addr.sin_port);
+}
+
+bool portAccepts(uint16_t port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    bool ok = connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0;
+    close(fd);
+    return ok;
+}
+
+std::string encodeLength(size_t len)
+{
+    std::string out;
+    do
+    {
+        uint8_t digit = len & 0x7F;
+        len >>= 7;
+        if (len > 0)
+            digit |= 0x80;
+        out += static_cast<char>(digit);
+    } while (len > 0);
+    return out;
+}
+
+// Reads a length-prefixed string at pos; false if the packet is short
+bool readString(const std::string& body, size_t& pos, std::string& out)
+{
+    if (pos + 2 > body.size())
+        return false;
+    size_t len = (static_cast<uint8_t>(body[pos]) << 8) | static_cast<uint8_t>(body[pos + 1]);
+    if (pos + 2 + len > body.size())
+        return false;
+    out = body.substr(pos + 2, len);
+    pos += 2 + len;
+    return true;
+}
+} // namespace
+
+Broker::Broker(bool builtin)
+{
+    if (!builtin)
+        _mosquitto = findOnPath("mosquitto");
+}
+
+bool Broker::start(uint16_t port)
+{
+    if (_running)
+        return true;
+    if (port != 0)
+        _port = port;
+    _running = _mosquitto.empty() ? startBuiltin() : startMosquitto();
+    return _running;
+}
+
+bool Broker::startMosquitto()
+{
+    if (_port == 0)
+    {
+        // let the kernel pick a free port, then hand it to mosquitto
+        int fd = listenOn(0);
+        if (fd < 0)
+            return false;
+        _port = boundPort(fd);
+        close(fd);
+    }
+    char port[8];
+    snprintf(port, sizeof(port), "%u", _port);
+    const char* argv[] = {_mosquitto.c_str(), "-p", port, nullptr};
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+    posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+    int rc = posix_spawn(&_pid, _mosquitto.c_str(), &actions, nullptr, const_cast<char**>(argv), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    if (rc != 0)
+    {
+        _pid = -1;
+        return false;
+    }
+    for (int i = 0; i < 500; i++)
+    {
+        if (portAccepts(_port))
+            return true;
+        usleep(10000);
+    }
+    kill(_pid, SIGKILL);
+    waitpid(_pid, nullptr, 0);
+    _pid = -1;
+    return false;
+}
+
+bool Broker::startBuiltin()
+{
+    _listenFd = listenOn(_port);
+    if (_listenFd < 0 || pipe(_wakeFd) < 0)
+        return false;
+    _port = boundPort(_listenFd);
+    _thread = std::thread(&Broker::run, this);
+    return true;
+}
+
+void Broker::stop()
+{
+    if (!_running)
+        return;
+    _running = false;
+    if (_pid > 0)
+    {
+        kill(_pid, SIGTERM);
+        waitpid(_pid, nullptr, 0);
+        _pid = -1;
+        return;
+    }
+    char c = 0;
+    if (write(_wakeFd[1], &c, 1) != 1)
+        perror("broker wake");
+    _thread.join();
+    for (Session& s : _sessions)
+        close(s.fd);
+    _sessions.clear();
+    _retained.clear();
+    close(_listenFd);
+    close(_wakeFd[0]);
+    close(_wakeFd[1]);
+    _listenFd = _wakeFd[0] = _wakeFd[1] = -1;
+}
+
+void Broker::run()
+{
+    std::vector<pollfd> fds;
+    for (;;)
+    {
+        fds.clear();
+        fds.push_back({_wakeFd[0], POLLIN, 0});
+        fds.push_back({_listenFd, POLLIN, 0});
+        for (const Session& s : _sessions)
+            fds.push_back({s.fd, static_cast<short>(POLLIN | (s.out.empty() ? 0 : POLLOUT)), 0});
+        if (poll(fds.data(), fds.size(), -1) < 0 && errno != EINTR)
+            return;
+        if (fds[0].revents)
+            return;
+        if (fds[1].revents & POLLIN)
+        {
+            int fd = accept(_listenFd, nullptr, nullptr);
+            if (fd >= 0)
+            {
+                int one = 1;
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                fcntl(fd, F_SETFL, O_NONBLOCK);
+                Session s;
+                s.fd = fd;
+                _sessions.push_back(s);
+            }
+        }
+        // sessions accepted above are polled from the next round on
+        for (size_t i = 0; i + 2 < fds.size(); i++)
+        {
+            Session& s = _sessions[i];
+            short ev = fds[i + 2].revents;
+            if (ev & (POLLIN | POLLHUP | POLLERR))
+            {
+                char buf[4096];
+                ssize_t n = read(s.fd, buf, sizeof(buf));
+                if (n > 0)
+                    s.in.append(buf, n);
+                else if (n == 0 || (errno != EAGAIN && errno != EINTR))
+                    s.closing = true;
+            }
+            // complete packets
+            while (!s.closing)
+            {
+                if (s.in.size() < 2)
+                    break;
+                size_t len = 0;
+                size_t pos = 1;
+                uint32_t multiplier = 1;
+                bool complete = false;
+                while (pos < s.in.size() && pos < 5)
+                {
+                    uint8_t digit = s.in[pos++];
+                    len += (digit & 0x7F) * multiplier;
+                    multiplier <<= 7;
+                    if (!(digit & 0x80))
+                    {
+                        complete = true;
+                        break;
+                    }
+                }
+                if (!complete || s.in.size() < pos + len)
+                    break;
+                uint8_t header = s.in[0];
+                std::string body = s.in.substr(pos, len);
+                s.in.erase(0, pos + len);
+                if (!handle(s, header, body))
+                    s.closing = true;
+            }
+            if (s.closing && s.willSet)
+            {
+                s.willSet = false;
+                route(s.willTopic, s.willPayload, s.willRetain);
+            }
+        }
+        for (Session& s : _sessions)
+        {
+            while (!s.out.empty())
+            {
+                ssize_t n = send(s.fd, s.out.data(), s.out.size(), MSG_NOSIGNAL);
+                if (n <= 0)
+                {
+                    if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+                        s.closing = true;
+                    break;
+                }
+                s.out.erase(0, n);
+            }
+        }
+        for (size_t i = 0; i < _sessions.size();)
+        {
+            if (_sessions[i].closing)
+            {
+                close(_sessions[i].fd);
+                _sessions.erase(_sessions.begin() + i);
+            }
+            else
+                i++;
+        }
+    }
+}
+
+bool Broker::handle(Session& s, uint8_t header, const std::string& body)
+{
+    uint8_t type = header & 0xF0;
+    if (!s.connected && type != CONNECT)
+        return false;
+    size_t pos = 0;
+    switch (type)
+    {
+    case CONNECT:
+    {
+        std::string protocol, clientId;
+        if (s.connected || !readString(body, pos, protocol) || pos + 4 > body.size())
+            return false;
+        uint8_t flags = body[pos + 1];
+        pos += 4; // level, flags, keep alive
+        if (!readString(body, pos, clientId))
+            return false;
+        if (flags & 0x04)
+        {
+            if (!readString(body, pos, s.willTopic) || !readString(body, pos, s.willPayload))
+                return false;
+            s.willSet = true;
+            s.willRetain = flags & 0x20;
+        }
+        // user name and password are accepted as they come
+        s.connected = true;
+        s.out += std::string{static_cast<char>(CONNACK), 2, 0, 0};
+        return true;
+    }
+    case PUBLISH:
+    {
+        std::string topic;
+        if (!readString(body, pos, topic))
+            return false;
+        uint8_t qos = (header >> 1) & 0x03;
+        if (qos > 0)
+        {
+            if (pos + 2 > body.size())
+                return false;
+            if (qos == 1)
+                s.out += std::string{static_cast<char>(PUBACK), 2, body[pos], body[pos + 1]};
+            pos += 2;
+        }
+        route(topic, body.substr(pos), header & 0x01);
+        return true;
+    }
+    case SUBSCRIBE:
+    case UNSUBSCRIBE:
+    {
+        if (body.size() < 2)
+            return false;
+        std::string ack{static_cast<char>(type == SUBSCRIBE ? SUBACK : UNSUBACK), 0, body[0], body[1]};
+        pos = 2;
+        std::vector<std::string> added;
+        while (pos < body.size())
+        {
+            std::string filter;
+            if (!readString(body, pos, filter))
+                return false;
+            if (type == SUBSCRIBE)
+            {
+                pos++; // requested QoS; 0 is granted
+                ack += '\0';
+                s.filters.push_back(filter);
+                added.push_back(filter);
+            }
+            else
+            {
+                for (size_t i = 0; i < s.filters.size();)
+                {
+                    if (s.filters[i] == filter)
+                        s.filters.erase(s.filters.begin() + i);
+                    else
+                        i++;
+                }
+            }
+        }
+        ack[1] = static_cast<char>(ack.size() - 2);
+        s.out += ack;
+        for (const std::string& filter : added)
+        {
+            for (const auto& kv : _retained)
+            {
+                if (matches(filter, kv.first))
+                    queuePublish(s, kv.first, kv.second, true);
+            }
+        }
+        return true;
+    }
+    case PINGREQ:
+        s.out += std::string{static_cast<char>(PINGRESP), 0};
+        return true;
+    case DISCONNECT:
+        s.willSet = false;
+        return false;
+    default:
+        return false;
+    }
+}
+
+void Broker::route(const std::string& topic, const std::string& payload, bool retain)
+{
+    if (retain)
+    {
+        if (payload.empty())
+            _retained.erase(topic);
+        else
+            _retained[topic] = payload;
+    }
+    for (Session& s : _sessions)
+    {
+        if (!s.connected || s.closing)
+            continue;
+        for (const std::string& filter : s.filters)
+        {
+            if (matches(filter, topic))
+            {
+                queuePublish(s, topic, payload, false);
+                _routed++;
+                break;
+            }
+        }
+    }
+}
+
+void Broker::queuePublish(Session& s, const std::string& topic, const std::string& payload, bool retain)
+{
+    s.out += static_cast<char>(PUBLISH | (retain ? 1 : 0));
+    s.out += encodeLength(2 + topic.size() + payload.size());
+    s.out += static_cast<char>(topic.size() >> 8);
+    s.out += static_cast<char>(topic.size() & 0xFF);
+    s.out += topic;
+    s.out += payload;
+}
+
+bool Broker::matches(const std::string& filter, const std::string& topic)
+{
+    size_t f = 0;
+    size_t t = 0;
+    for (;;)
+    {
+        size_t fEnd = filter.find('/', f);
+        size_t tEnd = topic.find('/', t);
+        std::string level = filter.substr(f, fEnd == std::string::npos ? std::string::npos : fEnd - f);
+        if (level == "#")
+            return true;
+        std::string part = topic.substr(t, tEnd == std::string::npos ? std::string::npos : tEnd - t);
+        if (level != "+" && level != part)
+            return false;
+        if (fEnd == std::string::npos || tEnd == std::string::npos)
+            return fEnd == std::string::npos && tEnd == std::string::npos;
+        f = fEnd + 1;
+        t = tEnd + 1;
+    }
+}
@@ -0,0 +1,71 @@
+#ifndef MQTT_BENCH_BROKER_H
+#define MQTT_BENCH_BROKER_H
+
+// Broker on 127.0.0.1 for the MQTT benchmark, stoppable to measure recovery: mosquitto when it is
+// on the PATH (started as `mosquitto -p <port>`, stopped with SIGTERM), otherwise an in-process
+// MQTT 3.1.1 broker in a thread. The built-in one covers what the firmware and the benchmark use:
+// QoS 0 delivery (QoS 1 publishes are acknowledged and delivered as QoS 0), retained messages,
+// '+'/'#' filters, last will, ping. Like mosquitto without persistence it forgets retained
+// messages when stopped.
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <atomic>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+class Broker {
+public:
+    // builtin forces the in-process broker even if mosquitto is installed
+    explicit Broker(bool builtin);
+    ~Broker() { stop(); }
+
+    // Port 0 picks a free one; restarts reuse it
+    bool start(uint16_t port = 0);
+    void stop();
+    bool running() const { return _running; }
+    uint16_t port() const { return _port; }
+    const char* kind() const { return _mosquitto.empty() ? "builtin" : "mosquitto"; }
+
+    // Messages routed by the built-in broker since construction (0 for mosquitto)
+    uint64_t routed() const { return _routed; }
+
+private:
+    struct Session {
+        int fd;
+        std::string in;
+        std::string out;
+        std::vector<std::string> filters;
+        bool connected = false;
+        bool willSet = false;
+        bool willRetain = false;
+        std::string willTopic;
+        std::string willPayload;
+        bool closing = false;
+    };
+
+    bool startMosquitto();
+    bool startBuiltin();
+    void run();
+    // false once the session must be dropped
+    bool handle(Session& s, uint8_t header, const std::string& body);
+    void route(const std::string& topic, const std::string& payload, bool retain);
+    static void queuePublish(Session& s, const std::string& topic, const std::string& payload, bool retain);
+    static bool matches(const std::string& filter, const std::string& topic);
+
+    std::string _mosquitto; // path of the executable, empty for the built-in broker
+    pid_t _pid = -1;
+    uint16_t _port = 0;
+    bool _running = false;
+
+    int _listenFd = -1;
+    int _wakeFd[2] = {-1, -1};
+    std::thread _thread;
+    std::vector<Session> _sessions;
+    std::map<std::string, std::string> _retained;
+    std::atomic<uint64_t> _routed{0};
+};
+
+#endif // MQTT_BENCH_BROKER_H
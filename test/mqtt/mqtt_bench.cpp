@@ -0,0 +1,351 @@
+// MQTT benchmark: the firmware's MQTT layer (src/Mqtt.cpp: reconnect_mqtt, publishGasVolume,
+// publishHassDiscovery, MQTTcallbackReceive) built for Linux and run against a broker on
+// 127.0.0.1, mosquitto if installed, the built-in one of Broker.h otherwise. A second client plays
+// Home Assistant and times when messages arrive. Prints one JSON document to compare runs:
+//
+//   mqtt_bench [--builtin] [--connects N] [--discoveries N] [--publishes N] [--burst N]
+//              [--sets N] [--restarts N] [--down-ms MS] [--retry-ms MS]
+//
+// Measured on the wall clock over loopback TCP, so the figures show the cost of the MQTT code
+// and the protocol round trips, not WiFi. The firmware's own waits are part of them: reconnect_mqtt()
+// spends 100 ms in its settle loops, and the device retries a lost broker only every 30 s
+// (MQTT_RECONNECT_INTERVAL); the benchmark retries every --retry-ms.
+
+#include <ArduinoJson.h>
+#include <WiFi.h>
+#include <sched.h>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Broker.h"
+#include "Metrics.h"
+#include "Mqtt.h"
+#include "check.h"
+
+// Device state main.cpp provides to the MQTT layer
+String clientID = "gasmeter-bench";
+const char* const version = "bench";
+MeterChannels meterChannels;
+uint32_t& pulseCount = meterChannels.pulses[0];
+uint32_t& offset = meterChannels.offset[0];
+AnomalyDetector anomalyDetector;
+CalendarStats calendarStats;
+bool clockSynced = false;
+volatile bool networkReady = true;
+Scheduler scheduler;
+Scheduler::JobId jobPublish;
+
+// Saving goes to SPIFFS on the device; only counted here
+uint32_t saves = 0;
+void saveDataToSPIFFS() { saves++; }
+void updateDisplay() {}
+
+namespace
+{
+void publishJob() {}
+
+// Sorted samples in microseconds
+struct Samples {
+    std::vector<uint64_t> us;
+
+    void add(uint64_t v) { us.push_back(v); }
+    uint64_t at(double p)
+    {
+        if (us.empty())
+            return 0;
+        std::sort(us.begin(), us.end());
+        return us[std::min(us.size() - 1, static_cast<size_t>(p * us.size()))];
+    }
+    void toJson(JsonObject out)
+    {
+        uint64_t sum = 0;
+        for (uint64_t v : us)
+            sum += v;
+        out["count"] = us.size();
+        out["meanUs"] = us.empty() ? 0 : sum / us.size();
+        out["p50Us"] = at(0.50);
+        out["p90Us"] = at(0.90);
+        out["p99Us"] = at(0.99);
+        out["maxUs"] = at(1.0);
+    }
+};
+
+// Home Assistant's side: subscribed to everything the device publishes
+struct Observer {
+    WiFiClient net;
+    PubSubClient mqtt{net};
+    std::map<std::string, std::string> last;
+    uint64_t received = 0;
+    uint64_t discovery = 0; // homeassistant/... config messages
+    uint64_t bytes = 0;
+
+    bool connect()
+    {
+        mqtt.setServer(mqtt_server, atoi(mqtt_port));
+        mqtt.setBufferSize(1024);
+        mqtt.setCallback([this](char* topic, uint8_t* payload, unsigned int length) {
+            last[topic] = std::string(reinterpret_cast<char*>(payload), length);
+            received++;
+            bytes += strlen(topic) + length;
+            if (strncmp(topic, "homeassistant/", 14) == 0)
+                discovery++;
+        });
+        if (!mqtt.connect("bench-observer"))
+            return false;
+        String device = clientID + "/#";
+        return mqtt.subscribe(device.c_str()) && mqtt.subscribe("homeassistant/#");
+    }
+    std::string value(const String& topic) const
+    {
+        auto it = last.find(topic.c_str());
+        return it == last.end() ? "" : it->second;
+    }
+};
+
+Observer observer;
+
+// Serves both clients until done() or the timeout; false on timeout
+template <typename Done>
+bool pump(uint32_t timeoutMs, Done done)
+{
+    unsigned long start = millis();
+    while (!done())
+    {
+        if (millis() - start >= timeoutMs)
+            return false;
+        client.loop();
+        observer.mqtt.loop();
+        sched_yield();
+    }
+    return true;
+}
+
+uint32_t option(int argc, char** argv, const char* name, uint32_t fallback)
+{
+    for (int i = 1; i + 1 < argc; i++)
+    {
+        if (strcmp(argv[i], name) == 0)
+            return strtoul(argv[i + 1], nullptr, 10);
+    }
+    return fallback;
+}
+
+bool flag(int argc, char** argv, const char* name)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], name) == 0)
+            return true;
+    }
+    return false;
+}
+
+// Discovery messages per announce: gas volume, current value, channels (disabled ones clear their
+// entity with an empty retained config), calendar sensors, alerts
+const uint32_t DISCOVERY_MESSAGES = 2 + (MeterChannels::MAX_CHANNELS - 1) + 6 + AnomalyDetector::ALERT_COUNT;
+} // namespace
+
+int main(int argc, char** argv)
+{
+    const uint32_t connects = option(argc, argv, "--connects", 10);
+    const uint32_t discoveries = option(argc, argv, "--discoveries", 20);
+    const uint32_t publishes = option(argc, argv, "--publishes", 200);
+    const uint32_t burst = option(argc, argv, "--burst", 5000);
+    const uint32_t sets = option(argc, argv, "--sets", 50);
+    const uint32_t restarts = option(argc, argv, "--restarts", 3);
+    const uint32_t downMs = option(argc, argv, "--down-ms", 200);
+    const uint32_t retryMs = option(argc, argv, "--retry-ms", 100);
+
+    host::useWallClock();
+    Broker broker(flag(argc, argv, "--builtin"));
+    if (!broker.start())
+    {
+        fprintf(stderr, "mqtt_bench: %s broker did not start\n", broker.kind());
+        return 1;
+    }
+    jobPublish = scheduler.once("publish", publishJob);
+    strlcpy(mqtt_server, "127.0.0.1", sizeof(mqtt_server));
+    snprintf(mqtt_port, sizeof(mqtt_port), "%u", broker.port());
+    mqtt_user[0] = '\0';
+    mqtt_password[0] = '\0';
+    client.setBufferSize(1024); // as in setup()
+
+    // one extra channel, so its state and discovery messages are part of the traffic
+    ChannelConfig water;
+    water.enabled = true;
+    water.pin = 25;
+    strlcpy(water.name, "Water", sizeof(water.name));
+    strlcpy(water.unit, "m³", sizeof(water.unit));
+    strlcpy(water.deviceClass, "water", sizeof(water.deviceClass));
+    strlcpy(water.topic, "measurement/water", sizeof(water.topic));
+    meterChannels.configure(1, water);
+    // retained configs a fresh subscriber gets
+    uint32_t retainedConfigs = DISCOVERY_MESSAGES - (MeterChannels::MAX_CHANNELS - 2);
+
+    CHECK(observer.connect());
+    DynamicJsonDocument report(4096);
+    report["broker"] = broker.kind();
+    report["port"] = broker.port();
+
+    // Connect: reconnect_mqtt() from a closed session, including the announce it ends with
+    Samples connectUs;
+    for (uint32_t i = 0; i < connects; i++)
+    {
+        if (client.connected())
+            client.disconnect();
+        hassDiscoveryPublished = false;
+        uint64_t t0 = host::nowMicros();
+        bool ok = reconnect_mqtt();
+        connectUs.add(host::nowMicros() - t0);
+        CHECK(ok);
+        CHECK(hassDiscoveryPublished);
+    }
+    JsonObject connect = report.createNestedObject("connect");
+    connectUs.toJson(connect);
+    connect["failures"] = metrics.mqttReconnectFailures;
+
+    // Discovery announce: time in publishHassDiscovery() and until the observer has every message
+    Samples announceUs, deliveredUs;
+    uint64_t announceBytes = metrics.mqttPublishBytes.get();
+    for (uint32_t i = 0; i < discoveries; i++)
+    {
+        uint64_t expected = observer.discovery + DISCOVERY_MESSAGES;
+        uint64_t t0 = host::nowMicros();
+        publishHassDiscovery();
+        announceUs.add(host::nowMicros() - t0);
+        CHECK(pump(5000, [&] { return observer.discovery >= expected; }));
+        deliveredUs.add(host::nowMicros() - t0);
+        CHECK(hassDiscoveryPublished);
+    }
+    JsonObject discovery = report.createNestedObject("discovery");
+    discovery["messages"] = DISCOVERY_MESSAGES;
+    discovery["bytes"] = discoveries ? (metrics.mqttPublishBytes.get() - announceBytes) / discoveries : 0;
+    announceUs.toJson(discovery.createNestedObject("announce"));
+    deliveredUs.toJson(discovery.createNestedObject("delivered"));
+
+    // Publish: publishGasVolume() per new reading, latency until the observer has the new state
+    const String stateTopic = clientID + "/" + mqtt_topic_gas + "/state";
+    Samples publishCallUs, publishLatencyUs;
+    uint32_t messagesBefore = metrics.mqttPublishOk;
+    for (uint32_t i = 0; i < publishes; i++)
+    {
+        pulseCount++;
+        char expected[16];
+        snprintf(expected, sizeof(expected), "%.2f", (pulseCount + offset) / 100.0f);
+        uint64_t t0 = host::nowMicros();
+        publishGasVolume();
+        publishCallUs.add(host::nowMicros() - t0);
+        CHECK(pump(5000, [&] { return observer.value(stateTopic) == expected; }));
+        publishLatencyUs.add(host::nowMicros() - t0);
+    }
+    JsonObject publish = report.createNestedObject("publish");
+    publish["messagesPerReading"] = publishes ? (metrics.mqttPublishOk - messagesBefore) / publishes : 0;
+    publishCallUs.toJson(publish.createNestedObject("call"));
+    publishLatencyUs.toJson(publish.createNestedObject("latency"));
+    publish["failed"] = metrics.mqttPublishFailed;
+
+    // Throughput: back-to-back mqttPublish() of the state topic, until the observer has them all
+    const String burstTopic = clientID + "/bench/burst";
+    uint64_t receivedBefore = observer.received;
+    uint64_t t0 = host::nowMicros();
+    uint32_t sent = 0;
+    char payload[16];
+    for (uint32_t i = 0; i < burst; i++)
+    {
+        snprintf(payload, sizeof(payload), "%lu.%02lu", static_cast<unsigned long>(i / 100),
+                 static_cast<unsigned long>(i % 100));
+        if (mqttPublish(burstTopic.c_str(), payload))
+            sent++;
+        client.loop();
+    }
+    uint64_t sendUs = host::nowMicros() - t0;
+    pump(10000, [&] { return observer.received - receivedBefore >= sent; });
+    uint64_t deliverUs = host::nowMicros() - t0;
+    uint64_t delivered = observer.received - receivedBefore;
+    JsonObject throughput = report.createNestedObject("throughput");
+    throughput["messages"] = burst;
+    throughput["sent"] = sent;
+    throughput["delivered"] = delivered;
+    throughput["sendMsgPerSec"] = sendUs ? sent * 1000000.0 / sendUs : 0;
+    throughput["deliveredMsgPerSec"] = deliverUs ? delivered * 1000000.0 / deliverUs : 0;
+    throughput["deliveredBytesPerSec"] =
+        deliverUs ? delivered * (burstTopic.length() + strlen(payload)) * 1000000.0 / deliverUs : 0;
+    CHECK_EQ(sent, burst);
+    CHECK_EQ(delivered, sent);
+
+    // Set value: the observer writes measurement/current, the device takes it over, saves and
+    // publishes; round trip until the observer sees the new state
+    const String currentTopic = clientID + "/" + mqtt_topic_currentVal;
+    Samples setUs, setDeviceUs;
+    uint32_t savesBefore = saves;
+    for (uint32_t i = 0; i < sets; i++)
+    {
+        char value[16];
+        snprintf(value, sizeof(value), "%lu.%02lu", 12000 + static_cast<unsigned long>(i), static_cast<unsigned long>(i % 100));
+        uint32_t setsBefore = metrics.mqttSetCount;
+        uint64_t t0 = host::nowMicros();
+        observer.mqtt.publish(currentTopic.c_str(), value);
+        CHECK(pump(5000, [&] { return observer.value(stateTopic) == value; }));
+        setUs.add(host::nowMicros() - t0);
+        CHECK_EQ(metrics.mqttSetCount, setsBefore + 1);
+        setDeviceUs.add(metrics.mqttSetLastUs);
+        CHECK_EQ(pulseCount, 0u);
+    }
+    JsonObject set = report.createNestedObject("set");
+    setUs.toJson(set.createNestedObject("roundTrip"));
+    setDeviceUs.toJson(set.createNestedObject("device"));
+    CHECK_EQ(saves - savesBefore, sets);
+
+    // Broker restart: stop it, see how long the client takes to notice, bring it back and retry
+    // reconnect_mqtt() every retryMs until the session and the announce are back
+    Samples noticedUs, recoveredUs;
+    uint32_t attempts = 0;
+    const String availabilityTopic = clientID + "/availability";
+    for (uint32_t i = 0; i < restarts; i++)
+    {
+        broker.stop();
+        uint64_t down = host::nowMicros();
+        CHECK(pump(5000, [&] { return !client.connected(); }));
+        noticedUs.add(host::nowMicros() - down);
+        CHECK_EQ(client.state(), MQTT_CONNECTION_LOST);
+        // the observer reads what was still in flight before it sees the loss
+        CHECK(pump(5000, [&] { return !observer.mqtt.connected(); }));
+        delay(downMs);
+        CHECK(broker.start());
+        uint64_t up = host::nowMicros();
+        bool back = false;
+        for (int tries = 0; tries < 50 && !back; tries++)
+        {
+            attempts++;
+            back = reconnect_mqtt();
+            if (!back)
+                delay(retryMs);
+        }
+        recoveredUs.add(host::nowMicros() - up);
+        CHECK(back);
+        CHECK(hassDiscoveryPublished);
+        // what Home Assistant finds after reconnecting: the retained announce and "online"
+        observer.last.clear();
+        uint64_t discoveryBefore = observer.discovery;
+        CHECK(observer.connect());
+        CHECK(pump(5000, [&] {
+            return observer.discovery - discoveryBefore >= retainedConfigs &&
+                   observer.value(availabilityTopic) == "online";
+        }));
+    }
+    JsonObject recovery = report.createNestedObject("recovery");
+    recovery["restarts"] = restarts;
+    recovery["downMs"] = downMs;
+    recovery["retryMs"] = retryMs;
+    recovery["attempts"] = attempts;
+    noticedUs.toJson(recovery.createNestedObject("noticed"));
+    recoveredUs.toJson(recovery.createNestedObject("recovered"));
+
+    CHECK(!report.overflowed());
+    serializeJsonPretty(report, Serial);
+    Serial.println();
+    broker.stop();
+    return checkResult("mqtt_bench");
+}
@@ -0,0 +1,43 @@
+#ifndef LEGACY_FORMAT_H
+#define LEGACY_FORMAT_H
+
+#include <iomanip>
+#include <locale>
+#include <sstream>
+#include <string>
+
+#include "NumberFormat.h"
+
+// formatWithHundredsSeparator() as it was before formatCentiValue() replaced it. On the device
+// std::locale("") is the C locale; the en/de styles correspond to the same code running with
+// a locale that groups by three, which the numpunct facet below provides.
+class Punct : public std::numpunct<char> {
+public:
+    Punct(char decimal, char group) : _decimal(decimal), _group(group) {}
+
+protected:
+    char do_decimal_point() const override { return _decimal; }
+    char do_thousands_sep() const override { return _group; }
+    std::string do_grouping() const override { return _group ? "\3" : ""; }
+
+private:
+    char _decimal;
+    char _group;
+};
+
+inline std::locale legacyLocale(NumberStyle style)
+{
+    if (style == NUMBER_STYLE_C)
+        return std::locale::classic();
+    return std::locale(std::locale::classic(), new Punct(decimalSeparator(style), groupSeparator(style)));
+}
+
+inline std::string legacyFormat(uint32_t value, const std::locale& locale)
+{
+    std::ostringstream oss;
+    oss.imbue(locale);
+    oss << std::fixed << std::setprecision(2) << (value / 100.0);
+    return oss.str();
+}
+
+#endif // LEGACY_FORMAT_H
@@ -0,0 +1,58 @@
+// Cost of formatting one meter value: formatCentiValue() against the ostringstream
+// formatter it replaced and plain snprintf("%.2f"). Heap allocations are counted too.
+//
+//   number_format_bench [iterations]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <new>
+
+#include "LegacyFormat.h"
+#include "NumberFormat.h"
+
+namespace
+{
+size_t allocations = 0;
+volatile size_t sink = 0; // keeps the results alive
+
+template <typename Fn>
+void run(const char* name, uint32_t iterations, Fn fn)
+{
+    size_t allocationsBefore = allocations;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < iterations; i++)
+        sink += fn(1234567 + i * 7919u);
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    printf("{\"name\":\"%s\",\"iterations\":%u,\"nsPerCall\":%.1f,\"allocsPerCall\":%.2f}\n", name, iterations,
+           ns / iterations, static_cast<double>(allocations - allocationsBefore) / iterations);
+}
+} // namespace
+
+void* operator new(size_t size)
+{
+    allocations++;
+    if (void* p = malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+int main(int argc, char** argv)
+{
+    uint32_t iterations = argc > 1 ? strtoul(argv[1], nullptr, 10) : 2000000;
+    const std::locale de = legacyLocale(NUMBER_STYLE_DE);
+    char buf[NUMBER_BUFFER_SIZE];
+
+    run("formatCentiValue_c", iterations, [&](uint32_t v) { return formatCentiValue(v, buf, sizeof(buf)); });
+    run("formatCentiValue_de", iterations,
+        [&](uint32_t v) { return formatCentiValue(v, buf, sizeof(buf), NUMBER_STYLE_DE); });
+    run("snprintf", iterations, [&](uint32_t v) {
+        return static_cast<size_t>(snprintf(buf, sizeof(buf), "%.2f", v / 100.0));
+    });
+    run("ostringstream_c", iterations / 10, [&](uint32_t v) { return legacyFormat(v, std::locale::classic()).size(); });
+    run("ostringstream_de", iterations / 10, [&](uint32_t v) { return legacyFormat(v, de).size(); });
+    return 0;
+}
@@ -0,0 +1,139 @@
+// formatCentiValue() against the ostringstream formatter it replaced, and back.
+//
+//   number_format_test [--full]
+//
+// By default every value up to 100,000.00 m3 is checked in all styles, plus every 997th value
+// and the digit-count boundaries over the rest of the uint32_t range. --full checks all 2^32
+// values (several minutes). The round trip runs on every value; the slow ostringstream
+// comparison on all values up to 1,000.00 and a spread beyond.
+
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "LegacyFormat.h"
+#include "NumberFormat.h"
+#include "check.h"
+
+namespace
+{
+const NumberStyle STYLES[] = {NUMBER_STYLE_C, NUMBER_STYLE_EN, NUMBER_STYLE_DE};
+const char* const STYLE_NAMES[] = {"C", "en", "de"};
+
+// Reads the text back; false if it is not a well-formed value in that style
+bool parse(const char* text, NumberStyle style, uint32_t& value)
+{
+    const char group = groupSeparator(style);
+    const char* decimal = strchr(text, decimalSeparator(style));
+    if (decimal == nullptr || strlen(decimal) != 3 || decimal == text)
+        return false;
+    uint64_t v = 0;
+    size_t digitsBeforeDecimal = 0;
+    for (const char* p = text; p < decimal; p++)
+    {
+        if (group && *p == group)
+        {
+            // groups of exactly three digits after the first one
+            if (p == text || (decimal - p - 1) % 4 != 3)
+                return false;
+            continue;
+        }
+        if (*p < '0' || *p > '9')
+            return false;
+        v = v * 10 + (*p - '0');
+        digitsBeforeDecimal++;
+    }
+    if (digitsBeforeDecimal > 1 && text[0] == '0')
+        return false;
+    for (const char* p = decimal + 1; *p; p++)
+    {
+        if (*p < '0' || *p > '9')
+            return false;
+        v = v * 10 + (*p - '0');
+    }
+    if (v > UINT32_MAX)
+        return false;
+    value = static_cast<uint32_t>(v);
+    return true;
+}
+
+uint64_t checked = 0;
+
+void checkValue(uint32_t value, bool compareLegacy, const std::locale* locales)
+{
+    for (size_t s = 0; s < 3; s++)
+    {
+        char buf[NUMBER_BUFFER_SIZE];
+        size_t n = formatCentiValue(value, buf, sizeof(buf), STYLES[s]);
+        uint32_t back = 0;
+        bool ok = n == strlen(buf) && n == centiValueLength(value, STYLES[s]) && parse(buf, STYLES[s], back) &&
+                  back == value;
+        if (ok && compareLegacy)
+            ok = legacyFormat(value, locales[s]) == buf;
+        if (!ok)
+        {
+            fprintf(stderr, "%s: %u printed as \"%s\" (legacy \"%s\")\n", STYLE_NAMES[s], value, buf,
+                    legacyFormat(value, locales[s]).c_str());
+            checkFailures++;
+        }
+    }
+    checked++;
+}
+
+// Output that does not fit is cut like snprintf does, and the full length is still returned
+void checkTruncation()
+{
+    char buf[NUMBER_BUFFER_SIZE];
+    for (size_t len = 0; len <= 14; len++)
+    {
+        memset(buf, 'x', sizeof(buf));
+        size_t n = formatCentiValue(4294967295u, buf, len, NUMBER_STYLE_DE);
+        CHECK_EQ(n, 13u);
+        if (len > 0)
+        {
+            CHECK_EQ(strlen(buf), len - 1 < 13 ? len - 1 : 13);
+            CHECK(strncmp(buf, "42.949.672,95", len - 1) == 0);
+        }
+        CHECK_EQ(buf[len], 'x'); // nothing written past len
+    }
+}
+
+// The helpers must be usable in constant expressions
+static_assert(integerDigits(0) == 1, "");
+static_assert(integerDigits(99999) == 3, "");
+static_assert(integerDigits(100000) == 4, "");
+static_assert(centiValueLength(123456789, NUMBER_STYLE_C) == 10, "");
+static_assert(centiValueLength(123456789, NUMBER_STYLE_EN) == 12, "");
+static_assert(centiValueLength(UINT32_MAX, NUMBER_STYLE_DE) == 13, "");
+static_assert(groupSeparator(NUMBER_STYLE_C) == 0 && decimalSeparator(NUMBER_STYLE_DE) == ',', "");
+} // namespace
+
+int main(int argc, char** argv)
+{
+    bool full = argc > 1 && strcmp(argv[1], "--full") == 0;
+    std::locale locales[3];
+    for (size_t s = 0; s < 3; s++)
+        locales[s] = legacyLocale(STYLES[s]);
+
+    checkTruncation();
+
+    if (full)
+    {
+        for (uint64_t v = 0; v <= UINT32_MAX; v++)
+            checkValue(static_cast<uint32_t>(v), v % 1009 == 0, locales);
+    }
+    else
+    {
+        for (uint32_t v = 0; v <= 10000000; v++)
+            checkValue(v, v <= 100000 || v % 101 == 0, locales);
+        for (uint64_t v = 10000000, i = 0; v <= UINT32_MAX; v += 997, i++)
+            checkValue(static_cast<uint32_t>(v), i % 16 == 0, locales);
+        for (uint64_t p = 1; p <= UINT32_MAX; p *= 10)
+            for (int64_t d = -2; d <= 2; d++)
+                if (static_cast<int64_t>(p) + d >= 0 && p + d <= UINT32_MAX)
+                    checkValue(static_cast<uint32_t>(p + d), true, locales);
+        checkValue(UINT32_MAX, true, locales);
+    }
+    printf("%llu values checked in %zu styles\n", (unsigned long long)checked, sizeof(STYLES) / sizeof(STYLES[0]));
+    return checkResult("number_format");
+}
@@ -0,0 +1,158 @@
+// Timer wheel, signals and capacity of the loop() scheduler, on the virtual clock.
+
+#include <vector>
+
+#include "Scheduler.h"
+#include "check.h"
+
+namespace
+{
+// Job functions are plain function pointers, so each test job is a template instance with its own counter
+std::vector<uint32_t> runsAt[Scheduler::MAX_JOBS + 1];
+
+template <int N>
+void job()
+{
+    runsAt[N].push_back(millis());
+}
+
+template <int... N>
+struct JobTable {
+    static constexpr Scheduler::JobFn fns[] = {job<N>...};
+};
+template <int... N>
+constexpr Scheduler::JobFn JobTable<N...>::fns[];
+
+template <int... N>
+constexpr const Scheduler::JobFn* makeTable(std::integer_sequence<int, N...>)
+{
+    return JobTable<N...>::fns;
+}
+const Scheduler::JobFn* const JOBS = makeTable(std::make_integer_sequence<int, Scheduler::MAX_JOBS + 1>());
+
+void reset()
+{
+    for (auto& r : runsAt)
+        r.clear();
+}
+
+// Runs the scheduler like loop() does: run(), then sleep for the returned wait
+void runFor(Scheduler& s, uint32_t ms)
+{
+    uint32_t end = millis() + ms;
+    while (static_cast<int32_t>(end - millis()) > 0)
+    {
+        uint32_t wait = s.run();
+        uint32_t left = end - millis();
+        host::advanceMillis(wait == 0 ? 1 : min(wait, left));
+    }
+}
+
+void testCapacity()
+{
+    reset();
+    Scheduler s;
+    s.begin();
+    Scheduler::JobId ids[Scheduler::MAX_JOBS];
+    for (int i = 0; i < Scheduler::MAX_JOBS; i++)
+    {
+        ids[i] = s.onEvent("event", JOBS[i]);
+        CHECK_EQ(ids[i], i);
+    }
+    CHECK_EQ(s.onEvent("one too many", JOBS[Scheduler::MAX_JOBS]), -1);
+    CHECK_EQ(s.jobCount(), Scheduler::MAX_JOBS);
+
+    // signals on the highest ids reach their jobs; the one that did not fit is ignored
+    s.signal(ids[Scheduler::MAX_JOBS - 1]);
+    s.signal(ids[16]);
+    s.signal(-1);
+    s.run();
+    CHECK_EQ(runsAt[Scheduler::MAX_JOBS - 1].size(), 1u);
+    CHECK_EQ(runsAt[16].size(), 1u);
+    CHECK_EQ(runsAt[Scheduler::MAX_JOBS].size(), 0u);
+    size_t total = 0;
+    for (auto& r : runsAt)
+        total += r.size();
+    CHECK_EQ(total, 2u);
+
+    // /api/scheduler serializes a full table into a 6144-byte document
+    DynamicJsonDocument doc(6144);
+    JsonObject root = doc.to<JsonObject>();
+    s.toJson(root.createNestedArray("jobs"));
+    root["dutyCycle"] = 0.5f;
+    root["uptime"] = millis();
+    CHECK(!doc.overflowed());
+    CHECK_EQ(doc["jobs"].size(), static_cast<size_t>(Scheduler::MAX_JOBS));
+}
+
+void testTimers()
+{
+    reset();
+    host::setMicros(5000000000ULL); // millis() wraps 32 bits after 49.7 days; start close to it below
+    Scheduler s;
+    s.begin();
+    Scheduler::JobId sampling = s.every("sampling", 50, JOBS[0]);
+    Scheduler::JobId save = s.once("save", JOBS[1]);
+    Scheduler::JobId slow = s.every("slow", 60000, JOBS[2], 1000);
+    s.schedule(save, 100UL * 60 * 1000); // many wheel turns away
+    uint32_t start = millis();
+
+    runFor(s, 2UL * 60 * 60 * 1000);
+    // a 50 ms job over two hours, never late by more than a wheel tick
+    CHECK(runsAt[0].size() >= 2UL * 60 * 60 * 20 - 1 && runsAt[0].size() <= 2UL * 60 * 60 * 20 + 1);
+    uint32_t maxGap = 0;
+    for (size_t i = 1; i < runsAt[0].size(); i++)
+        maxGap = max(maxGap, runsAt[0][i] - runsAt[0][i - 1]);
+    CHECK(maxGap <= 50 + Scheduler::TICK_MS);
+    CHECK(s.stats(sampling).maxJitterMs <= Scheduler::TICK_MS);
+
+    CHECK_EQ(runsAt[1].size(), 1u);
+    if (!runsAt[1].empty())
+    {
+        uint32_t late = runsAt[1][0] - start - 100UL * 60 * 1000;
+        CHECK(late <= Scheduler::TICK_MS);
+    }
+    CHECK_EQ(s.msUntil(save), UINT32_MAX);
+    CHECK_EQ(runsAt[2].size(), 120u);
+    CHECK(s.msUntil(slow) <= 60000);
+
+    // across the 32-bit millis() wrap
+    reset();
+    host::setMicros((0x100000000ULL - 30000) * 1000);
+    Scheduler w;
+    w.begin();
+    w.every("sampling", 50, JOBS[0]);
+    Scheduler::JobId once = w.once("save", JOBS[1]);
+    w.schedule(once, 60000);
+    runFor(w, 120000);
+    CHECK(runsAt[0].size() >= 2399 && runsAt[0].size() <= 2401);
+    CHECK_EQ(runsAt[1].size(), 1u);
+}
+
+void testSignals()
+{
+    reset();
+    Scheduler s;
+    s.begin();
+    Scheduler::JobId timer = s.every("timer", 100, JOBS[0], 100);
+    Scheduler::JobId event = s.onEvent("event", JOBS[1]);
+    CHECK(s.run() <= 100);
+    s.signal(event);
+    s.signal(event);
+    s.signal(timer); // a signalled timer job runs now and keeps its period
+    CHECK_EQ(s.run(), 100u);
+    CHECK_EQ(runsAt[1].size(), 1u);
+    CHECK_EQ(runsAt[0].size(), 1u);
+    host::advanceMillis(100);
+    s.run();
+    CHECK_EQ(runsAt[0].size(), 2u);
+}
+} // namespace
+
+int main()
+{
+    testCapacity();
+    testTimers();
+    testSignals();
+    return checkResult("scheduler");
+}
@@ -0,0 +1,575 @@
+// Weeks of gas meter operation compressed on the virtual clock. The loop() jobs that count, track
+// and persist the meter run on the real modules (Scheduler, ConsumptionHistory, AnomalyDetector,
+// CalendarStats, Logger, SPIFFSManager on the emulated NOR flash), wired and timed like main.cpp.
+// A scripted household drives the reed input; reboots at random times throw the RAM state away
+// and load it back from the flash. WiFi, MQTT and the web server are not simulated; a status page
+// poll renders the web API documents of these modules instead.
+//
+// Checks:
+//  - every boot loads the reading of the last save
+//  - the final reading is exact: the pulses the meter made while the device was up, minus the
+//    ones counted after the last save before each reboot
+//  - the scripted leak on day 9 raises the continuous-flow alert, no other day does
+//  - no ERROR or WARN log lines, no heap growth from day to day
+// Prints a JSON report: flash traffic and wear, heap high-water mark, loop pass time distribution.
+//
+//   soak_test [days]   (default 63; the partition is full after about eight weeks, then garbage collection runs)
+
+#include <malloc.h>
+#include <time.h>
+#include <chrono>
+#include <new>
+
+#include "AnomalyDetector.h"
+#include "CalendarStats.h"
+#include "ConsumptionHistory.h"
+#include "Logger.h"
+#include "NorFlash.h"
+#include "SPIFFSManager.h"
+#include "Scheduler.h"
+#include "check.h"
+
+namespace
+{
+// Usable size of the live allocations, so the peak is what the allocator had to provide
+struct HeapStats {
+    uint64_t allocations;
+    size_t live;
+    size_t peak;
+} heap;
+} // namespace
+
+void* operator new(size_t size)
+{
+    void* p = malloc(size ? size : 1);
+    if (!p)
+        throw std::bad_alloc();
+    heap.allocations++;
+    heap.live += malloc_usable_size(p);
+    heap.peak = std::max(heap.peak, heap.live);
+    return p;
+}
+
+void operator delete(void* p) noexcept
+{
+    if (!p)
+        return;
+    heap.live -= malloc_usable_size(p);
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept { operator delete(p); }
+
+namespace
+{
+// As in main.cpp
+#define REED_PIN 32
+#define HYSTERESIS_LOW 500.0
+#define HYSTERESIS_HIGH 4000.0
+constexpr unsigned long INTERRUPT_INTERVAL = 50;
+constexpr unsigned long SAVE_INTERVAL = 100 * 60 * 1000;
+constexpr unsigned long HOUSEKEEPING_INTERVAL = 100;
+constexpr unsigned long ANOMALY_CHECK_INTERVAL = 10 * 1000;
+constexpr unsigned long CALENDAR_CHECK_INTERVAL = 10 * 1000;
+
+constexpr unsigned long WEB_POLL_INTERVAL = 5 * 60 * 1000; // a status page open somewhere
+constexpr unsigned long SNTP_DELAY = 20 * 1000;            // clock set this long after boot
+constexpr time_t START_TIME = 1773615600;                  // Monday 2026-03-16 00:00 CET; summer time from day 14
+constexpr uint64_t DAY_MS = 24ULL * 60 * 60 * 1000;
+constexpr uint32_t LEAK_DAY = 8;
+constexpr uint32_t PULSE_MS = 2000; // reed contact closed per revolution of the last digit
+
+// Deterministic pseudo-random numbers (xorshift32)
+struct Random {
+    uint32_t state;
+    uint32_t next()
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+    uint32_t between(uint32_t lo, uint32_t hi) { return lo + next() % (hi - lo + 1); }
+};
+
+// The gas meter: flow per minute of the day from a heating and hot water profile, one pulse per
+// 0.01 m3. Each day's profile depends on the day only, so runs of different length agree.
+class Meter {
+public:
+    // Reed contact at world time t; t never goes back
+    bool closed(uint64_t t)
+    {
+        while (t >= _fall)
+            nextPulse();
+        return t >= _rise;
+    }
+    // Pulses that started up to t
+    uint64_t risen(uint64_t t)
+    {
+        closed(t);
+        return t >= _rise ? _pulses : _pulses - 1;
+    }
+
+private:
+    void planDay(uint32_t day)
+    {
+        Random r{0x9E3779B9u ^ (day + 1) * 2654435761u};
+        memset(_rate, 0, sizeof(_rate));
+        // burner cycles 05:00-22:00 at 1.2-1.8 m3/h with pauses of 12-45 minutes
+        for (uint32_t m = 5 * 60 + r.between(0, 30); m < 22 * 60;)
+        {
+            uint32_t on = r.between(6, 18);
+            float m3h = r.between(12, 18) / 10.0f;
+            for (uint32_t i = m; i < m + on && i < 22 * 60; i++)
+                _rate[i] += m3h;
+            m += on + r.between(12, 45);
+        }
+        // hot water, 2 m3/h
+        for (int draw = 0; draw < 4; draw++)
+        {
+            uint32_t m = r.between(6 * 60, 21 * 60);
+            uint32_t len = r.between(3, 10);
+            for (uint32_t i = m; i < m + len; i++)
+                _rate[i] += 2.0f;
+        }
+        // a dripping appliance, 0.15 m3/h from 01:00 to 07:00
+        if (day == LEAK_DAY)
+        {
+            for (uint32_t i = 60; i < 7 * 60; i++)
+                _rate[i] += 0.15f;
+        }
+        _day = day;
+    }
+
+    // Integrates the flow in 1 s steps up to the next 0.01 m3
+    void nextPulse()
+    {
+        uint64_t t = _fall;
+        for (;;)
+        {
+            uint32_t day = t / DAY_MS;
+            if (day != _day)
+                planDay(day);
+            _volume += _rate[t % DAY_MS / 60000] / 3600.0f * 100.0f; // pulses in this second
+            t += 1000;
+            if (_volume >= 1.0f)
+                break;
+        }
+        _volume -= 1.0f;
+        _rise = t;
+        _fall = t + PULSE_MS;
+        _pulses++;
+    }
+
+    float _rate[24 * 60]; // m3/h per minute of the day
+    uint32_t _day = UINT32_MAX;
+    float _volume = 0;
+    uint64_t _rise = UINT64_MAX;
+    uint64_t _fall = 0;
+    uint64_t _pulses = 0;
+};
+
+// Log2 buckets of a value, for percentiles without keeping the samples
+struct Distribution {
+    uint64_t buckets[40] = {};
+    uint64_t count = 0;
+    uint64_t max = 0;
+
+    void add(uint64_t v)
+    {
+        int b = 0;
+        while (b < 39 && (1ULL << b) <= v)
+            b++;
+        buckets[b]++;
+        count++;
+        if (v > max)
+            max = v;
+    }
+    // Upper bound of the bucket holding the p-th quantile
+    uint64_t atMost(double p) const
+    {
+        uint64_t rank = static_cast<uint64_t>(p * count);
+        uint64_t seen = 0;
+        for (int b = 0; b < 40; b++)
+        {
+            seen += buckets[b];
+            if (seen > rank)
+                return std::min<uint64_t>(max, b == 0 ? 0 : (1ULL << b) - 1);
+        }
+        return max;
+    }
+    void toJson(JsonObject out) const
+    {
+        out["passes"] = count;
+        out["p50"] = atMost(0.50);
+        out["p99"] = atMost(0.99);
+        out["p999"] = atMost(0.999);
+        out["max"] = max;
+        JsonArray hist = out.createNestedArray("histogram");
+        for (int b = 0; b < 40; b++)
+        {
+            if (buckets[b] == 0)
+                continue;
+            JsonObject o = hist.createNestedObject();
+            o["le"] = b == 0 ? 0 : (1ULL << b) - 1;
+            o["count"] = buckets[b];
+        }
+    }
+};
+
+// What the firmware keeps in RAM; gone at every reboot
+struct Device {
+    Scheduler scheduler;
+    SPIFFSManager storage;
+    ConsumptionHistory history;
+    AnomalyDetector anomaly;
+    CalendarStats calendar;
+    uint32_t pulseCount = 0;
+    uint32_t offset = 0;
+    uint32_t prevPulseCount = 0;
+    uint32_t prevOffset = 0;
+    bool lastState = false;
+    unsigned long lastPulseTime = 0;
+    bool clockSynced = false;
+    char mqttServer[40] = "192.168.178.203";
+    char mqttPort[6] = "1883";
+    char mqttUser[40] = "gas";
+    char mqttPassword[40] = "soak-secret";
+    char clientId[64] = "Gaszaehler_SOAK";
+    char topicGas[64] = "measurement/gas";
+    char topicCurrent[64] = "measurement/current";
+    Scheduler::JobId jobPulse = -1;
+    Scheduler::JobId jobSave = -1;
+};
+
+// The world around the device; survives reboots
+struct World {
+    Meter meter;
+    uint64_t bootMs = 0;        // world time of the running boot's millis() == 0
+    uint32_t savedReading = 0;  // last reading written to /data.json
+    uint64_t missedPulses = 0;  // made while the device was down
+    uint64_t lostPulses = 0;    // counted, but not saved before a reboot
+    uint32_t boots = 0;
+    uint32_t dataSaves = 0;
+    uint64_t flowAlertMs = UINT64_MAX;
+    uint32_t flowAlertDays = 0; // bit per day on which the continuous-flow alert was up
+    uint32_t logIssues = 0;
+    uint32_t logSeq = 0;
+    size_t dayHeap[64] = {};
+};
+
+// Static like the firmware's globals, so it does not count as heap
+alignas(Device) unsigned char deviceRam[sizeof(Device)];
+Device* device = nullptr;
+World* world = nullptr;
+
+uint64_t worldMs() { return world->bootMs + host::nowMicros() / 1000; }
+time_t wallClock() { return START_TIME + worldMs() / 1000; }
+
+uint8_t currentHourOfDay()
+{
+    if (!device->clockSynced)
+        return (millis() / 3600000UL) % 24;
+    time_t now = wallClock();
+    struct tm local;
+    localtime_r(&now, &local);
+    return local.tm_hour;
+}
+
+void saveCalendarStats()
+{
+    DynamicJsonDocument doc(512);
+    device->calendar.toJson(doc.to<JsonObject>());
+    if (device->storage.saveStats(doc))
+        device->calendar.clearDirty();
+}
+
+void saveDataToSPIFFS()
+{
+    Device& d = *device;
+    if (d.calendar.dirty())
+        saveCalendarStats();
+    if (d.pulseCount == d.prevPulseCount && d.offset == d.prevOffset)
+        return;
+    if (d.storage.saveData(d.pulseCount, d.offset, d.mqttServer, d.mqttPort, d.mqttUser, d.mqttPassword, d.clientId,
+                           d.topicGas, d.topicCurrent))
+    {
+        d.prevPulseCount = d.pulseCount;
+        d.prevOffset = d.offset;
+        world->savedReading = d.pulseCount + d.offset;
+        world->dataSaves++;
+    }
+}
+
+void samplingJob()
+{
+    Device& d = *device;
+    float voltage = analogRead(REED_PIN);
+    if (d.lastState && voltage <= HYSTERESIS_LOW)
+    {
+        d.lastState = false;
+    }
+    else if (!d.lastState && voltage > HYSTERESIS_HIGH)
+    {
+        d.lastState = true;
+        d.pulseCount++;
+        d.lastPulseTime = millis();
+        d.scheduler.signal(d.jobPulse);
+    }
+}
+
+void pulseJob()
+{
+    Device& d = *device;
+    d.history.onPulse(d.lastPulseTime);
+    d.anomaly.onPulse(d.lastPulseTime);
+    d.calendar.onPulse();
+}
+
+void housekeepingJob() { device->history.tick(millis()); }
+
+void anomalyJob()
+{
+    Device& d = *device;
+    d.anomaly.tick(millis(), currentHourOfDay());
+    if (d.anomaly.alerts() & AnomalyDetector::ALERT_CONTINUOUS_FLOW)
+    {
+        world->flowAlertMs = std::min(world->flowAlertMs, worldMs());
+        world->flowAlertDays |= 1u << std::min<uint64_t>(worldMs() / DAY_MS, 31);
+    }
+}
+
+void calendarJob()
+{
+    Device& d = *device;
+    if (millis() < SNTP_DELAY)
+        return;
+    if (!d.clockSynced)
+    {
+        d.clockSynced = true;
+        d.anomaly.restartHour();
+    }
+    if (d.calendar.tick(wallClock()))
+        saveCalendarStats();
+}
+
+void saveJob()
+{
+    saveDataToSPIFFS();
+    device->scheduler.schedule(device->jobSave, SAVE_INTERVAL);
+}
+
+// Renders what /api/status and /api/storage would serve
+void webPollJob()
+{
+    Device& d = *device;
+    DynamicJsonDocument doc(4096);
+    AnomalyDetector::statusToJson(d.anomaly.status(millis()), doc.createNestedObject("anomaly"));
+    d.calendar.toJson(doc.createNestedObject("calendar"));
+    d.storage.statsToJson(doc.createNestedObject("storage"));
+    uint16_t buckets[ConsumptionHistory::BUCKETS];
+    uint32_t head;
+    d.history.copy(buckets, head);
+    doc["flow"] = d.history.flowRateM3h(millis());
+    String out;
+    serializeJson(doc, out);
+    CHECK(!doc.overflowed());
+}
+
+void setup()
+{
+    Device& d = *device;
+    logger.addSecret(d.mqttPassword);
+    if (d.storage.begin())
+    {
+        char storedClientId[64] = "";
+        char storedTopic[64] = "";
+        char storedTopicCurrent[64] = "";
+        d.storage.loadData(d.pulseCount, d.offset, d.mqttServer, d.mqttPort, d.mqttUser, d.mqttPassword, storedClientId,
+                           storedTopic, storedTopicCurrent);
+    }
+    DynamicJsonDocument doc(512);
+    if (d.storage.loadStats(doc))
+        d.calendar.fromJson(doc.as<JsonObjectConst>());
+    d.prevPulseCount = d.pulseCount;
+    d.prevOffset = d.offset;
+
+    Scheduler& s = d.scheduler;
+    s.begin();
+    s.every("sampling", INTERRUPT_INTERVAL, samplingJob);
+    d.jobPulse = s.onEvent("pulse", pulseJob);
+    d.jobSave = s.once("save", saveJob);
+    s.every("housekeeping", HOUSEKEEPING_INTERVAL, housekeepingJob);
+    s.every("anomaly", ANOMALY_CHECK_INTERVAL, anomalyJob);
+    s.every("calendar", CALENDAR_CHECK_INTERVAL, calendarJob);
+    s.every("web_poll", WEB_POLL_INTERVAL, webPollJob, WEB_POLL_INTERVAL);
+    s.schedule(d.jobSave, SAVE_INTERVAL);
+}
+
+// Power comes back at world time bootMs after it went away at cutMs (with the contact open): a
+// fresh device boots from what the flash holds. Pulses that ended before the first sampling pass
+// were missed; one still in progress is counted by it.
+void boot(uint64_t cutMs, uint64_t bootMs)
+{
+    World& w = *world;
+    uint64_t before = w.meter.risen(cutMs);
+    w.bootMs = bootMs;
+    host::setMicros(0);
+    device = new (deviceRam) Device();
+    setup();
+    w.boots++;
+    CHECK_EQ(device->pulseCount + device->offset, w.savedReading);
+    uint64_t now = worldMs();
+    w.missedPulses += w.meter.risen(now) - before - (w.meter.closed(now) ? 1 : 0);
+}
+
+void powerCycle(uint64_t downMs)
+{
+    uint64_t cutMs = worldMs();
+    world->lostPulses += device->pulseCount + device->offset - world->savedReading;
+    device->~Device();
+    device = nullptr;
+    boot(cutMs, cutMs + downMs);
+}
+
+bool collectLogIssues(void* ctx, const Logger::Line& line)
+{
+    World& w = *static_cast<World*>(ctx);
+    if (line.seq < w.logSeq)
+        return true;
+    w.logSeq = line.seq + 1;
+    if (line.level <= LOG_LEVEL_WARN)
+    {
+        fprintf(stderr, "day %.2f: %s %s\n", worldMs() / double(DAY_MS), Logger::levelName(line.level), line.text);
+        w.logIssues++;
+    }
+    return true;
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+    uint32_t days = argc > 1 ? strtoul(argv[1], nullptr, 10) : 63;
+    setenv("TZ", "CET-1CEST,M3.5.0,M10.5.0/3", 1);
+    tzset();
+    auto hostStart = std::chrono::steady_clock::now();
+
+    world = new World();
+    World& w = *world;
+    // neither the world nor the emulated flash are the device's heap
+    host::spiffsFlash();
+    heap = HeapStats();
+    Random reboots{12345};
+    uint64_t endMs = days * DAY_MS;
+    uint64_t nextReboot = reboots.between(2 * 24, 6 * 24) * 3600000ULL;
+    uint64_t nextMidnight = DAY_MS;
+    Distribution loopUs;
+    Distribution hostNs;
+
+    // the flash starts erased, so the first boot formats it (and finds no /data.json)
+    boot(0, 0);
+    w.logSeq = logger.written();
+
+    for (;;)
+    {
+        // the run ends like a reboot, with the contact open and so every pulse sampled
+        uint64_t now = worldMs();
+        bool closed = w.meter.closed(now);
+        if (now >= endMs && !closed)
+            break;
+        host::setAnalog(REED_PIN, closed ? 4095 : 0);
+        auto t0 = std::chrono::steady_clock::now();
+        uint64_t v0 = host::nowMicros();
+        uint32_t wait = device->scheduler.run();
+        hostNs.add(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t0).count());
+        loopUs.add(host::nowMicros() - v0);
+        if (logger.written() != w.logSeq)
+            logger.tail(Logger::SLOTS, collectLogIssues, &w);
+
+        now = worldMs();
+        if (now >= nextMidnight)
+        {
+            uint32_t day = nextMidnight / DAY_MS;
+            if (day < 64)
+                w.dayHeap[day] = heap.live;
+            nextMidnight += DAY_MS;
+        }
+        // reboots happen with the contact open, and not during the scripted leak
+        uint64_t leakStart = LEAK_DAY * DAY_MS;
+        if (now >= nextReboot && !w.meter.closed(now) && !(now >= leakStart && now < leakStart + 8 * 3600000ULL))
+        {
+            powerCycle(reboots.between(3, 60) * 1000ULL);
+            nextReboot = worldMs() + reboots.between(2 * 24, 6 * 24) * 3600000ULL;
+            continue;
+        }
+        host::advanceMicros(static_cast<uint64_t>(wait) * 1000);
+    }
+
+    uint32_t reading = device->pulseCount + device->offset;
+    uint64_t made = w.meter.risen(worldMs());
+    uint64_t expected = made - w.missedPulses - w.lostPulses;
+    CHECK_EQ(reading, expected);
+    CHECK(w.boots > 1);
+    if (days > LEAK_DAY)
+    {
+        CHECK(w.flowAlertMs >= LEAK_DAY * DAY_MS + 5 * 3600000ULL);
+        CHECK(w.flowAlertMs <= LEAK_DAY * DAY_MS + 7 * 3600000ULL);
+        CHECK_EQ(w.flowAlertDays, 1u << LEAK_DAY);
+    }
+    CHECK_EQ(w.logIssues, 0u);
+    // the same work every day: the live heap after day 2 must not grow
+    for (uint32_t day = 3; day <= days && day < 64; day++)
+        CHECK(w.dayHeap[day] <= w.dayHeap[2]);
+
+    const host::NorFlash& flash = host::spiffsFlash();
+    const host::NorFlash::Counters& c = flash.counters();
+    uint32_t minErases = UINT32_MAX;
+    uint32_t maxErases = 0;
+    for (size_t s = 0; s < flash.sectors(); s++)
+    {
+        minErases = std::min(minErases, flash.sectorErases(s));
+        maxErases = std::max(maxErases, flash.sectorErases(s));
+    }
+    CHECK_EQ(c.bitsSet, 0u);
+    double hostSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - hostStart).count();
+
+    DynamicJsonDocument report(8192);
+    report["days"] = days;
+    report["hostSeconds"] = hostSeconds;
+    report["boots"] = w.boots;
+    JsonObject meter = report.createNestedObject("meter");
+    meter["pulses"] = made;
+    meter["missedWhileDown"] = w.missedPulses;
+    meter["lostSinceLastSave"] = w.lostPulses;
+    meter["expected"] = expected;
+    meter["reading"] = reading;
+    meter["dataSaves"] = w.dataSaves;
+    meter["continuousFlowAlertDay"] = w.flowAlertMs / double(DAY_MS);
+    JsonObject fl = report.createNestedObject("flash");
+    fl["sectors"] = flash.sectors();
+    fl["reads"] = c.reads;
+    fl["bytesRead"] = c.bytesRead;
+    fl["programs"] = c.programs;
+    fl["bytesProgrammed"] = c.bytesProgrammed;
+    fl["bytesProgrammedPerDay"] = c.bytesProgrammed / days;
+    fl["erases"] = c.erases; // the first boot formats every sector once
+    fl["minSectorErases"] = minErases;
+    fl["maxSectorErases"] = maxErases;
+    fl["busyMs"] = c.busyUs / 1000;
+    JsonObject h = report.createNestedObject("heap");
+    h["peakBytes"] = heap.peak;
+    h["liveBytes"] = heap.live;
+    h["allocations"] = heap.allocations;
+    h["allocationsPerDay"] = heap.allocations / days;
+    JsonObject loop = report.createNestedObject("loop");
+    loopUs.toJson(loop.createNestedObject("virtualUs")); // flash busy time, as the device would stall
+    hostNs.toJson(loop.createNestedObject("hostNs"));    // CPU time of the module code on this machine
+    device->storage.statsToJson(report.createNestedObject("storage"));
+    CHECK(!report.overflowed());
+    serializeJsonPretty(report, Serial);
+    Serial.println();
+
+    device->~Device();
+    delete world;
+    return checkResult("soak");
+}
@@ -0,0 +1,463 @@
+// SPIFFSManager on the emulated NOR flash: what a save and a load cost, how the flash wears over
+// a year, and what a power cut in the middle of a save leaves behind. The figures /api/storage
+// reports are estimates (whole pages per file, no SPIFFS bookkeeping, no garbage collection);
+// this measures the flash itself and prints both side by side.
+//
+//  - a year of saves as main.cpp makes them: /data.json every SAVE_INTERVAL if the reading
+//    changed, /stats.json when CalendarStats is dirty (midnight and the first pulse after a save).
+//    The pulses come from a household with gas heating and hot water whose heating follows the
+//    season, one pulse per 0.01 m3 (about 1500 m3 a year).
+//  - per file: save latency, flash programs, bytes programmed and erases per save, measured
+//    against the estimate; load and mount latency once the partition is in steady state
+//  - erases per sector over the year and the years until the most worn sector reaches 100k cycles
+//  - power cuts after every single flash operation of a plain save and of one that garbage
+//    collects: after the reboot /data.json holds the old or the new reading and the next save works
+//
+// Latencies are virtual time, charged by NorFlash with the datasheet timings of the flash chip.
+// Prints a JSON report.
+//
+//   storage_bench [days]   (default 365)
+
+#include <math.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <vector>
+
+#include "CalendarStats.h"
+#include "NorFlash.h"
+#include "SPIFFSManager.h"
+#include "check.h"
+
+namespace
+{
+// As in main.cpp
+constexpr uint32_t SAVE_INTERVAL_MIN = 100;
+
+constexpr time_t START_TIME = 1773615600; // Monday 2026-03-16 00:00 CET
+constexpr uint32_t START_DAY_OF_YEAR = 74;
+constexpr uint32_t CYCLE_RATING = 100000; // erase cycles per sector the flash is specified for
+
+// Deterministic pseudo-random numbers (xorshift32)
+struct Random {
+    uint32_t state;
+    uint32_t next()
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+    uint32_t between(uint32_t lo, uint32_t hi) { return lo + next() % (hi - lo + 1); }
+};
+
+// Flow per minute of the day, as the soak test's meter, with the heating scaled by the season:
+// every burner cycle in January, none from June to August
+class Household {
+public:
+    // Pulses in minute m since the start
+    uint32_t pulses(uint32_t m)
+    {
+        uint32_t day = m / (24 * 60);
+        if (day != _day)
+            planDay(day);
+        _volume += _rate[m % (24 * 60)] / 60.0f * 100.0f;
+        uint32_t n = static_cast<uint32_t>(_volume);
+        _volume -= n;
+        return n;
+    }
+
+private:
+    void planDay(uint32_t day)
+    {
+        Random r{0x9E3779B9u ^ (day + 1) * 2654435761u};
+        double doy = (START_DAY_OF_YEAR + day) % 365;
+        double heating = std::max(0.0, std::min(1.0, 0.45 + 0.6 * cos(2 * M_PI * (doy - 15) / 365)));
+        memset(_rate, 0, sizeof(_rate));
+        // burner cycles 05:00-22:00 at 1.2-1.8 m3/h with pauses of 12-45 minutes
+        for (uint32_t m = 5 * 60 + r.between(0, 30); m < 22 * 60;)
+        {
+            uint32_t on = r.between(6, 18);
+            float m3h = r.between(12, 18) / 10.0f;
+            if (r.next() % 1000 < heating * 1000)
+            {
+                for (uint32_t i = m; i < m + on && i < 22 * 60; i++)
+                    _rate[i] += m3h;
+            }
+            m += on + r.between(12, 45);
+        }
+        // hot water, 2 m3/h
+        for (int draw = 0; draw < 4; draw++)
+        {
+            uint32_t m = r.between(6 * 60, 21 * 60);
+            uint32_t len = r.between(3, 10);
+            for (uint32_t i = m; i < m + len; i++)
+                _rate[i] += 2.0f;
+        }
+        _day = day;
+    }
+
+    float _rate[24 * 60]; // m3/h per minute of the day
+    uint32_t _day = UINT32_MAX;
+    float _volume = 0;
+};
+
+// Samples of one quantity, kept to give exact percentiles
+struct Samples {
+    std::vector<uint64_t> values;
+
+    void add(uint64_t v) { values.push_back(v); }
+    void toJson(JsonObject out)
+    {
+        std::sort(values.begin(), values.end());
+        uint64_t sum = 0;
+        for (uint64_t v : values)
+            sum += v;
+        size_t n = values.size();
+        out["count"] = n;
+        out["mean"] = n ? static_cast<double>(sum) / n : 0.0;
+        out["p50"] = n ? values[n / 2] : 0;
+        out["p99"] = n ? values[std::min(n - 1, n * 99 / 100)] : 0;
+        out["max"] = n ? values[n - 1] : 0;
+    }
+};
+
+// What the saves of one file did to the flash
+struct SaveCost {
+    uint32_t saves = 0;
+    uint32_t failures = 0;
+    uint32_t collecting = 0; // saves during which garbage collection erased a block
+    uint64_t jsonBytes = 0;
+    uint64_t programs = 0;
+    uint64_t bytesProgrammed = 0;
+    uint64_t erases = 0;
+    Samples us;
+    Samples programmed;
+};
+
+struct Device {
+    SPIFFSManager storage;
+    CalendarStats calendar;
+    uint32_t pulseCount = 0;
+    uint32_t offset = 0;
+    uint32_t prevPulseCount = 0;
+    uint32_t prevOffset = 0;
+    char mqttServer[40] = "192.168.178.203";
+    char mqttPort[6] = "1883";
+    char mqttUser[40] = "gas";
+    char mqttPassword[40] = "bench-secret";
+    char clientId[64] = "Gaszaehler_BENCH";
+    char topicGas[64] = "measurement/gas";
+    char topicCurrent[64] = "measurement/current";
+} device;
+
+SaveCost dataCost;
+SaveCost statsCost;
+
+template <typename F>
+bool measure(SaveCost& cost, F save)
+{
+    const host::NorFlash::Counters before = host::spiffsFlash().counters();
+    uint64_t start = host::nowMicros();
+    bool ok = save();
+    uint64_t us = host::nowMicros() - start;
+    const host::NorFlash::Counters& after = host::spiffsFlash().counters();
+    if (!ok)
+    {
+        cost.failures++;
+        return false;
+    }
+    cost.saves++;
+    cost.jsonBytes += device.storage.lastWriteSize();
+    cost.programs += after.programs - before.programs;
+    cost.bytesProgrammed += after.bytesProgrammed - before.bytesProgrammed;
+    cost.erases += after.erases - before.erases;
+    if (after.erases > before.erases)
+        cost.collecting++;
+    cost.us.add(us);
+    cost.programmed.add(after.bytesProgrammed - before.bytesProgrammed);
+    return true;
+}
+
+bool saveData(uint32_t pulseCount, uint32_t offset)
+{
+    Device& d = device;
+    return d.storage.saveData(pulseCount, offset, d.mqttServer, d.mqttPort, d.mqttUser, d.mqttPassword, d.clientId,
+                              d.topicGas, d.topicCurrent);
+}
+
+// The reading in /data.json, UINT32_MAX if there is none
+uint32_t loadReading()
+{
+    Device& d = device;
+    uint32_t pulseCount = 0;
+    uint32_t offset = 0;
+    char server[40], port[6], user[40], password[40], clientId[64], topic[64], topicCurrent[64];
+    if (!d.storage.loadData(pulseCount, offset, server, port, user, password, clientId, topic, topicCurrent))
+        return UINT32_MAX;
+    return pulseCount + offset;
+}
+
+// As main.cpp's saveCalendarStats() and saveDataToSPIFFS()
+void saveCalendarStats()
+{
+    DynamicJsonDocument doc(512);
+    device.calendar.toJson(doc.to<JsonObject>());
+    if (measure(statsCost, [&] { return device.storage.saveStats(doc); }))
+        device.calendar.clearDirty();
+}
+
+void saveDataToSPIFFS()
+{
+    Device& d = device;
+    if (d.calendar.dirty())
+        saveCalendarStats();
+    if (d.pulseCount == d.prevPulseCount && d.offset == d.prevOffset)
+        return;
+    if (measure(dataCost, [&] { return saveData(d.pulseCount, d.offset); }))
+    {
+        d.prevPulseCount = d.pulseCount;
+        d.prevOffset = d.offset;
+    }
+}
+
+void remount()
+{
+    device.storage.end();
+    CHECK(device.storage.begin());
+}
+
+void costToJson(SaveCost& cost, JsonObjectConst estimate, JsonObject out)
+{
+    out["saves"] = cost.saves;
+    out["failures"] = cost.failures;
+    out["savesWithGc"] = cost.collecting;
+    out["jsonBytesPerSave"] = cost.saves ? static_cast<double>(cost.jsonBytes) / cost.saves : 0.0;
+    out["programsPerSave"] = cost.saves ? static_cast<double>(cost.programs) / cost.saves : 0.0;
+    out["erasesPerSave"] = cost.saves ? static_cast<double>(cost.erases) / cost.saves : 0.0;
+    out["writeAmplification"] = cost.jsonBytes ? static_cast<double>(cost.bytesProgrammed) / cost.jsonBytes : 0.0;
+    out["estimatedWriteAmplification"] = estimate["estimatedWriteAmplification"];
+    cost.programmed.toJson(out.createNestedObject("bytesProgrammed"));
+    cost.us.toJson(out.createNestedObject("saveUs"));
+}
+
+JsonObjectConst fileStats(JsonObjectConst storage, const char* path)
+{
+    for (JsonObjectConst f : storage["files"].as<JsonArrayConst>())
+    {
+        const char* p = f["path"];
+        if (p && strcmp(p, path) == 0)
+            return f;
+    }
+    return JsonObjectConst();
+}
+
+// Power cuts after each flash operation of saveData(next) from the flash state 'before', which
+// holds 'reading'. Every reboot must find the old or the new reading; the save after it must work.
+void sweepPowerCuts(const host::NorFlash& before, uint32_t reading, JsonObject out)
+{
+    host::NorFlash& flash = host::spiffsFlash();
+    uint32_t next = reading + 1;
+
+    // the uninterrupted save, to count its operations
+    flash = before;
+    remount();
+    host::NorFlash::Counters c0 = flash.counters();
+    CHECK(saveData(next, 0));
+    uint32_t ops = flash.counters().programs - c0.programs + flash.counters().erases - c0.erases;
+    uint32_t erases = flash.counters().erases - c0.erases;
+
+    uint32_t keptOld = 0;
+    uint32_t gotNew = 0;
+    uint32_t fromTmp = 0;
+    uint32_t broken = 0;
+    uint64_t bitsSet = 0;
+    DynamicJsonDocument stats(4096);
+    for (uint32_t cut = 1; cut <= ops; cut++)
+    {
+        flash = before;
+        remount();
+        flash.cutPowerAfter(cut);
+        saveData(next, 0);
+        CHECK(!flash.powered());
+        flash.powerOn();
+        remount();
+
+        uint32_t found = loadReading();
+        device.storage.statsToJson(stats.to<JsonObject>());
+        if (fileStats(stats.as<JsonObjectConst>(), "/data.json")["recovered"].as<bool>())
+            fromTmp++;
+        if (found == reading)
+            keptOld++;
+        else if (found == next)
+            gotNew++;
+        else
+        {
+            fprintf(stderr, "power cut after operation %u of %u: reading %u, expected %u or %u\n", cut, ops, found,
+                    reading, next);
+            broken++;
+        }
+        // the device goes on saving
+        CHECK(saveData(next + 1, 0));
+        CHECK_EQ(loadReading(), next + 1);
+        remount();
+        CHECK_EQ(loadReading(), next + 1);
+        bitsSet += flash.counters().bitsSet;
+    }
+    CHECK_EQ(broken, 0u);
+    CHECK_EQ(bitsSet, 0u);
+    out["flashOps"] = ops;
+    out["erases"] = erases;
+    out["keptOld"] = keptOld;
+    out["gotNew"] = gotNew;
+    out["fromTmp"] = fromTmp;
+    out["broken"] = broken;
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+    uint32_t days = argc > 1 ? strtoul(argv[1], nullptr, 10) : 365;
+    setenv("TZ", "CET-1CEST,M3.5.0,M10.5.0/3", 1);
+    tzset();
+
+    host::NorFlash& flash = host::spiffsFlash();
+    Device& d = device;
+    // the flash starts erased, so the first mount formats it
+    CHECK(d.storage.begin());
+    std::vector<uint32_t> formatErases(flash.sectors());
+    for (size_t s = 0; s < flash.sectors(); s++)
+        formatErases[s] = flash.sectorErases(s);
+    host::NorFlash::Counters formatted = flash.counters();
+
+    // The loop: pulses minute by minute, the calendar job, the save job every SAVE_INTERVAL
+    Household household;
+    uint64_t pulses = 0;
+    uint32_t minutes = days * 24 * 60;
+    for (uint32_t m = 0; m < minutes; m++)
+    {
+        host::setMicros(static_cast<uint64_t>(m) * 60 * 1000000);
+        for (uint32_t n = household.pulses(m); n > 0; n--)
+        {
+            d.pulseCount++;
+            d.calendar.onPulse();
+            pulses++;
+        }
+        if (d.calendar.tick(START_TIME + static_cast<time_t>(m) * 60))
+            saveCalendarStats();
+        if (m % SAVE_INTERVAL_MIN == SAVE_INTERVAL_MIN - 1)
+            saveDataToSPIFFS();
+    }
+    host::setMicros(static_cast<uint64_t>(minutes) * 60 * 1000000);
+    saveDataToSPIFFS();
+
+    DynamicJsonDocument storage(4096);
+    d.storage.statsToJson(storage.to<JsonObject>());
+    JsonObjectConst st = storage.as<JsonObjectConst>();
+
+    // wear over the run, without the erases of the format
+    uint32_t minErases = UINT32_MAX;
+    uint32_t maxErases = 0;
+    uint64_t totalErases = 0;
+    for (size_t s = 0; s < flash.sectors(); s++)
+    {
+        uint32_t e = flash.sectorErases(s) - formatErases[s];
+        minErases = std::min(minErases, e);
+        maxErases = std::max(maxErases, e);
+        totalErases += e;
+    }
+    const host::NorFlash::Counters& c = flash.counters();
+    CHECK_EQ(c.erases - formatted.erases, totalErases);
+    CHECK_EQ(c.bitsSet, 0u);
+    CHECK_EQ(dataCost.failures + statsCost.failures, 0u);
+    CHECK_EQ(loadReading(), d.pulseCount);
+    // SPIFFS spreads the erases: no sector more than twice the mean
+    double meanErases = static_cast<double>(totalErases) / flash.sectors();
+    CHECK(maxErases <= 2 * meanErases + 2);
+
+    // loads and the mount at boot, on the partition as the year left it
+    Samples loadUs;
+    Samples statsLoadUs;
+    Samples mountUs;
+    for (int i = 0; i < 50; i++)
+    {
+        uint64_t t0 = host::nowMicros();
+        d.storage.end();
+        CHECK(d.storage.begin());
+        uint64_t t1 = host::nowMicros();
+        CHECK_EQ(loadReading(), d.pulseCount);
+        uint64_t t2 = host::nowMicros();
+        DynamicJsonDocument doc(512);
+        CHECK(d.storage.loadStats(doc));
+        mountUs.add(t1 - t0);
+        loadUs.add(t2 - t1);
+        statsLoadUs.add(host::nowMicros() - t2);
+    }
+
+    DynamicJsonDocument report(16384);
+    report["days"] = days;
+    report["pulses"] = pulses;
+    report["m3"] = pulses / 100.0;
+    JsonObject files = report.createNestedObject("saves");
+    costToJson(dataCost, fileStats(st, "/data.json"), files.createNestedObject("/data.json"));
+    costToJson(statsCost, fileStats(st, "/stats.json"), files.createNestedObject("/stats.json"));
+    JsonObject loads = report.createNestedObject("loads");
+    mountUs.toJson(loads.createNestedObject("mountUs"));
+    loadUs.toJson(loads.createNestedObject("dataUs"));
+    statsLoadUs.toJson(loads.createNestedObject("statsUs"));
+
+    JsonObject wear = report.createNestedObject("wear");
+    wear["sectors"] = flash.sectors();
+    wear["usedBytes"] = st["usedBytes"];
+    wear["bytesProgrammed"] = c.bytesProgrammed - formatted.bytesProgrammed;
+    wear["erases"] = totalErases;
+    wear["minSectorErases"] = minErases;
+    wear["meanSectorErases"] = meanErases;
+    wear["maxSectorErases"] = maxErases;
+    double perYear = maxErases * 365.0 / days;
+    wear["maxSectorErasesPerYear"] = perYear;
+    wear["meanSectorErasesPerYear"] = meanErases * 365.0 / days;
+    wear["estimatedErasesPerBlockPerYear"] = st["estimatedErasesPerBlockPerYear"];
+    wear["estimatedProgrammedBytes"] = st["estimatedProgrammedBytes"];
+    wear["yearsToRating"] = perYear > 0 ? CYCLE_RATING / perYear : 0.0;
+    JsonArray histogram = wear.createNestedArray("sectorErases");
+    for (size_t s = 0; s < flash.sectors(); s++)
+        histogram.add(flash.sectorErases(s) - formatErases[s]);
+
+    // A plain save and one that garbage collects, each cut after every flash operation. The
+    // flash state before a save is kept until a save is found that erases.
+    JsonObject cuts = report.createNestedObject("powerCuts");
+    uint32_t reading = d.pulseCount;
+    host::NorFlash plain(0);
+    host::NorFlash collecting(0);
+    uint32_t plainReading = 0;
+    uint32_t collectingReading = 0;
+    for (int i = 0; i < 500 && (plain.size() == 0 || collecting.size() == 0); i++)
+    {
+        host::NorFlash before = flash;
+        uint64_t erases = flash.counters().erases;
+        CHECK(saveData(reading + 1, 0));
+        bool erased = flash.counters().erases > erases;
+        if (erased && collecting.size() == 0)
+        {
+            collecting = before;
+            collectingReading = reading;
+        }
+        else if (!erased && plain.size() == 0)
+        {
+            plain = before;
+            plainReading = reading;
+        }
+        reading++;
+    }
+    CHECK(plain.size() > 0 && collecting.size() > 0);
+    if (plain.size() > 0)
+        sweepPowerCuts(plain, plainReading, cuts.createNestedObject("plainSave"));
+    if (collecting.size() > 0)
+        sweepPowerCuts(collecting, collectingReading, cuts.createNestedObject("gcSave"));
+
+    CHECK(!report.overflowed());
+    serializeJsonPretty(report, Serial);
+    Serial.println();
+    return checkResult("storage_bench");
+}